@@ -0,0 +1,36 @@
+// Trivial shader the shader display modes draw with while their own
+// programs are still being compiled: the diffuse color map, lit from the
+// eye. It is built before any other, and without any permutations.
+
+[vert]
+
+#version 150 compatibility
+
+#include "include/vertex_decode.glsl"
+
+// data to be passed down to a later stage
+out vec3 normal;
+
+void main()
+{
+    normal = normalize(gl_NormalMatrix * DecodeNormal());
+    gl_Position = gl_ModelViewProjectionMatrix * DecodePosition();
+    gl_TexCoord[0] = gl_MultiTexCoord0;
+}
+
+[frag]
+
+#version 150 compatibility
+
+#include "include/texturing.glsl"
+
+// data passed down and interpolated from the vertex shader
+in vec3 normal;
+
+void main()
+{
+    float nDotE = max(0.0, normalize(normal).z);
+    vec4 color = gl_FrontMaterial.diffuse * ColorMap(gl_TexCoord[0].st);
+
+    gl_FragColor = vec4(color.rgb * (0.2 + 0.8 * nDotE), color.a);
+}
@@ -0,0 +1,27 @@
+// Vertex animation. ANIMATED is a permutation constant; without it the
+// position is passed through and the uniforms aren't declared.
+
+#ifndef ANIMATED
+#define ANIMATED 0
+#endif
+
+#if ANIMATED
+uniform float g_fFrameTime;
+uniform float g_fModelScale;    // model transform set by normalize(),
+uniform vec3 g_vModelOffset;    // see ModelOBJ::getTransform()
+#endif
+
+vec4 Animate(vec4 position)
+{
+#if ANIMATED
+    // The motion is made for the normalized model, so animate in its space
+    // and map back to the stored one.
+    vec3 p = (position.xyz + g_vModelOffset) * g_fModelScale;
+
+    p.x += sin(g_fFrameTime/300.0 + p.x * 5)*0.02 
+         * (cos(clamp(p.x*2, -1, 1)*3.1416)*0.5+0.5)
+         + sin(g_fFrameTime/2000.0)*0.3;
+    position.xyz = p / g_fModelScale - g_vModelOffset;
+#endif
+    return position;
+}
@@ -0,0 +1,96 @@
+// Blinn-Phong point lights.
+//
+// Permutation constants: LIGHT_INDEX selects the single light of a per-light
+// pass, otherwise lights 0 to LIGHT_COUNT - 1 are summed. Either way the
+// light indices are constants, so gl_LightSource is never indexed
+// dynamically.
+//
+// Built-in variables and states that are used:
+//
+// Light attributes:
+// gl_LightSource[i].position	: vec4	: position of lightsource i (same below)
+// gl_LightSource[i].ambient	: vec4	: ambient contribution
+// gl_LightSource[i].diffuse	: vec4	: diffuse contribution
+// gl_LightSource[i].specular	: vec4	: specular contribution
+//
+// Material attributes:
+// gl_FrontMaterial.shininess	: float : specular exponential term of the current shaded material
+// gl_FrontMaterial.ambient     : vec4  : ambient reflective factor
+// gl_FrontMaterial.diffuse     : vec4  : diffuse reflective factor
+// gl_FrontMaterial.specular    : vec4  : specular reflective factor
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 2
+#endif
+
+// light intensity accumulators
+vec4 Ambient;
+vec4 Diffuse;
+vec4 Specular;
+
+void pointLight(in int i, in vec3 normal, in vec3 eye, in vec3 ecPosition3)
+{
+    // Parameters: 
+    //   i: light index
+    //   normal: eye(view) space surface normal at the shaded point
+    //   eye: eye(view) space direction to the camera
+    //   ecPosition3: eye(view) space position of the shaded point
+
+    float nDotVP;       // normal . light direction
+    float nDotHV;       // normal . light half vector
+    float pf;           // power factor
+    float attenuation;  // computed attenuation factor
+    float d;            // distance from surface to light source
+    vec3  VP;           // direction from surface to light position
+    vec3  halfVector;   // direction of maximum highlights (Half vector defined by the *Blinn-Phong model*)
+
+    // Compute vector from surface to light position
+    VP = vec3 (gl_LightSource[i].position) - ecPosition3;
+
+    // Compute distance between surface and light position
+    d = length(VP);
+
+    // Normalize the vector from surface to light position
+    VP = normalize(VP);
+
+    // Compute attenuation
+    attenuation = 1.0 / (gl_LightSource[i].constantAttenuation +
+        gl_LightSource[i].linearAttenuation * d +
+        gl_LightSource[i].quadraticAttenuation * d * d);
+
+    halfVector = normalize(VP + eye);
+
+    nDotVP = max(0.0, dot(normal, VP));
+    nDotHV = max(0.0, dot(normal, halfVector));
+
+    pf = (nDotVP == 0.0) ? 0.0 : pow(nDotHV, gl_FrontMaterial.shininess);
+
+    Ambient  += gl_LightSource[i].ambient * attenuation;
+    Diffuse  += gl_LightSource[i].diffuse * nDotVP * attenuation;
+    Specular += gl_LightSource[i].specular * pf * attenuation;
+}
+
+// Clear the accumulators and add the contributions of the lights
+void computeLights(in vec3 normal, in vec3 ecPosition3)
+{
+    vec3 eye = vec3 (0.0, 0.0, 1.0);
+
+    Ambient  = vec4 (0.0);
+    Diffuse  = vec4 (0.0);
+    Specular = vec4 (0.0);
+
+#if defined(LIGHT_INDEX)
+    pointLight(LIGHT_INDEX, normal, eye, ecPosition3);
+#else
+    pointLight(0, normal, eye, ecPosition3);
+#if LIGHT_COUNT > 1
+    pointLight(1, normal, eye, ecPosition3);
+#endif
+#if LIGHT_COUNT > 2
+    pointLight(2, normal, eye, ecPosition3);
+#endif
+#if LIGHT_COUNT > 3
+    pointLight(3, normal, eye, ecPosition3);
+#endif
+#endif
+}
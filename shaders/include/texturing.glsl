@@ -0,0 +1,19 @@
+// Diffuse color map lookup. TEXTURED is a permutation constant; models
+// without textures use the variant that doesn't sample at all.
+
+#ifndef TEXTURED
+#define TEXTURED 1
+#endif
+
+#if TEXTURED
+uniform sampler2D colorMap;
+#endif
+
+vec4 ColorMap(vec2 texCoord)
+{
+#if TEXTURED
+    return texture2D(colorMap, texCoord);
+#else
+    return vec4(1.0);
+#endif
+}
@@ -0,0 +1,25 @@
+// Vertex decoding, see ModelOBJ::CompactVertex. For float vertices
+// g_bCompactVertices is false, g_vPositionScale is 1 and g_vPositionBias 0.
+
+uniform bool g_bCompactVertices;
+uniform vec3 g_vPositionScale;
+uniform vec3 g_vPositionBias;
+in vec2 vOctNormal;
+
+vec4 DecodePosition()
+{
+    return vec4(gl_Vertex.xyz * g_vPositionScale + g_vPositionBias, 1.0);
+}
+
+vec3 DecodeNormal()
+{
+    if (!g_bCompactVertices)
+        return gl_Normal;
+
+    // Unfold the octahedral encoding
+    vec3 n = vec3(vOctNormal, 1.0 - abs(vOctNormal.x) - abs(vOctNormal.y));
+    float t = max(-n.z, 0.0);
+    n.x += (n.x >= 0.0) ? -t : t;
+    n.y += (n.y >= 0.0) ? -t : t;
+    return normalize(n);
+}
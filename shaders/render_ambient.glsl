@@ -1,10 +1,13 @@
 //Per-fragment ambient light shader for two single directional light sources.
+//
+// Permutations: LIGHT_COUNT, TEXTURED and ANIMATED, see the files included.
 
 [vert]
 
 #version 150 compatibility
 
-uniform float g_fFrameTime;
+#include "include/vertex_decode.glsl"
+#include "include/animation.glsl"
 
 // data to be passed down to a later stage
 out vec3 normal;
@@ -12,13 +15,10 @@ out vec4 ecPosition;
 
 void main()
 {
-    normal = normalize(gl_NormalMatrix * gl_Normal);
-	vec4 vAnimatedPos = gl_Vertex;
-	//vAnimatedPos.x += sin(g_fFrameTime/300.0 + vAnimatedPos.x * 5)*0.02 
-					//* (cos(clamp(vAnimatedPos.x*2, -1, 1)*3.1416)*0.5+0.5)
-					//+ sin(g_fFrameTime/2000.0)*0.3;
+    normal = normalize(gl_NormalMatrix * DecodeNormal());
+	vec4 vAnimatedPos = Animate(DecodePosition());
 					
-    //// Eye-coordinate position of vertex, needed in various calculations
+    // Eye-coordinate position of vertex, needed in various calculations
     ecPosition = gl_ModelViewMatrix * vAnimatedPos;
 
     gl_Position = gl_ModelViewProjectionMatrix * vAnimatedPos;
@@ -29,75 +29,27 @@ void main()
 
 #version 150 compatibility
 
-uniform sampler2D colorMap;
+#include "include/texturing.glsl"
+#include "include/point_light.glsl"
 
 // data passed down and interpolated from the vertex shader
 in vec3 normal;
 in vec4 ecPosition;
 
-// global variables used in auxilary functions
-vec4 Ambient;
-vec4 Diffuse;
-vec4 Specular;
-
-void pointLight(in int i, in vec3 normal, in vec3 eye, in vec3 ecPosition3)
-{
-   float nDotVP;       // normal . light direction
-   float nDotHV;       // normal . light half vector
-   float pf;           // power factor
-   float attenuation;  // computed attenuation factor
-   float d;            // distance from surface to light source
-   vec3  VP;           // direction from surface to light position
-   vec3  halfVector;   // direction of maximum highlights
-
-   // Compute vector from surface to light position
-   VP = vec3 (gl_LightSource[i].position) - ecPosition3;
-
-   // Compute distance between surface and light position
-   d = length(VP);
-
-   // Normalize the vector from surface to light position
-   VP = normalize(VP);
-
-   // Compute attenuation
-   attenuation = 1.0 / (gl_LightSource[i].constantAttenuation +
-       gl_LightSource[i].linearAttenuation * d +
-       gl_LightSource[i].quadraticAttenuation * d * d);
-
-   halfVector = normalize(VP + eye);
-
-   nDotVP = max(0.0, dot(normal, VP));
-   nDotHV = max(0.0, dot(normal, halfVector));
-
-   pf = (nDotVP == 0.0) ? 0.0 : pow(nDotHV, gl_FrontMaterial.shininess);
-
-   Ambient  += gl_LightSource[i].ambient * attenuation;
-   Diffuse  += gl_LightSource[i].diffuse * nDotVP * attenuation;
-   Specular += gl_LightSource[i].specular * pf * attenuation;
-}
-
-
 void main()
 {   
     vec3 n = normalize(normal);
 
     vec3 ecPosition3 = (vec3 (ecPosition)) / ecPosition.w;
 
-	// Clear the light intensity accumulators
-    Ambient  = vec4 (0.0);
-    Diffuse  = vec4 (0.0);
-    Specular = vec4 (0.0);
-    vec3 eye = vec3 (0.0, 0.0, 1.0);
-    
     // Compute point light contributions
-    pointLight(0, n, eye, ecPosition3);
-    pointLight(1, n, eye, ecPosition3);
+    computeLights(n, ecPosition3);
     
     // Render ambient light only
     vec4 color = gl_FrontLightModelProduct.sceneColor +
 		Ambient * gl_FrontMaterial.ambient;
 
-    color *= texture2D(colorMap, gl_TexCoord[0].st);
+    color *= ColorMap(gl_TexCoord[0].st);
     color = clamp( color, 0.0, 1.0 );
     gl_FragColor = color;
 }
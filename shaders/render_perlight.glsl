@@ -0,0 +1,102 @@
+//Per-fragment diffuse/specular lighting shader (Phong shading) for a particular single directional light source.
+//
+// Permutations: LIGHT_INDEX, TEXTURED and ANIMATED, see the files included.
+// SHADOW_MAP tests the light's shadow map, bound to texture unit 1 with the
+// light's projection in texture matrix 1. Without it the shadows are left
+// to the stencil buffer of the shadow volume pass.
+
+[vert]
+
+#version 150 compatibility
+
+#ifndef SHADOW_MAP
+#define SHADOW_MAP 0
+#endif
+
+#include "include/vertex_decode.glsl"
+#include "include/animation.glsl"
+
+// data to be passed down to a later stage
+out vec3 normal;
+out vec4 ecPosition;
+#if SHADOW_MAP
+out vec4 shadowCoord;
+#endif
+
+void main()
+{
+    normal = normalize(gl_NormalMatrix * DecodeNormal());
+	vec4 vAnimatedPos = Animate(DecodePosition());
+					
+    // Eye-coordinate position of vertex, needed in various calculations
+    ecPosition = gl_ModelViewMatrix * vAnimatedPos;
+
+    gl_Position = gl_ModelViewProjectionMatrix * vAnimatedPos;
+    
+#if SHADOW_MAP
+    // Compute shadow map coordinate (including depth)
+    shadowCoord= gl_TextureMatrix[1] * vAnimatedPos; 
+#endif
+    
+    gl_TexCoord[0] = gl_MultiTexCoord0;
+}
+
+[frag]
+
+#version 150 compatibility
+
+#ifndef SHADOW_MAP
+#define SHADOW_MAP 0
+#endif
+
+#include "include/texturing.glsl"
+#include "include/point_light.glsl"
+
+// data passed down and interpolated from the vertex shader
+in vec3 normal;
+in vec4 ecPosition;
+
+#if SHADOW_MAP
+uniform sampler2D shadowMap;
+uniform float shadowZOffset = 1e-5;
+in vec4 shadowCoord;
+#endif
+
+void main()
+{   
+    vec3 n = normalize(normal);
+
+    vec3 ecPosition3 = (vec3 (ecPosition)) / ecPosition.w;
+
+    // Compute point light contributions
+    computeLights(n, ecPosition3);
+    
+ 	float shadow = 1.0;
+ 	
+#if SHADOW_MAP
+    // 1) Compute shadow map coordinate (including depth)
+    //    in texture space (Hint: use perspective division)
+    // 2) Fetch depth from the shadow map
+    // 3) Compute "shadow" value based on the comparison of 
+    //    fetched depth and the computed depth
+    //    Hint: Compare with the tolerance "shadowZOffset"
+    //          to avoid shadow acnes in self shadowing
+
+    // 1) homogeneity
+    vec4 shadowMapCoord = shadowCoord / shadowCoord.w;
+    // 2) fetch depth
+	float depth = texture2D(shadowMap, shadowMapCoord.xy).z;
+    // 3) shadow map logic
+	if(shadowMapCoord.z - depth > shadowZOffset) {
+		shadow = 0.0;
+	}
+#endif
+
+	// Definition: gl_FrontLightProduct[i] = gl_FrontMaterial * gl_LightSource[i]        
+    vec4 color = Diffuse * gl_FrontMaterial.diffuse;
+
+    color *= ColorMap(gl_TexCoord[0].st);
+    color += Specular * gl_FrontMaterial.specular;
+    color = clamp( color, 0.0, 1.0 );
+    gl_FragColor = color * shadow;
+}
@@ -1,17 +1,17 @@
 // Shadow volume shader.
+//
+// Permutations: LIGHT_INDEX, the light the volume is extruded from, and
+// ANIMATED, see include/animation.glsl.
 
 [vert]
 
 #version 150 compatibility
 
-uniform float g_fFrameTime;
+#include "include/animation.glsl"
 
 void main()
 {
-	vec4 vAnimatedPos = gl_Vertex;
-    //vAnimatedPos.x += sin(g_fFrameTime/300.0 + vAnimatedPos.x * 5)*0.02 
-					//* (cos(clamp(vAnimatedPos.x*2, -1, 1)*3.1416)*0.5+0.5)
-					//+ sin(g_fFrameTime/2000.0)*0.3;
+	vec4 vAnimatedPos = Animate(gl_Vertex);
 
     gl_Position = gl_ModelViewMatrix * vAnimatedPos;
 }
@@ -29,7 +29,9 @@ layout(triangles_adjacency) in;
 // max_vertices is 3 * 6 = 18.
 layout(triangle_strip, max_vertices = 18) out;
 
-uniform int lightIndex;
+#ifndef LIGHT_INDEX
+#define LIGHT_INDEX 0
+#endif
 //
 // Helper function to detect a silhouette edge and extrude a volume from it.
 // This function takes an edge of the model (end points v1 and v2), 
@@ -93,7 +95,7 @@ void DetectAndProcessSilhouette( vec3 N,          // triangle normal (Un-normali
 
 void main()
 {
-    vec3 lightPos = gl_LightSource[lightIndex].position.xyz;
+    vec3 lightPos = gl_LightSource[LIGHT_INDEX].position.xyz;
 
     // Compute the triangle normal (un-normalized)
     // Note: this is different from the interpolated one
@@ -117,11 +119,15 @@ void main()
 [frag]
 
 #version 150 compatibility
-uniform int lightIndex;
+
+#ifndef LIGHT_INDEX
+#define LIGHT_INDEX 0
+#endif
+
 void main()
 {
     // Render light color for visualization purpose
     // In a normal shadow volume pass, color buffer will not be modified.
-    gl_FragColor = gl_LightSource[lightIndex].diffuse * vec4(0.1, 0.1, 0.1, 0.1);
+    gl_FragColor = gl_LightSource[LIGHT_INDEX].diffuse * vec4(0.1, 0.1, 0.1, 0.1);
 }
 
@@ -0,0 +1,23 @@
+// Unlit shader the fixed function display modes draw models that only have
+// compact vertices with while lighting is off: the current color, untextured.
+
+[vert]
+
+#version 150 compatibility
+
+#include "include/vertex_decode.glsl"
+
+void main()
+{
+    gl_Position = gl_ModelViewProjectionMatrix * DecodePosition();
+    gl_FrontColor = gl_Color;
+}
+
+[frag]
+
+#version 150 compatibility
+
+void main()
+{
+    gl_FragColor = gl_Color;
+}
@@ -0,0 +1,108 @@
+// Copyright info of this file is left out for the assignment.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <sys/types.h>
+#include "external_sort.h"
+
+namespace
+{
+    int SeekFile(FILE *pFile, long long offset, int origin)
+    {
+#if defined(_WIN32)
+        return _fseeki64(pFile, offset, origin);
+#else
+        return fseeko(pFile, static_cast<off_t>(offset), origin);
+#endif
+    }
+}
+
+TempFile::TempFile()
+{
+    m_pFile = 0;
+    m_size = 0;
+    m_error = false;
+}
+
+TempFile::~TempFile()
+{
+    remove();
+}
+
+bool TempFile::open(const std::string &filename)
+{
+    remove();
+
+    m_pFile = fopen(filename.c_str(), "w+b");
+
+    if (!m_pFile)
+    {
+        m_error = true;
+        return false;
+    }
+
+    m_filename = filename;
+    m_size = 0;
+    m_error = false;
+    return true;
+}
+
+bool TempFile::close()
+{
+    if (m_pFile && fclose(m_pFile) != 0)
+        m_error = true;
+
+    m_pFile = 0;
+    return !m_error;
+}
+
+void TempFile::remove()
+{
+    close();
+
+    if (!m_filename.empty())
+        ::remove(m_filename.c_str());
+
+    m_filename.clear();
+    m_size = 0;
+}
+
+bool TempFile::write(const void *pData, size_t size)
+{
+    // Data is always appended, also after reading from the file.
+
+    if (!m_pFile || SeekFile(m_pFile, m_size, SEEK_SET) != 0 ||
+        fwrite(pData, 1, size, m_pFile) != size)
+    {
+        m_error = true;
+        return false;
+    }
+
+    m_size += static_cast<long long>(size);
+    return true;
+}
+
+bool TempFile::seek(long long offset)
+{
+    if (!m_pFile || SeekFile(m_pFile, offset, SEEK_SET) != 0)
+    {
+        m_error = true;
+        return false;
+    }
+
+    return true;
+}
+
+size_t TempFile::read(void *pData, size_t size)
+{
+    if (!m_pFile)
+        return 0;
+
+    size_t count = fread(pData, 1, size, m_pFile);
+
+    if (count < size && ferror(m_pFile))
+        m_error = true;
+
+    return count;
+}
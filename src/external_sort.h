@@ -0,0 +1,291 @@
+// Copyright info of this file is left out for the assignment.
+
+#if !defined(EXTERNAL_SORT_H)
+#define EXTERNAL_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Temporary file for data spilled to disk.
+//
+// The file is created by open() and deleted by remove() or the destructor.
+// close() only closes the handle, e.g. so that the file can then be memory
+// mapped. Offsets and sizes are 64-bit, so files larger than 2 GB work.
+//-----------------------------------------------------------------------------
+
+class TempFile
+{
+public:
+    TempFile();
+    ~TempFile();
+
+    bool open(const std::string &filename);
+    bool close();
+    void remove();
+
+    bool write(const void *pData, size_t size);
+    bool seek(long long offset);
+    size_t read(void *pData, size_t size);
+
+    const std::string &getFilename() const;
+    long long getSize() const;
+    bool hasError() const;
+
+private:
+    TempFile(const TempFile &);
+    TempFile &operator=(const TempFile &);
+
+    FILE *m_pFile;
+    std::string m_filename;
+    long long m_size;
+    bool m_error;
+};
+
+//-----------------------------------------------------------------------------
+// External merge sort of fixed size records that can be copied with memcpy.
+//
+// Records are collected in a buffer of about memoryBudget bytes. Each time
+// it fills up the buffer is sorted and appended to a temporary file as a
+// sorted run, so any number of records can be sorted in bounded memory.
+// merge() visits all records in order with a k-way merge of the runs, and
+// the runs' read buffers share the same budget. Nothing is written to disk
+// if all records fit in the buffer. merge() may be called more than once.
+//-----------------------------------------------------------------------------
+
+template <typename T, typename Less>
+class ExternalSorter
+{
+public:
+    ExternalSorter(const std::string &filename, size_t memoryBudget, Less less = Less());
+
+    void add(const T &record);
+    void clear();
+
+    // Calls visit(record) for every record in sorted order. Records that
+    // compare equal are visited in no particular order.
+    template <typename Visitor>
+    bool merge(Visitor visit);
+
+    long long getSize() const;
+    int getNumberOfRuns() const;
+    bool hasError() const;
+
+private:
+    ExternalSorter(const ExternalSorter &);
+    ExternalSorter &operator=(const ExternalSorter &);
+
+    bool flushRun();
+
+    TempFile m_file;
+    std::string m_filename;
+    Less m_less;
+    std::vector<T> m_buffer;
+    std::vector<long long> m_runStarts;     // first record of every run
+    size_t m_capacity;                      // records per run
+    long long m_size;
+    bool m_error;
+};
+
+//-----------------------------------------------------------------------------
+
+inline const std::string &TempFile::getFilename() const
+{ return m_filename; }
+
+inline long long TempFile::getSize() const
+{ return m_size; }
+
+inline bool TempFile::hasError() const
+{ return m_error; }
+
+//-----------------------------------------------------------------------------
+
+template <typename T, typename Less>
+ExternalSorter<T, Less>::ExternalSorter(const std::string &filename,
+                                        size_t memoryBudget, Less less)
+    : m_filename(filename), m_less(less)
+{
+    m_capacity = std::max(memoryBudget / sizeof(T), static_cast<size_t>(1));
+    m_size = 0;
+    m_error = false;
+}
+
+template <typename T, typename Less>
+void ExternalSorter<T, Less>::add(const T &record)
+{
+    // Grow the buffer geometrically but never past the budget.
+    if (m_buffer.size() == m_buffer.capacity())
+    {
+        m_buffer.reserve(std::min(m_capacity,
+            std::max(m_buffer.capacity() * 2, static_cast<size_t>(1024))));
+    }
+
+    m_buffer.push_back(record);
+    ++m_size;
+
+    if (m_buffer.size() == m_capacity && !flushRun())
+        m_error = true;
+}
+
+template <typename T, typename Less>
+void ExternalSorter<T, Less>::clear()
+{
+    // Frees the buffer and deletes the runs.
+    std::vector<T>().swap(m_buffer);
+    m_runStarts.clear();
+    m_file.remove();
+    m_size = 0;
+    m_error = false;
+}
+
+template <typename T, typename Less>
+bool ExternalSorter<T, Less>::flushRun()
+{
+    if (m_runStarts.empty() && !m_file.open(m_filename))
+        return false;
+
+    std::sort(m_buffer.begin(), m_buffer.end(), m_less);
+
+    m_runStarts.push_back(m_file.getSize() / static_cast<long long>(sizeof(T)));
+
+    if (!m_file.write(&m_buffer[0], m_buffer.size() * sizeof(T)))
+        return false;
+
+    m_buffer.clear();
+    return true;
+}
+
+template <typename T, typename Less>
+template <typename Visitor>
+bool ExternalSorter<T, Less>::merge(Visitor visit)
+{
+    if (m_error)
+        return false;
+
+    // Everything fit in memory.
+    if (m_runStarts.empty())
+    {
+        std::sort(m_buffer.begin(), m_buffer.end(), m_less);
+
+        for (size_t i = 0; i < m_buffer.size(); ++i)
+            visit(m_buffer[i]);
+
+        return true;
+    }
+
+    // Write out the last partial run and hand its memory to the read
+    // buffers of the runs.
+
+    if (!m_buffer.empty() && !flushRun())
+    {
+        m_error = true;
+        return false;
+    }
+
+    std::vector<T>().swap(m_buffer);
+
+    struct Run
+    {
+        long long next;         // next record to read from the file
+        long long end;
+        size_t position;        // next record in the run's read buffer
+        size_t count;           // records in the read buffer
+    };
+
+    size_t numRuns = m_runStarts.size();
+    size_t runCapacity = std::max(m_capacity / numRuns, static_cast<size_t>(1));
+    std::vector<T> buffers(runCapacity * numRuns);
+    std::vector<Run> runs(numRuns);
+    std::vector<size_t> heap;
+
+    // Orders the heap so that the run with the smallest record is on top.
+    auto after = [&](size_t a, size_t b)
+    {
+        return m_less(buffers[b * runCapacity + runs[b].position],
+            buffers[a * runCapacity + runs[a].position]);
+    };
+
+    auto refill = [&](size_t r) -> bool
+    {
+        Run &run = runs[r];
+        size_t count = static_cast<size_t>(std::min(
+            static_cast<long long>(runCapacity), run.end - run.next));
+        size_t bytes = count * sizeof(T);
+
+        if (!m_file.seek(run.next * static_cast<long long>(sizeof(T))) ||
+            m_file.read(&buffers[r * runCapacity], bytes) != bytes)
+        {
+            return false;
+        }
+
+        run.next += count;
+        run.position = 0;
+        run.count = count;
+        return true;
+    };
+
+    long long fileRecords = m_file.getSize() / static_cast<long long>(sizeof(T));
+
+    for (size_t r = 0; r < numRuns; ++r)
+    {
+        runs[r].next = m_runStarts[r];
+        runs[r].end = (r + 1 < numRuns) ? m_runStarts[r + 1] : fileRecords;
+
+        if (!refill(r))
+        {
+            m_error = true;
+            return false;
+        }
+
+        if (runs[r].count > 0)
+            heap.push_back(r);
+    }
+
+    std::make_heap(heap.begin(), heap.end(), after);
+
+    while (!heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), after);
+
+        size_t r = heap.back();
+        Run &run = runs[r];
+
+        visit(buffers[r * runCapacity + run.position]);
+
+        if (++run.position == run.count)
+        {
+            if (run.next == run.end)
+            {
+                heap.pop_back();
+                continue;
+            }
+
+            if (!refill(r))
+            {
+                m_error = true;
+                return false;
+            }
+        }
+
+        std::push_heap(heap.begin(), heap.end(), after);
+    }
+
+    return true;
+}
+
+template <typename T, typename Less>
+inline long long ExternalSorter<T, Less>::getSize() const
+{ return m_size; }
+
+template <typename T, typename Less>
+inline int ExternalSorter<T, Less>::getNumberOfRuns() const
+{ return static_cast<int>(m_runStarts.size()); }
+
+template <typename T, typename Less>
+inline bool ExternalSorter<T, Less>::hasError() const
+{ return m_error || m_file.hasError(); }
+
+#endif
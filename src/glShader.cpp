@@ -1,10 +1,147 @@
 #include "glShader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
+// GL_KHR_parallel_shader_compile, which this GLEW predates. The ARB version
+// of the extension uses the same value.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
+namespace
+{
+	// Program binary cache file header, followed by the binary itself
+	const unsigned int PROGRAM_CACHE_MAGIC = 0x42504C47;	// "GLPB"
+	const unsigned int PROGRAM_CACHE_VERSION = 1;
+
+	struct ProgramCacheHeader
+	{
+		unsigned int magic;
+		unsigned int version;
+		unsigned long long key;		// see ProgramCacheKey()
+		GLenum format;				// binary format of the driver
+		GLint length;				// bytes of binary that follow
+	};
+
+	void HashBytes(unsigned long long &hash, const void *pData, size_t size)
+	{
+		// 64-bit FNV-1a
+		const unsigned char *p = static_cast<const unsigned char *>(pData);
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= p[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	unsigned long long ProgramCacheKey(const std::string &source)
+	{
+		// Binaries are only valid for the driver that built them, so the key
+		// covers the driver strings as well as the source.
+
+		const GLenum strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+		unsigned long long hash = 14695981039346656037ULL;
+
+		HashBytes(hash, source.data(), source.size());
+
+		for (int i = 0; i < 3; ++i)
+		{
+			const char *pszString = reinterpret_cast<const char *>(glGetString(strings[i]));
+
+			if (pszString)
+				HashBytes(hash, pszString, strlen(pszString) + 1);
+		}
+
+		return hash;
+	}
+
+	// Includes nested deeper than this are taken to be recursive.
+	const int MAX_INCLUDE_DEPTH = 16;
+
+	void ParseDefines(const char *pszDefines, std::string &defineLines, std::string &cacheSuffix)
+	{
+		// Turns "A B=2" into "#define A 1\n#define B 2\n" and ".A.B-2".
+
+		const char *p = pszDefines ? pszDefines : "";
+
+		defineLines.clear();
+		cacheSuffix.clear();
+
+		while (*p)
+		{
+			if (*p == ' ')
+			{
+				++p;
+				continue;
+			}
+
+			std::string define(p, strcspn(p, " "));
+			std::string::size_type equals = define.find('=');
+
+			p += define.length();
+
+			if (equals == std::string::npos)
+				defineLines += "#define " + define + " 1\n";
+			else
+				defineLines += "#define " + define.substr(0, equals) + " " + define.substr(equals + 1) + "\n";
+
+			std::replace(define.begin(), define.end(), '=', '-');
+			cacheSuffix += "." + define;
+		}
+	}
+
+	std::string SpecializeStage(const std::string &buffer, std::string::size_type begin,
+		std::string::size_type end, const std::string &defineLines)
+	{
+		// Returns the stage's source with the permutation constants defined
+		// right after its #version line, which has to come first.
+
+		std::string source = buffer.substr(begin, end - begin);
+		std::string::size_type version = source.find("#version");
+		std::string::size_type insert = 0;
+
+		if (version != std::string::npos)
+		{
+			insert = source.find('\n', version);
+			insert = (insert != std::string::npos) ? insert + 1 : source.length();
+		}
+
+		source.insert(insert, defineLines);
+		return source;
+	}
+
+	int MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start).count());
+	}
+
+	// Arrays are reflected as "name[0]", but looked up by their name alone.
+	void StripArraySuffix(std::string &name)
+	{
+		std::string::size_type bracket = name.find('[');
+
+		if (bracket != std::string::npos)
+			name.erase(bracket);
+	}
+
+	template <typename T>
+	bool NameLess(const T &a, const T &b)
+	{
+		return a.name < b.name;
+	}
+}
 
 GLShader::GLShader(void)
 {
 	m_shader = 0;
+	m_pending.cacheKey = 0;
+	m_pending.program = 0;
+
+	for (int i = 0; i < 3; ++i)
+		m_pending.stages[i] = 0;
 }
 
 GLShader::~GLShader(void)
@@ -14,15 +151,27 @@ GLShader::~GLShader(void)
 
 void GLShader::DeleteShader()
 {
+	for (int i = 0; i < 3; ++i)
+	{
+		glDeleteShader(m_pending.stages[i]);
+		m_pending.stages[i] = 0;
+	}
+
+	glDeleteProgram(m_pending.program);
+	m_pending.program = 0;
+
 	glDeleteProgram(m_shader);
 	m_shader = 0;
+	m_uniforms.clear();
+	m_attributes.clear();
+	ResolveUniformSlots();
 }
 
 GLuint GLShader::CompileShader(GLenum type, const GLchar *pszSource, GLint length)
 {
-	// Compiles the shader given it's source code. Returns the shader object.
-	// A std::string object containing the shader's info log is thrown if the
-	// shader failed to compile.
+	// Starts compiling the shader given it's source code. Returns the shader
+	// object. Its compile status is only asked for by CheckShader(), so the
+	// driver may compile it in the background until then.
 	//
 	// 'type' is either GL_VERTEX_SHADER, GL_GEOMETRY_SHADER or GL_FRAGMENT_SHADER.
 	// 'pszSource' is a C style string containing the shader's source code.
@@ -32,40 +181,22 @@ GLuint GLShader::CompileShader(GLenum type, const GLchar *pszSource, GLint lengt
 
 	if (shader)
 	{
-		GLint compiled = 0;
-
 		glShaderSource(shader, 1, &pszSource, &length);
 		glCompileShader(shader);
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-
-		if (!compiled)
-		{
-			GLsizei infoLogSize = 0;
-			std::string infoLog;
-
-			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogSize);
-			infoLog.resize(infoLogSize);
-			glGetShaderInfoLog(shader, infoLogSize, &infoLogSize, &infoLog[0]);
-
-			throw infoLog;
-		}
 	}
 	return shader;
 }
 
 GLuint GLShader::LinkShaders(GLuint vertShader, GLuint geomShader, GLuint fragShader)
 {
-	// Links the compiled vertex and/or fragment shaders into an executable
-	// shader program. Returns the executable shader object. If the shaders
-	// failed to link into an executable shader program, then a std::string
-	// object is thrown containing the info log.
+	// Starts linking the compiled vertex, geometry and/or fragment shaders
+	// into an executable shader program. Returns the program object, which
+	// is checked by CheckProgram().
 
 	GLuint program = glCreateProgram();
 
 	if (program)
 	{
-		GLint linked = 0;
-
 		if (vertShader)
 			glAttachShader(program, vertShader);
 
@@ -75,122 +206,239 @@ GLuint GLShader::LinkShaders(GLuint vertShader, GLuint geomShader, GLuint fragSh
 		if (fragShader)
 			glAttachShader(program, fragShader);
 
+		// Ask for a binary that can be written to the program cache.
+		if (GLEW_ARB_get_program_binary)
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 		glLinkProgram(program);
-		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	}
 
-		if (!linked)
-		{
-			GLsizei infoLogSize = 0;
-			std::string infoLog;
+	return program;
+}
+
+void GLShader::CheckShader(GLuint shader)
+{
+	// A std::string object containing the shader's info log is thrown if
+	// the shader failed to compile.
+
+	GLint compiled = 0;
+
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+	if (!compiled)
+	{
+		GLsizei infoLogSize = 0;
+		std::string infoLog;
+
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogSize);
+		infoLog.resize(infoLogSize);
+		glGetShaderInfoLog(shader, infoLogSize, &infoLogSize, &infoLog[0]);
+
+		throw infoLog;
+	}
+}
+
+void GLShader::CheckProgram(GLuint program)
+{
+	// A std::string object containing the info log is thrown if the shaders
+	// failed to link into an executable shader program.
+
+	GLint linked = 0;
 
-			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogSize);
-			infoLog.resize(infoLogSize);
-			glGetProgramInfoLog(program, infoLogSize, &infoLogSize, &infoLog[0]);
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
 
-			throw infoLog;
+	if (!linked)
+	{
+		GLsizei infoLogSize = 0;
+		std::string infoLog;
+
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogSize);
+		infoLog.resize(infoLogSize);
+		glGetProgramInfoLog(program, infoLogSize, &infoLogSize, &infoLog[0]);
+
+		throw infoLog;
+	}
+}
+
+void GLShader::FinishProgram()
+{
+	// Checks the pending program, and makes it the shader's program if it
+	// linked. This waits for the driver if it is still busy with it.
+
+	static const char *const stageErrors[] = {
+		"Error in compiling the vertex shader:\n",
+		"Error in compiling the geometry shader:\n",
+		"Error in compiling the fragment shader:\n"
+	};
+
+	std::string compilingErrorMsg;
+
+	try
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			if (m_pending.stages[i])
+			{
+				compilingErrorMsg = stageErrors[i];
+				CheckShader(m_pending.stages[i]);
+			}
 		}
 
-		// Mark the two attached shaders for deletion. These two shaders aren't
-		// deleted right now because both are already attached to a shader
-		// program. When the shader program is deleted these two shaders will
-		// be automatically detached and deleted.
+		compilingErrorMsg = "Error in linking the shaders:\n";
+		CheckProgram(m_pending.program);
+		m_shader = m_pending.program;
 
-		if (vertShader)
-			glDeleteShader(vertShader);
+		if (!m_pending.cacheFilename.empty())
+			SaveProgramBinary(m_pending.cacheFilename, m_pending.cacheKey);
 
-		if (geomShader)
-			glDeleteShader(geomShader);
+		fprintf(stdout, "Shader \"%s\" compiled successfully in %d ms.\n",
+			m_pending.name.c_str(), MillisecondsSince(m_pending.start));
+	}
+	catch (const std::string &errors)
+	{
+		std::string infoLog = compilingErrorMsg + errors;
+		fprintf(stderr, "%s\n", infoLog.c_str());
+		glDeleteProgram(m_pending.program);
+	}
 
-		if (fragShader)
-			glDeleteShader(fragShader);
+	// Mark the shaders for deletion. The ones attached to the program are
+	// deleted with it.
+	for (int i = 0; i < 3; ++i)
+	{
+		glDeleteShader(m_pending.stages[i]);
+		m_pending.stages[i] = 0;
 	}
 
-	return program;
+	m_pending.program = 0;
+	ReflectProgram();
 }
 
+bool GLShader::IsReady()
+{
+	if (!m_pending.program)
+		return true;
+
+	if (IsParallelCompileSupported())
+	{
+		GLint completed = GL_FALSE;
+
+		glGetProgramiv(m_pending.program, GL_COMPLETION_STATUS_KHR, &completed);
+
+		if (!completed)
+			return false;
+	}
 
-void GLShader::LoadShaderProgramFromFile(const char *filename)
+	FinishProgram();
+	return true;
+}
+
+bool GLShader::IsParallelCompileSupported()
 {
-    fprintf(stdout, "Compiling shader \"%s\".\n", filename);
+	// Looked up once, the viewer has a single context.
+	static int supported = -1;
+
+	if (supported < 0)
+	{
+		supported = (glewGetExtension("GL_KHR_parallel_shader_compile") ||
+			glewGetExtension("GL_ARB_parallel_shader_compile")) ? 1 : 0;
+	}
+
+	return supported != 0;
+}
 
+void GLShader::LoadShaderProgramFromFile(const char *filename, const char *pszDefines, bool useCache, bool bAsync)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     std::string infoLog;
 
-	m_shader = 0;
+	DeleteShader();
 	std::string buffer;
+	std::string defineLines;
+	std::string cacheSuffix;
+
+	// Read the text file containing the GLSL shader program, with its
+	// includes. This file contains 1 vertex shader and 1 fragment shader.
+	if (!ReadShaderSource(filename, buffer, 0))
+		buffer.clear();
+
+	ParseDefines(pszDefines, defineLines, cacheSuffix);
+
+	std::string name = std::string(filename) + (pszDefines && *pszDefines ? std::string(" [") + pszDefines + "]" : "");
+
+	// Try the program binary cache before compiling anything.
+	std::string cacheFilename = std::string(filename) + cacheSuffix + ".cache";
+	unsigned long long cacheKey = 0;
+	bool binaryCache = useCache && GLEW_ARB_get_program_binary && buffer.length() > 0;
+
+	if (binaryCache)
+	{
+		cacheKey = ProgramCacheKey(defineLines + buffer);
+
+		if (LoadProgramBinary(cacheFilename, cacheKey))
+		{
+			fprintf(stdout, "Shader \"%s\" loaded from the program cache in %d ms.\n",
+				name.c_str(), MillisecondsSince(start));
+			ReflectProgram();
+			return;
+		}
+	}
 
-	// Read the text file containing the GLSL shader program.
-	// This file contains 1 vertex shader and 1 fragment shader.
-	ReadTextFileToBuffer(filename, buffer);
+    fprintf(stdout, "Compiling shader \"%s\".\n", name.c_str());
 
-	// Compile and link the vertex and fragment shaders.
+	// Start compiling and linking the vertex and fragment shaders.
 	if (buffer.length() > 0)
 	{
-		const GLchar *pSource = 0;
-		GLint length = 0;
-		GLuint vertShader = 0;
-		GLuint geomShader = 0;
-		GLuint fragShader = 0;
+		std::string source;
 
 		std::string::size_type vertOffset = buffer.find("[vert]");
 		std::string::size_type geomOffset = buffer.find("[geom]");
 		std::string::size_type fragOffset = buffer.find("[frag]");
-		
-		std::string compilingErrorMsg;
 
-		try
-		{
-			// Get the vertex shader source and compile it.
-			// The source is between the [vert] and [geom] (or [frag]) tags.
-			if (vertOffset != std::string::npos)
-			{
-				compilingErrorMsg = "Error in compiling the vertex shader:\n";
-				vertOffset += 6;        // skip over the [vert] tag
-				pSource = reinterpret_cast<const GLchar *>(&buffer[vertOffset]);
-				std::string::size_type endVertOffset = 
-					(geomOffset != std::string::npos) ? geomOffset : 
-					((fragOffset != std::string::npos) ? fragOffset : buffer.length() - 1);
-				length = static_cast<GLint>(endVertOffset - vertOffset);
-				vertShader = CompileShader(GL_VERTEX_SHADER, pSource, length);
-			}
-
-			// Get the geometry shader source and compile it.
-			// The source is between the [geom] and [frag] tags.
-			if (geomOffset != std::string::npos)
-			{
-				compilingErrorMsg = "Error in compiling the geometry shader:\n";
-				geomOffset += 6;        // skip over the [geom] tag
-				pSource = reinterpret_cast<const GLchar *>(&buffer[geomOffset]);
-				std::string::size_type endGeomOffset = 
-					(fragOffset != std::string::npos) ? fragOffset : buffer.length() - 1;
-				length = static_cast<GLint>(endGeomOffset - geomOffset);
-				geomShader = CompileShader(GL_GEOMETRY_SHADER, pSource, length);
-			}
-
-			// Get the fragment shader source and compile it.
-			// The source is between the [frag] tag and the end of the file.
-			if (fragOffset != std::string::npos)
-			{
-				compilingErrorMsg = "Error in compiling the fragment shader:\n";
-				fragOffset += 6;        // skip over the [frag] tag
-				pSource = reinterpret_cast<const GLchar *>(&buffer[fragOffset]);
-				length = static_cast<GLint>(buffer.length() - fragOffset - 1);
-				fragShader = CompileShader(GL_FRAGMENT_SHADER, pSource, length);
-			}
+		m_pending.name = name;
+		m_pending.cacheFilename = binaryCache ? cacheFilename : std::string();
+		m_pending.cacheKey = cacheKey;
+		m_pending.start = start;
 
+		// Get the vertex shader source and compile it.
+		// The source is between the [vert] and [geom] (or [frag]) tags.
+		if (vertOffset != std::string::npos)
+		{
+			vertOffset += 6;        // skip over the [vert] tag
+			std::string::size_type endVertOffset = 
+				(geomOffset != std::string::npos) ? geomOffset : 
+				((fragOffset != std::string::npos) ? fragOffset : buffer.length() - 1);
+			source = SpecializeStage(buffer, vertOffset, endVertOffset, defineLines);
+			m_pending.stages[0] = CompileShader(GL_VERTEX_SHADER, source.c_str(), static_cast<GLint>(source.length()));
+		}
 
-			compilingErrorMsg = "Error in linking the shaders:\n";
-			// Now link the vertex and fragment shaders into a shader program.
-			m_shader = LinkShaders(vertShader, geomShader, fragShader);
-
-            fprintf(stdout, "Shader \"%s\" compiled successfully.\n", filename);
+		// Get the geometry shader source and compile it.
+		// The source is between the [geom] and [frag] tags.
+		if (geomOffset != std::string::npos)
+		{
+			geomOffset += 6;        // skip over the [geom] tag
+			std::string::size_type endGeomOffset = 
+				(fragOffset != std::string::npos) ? fragOffset : buffer.length() - 1;
+			source = SpecializeStage(buffer, geomOffset, endGeomOffset, defineLines);
+			m_pending.stages[1] = CompileShader(GL_GEOMETRY_SHADER, source.c_str(), static_cast<GLint>(source.length()));
 		}
-		catch (const std::string &errors)
+
+		// Get the fragment shader source and compile it.
+		// The source is between the [frag] tag and the end of the file.
+		if (fragOffset != std::string::npos)
 		{
-			infoLog = compilingErrorMsg + errors;
-            fprintf(stderr, "%s\n", infoLog.c_str());
-            // throw std::runtime_error("Failed to load shader.\n" + infoLog);
+			fragOffset += 6;        // skip over the [frag] tag
+			source = SpecializeStage(buffer, fragOffset, buffer.length() - 1, defineLines);
+			m_pending.stages[2] = CompileShader(GL_FRAGMENT_SHADER, source.c_str(), static_cast<GLint>(source.length()));
 		}
 
+		// Now link the vertex and fragment shaders into a shader program.
+		m_pending.program = LinkShaders(m_pending.stages[0], m_pending.stages[1], m_pending.stages[2]);
+
+		// A program that couldn't be created is reported right away.
+		if (!bAsync || !m_pending.program)
+			FinishProgram();
+
+		return;
 	}
 	else
 	{
@@ -200,6 +448,298 @@ void GLShader::LoadShaderProgramFromFile(const char *filename)
 
 	}
 
+	ReflectProgram();
+}
+
+bool GLShader::LoadProgramBinary(const std::string &cacheFilename, unsigned long long key)
+{
+	// Creates the program from its cached binary. Returns false if there is
+	// no cache for this source and driver, or the driver rejects it.
+
+	ProgramCacheHeader header;
+	std::vector<char> binary;
+	FILE *fp = 0;
+	GLint linked = 0;
+
+	if (fopen_s(&fp, cacheFilename.c_str(), "rb") != 0 || fp == NULL)
+		return false;
+
+	bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+		header.magic == PROGRAM_CACHE_MAGIC &&
+		header.version == PROGRAM_CACHE_VERSION &&
+		header.key == key && header.length > 0;
+
+	if (valid)
+	{
+		binary.resize(header.length);
+		valid = fread(&binary[0], 1, binary.size(), fp) == binary.size();
+	}
+
+	fclose(fp);
+
+	if (!valid)
+		return false;
+
+	GLuint program = glCreateProgram();
+
+	glProgramBinary(program, header.format, &binary[0], header.length);
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+	if (!linked)
+	{
+		// e.g. a driver update that kept the version string. Clear the error
+		// a format it no longer supports raises.
+		glGetError();
+		glDeleteProgram(program);
+		return false;
+	}
+
+	m_shader = program;
+	return true;
+}
+
+void GLShader::SaveProgramBinary(const std::string &cacheFilename, unsigned long long key)
+{
+	ProgramCacheHeader header;
+	std::vector<char> binary;
+	FILE *fp = 0;
+	GLint length = 0;
+
+	glGetProgramiv(m_shader, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+		return;
+
+	binary.resize(length);
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	header.format = 0;
+	glGetProgramBinary(m_shader, length, &header.length, &header.format, &binary[0]);
+
+	if (header.length <= 0)
+		return;
+
+	// A partially written cache fails the length check when it is read.
+	if (fopen_s(&fp, cacheFilename.c_str(), "wb") != 0 || fp == NULL ||
+		fwrite(&header, sizeof(header), 1, fp) != 1 ||
+		fwrite(&binary[0], 1, header.length, fp) != static_cast<size_t>(header.length))
+	{
+		fprintf(stderr, "Failed to write the program cache \"%s\".\n", cacheFilename.c_str());
+	}
+
+	if (fp)
+		fclose(fp);
+}
+
+void GLShader::ReflectProgram()
+{
+	// Lists the active uniforms and attributes of the linked program, sorted
+	// by name. Built-in variables (gl_*) have no location and are left out.
+
+	GLint count = 0;
+	GLint maxLength = 0;
+	std::vector<GLchar> name;
+
+	m_uniforms.clear();
+	m_attributes.clear();
+
+	if (m_shader)
+	{
+		glGetProgramiv(m_shader, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(m_shader, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+
+		for (GLint i = 0; i < count; ++i)
+		{
+			Uniform uniform;
+			GLsizei length = 0;
+
+			glGetActiveUniform(m_shader, i, static_cast<GLsizei>(name.size()), &length,
+				&uniform.size, &uniform.type, &name[0]);
+			uniform.name.assign(&name[0], length);
+			uniform.location = glGetUniformLocation(m_shader, uniform.name.c_str());
+			uniform.bCached = false;
+
+			if (uniform.location < 0)
+				continue;
+
+			StripArraySuffix(uniform.name);
+			m_uniforms.push_back(uniform);
+		}
+
+		glGetProgramiv(m_shader, GL_ACTIVE_ATTRIBUTES, &count);
+		glGetProgramiv(m_shader, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+
+		for (GLint i = 0; i < count; ++i)
+		{
+			Variable attribute;
+			GLsizei length = 0;
+
+			glGetActiveAttrib(m_shader, i, static_cast<GLsizei>(name.size()), &length,
+				&attribute.size, &attribute.type, &name[0]);
+			attribute.name.assign(&name[0], length);
+			attribute.location = glGetAttribLocation(m_shader, attribute.name.c_str());
+
+			if (attribute.location < 0)
+				continue;
+
+			StripArraySuffix(attribute.name);
+			m_attributes.push_back(attribute);
+		}
+
+		std::sort(m_uniforms.begin(), m_uniforms.end(), NameLess<Uniform>);
+		std::sort(m_attributes.begin(), m_attributes.end(), NameLess<Variable>);
+	}
+
+	ResolveUniformSlots();
+}
+
+void GLShader::ResolveUniformSlots()
+{
+	m_slots.resize(m_slotNames.size());
+
+	for (size_t i = 0; i < m_slotNames.size(); ++i)
+		m_slots[i] = FindUniform(m_slotNames[i].c_str());
+}
+
+int GLShader::FindUniform(const char *pszName) const
+{
+	// Returns the index of the named uniform in m_uniforms, or -1 if the
+	// program has no such active uniform.
+
+	Uniform key;
+
+	key.name = pszName;
+
+	std::vector<Uniform>::const_iterator i =
+		std::lower_bound(m_uniforms.begin(), m_uniforms.end(), key, NameLess<Uniform>);
+
+	if (i == m_uniforms.end() || i->name != key.name)
+		return -1;
+
+	return static_cast<int>(i - m_uniforms.begin());
+}
+
+GLint GLShader::GetUniformLocation(const char *pszName) const
+{
+	int uniform = FindUniform(pszName);
+
+	return (uniform >= 0) ? m_uniforms[uniform].location : -1;
+}
+
+GLint GLShader::GetAttribLocation(const char *pszName) const
+{
+	Variable key;
+
+	key.name = pszName;
+
+	std::vector<Variable>::const_iterator i =
+		std::lower_bound(m_attributes.begin(), m_attributes.end(), key, NameLess<Variable>);
+
+	return (i != m_attributes.end() && i->name == key.name) ? i->location : -1;
+}
+
+void GLShader::SetUniformSlots(const char *const ppszNames[], int count)
+{
+	m_slotNames.assign(ppszNames, ppszNames + count);
+	ResolveUniformSlots();
+}
+
+GLShader::Uniform *GLShader::UpdateUniform(int slot, const void *pValue, size_t size)
+{
+	// Returns the uniform of the slot if its value has to be uploaded, after
+	// remembering the new value. Returns 0 if there is nothing to upload.
+
+	if (slot < 0 || slot >= static_cast<int>(m_slots.size()) || m_slots[slot] < 0)
+		return 0;
+
+	Uniform &uniform = m_uniforms[m_slots[slot]];
+
+	if (uniform.bCached && memcmp(uniform.value, pValue, size) == 0)
+		return 0;
+
+	memcpy(uniform.value, pValue, size);
+	uniform.bCached = true;
+	return &uniform;
+}
+
+void GLShader::SetUniform(int slot, GLint value)
+{
+	if (Uniform *pUniform = UpdateUniform(slot, &value, sizeof(value)))
+		glUniform1i(pUniform->location, value);
+}
+
+void GLShader::SetUniform(int slot, GLfloat value)
+{
+	if (Uniform *pUniform = UpdateUniform(slot, &value, sizeof(value)))
+		glUniform1f(pUniform->location, value);
+}
+
+void GLShader::SetUniform3(int slot, const GLfloat value[3])
+{
+	if (Uniform *pUniform = UpdateUniform(slot, value, sizeof(GLfloat) * 3))
+		glUniform3fv(pUniform->location, 1, value);
+}
+
+bool GLShader::ReadShaderSource(const std::string &filename, std::string &buffer, int depth)
+{
+	// Reads the shader file into buffer, replacing every #include line by
+	// the included file. Returns false if any of the files can't be read.
+
+	std::string source;
+	std::string::size_type lineStart = 0;
+	std::string::size_type slash = filename.find_last_of("\\/");
+	std::string directory = (slash != std::string::npos) ? filename.substr(0, slash + 1) : "";
+
+	buffer.clear();
+	ReadTextFileToBuffer(filename.c_str(), source);
+
+	// A missing top level file is reported by the caller.
+	if (source.empty())
+	{
+		if (depth > 0)
+			fprintf(stderr, "Failed to load shader include %s.\n", filename.c_str());
+		return false;
+	}
+
+	if (depth > MAX_INCLUDE_DEPTH)
+	{
+		fprintf(stderr, "Shader includes nested too deeply in %s.\n", filename.c_str());
+		return false;
+	}
+
+	while (lineStart < source.length())
+	{
+		std::string::size_type lineEnd = source.find('\n', lineStart);
+		lineEnd = (lineEnd != std::string::npos) ? lineEnd + 1 : source.length();
+
+		std::string::size_type first = source.find_first_not_of(" \t", lineStart);
+		std::string::size_type open = source.find('"', lineStart);
+		std::string::size_type close = (open < lineEnd) ? source.find('"', open + 1) : std::string::npos;
+
+		if (first != std::string::npos && source.compare(first, 8, "#include") == 0 && close < lineEnd)
+		{
+			std::string included;
+
+			if (!ReadShaderSource(directory + source.substr(open + 1, close - open - 1), included, depth + 1))
+				return false;
+
+			buffer += included;
+
+			if (!included.empty() && included[included.length() - 1] != '\n')
+				buffer += '\n';
+		}
+		else
+		{
+			buffer.append(source, lineStart, lineEnd - lineStart);
+		}
+
+		lineStart = lineEnd;
+	}
+
+	return true;
 }
 
 void GLShader::ReadTextFileToBuffer(const char *filename, std::string &buffer)
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "GL/glew.h"
+#include <chrono>
 #include <string>
+#include <vector>
 
 class GLShader
 {
@@ -9,14 +11,90 @@ public:
 	GLShader(void);
 	~GLShader(void);
 
-	void LoadShaderProgramFromFile(const char *filename);
+	// Lines of the form #include "file" are replaced by the file, relative
+	// to the including one. pszDefines is a space separated list of NAME or
+	// NAME=VALUE permutation constants, which are defined at the top of
+	// every stage, so one file builds a program for each combination.
+	//
+	// Linked programs are cached in "<filename>[.<defines>].cache" if the
+	// driver supports program binaries. The cache is used while the shader
+	// source, its includes, the driver vendor, renderer and version are the
+	// same as when it was written, and rebuilt otherwise.
+	//
+	// With bAsync the shaders are only handed to the driver here, and the
+	// program is finished by IsReady() once the driver has linked it.
+	// GetShader() returns 0 until then.
+	void LoadShaderProgramFromFile(const char *filename, const char *pszDefines = 0, bool useCache = true, bool bAsync = false);
 	void DeleteShader();
 	GLuint GetShader() {return m_shader;}
 
+	// Returns true once the program is linked, or failed to. The first call
+	// that finds the driver done with a pending program finishes it. Drivers
+	// with GL_KHR_parallel_shader_compile link on their own threads and are
+	// asked without waiting; with any other driver this call waits for it.
+	bool IsReady();
+	bool IsPending() const {return m_pending.program != 0;}
+	static bool IsParallelCompileSupported();
+
+	// Active uniforms and attributes are reflected once the program is
+	// linked. Lookups by name search the reflected lists, not the driver.
+	GLint GetUniformLocation(const char *pszName) const;
+	GLint GetAttribLocation(const char *pszName) const;
+
+	// The renderer refers to the uniforms it sets by slot, an index into
+	// the names given here, so setting them needs no name lookup at all.
+	// Slots that aren't active uniforms of this program are ignored. The
+	// setters skip the upload if the uniform already holds the value, and
+	// like glUniform* they need the program to be in use.
+	void SetUniformSlots(const char *const ppszNames[], int count);
+	void SetUniform(int slot, GLint value);
+	void SetUniform(int slot, GLfloat value);
+	void SetUniform3(int slot, const GLfloat value[3]);
+
 private:
+	struct Variable
+	{
+		std::string name;		// without the "[0]" of arrays
+		GLint location;
+		GLenum type;
+		GLint size;				// array elements
+	};
+
+	struct Uniform : Variable
+	{
+		bool bCached;			// value holds the last uploaded value
+		GLuint value[3];		// bits of the last uploaded value
+	};
+
+	// A program handed to the driver, but not checked yet
+	struct PendingProgram
+	{
+		std::string name;			// file and defines, for messages
+		std::string cacheFilename;	// empty if the binary isn't cached
+		unsigned long long cacheKey;
+		GLuint stages[3];			// vertex, geometry and fragment shader
+		GLuint program;				// 0 if nothing is pending
+		std::chrono::steady_clock::time_point start;
+	};
+
 	GLuint m_shader;
+	PendingProgram m_pending;
+	std::vector<Uniform> m_uniforms;		// sorted by name
+	std::vector<Variable> m_attributes;		// sorted by name
+	std::vector<std::string> m_slotNames;
+	std::vector<int> m_slots;				// index into m_uniforms, -1 if not active
 
 	GLuint CompileShader(GLenum type, const GLchar *pszSource, GLint length);
 	GLuint LinkShaders(GLuint vertShader, GLuint geomShader, GLuint fragShader);
+	void CheckShader(GLuint shader);
+	void CheckProgram(GLuint program);
+	void FinishProgram();
+	bool LoadProgramBinary(const std::string &cacheFilename, unsigned long long key);
+	void SaveProgramBinary(const std::string &cacheFilename, unsigned long long key);
+	void ReflectProgram();
+	void ResolveUniformSlots();
+	int FindUniform(const char *pszName) const;
+	Uniform *UpdateUniform(int slot, const void *pValue, size_t size);
+	bool ReadShaderSource(const std::string &filename, std::string &buffer, int depth);
 	void ReadTextFileToBuffer(const char *filename, std::string &buffer);
 };
@@ -0,0 +1,420 @@
+// Copyright info of this file is left out for the assignment.
+
+#include <cstddef>
+#include <cstdio>
+#include "gpu_mesh.h"
+
+namespace
+{
+    // Names of the index buffers in memoryUsage(), in GPUMesh::Indices order.
+    const char *g_indexBufferNames[GPUMesh::INDICES_COUNT] =
+    {
+        "GPU indices",
+        "GPU 16-bit indices",
+        "GPU position indices",
+        "GPU 16-bit position indices",
+        "GPU position adjacency",
+        "GPU 16-bit position adjacency",
+        "GPU LOD indices",
+        "GPU LOD position indices"
+    };
+
+    inline const GLvoid *BufferOffset(size_t bytes)
+    {
+        return reinterpret_cast<const GLvoid *>(bytes);
+    }
+
+    void AddBufferUsage(std::vector<ModelOBJ::BufferUsage> &usage, const char *pszName, size_t bytes)
+    {
+        ModelOBJ::BufferUsage entry;
+
+        entry.pszName = pszName;
+        entry.bytes = bytes;
+        entry.mapped = false;
+
+        if (entry.bytes > 0)
+            usage.push_back(entry);
+    }
+}
+
+GPUMesh::GPUMesh()
+{
+    m_created = false;
+    m_hasPositions = false;
+    m_hasTextureCoords = false;
+    m_hasNormals = false;
+    m_hasTangents = false;
+    m_hasAdjacency = false;
+
+    m_vertexBuffer = 0;
+    m_compactVertexBuffer = 0;
+    m_positionBuffer = 0;
+    m_vertexBytes = 0;
+    m_compactVertexBytes = 0;
+    m_positionBytes = 0;
+
+    for (int i = 0; i < INDICES_COUNT; ++i)
+    {
+        m_indexBuffers[i] = 0;
+        m_indexBytes[i] = 0;
+        m_firstTriangles[i] = 0;
+    }
+
+    for (int i = 0; i < LAYOUT_COUNT; ++i)
+        m_vertexArrays[i] = 0;
+}
+
+GPUMesh::~GPUMesh()
+{
+    // The GL context may already be gone, so the buffers have to be
+    // released with destroy() while it is current.
+}
+
+bool GPUMesh::create(const ModelOBJ &model)
+{
+    // The triangles drawn with 16-bit indices come first in the model's
+    // index buffers, so the 32-bit buffers only need the rest.
+
+    int numTriangles = model.getNumberOfTriangles();
+    int numShortTriangles = model.getNumberOfShortTriangles();
+    int numShortPositionTriangles = model.getNumberOfShortPositionTriangles();
+    size_t numLodIndices = static_cast<size_t>(model.getNumberOfLodIndices());
+    const int *pIndices = model.getIndexBuffer();
+    const int *pPositionIndices = model.getPositionIndexBuffer();
+
+    destroy();
+
+    // Element array bindings go into the bound vertex array object, so keep
+    // the uploads out of the ones drawn with.
+    glBindVertexArray(0);
+
+    m_hasPositions = model.hasPositions();
+    m_hasTextureCoords = model.hasTextureCoords();
+    m_hasNormals = model.hasNormals();
+
+    m_positionBytes = static_cast<size_t>(model.getNumberOfPositions()) * model.getPositionSize();
+    m_positionBuffer = createBuffer(GL_ARRAY_BUFFER, model.getPositionBuffer(), m_positionBytes);
+
+    bool uploaded = (m_positionBytes == 0 || m_positionBuffer != 0) &&
+        uploadVertices(model) &&
+        uploadIndices(INDICES, pIndices ? pIndices + numShortTriangles * 3 : 0,
+            static_cast<size_t>(numTriangles - numShortTriangles) * 3 * sizeof(int), numShortTriangles) &&
+        uploadIndices(SHORT_INDICES, model.getShortIndexBuffer(),
+            static_cast<size_t>(numShortTriangles) * 3 * sizeof(unsigned short), 0) &&
+        uploadIndices(POSITION_INDICES, pPositionIndices ? pPositionIndices + numShortPositionTriangles * 3 : 0,
+            static_cast<size_t>(numTriangles - numShortPositionTriangles) * 3 * sizeof(int), numShortPositionTriangles) &&
+        uploadIndices(SHORT_POSITION_INDICES, model.getShortPositionIndexBuffer(),
+            static_cast<size_t>(numShortPositionTriangles) * 3 * sizeof(unsigned short), 0) &&
+        uploadIndices(LOD_INDICES, model.getLodIndexBuffer(), numLodIndices * sizeof(int), 0) &&
+        uploadIndices(LOD_POSITION_INDICES, model.getLodPositionIndexBuffer(), numLodIndices * sizeof(int), 0);
+
+    m_created = true;
+
+    if (!uploaded || !update(model))
+    {
+        destroy();
+        return false;
+    }
+
+    return true;
+}
+
+bool GPUMesh::update(const ModelOBJ &model)
+{
+    // Uploads the buffers the model built on demand since create().
+
+    if (!m_created)
+        return false;
+
+    glBindVertexArray(0);
+
+    if (model.hasTangents() != m_hasTangents)
+    {
+        // The vertex buffers are replaced, so the vertex arrays pointing into
+        // them are rebuilt the next time they are bound.
+
+        destroyVertexArrays();
+        glDeleteBuffers(1, &m_vertexBuffer);
+        glDeleteBuffers(1, &m_compactVertexBuffer);
+        m_vertexBuffer = 0;
+        m_compactVertexBuffer = 0;
+
+        if (!uploadVertices(model))
+            return false;
+    }
+
+    if (model.hasAdjacency() && !m_hasAdjacency)
+    {
+        // Meshes with 16-bit position indices whose adjacency doesn't fit 16
+        // bits are drawn from the 32-bit adjacency, so it starts at the first
+        // of those.
+
+        int numTriangles = model.getNumberOfTriangles();
+        int numShortTriangles = model.getNumberOfShortPositionTriangles();
+        int firstTriangle = numShortTriangles;
+        const int *pIndicesAdj = model.getPositionIndexBufferAdj();
+
+        for (int i = 0; i < model.getNumberOfMeshes(); ++i)
+        {
+            const ModelOBJ::Mesh &mesh = model.getMesh(i);
+
+            if (mesh.shortPositions && !mesh.shortAdjacency && mesh.startIndex / 3 < firstTriangle)
+                firstTriangle = mesh.startIndex / 3;
+        }
+
+        if (!uploadIndices(POSITION_INDICES_ADJ, pIndicesAdj ? pIndicesAdj + firstTriangle * 6 : 0,
+                static_cast<size_t>(numTriangles - firstTriangle) * 6 * sizeof(int), firstTriangle) ||
+            !uploadIndices(SHORT_POSITION_INDICES_ADJ, model.getShortPositionIndexBufferAdj(),
+                static_cast<size_t>(numShortTriangles) * 6 * sizeof(unsigned short), 0))
+            return false;
+
+        m_hasAdjacency = true;
+    }
+
+    return true;
+}
+
+void GPUMesh::destroy()
+{
+    destroyVertexArrays();
+
+    glDeleteBuffers(1, &m_vertexBuffer);
+    glDeleteBuffers(1, &m_compactVertexBuffer);
+    glDeleteBuffers(1, &m_positionBuffer);
+    glDeleteBuffers(INDICES_COUNT, m_indexBuffers);
+
+    m_vertexBuffer = 0;
+    m_compactVertexBuffer = 0;
+    m_positionBuffer = 0;
+    m_vertexBytes = 0;
+    m_compactVertexBytes = 0;
+    m_positionBytes = 0;
+
+    for (int i = 0; i < INDICES_COUNT; ++i)
+    {
+        m_indexBuffers[i] = 0;
+        m_indexBytes[i] = 0;
+        m_firstTriangles[i] = 0;
+    }
+
+    m_created = false;
+    m_hasPositions = false;
+    m_hasTextureCoords = false;
+    m_hasNormals = false;
+    m_hasTangents = false;
+    m_hasAdjacency = false;
+}
+
+void GPUMesh::bindVertices(Layout layout, GLuint program)
+{
+    GLuint &vertexArray = (layout == LAYOUT_COMPACT) ?
+        m_compactVertexArrays[program] : m_vertexArrays[layout];
+
+    if (vertexArray == 0)
+        vertexArray = createVertexArray(layout, program);
+
+    glBindVertexArray(vertexArray);
+}
+
+void GPUMesh::unbindVertices()
+{
+    glBindVertexArray(0);
+}
+
+void GPUMesh::bindIndices(Indices indices)
+{
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffers[indices]);
+}
+
+std::vector<ModelOBJ::BufferUsage> GPUMesh::memoryUsage() const
+{
+    std::vector<ModelOBJ::BufferUsage> usage;
+
+    AddBufferUsage(usage, "GPU vertices", m_vertexBytes);
+    AddBufferUsage(usage, "GPU compact vertices", m_compactVertexBytes);
+    AddBufferUsage(usage, "GPU positions", m_positionBytes);
+
+    for (int i = 0; i < INDICES_COUNT; ++i)
+        AddBufferUsage(usage, g_indexBufferNames[i], m_indexBytes[i]);
+
+    return usage;
+}
+
+bool GPUMesh::uploadVertices(const ModelOBJ &model)
+{
+    // Models with compact vertices have released their float ones, so only
+    // one of the two vertex buffers is uploaded.
+
+    m_hasTangents = model.hasTangents();
+
+    m_vertexBytes = model.getVertexBuffer() ?
+        static_cast<size_t>(model.getNumberOfVertices()) * model.getVertexSize() : 0;
+    m_vertexBuffer = createBuffer(GL_ARRAY_BUFFER, model.getVertexBuffer(), m_vertexBytes);
+
+    if (m_vertexBytes > 0 && m_vertexBuffer == 0)
+        return false;
+
+    if (!model.hasCompactVertices())
+    {
+        m_compactVertexBytes = 0;
+        return true;
+    }
+
+    m_compactVertexBytes = static_cast<size_t>(model.getNumberOfVertices()) * model.getCompactVertexSize();
+    m_compactVertexBuffer = createBuffer(GL_ARRAY_BUFFER, model.getCompactVertexBuffer(), m_compactVertexBytes);
+
+    return m_compactVertexBuffer != 0;
+}
+
+bool GPUMesh::uploadIndices(Indices indices, const void *pData, size_t bytes, int firstTriangle)
+{
+    // Buffers the model doesn't have are left unbound. pData points at the
+    // indices of firstTriangle.
+
+    m_firstTriangles[indices] = firstTriangle;
+
+    if (pData == 0 || bytes == 0)
+        return true;
+
+    m_indexBuffers[indices] = createBuffer(GL_ELEMENT_ARRAY_BUFFER, pData, bytes);
+    m_indexBytes[indices] = (m_indexBuffers[indices] != 0) ? bytes : 0;
+
+    return m_indexBuffers[indices] != 0;
+}
+
+GLuint GPUMesh::createBuffer(GLenum target, const void *pData, size_t bytes)
+{
+    // The buffers are written once and only ever read by the GPU afterwards.
+
+    GLuint buffer = 0;
+
+    if (pData == 0 || bytes == 0)
+        return 0;
+
+    while (glGetError() != GL_NO_ERROR)
+        ;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    glBufferData(target, static_cast<GLsizeiptr>(bytes), pData, GL_STATIC_DRAW);
+    glBindBuffer(target, 0);
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        fprintf(stderr, "Failed to allocate a %llu KB GPU buffer. \n",
+            static_cast<unsigned long long>(bytes / 1024));
+        glDeleteBuffers(1, &buffer);
+        return 0;
+    }
+
+    return buffer;
+}
+
+GLuint GPUMesh::createVertexArray(Layout layout, GLuint program)
+{
+    GLuint vertexArray = 0;
+    GLint location = -1;
+
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+
+    if (layout == LAYOUT_POSITIONS)
+    {
+        if (m_hasPositions)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, m_positionBuffer);
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glVertexPointer(3, GL_FLOAT, sizeof(float) * 3, BufferOffset(0));
+        }
+    }
+    else if (layout == LAYOUT_COMPACT)
+    {
+        GLsizei stride = sizeof(ModelOBJ::CompactVertex);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_compactVertexBuffer);
+
+        if (m_hasPositions)
+        {
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glVertexPointer(3, GL_SHORT, stride,
+                BufferOffset(offsetof(ModelOBJ::CompactVertex, position)));
+        }
+
+        if (m_hasTextureCoords)
+        {
+            glClientActiveTexture(GL_TEXTURE0);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glTexCoordPointer(2, GL_HALF_FLOAT, stride,
+                BufferOffset(offsetof(ModelOBJ::CompactVertex, texCoord)));
+        }
+
+        // The normals are octahedral encoded, which only the shader can
+        // decode.
+        if (m_hasNormals && (location = glGetAttribLocation(program, "vOctNormal")) >= 0)
+        {
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 2, GL_SHORT, GL_TRUE, stride,
+                BufferOffset(offsetof(ModelOBJ::CompactVertex, normal)));
+        }
+    }
+    else if (m_vertexBuffer != 0)
+    {
+        GLsizei stride = sizeof(ModelOBJ::Vertex);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+
+        if (m_hasPositions)
+        {
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glVertexPointer(3, GL_FLOAT, stride,
+                BufferOffset(offsetof(ModelOBJ::Vertex, position)));
+        }
+
+        if (m_hasTextureCoords)
+        {
+            glClientActiveTexture(GL_TEXTURE0);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glTexCoordPointer(2, GL_FLOAT, stride,
+                BufferOffset(offsetof(ModelOBJ::Vertex, texCoord)));
+        }
+
+        if (m_hasNormals)
+        {
+            glEnableClientState(GL_NORMAL_ARRAY);
+            glNormalPointer(GL_FLOAT, stride,
+                BufferOffset(offsetof(ModelOBJ::Vertex, normal)));
+        }
+
+        // Tangents go through the second texture unit's coordinates.
+        if (m_hasTangents)
+        {
+            glClientActiveTexture(GL_TEXTURE1);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glTexCoordPointer(4, GL_FLOAT, stride,
+                BufferOffset(offsetof(ModelOBJ::Vertex, tangent)));
+            glClientActiveTexture(GL_TEXTURE0);
+        }
+    }
+
+    // The array buffer binding isn't part of the vertex array object.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return vertexArray;
+}
+
+void GPUMesh::destroyVertexArrays()
+{
+    std::map<GLuint, GLuint>::iterator iter = m_compactVertexArrays.begin();
+
+    while (iter != m_compactVertexArrays.end())
+    {
+        glDeleteVertexArrays(1, &iter->second);
+        ++iter;
+    }
+
+    m_compactVertexArrays.clear();
+    glDeleteVertexArrays(LAYOUT_COUNT, m_vertexArrays);
+
+    for (int i = 0; i < LAYOUT_COUNT; ++i)
+        m_vertexArrays[i] = 0;
+}
@@ -0,0 +1,111 @@
+// Copyright info of this file is left out for the assignment.
+
+#if !defined(GPU_MESH_H)
+#define GPU_MESH_H
+
+#include <map>
+#include <vector>
+#include "GL/glew.h"
+#include "model_obj.h"
+
+//-----------------------------------------------------------------------------
+// GPU copy of a ModelOBJ's vertex and index buffers.
+//
+// create() uploads the model's buffers once into static buffer objects, so
+// drawing no longer copies the vertex arrays from host memory every frame.
+// The vertex arrays of each layout the display modes draw with are recorded
+// in a vertex array object the first time the layout is bound. Compact
+// vertices pass their normals as generic attributes, so they get one vertex
+// array object per shader program. Models with compact vertices have no
+// float ones, and their LAYOUT_VERTICES vertex array is left empty.
+//
+// Buffers are never written after they are uploaded. Adjacency, and the
+// tangents, are built on demand after the model is loaded; update() uploads
+// them once they exist, replacing the vertex buffers in the tangents' case.
+//
+// Index buffers are bound with bindIndices() after bindVertices(), as the
+// element array binding is part of the bound vertex array object. Draws then
+// pass byte offsets into it instead of index pointers. Each index buffer only
+// holds the triangles drawn with its index size, starting at the model
+// triangle getFirstTriangle() returns; offsets are relative to that one.
+//-----------------------------------------------------------------------------
+
+class GPUMesh
+{
+public:
+    enum Layout
+    {
+        LAYOUT_VERTICES,        // float vertices through the fixed function arrays
+        LAYOUT_COMPACT,         // compact vertices, decoded by the shader program
+        LAYOUT_POSITIONS,       // the packed position stream only
+        LAYOUT_COUNT
+    };
+
+    enum Indices
+    {
+        INDICES,
+        SHORT_INDICES,
+        POSITION_INDICES,
+        SHORT_POSITION_INDICES,
+        POSITION_INDICES_ADJ,
+        SHORT_POSITION_INDICES_ADJ,
+        LOD_INDICES,
+        LOD_POSITION_INDICES,
+        INDICES_COUNT
+    };
+
+    GPUMesh();
+    ~GPUMesh();
+
+    bool create(const ModelOBJ &model);
+    bool update(const ModelOBJ &model);
+    void destroy();
+
+    void bindVertices(Layout layout, GLuint program = 0);
+    void unbindVertices();
+    void bindIndices(Indices indices);
+
+    bool isCreated() const;
+    int getFirstTriangle(Indices indices) const;
+    std::vector<ModelOBJ::BufferUsage> memoryUsage() const;
+
+private:
+    GPUMesh(const GPUMesh &);
+    GPUMesh &operator=(const GPUMesh &);
+
+    bool uploadVertices(const ModelOBJ &model);
+    bool uploadIndices(Indices indices, const void *pData, size_t bytes, int firstTriangle);
+    GLuint createBuffer(GLenum target, const void *pData, size_t bytes);
+    GLuint createVertexArray(Layout layout, GLuint program);
+    void destroyVertexArrays();
+
+    bool m_created;
+    bool m_hasPositions;
+    bool m_hasTextureCoords;
+    bool m_hasNormals;
+    bool m_hasTangents;
+    bool m_hasAdjacency;
+
+    GLuint m_vertexBuffer;
+    GLuint m_compactVertexBuffer;
+    GLuint m_positionBuffer;
+    GLuint m_indexBuffers[INDICES_COUNT];
+    size_t m_vertexBytes;
+    size_t m_compactVertexBytes;
+    size_t m_positionBytes;
+    size_t m_indexBytes[INDICES_COUNT];
+    int m_firstTriangles[INDICES_COUNT];
+
+    GLuint m_vertexArrays[LAYOUT_COUNT];    // compact ones are kept per program below
+    std::map<GLuint, GLuint> m_compactVertexArrays;
+};
+
+//-----------------------------------------------------------------------------
+
+inline bool GPUMesh::isCreated() const
+{ return m_created; }
+
+inline int GPUMesh::getFirstTriangle(Indices indices) const
+{ return m_firstTriangles[indices]; }
+
+#endif
@@ -0,0 +1,707 @@
+// Copyright info of this file is left out for the assignment.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <cstring>
+#include "input_stream.h"
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace
+{
+    // Gzip member header flags.
+    enum
+    {
+        GZIP_FLAG_HCRC = 1 << 1,
+        GZIP_FLAG_EXTRA = 1 << 2,
+        GZIP_FLAG_NAME = 1 << 3,
+        GZIP_FLAG_COMMENT = 1 << 4,
+        GZIP_FLAG_RESERVED = 0xe0
+    };
+
+    // Base values and extra bits of the length (257-285) and distance codes.
+    const unsigned short LENGTH_BASE[29] =
+    {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+
+    const unsigned char LENGTH_EXTRA[29] =
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+
+    const unsigned short DISTANCE_BASE[30] =
+    {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+        8193, 12289, 16385, 24577
+    };
+
+    const unsigned char DISTANCE_EXTRA[30] =
+    {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+
+    // Order in which a dynamic block stores the code length code lengths.
+    const unsigned char CODE_LENGTH_ORDER[19] =
+    {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+
+    struct Crc32Table
+    {
+        unsigned int entries[256];
+
+        Crc32Table()
+        {
+            for (unsigned int i = 0; i < 256; ++i)
+            {
+                unsigned int crc = i;
+
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+
+                entries[i] = crc;
+            }
+        }
+    };
+
+    const Crc32Table CRC32_TABLE;
+
+    bool SeekFile(FILE *pFile, long long offset, int origin)
+    {
+#if defined(_WIN32)
+        return _fseeki64(pFile, offset, origin) == 0;
+#else
+        return fseeko(pFile, static_cast<off_t>(offset), origin) == 0;
+#endif
+    }
+
+    long long TellFile(FILE *pFile)
+    {
+#if defined(_WIN32)
+        return _ftelli64(pFile);
+#else
+        return static_cast<long long>(ftello(pFile));
+#endif
+    }
+}
+
+InputStream::InputStream()
+{
+    m_pFile = 0;
+    m_ownsFile = false;
+    reset();
+}
+
+InputStream::~InputStream()
+{
+    close();
+}
+
+void InputStream::reset()
+{
+    m_compressed = false;
+    m_error = false;
+    m_size = 0;
+    m_bytesConsumed = 0;
+
+    m_inputPos = 0;
+    m_inputEnd = 0;
+    m_inputEof = false;
+
+    m_bitBuffer = 0;
+    m_bitCount = 0;
+    m_padBits = 0;
+
+    m_state = STATE_MEMBER_HEADER;
+    m_finalBlock = false;
+    m_storedRemaining = 0;
+    m_matchLength = 0;
+    m_matchDistance = 0;
+
+    m_windowPos = 0;
+    m_crc = 0;
+    m_memberSize = 0;
+}
+
+bool InputStream::open(const char *pszFilename)
+{
+    close();
+
+    if (strcmp(pszFilename, "-") == 0)
+    {
+#if defined(_WIN32)
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        m_pFile = stdin;
+        m_ownsFile = false;
+    }
+    else
+    {
+        m_pFile = fopen(pszFilename, "rb");
+
+        if (!m_pFile)
+            return false;
+
+        m_ownsFile = true;
+    }
+
+    m_input.resize(INPUT_BUFFER_SIZE);
+
+    // Peek at the first bytes to find out whether the data is compressed.
+
+    while (m_inputEnd < 2 && fillInput())
+        ;
+
+    m_compressed = m_inputEnd >= 2 && m_input[0] == 0x1f && m_input[1] == 0x8b;
+
+    if (m_compressed)
+        m_window.assign(WINDOW_SIZE, 0);
+
+    // The size is only known for sources that can be seeked, and for
+    // compressed ones only modulo 4 GB from the last member's trailer.
+
+    long long position = TellFile(m_pFile);
+
+    if (position >= 0 && SeekFile(m_pFile, 0, SEEK_END))
+    {
+        long long fileSize = TellFile(m_pFile);
+        unsigned char trailer[4] = {0};
+
+        if (!m_compressed)
+        {
+            m_size = std::max(fileSize, 0LL);
+        }
+        else if (fileSize >= 4 && SeekFile(m_pFile, fileSize - 4, SEEK_SET) &&
+                 fread(trailer, 1, 4, m_pFile) == 4)
+        {
+            m_size = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) |
+                (static_cast<long long>(trailer[3]) << 24);
+
+            // Text compresses well, so data that wrapped around can be
+            // told apart by the size of the compressed file.
+            while (fileSize >= (1LL << 32) && m_size < fileSize)
+                m_size += 1LL << 32;
+        }
+
+        if (!SeekFile(m_pFile, position, SEEK_SET))
+            m_error = true;
+    }
+
+    return !m_error;
+}
+
+void InputStream::close()
+{
+    if (m_pFile && m_ownsFile)
+        fclose(m_pFile);
+
+    m_pFile = 0;
+    m_ownsFile = false;
+    std::vector<unsigned char>().swap(m_input);
+    std::vector<unsigned char>().swap(m_window);
+    reset();
+}
+
+size_t InputStream::read(char *pBuffer, size_t size)
+{
+    size_t produced = 0;
+
+    if (!m_pFile || m_error)
+        return 0;
+
+    if (m_compressed)
+    {
+        inflate(pBuffer, size, produced);
+        return produced;
+    }
+
+    // Pass the data through, starting with the bytes open() peeked at.
+
+    produced = std::min(size, m_inputEnd - m_inputPos);
+
+    if (produced > 0)
+        memcpy(pBuffer, &m_input[m_inputPos], produced);
+
+    m_inputPos += produced;
+
+    if (produced < size && !m_inputEof)
+    {
+        size_t count = fread(pBuffer + produced, 1, size - produced, m_pFile);
+
+        produced += count;
+        m_bytesConsumed += count;
+
+        if (count == 0)
+        {
+            m_inputEof = true;
+            m_error = ferror(m_pFile) != 0;
+        }
+    }
+
+    return produced;
+}
+
+bool InputStream::fillInput()
+{
+    if (m_inputEof)
+        return false;
+
+    if (m_inputPos == m_inputEnd)
+        m_inputPos = m_inputEnd = 0;
+
+    size_t count = fread(&m_input[m_inputEnd], 1, m_input.size() - m_inputEnd, m_pFile);
+
+    if (count == 0)
+    {
+        m_inputEof = true;
+        m_error = ferror(m_pFile) != 0;
+        return false;
+    }
+
+    m_inputEnd += count;
+    m_bytesConsumed += count;
+    return true;
+}
+
+void InputStream::refillBits()
+{
+    // Tops the bit buffer up to at least 57 bits. Past the end of the source
+    // zero bytes are added instead; dropBits() flags an error if any of
+    // those are consumed, i.e. if the data is truncated.
+
+    while (m_bitCount <= 56)
+    {
+        if (m_inputPos == m_inputEnd && !fillInput())
+        {
+            m_padBits += 8;
+            m_bitCount += 8;
+            continue;
+        }
+
+        m_bitBuffer |= static_cast<unsigned long long>(m_input[m_inputPos++]) << m_bitCount;
+        m_bitCount += 8;
+    }
+}
+
+void InputStream::dropBits(int count)
+{
+    m_bitBuffer >>= count;
+    m_bitCount -= count;
+
+    if (m_bitCount < m_padBits)
+    {
+        m_error = true;
+        m_padBits = m_bitCount;
+    }
+}
+
+unsigned int InputStream::getBits(int count)
+{
+    if (count == 0)
+        return 0;
+
+    if (m_bitCount < count)
+        refillBits();
+
+    unsigned int value = static_cast<unsigned int>(m_bitBuffer & ((1ULL << count) - 1));
+
+    dropBits(count);
+    return m_error ? 0 : value;
+}
+
+bool InputStream::buildHuffman(Huffman &huffman, const unsigned char *pLengths, int count)
+{
+    // Builds the canonical code for the given code lengths. Codes of up to
+    // FAST_BITS bits are entered bit reversed into the lookup table, once
+    // for every value of the bits that follow them. Over-subscribed sets of
+    // lengths are rejected; incomplete ones fail in decodeSymbol() if one
+    // of their missing codes is read.
+
+    unsigned short offsets[MAX_CODE_BITS + 2];
+    int left = 1;
+
+    memset(huffman.counts, 0, sizeof(huffman.counts));
+    memset(huffman.fast, 0, sizeof(huffman.fast));
+
+    for (int i = 0; i < count; ++i)
+        ++huffman.counts[pLengths[i]];
+
+    huffman.counts[0] = 0;
+
+    for (int length = 1; length <= MAX_CODE_BITS; ++length)
+    {
+        left = (left << 1) - huffman.counts[length];
+
+        if (left < 0)
+            return false;
+    }
+
+    offsets[1] = 0;
+
+    for (int length = 1; length <= MAX_CODE_BITS; ++length)
+        offsets[length + 1] = offsets[length] + huffman.counts[length];
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (pLengths[i] != 0)
+            huffman.symbols[offsets[pLengths[i]]++] = static_cast<unsigned short>(i);
+    }
+
+    for (int length = 1, code = 0, index = 0; length <= FAST_BITS; ++length, code <<= 1)
+    {
+        for (int i = 0; i < huffman.counts[length]; ++i, ++code, ++index)
+        {
+            int reversed = 0;
+
+            for (int bit = 0; bit < length; ++bit)
+                reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+
+            for (int fill = reversed; fill < (1 << FAST_BITS); fill += 1 << length)
+                huffman.fast[fill] = static_cast<unsigned short>((length << 9) | huffman.symbols[index]);
+        }
+    }
+
+    return true;
+}
+
+int InputStream::decodeSymbol(const Huffman &huffman)
+{
+    if (m_bitCount < MAX_CODE_BITS)
+        refillBits();
+
+    unsigned int entry = huffman.fast[m_bitBuffer & ((1 << FAST_BITS) - 1)];
+
+    if (entry != 0)
+    {
+        dropBits(entry >> 9);
+        return static_cast<int>(entry & 511);
+    }
+
+    // Longer codes are decoded a bit at a time.
+
+    int code = 0;
+    int first = 0;
+    int index = 0;
+
+    for (int length = 1; length <= MAX_CODE_BITS; ++length)
+    {
+        code |= static_cast<int>(getBits(1));
+
+        int count = huffman.counts[length];
+
+        if (code - first < count)
+            return huffman.symbols[index + code - first];
+
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+
+    m_error = true;
+    return -1;
+}
+
+bool InputStream::readMemberHeader()
+{
+    if (getBits(8) != 0x1f || getBits(8) != 0x8b || getBits(8) != 8)
+        return false;
+
+    unsigned int flags = getBits(8);
+
+    getBits(16);    // modification time
+    getBits(16);
+    getBits(16);    // extra flags and operating system
+
+    if (flags & GZIP_FLAG_RESERVED)
+        return false;
+
+    if (flags & GZIP_FLAG_EXTRA)
+    {
+        for (unsigned int length = getBits(16); length > 0 && !m_error; --length)
+            getBits(8);
+    }
+
+    if (flags & GZIP_FLAG_NAME)
+    {
+        while (getBits(8) != 0)
+            ;
+    }
+
+    if (flags & GZIP_FLAG_COMMENT)
+    {
+        while (getBits(8) != 0)
+            ;
+    }
+
+    if (flags & GZIP_FLAG_HCRC)
+        getBits(16);
+
+    m_crc = 0xffffffffu;
+    m_memberSize = 0;
+    m_finalBlock = false;
+    return !m_error;
+}
+
+bool InputStream::readMemberTrailer()
+{
+    dropBits(m_bitCount & 7);
+
+    unsigned int crc = getBits(16);
+
+    crc |= getBits(16) << 16;
+
+    unsigned int size = getBits(16);
+
+    size |= getBits(16) << 16;
+
+    return !m_error && crc == ~m_crc && size == static_cast<unsigned int>(m_memberSize);
+}
+
+bool InputStream::readBlockHeader()
+{
+    m_finalBlock = getBits(1) != 0;
+
+    switch (getBits(2))
+    {
+    case 0: // stored
+        {
+            dropBits(m_bitCount & 7);
+
+            unsigned int length = getBits(16);
+            unsigned int complement = getBits(16);
+
+            if (length != (~complement & 0xffff))
+                return false;
+
+            m_storedRemaining = length;
+            m_state = STATE_STORED;
+        }
+        break;
+
+    case 1: // fixed Huffman codes
+        {
+            unsigned char lengths[288 + 30];
+
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+            memset(lengths + 288, 5, 30);
+
+            buildHuffman(m_literalCode, lengths, 288);
+            buildHuffman(m_distanceCode, lengths + 288, 30);
+            m_state = STATE_HUFFMAN;
+        }
+        break;
+
+    case 2: // dynamic Huffman codes
+        if (!readDynamicTables())
+            return false;
+
+        m_state = STATE_HUFFMAN;
+        break;
+
+    default:
+        return false;
+    }
+
+    return !m_error;
+}
+
+bool InputStream::readDynamicTables()
+{
+    unsigned char lengths[288 + 32] = {0};
+    int numLiterals = static_cast<int>(getBits(5)) + 257;
+    int numDistances = static_cast<int>(getBits(5)) + 1;
+    int numCodeLengths = static_cast<int>(getBits(4)) + 4;
+
+    if (numLiterals > 286 || numDistances > 30)
+        return false;
+
+    for (int i = 0; i < numCodeLengths; ++i)
+        lengths[CODE_LENGTH_ORDER[i]] = static_cast<unsigned char>(getBits(3));
+
+    // The literal/length and distance code lengths are themselves Huffman
+    // coded, with run lengths for repeats and zeros.
+
+    Huffman &codeLengthCode = m_distanceCode;
+
+    if (!buildHuffman(codeLengthCode, lengths, 19))
+        return false;
+
+    memset(lengths, 0, sizeof(lengths));
+
+    for (int i = 0; i < numLiterals + numDistances && !m_error; )
+    {
+        int symbol = decodeSymbol(codeLengthCode);
+        int repeat = 0;
+        unsigned char value = 0;
+
+        if (symbol < 0)
+            return false;
+
+        if (symbol < 16)
+        {
+            lengths[i++] = static_cast<unsigned char>(symbol);
+            continue;
+        }
+
+        if (symbol == 16)
+        {
+            if (i == 0)
+                return false;
+
+            value = lengths[i - 1];
+            repeat = 3 + static_cast<int>(getBits(2));
+        }
+        else if (symbol == 17)
+        {
+            repeat = 3 + static_cast<int>(getBits(3));
+        }
+        else
+        {
+            repeat = 11 + static_cast<int>(getBits(7));
+        }
+
+        if (i + repeat > numLiterals + numDistances)
+            return false;
+
+        memset(lengths + i, value, repeat);
+        i += repeat;
+    }
+
+    // Every block has to be able to end.
+    if (m_error || lengths[256] == 0)
+        return false;
+
+    return buildHuffman(m_literalCode, lengths, numLiterals) &&
+        buildHuffman(m_distanceCode, lengths + numLiterals, numDistances);
+}
+
+inline void InputStream::putByte(char *pBuffer, size_t &produced, unsigned char value)
+{
+    pBuffer[produced++] = static_cast<char>(value);
+    m_window[m_windowPos] = value;
+    m_windowPos = (m_windowPos + 1) & (WINDOW_SIZE - 1);
+    m_crc = CRC32_TABLE.entries[(m_crc ^ value) & 0xff] ^ (m_crc >> 8);
+    ++m_memberSize;
+}
+
+void InputStream::inflate(char *pBuffer, size_t size, size_t &produced)
+{
+    // Decodes until the caller's buffer is full or the data ends. A match
+    // or stored block cut short by the end of the buffer is continued by
+    // the next call.
+
+    while (produced < size && !m_error)
+    {
+        switch (m_state)
+        {
+        case STATE_MEMBER_HEADER:
+            if (!readMemberHeader())
+                m_error = true;
+            else
+                m_state = STATE_BLOCK_HEADER;
+            break;
+
+        case STATE_BLOCK_HEADER:
+            if (m_finalBlock)
+                m_state = STATE_MEMBER_TRAILER;
+            else if (!readBlockHeader())
+                m_error = true;
+            break;
+
+        case STATE_STORED:
+            while (produced < size && m_storedRemaining > 0 && !m_error)
+            {
+                putByte(pBuffer, produced, static_cast<unsigned char>(getBits(8)));
+                --m_storedRemaining;
+            }
+
+            if (m_storedRemaining == 0)
+                m_state = STATE_BLOCK_HEADER;
+            break;
+
+        case STATE_HUFFMAN:
+            while (produced < size && !m_error)
+            {
+                if (m_matchLength > 0)
+                {
+                    unsigned int from = (m_windowPos - m_matchDistance) & (WINDOW_SIZE - 1);
+
+                    putByte(pBuffer, produced, m_window[from]);
+                    --m_matchLength;
+                    continue;
+                }
+
+                int symbol = decodeSymbol(m_literalCode);
+
+                if (symbol < 256)
+                {
+                    if (symbol >= 0)
+                        putByte(pBuffer, produced, static_cast<unsigned char>(symbol));
+                    continue;
+                }
+
+                if (symbol == 256)
+                {
+                    m_state = STATE_BLOCK_HEADER;
+                    break;
+                }
+
+                symbol -= 257;
+
+                if (symbol >= 29)
+                {
+                    m_error = true;
+                    break;
+                }
+
+                m_matchLength = LENGTH_BASE[symbol] + static_cast<int>(getBits(LENGTH_EXTRA[symbol]));
+
+                int distance = decodeSymbol(m_distanceCode);
+
+                if (distance < 0 || distance >= 30)
+                {
+                    m_error = true;
+                    break;
+                }
+
+                m_matchDistance = DISTANCE_BASE[distance] + static_cast<int>(getBits(DISTANCE_EXTRA[distance]));
+
+                if (m_matchDistance > m_memberSize)
+                    m_error = true;
+            }
+            break;
+
+        case STATE_MEMBER_TRAILER:
+            if (!readMemberTrailer())
+            {
+                m_error = true;
+                break;
+            }
+
+            // Another member may follow. Anything else after the trailer,
+            // e.g. zero padding, is ignored.
+            refillBits();
+
+            if (m_bitCount - m_padBits >= 16 && (m_bitBuffer & 0xffff) == 0x8b1f)
+                m_state = STATE_MEMBER_HEADER;
+            else
+                m_state = STATE_END;
+            break;
+
+        case STATE_END:
+            return;
+        }
+    }
+}
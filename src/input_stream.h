@@ -0,0 +1,140 @@
+// Copyright info of this file is left out for the assignment.
+
+#if !defined(INPUT_STREAM_H)
+#define INPUT_STREAM_H
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Sequential reader for files, pipes and stdin that transparently inflates
+// gzip compressed data.
+//
+// The source is read front to back exactly once, so sources that can't be
+// seeked or memory mapped work as well. A source that starts with the gzip
+// magic bytes is decompressed on the fly with a built in DEFLATE decoder
+// (RFC 1951 and RFC 1952, including files of several concatenated gzip
+// members); anything else is passed through unchanged. The CRC-32 and size
+// in every gzip trailer are checked at the end of their member.
+//
+// The file name "-" reads stdin.
+//-----------------------------------------------------------------------------
+
+class InputStream
+{
+public:
+    InputStream();
+    ~InputStream();
+
+    bool open(const char *pszFilename);
+    void close();
+
+    // Reads up to size bytes, less only at the end of the data or after an
+    // error. Returns the number of bytes read.
+    size_t read(char *pBuffer, size_t size);
+
+    // Uncompressed size of the data if it is known up front, e.g. for
+    // regular files, and 0 otherwise.
+    long long getSize() const;
+
+    // Bytes read from the source so far, before decompression.
+    long long getBytesConsumed() const;
+
+    bool isCompressed() const;
+    bool isOpen() const;
+    bool hasError() const;
+
+private:
+    InputStream(const InputStream &);
+    InputStream &operator=(const InputStream &);
+
+    enum
+    {
+        FAST_BITS = 10,             // bits resolved by one table lookup
+        MAX_CODE_BITS = 15,
+        WINDOW_SIZE = 1 << 15,
+        INPUT_BUFFER_SIZE = 1 << 16
+    };
+
+    // Canonical Huffman code with a lookup table for the short codes.
+    struct Huffman
+    {
+        unsigned short fast[1 << FAST_BITS];    // code length << 9 | symbol
+        unsigned short counts[MAX_CODE_BITS + 1];
+        unsigned short symbols[288];
+    };
+
+    enum State
+    {
+        STATE_MEMBER_HEADER,
+        STATE_BLOCK_HEADER,
+        STATE_STORED,
+        STATE_HUFFMAN,
+        STATE_MEMBER_TRAILER,
+        STATE_END
+    };
+
+    bool buildHuffman(Huffman &huffman, const unsigned char *pLengths, int count);
+    int decodeSymbol(const Huffman &huffman);
+    void dropBits(int count);
+    bool fillInput();
+    unsigned int getBits(int count);
+    void inflate(char *pBuffer, size_t size, size_t &produced);
+    void putByte(char *pBuffer, size_t &produced, unsigned char value);
+    bool readBlockHeader();
+    bool readDynamicTables();
+    bool readMemberHeader();
+    bool readMemberTrailer();
+    void refillBits();
+    void reset();
+
+    FILE *m_pFile;
+    bool m_ownsFile;
+    bool m_compressed;
+    bool m_error;
+    long long m_size;
+    long long m_bytesConsumed;
+
+    std::vector<unsigned char> m_input;
+    size_t m_inputPos;
+    size_t m_inputEnd;
+    bool m_inputEof;
+
+    unsigned long long m_bitBuffer;
+    int m_bitCount;
+    int m_padBits;              // zero bits past the end of the source
+
+    State m_state;
+    bool m_finalBlock;
+    unsigned int m_storedRemaining;
+    int m_matchLength;          // bytes still to be copied from the window
+    int m_matchDistance;
+
+    std::vector<unsigned char> m_window;
+    unsigned int m_windowPos;
+    unsigned int m_crc;
+    long long m_memberSize;     // bytes inflated from the current member
+
+    Huffman m_literalCode;
+    Huffman m_distanceCode;
+};
+
+//-----------------------------------------------------------------------------
+
+inline long long InputStream::getSize() const
+{ return m_size; }
+
+inline long long InputStream::getBytesConsumed() const
+{ return m_bytesConsumed; }
+
+inline bool InputStream::isCompressed() const
+{ return m_compressed; }
+
+inline bool InputStream::isOpen() const
+{ return m_pFile != 0; }
+
+inline bool InputStream::hasError() const
+{ return m_error; }
+
+#endif
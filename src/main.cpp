@@ -6,10 +6,14 @@
 
 #include "vector3.h"
 #include "model_obj.h"
+#include "model_loader.h"
+#include "gpu_mesh.h"
 #include "bitmap.h"
 #include "glShader.h"
 
+#include <chrono>
 #include <map>
+#include <vector>
 
 
 // Enumeration
@@ -41,8 +45,42 @@ char* g_DisplayModeNames[] = {
     "Shadow Volume Visualization"
 };
 
+// Uniforms set by the renderer, by slot in every shader
+enum EnumUniform {
+    UNIFORM_COLORMAP = 0,
+    UNIFORM_SHADOWMAP,
+    UNIFORM_DEPTHMAP,
+    UNIFORM_FRAMETIME,
+    UNIFORM_COMPACTVERTICES,
+    UNIFORM_POSITIONSCALE,
+    UNIFORM_POSITIONBIAS,
+    UNIFORM_MODELSCALE,
+    UNIFORM_MODELOFFSET,
+    UNIFORMNUM };
+
+const char* g_UniformNames[] = {
+    "colorMap",
+    "shadowMap",
+    "depthMap",
+    "g_fFrameTime",
+    "g_bCompactVertices",
+    "g_vPositionScale",
+    "g_vPositionBias",
+    "g_fModelScale",
+    "g_vModelOffset"
+};
+
 typedef std::map<std::string, GLuint> ModelTextures;
 
+// Model space view state the meshlets are culled against
+struct MeshletCuller
+{
+	bool bFrustum;			// skip meshlets outside the planes
+	bool bBackFace;			// skip meshlets facing away from the eye
+	float planes[6][4];		// frustum planes, inside where dot(plane, p) >= 0
+	float eye[3];			// viewer or light position
+};
+
 // variables
 EnumDisplayMode displayMode = TEXTURESMOOTHSHADED;	// current display mode
 int mainMenu, displayMenu;		// glut menu handlers
@@ -61,21 +99,45 @@ int g_iFrameCount = 0;
 float g_fFPS = 0;
 const int g_iShadowMapDim = 768;
 ModelOBJ g_model;	// OBJ mesh representation
+GPUMesh g_gpuMesh;	// g_model's buffers uploaded to the GPU
+ModelOBJ::ImportOptions g_importOptions;	// set from the command line
+ModelLoader g_modelLoader;	// imports models in the background
+std::vector<std::string> g_modelFilenames;	// models given on the command line
+int g_currentModel = 0;
 ModelTextures       g_modelTextures;
 GLuint		g_nullTexture = 0;
-GLShader	g_shaderPerVertLight;
-GLShader	g_shaderPerFragLight;
-GLShader	g_shaderAmbient;
-GLShader	g_shaderPerLightDiffuseSpecular;
-GLShader	g_shaderShadowVolume;
-GLShader	g_shaderShadowMap;
+// Shader permutations, see LoadShaders(). [textured] is 1 for the variants
+// that sample the color map, [animated] for those that animate the model.
+const int	g_iNumLights = 2;
+GLShader	g_shaderPerVertLight[2];		// [textured]
+GLShader	g_shaderPerFragLight[2][2];		// [animated][textured]
+GLShader	g_shaderAmbient[2];				// [textured]
+GLShader	g_shaderPerLightDiffuseSpecular[g_iNumLights][2];	// [light][textured]
+GLShader	g_shaderShadowVolume[g_iNumLights];	// [light]
+GLShader	g_shaderShadowMap[g_iNumLights][2];	// [light][textured]
 GLShader	g_shaderShadowMapVis;
+GLShader	g_shaderFallback;			// drawn with until a mode's programs are linked
+GLShader	g_shaderUnlit;				// unlit fixed function modes, see FixedFunctionShader()
+std::vector<GLShader *>	g_pendingShaders;	// programs still compiling in the background
+std::chrono::steady_clock::time_point	g_shaderLoadStart;
+bool		g_bFirstFrame = true;
+GLShader	*g_pCurrentShader = 0;	// shader in use, 0 for the fixed function pipeline
 GLuint      g_fboId;  // Hold id of the framebuffer for light POV depth rendering
 GLuint      g_depthTextureId;  // texture associated to the depth framebuffer fboId
 
 
 float				g_maxAnisotrophy = 1.0f;
 bool                g_enableTextures = true;
+bool                g_bAnimate = true;		// animate the per-fragment lighting mode, toggled with 'a'
+bool                g_bCullMeshlets = true;	// toggled with 'c'
+int                 g_iForcedLod = -1;		// -1 picks the level from the screen size, cycled with 'l'
+int                 g_iCurrentLod = 0;		// level drawn this frame, 0 is full detail
+const float         g_fPixelsPerTriangle = 8.0f;	// screen area aimed for per visible triangle
+bool                g_bMeasureOverdraw = false;	// toggled with 'o'
+GLuint              g_overdrawQuery = 0;	// GL_SAMPLES_PASSED query
+long long           g_overdrawSamples = 0;	// samples shaded in the current frame
+int                 g_overdrawPasses = 0;	// shaded passes in the current frame
+float               g_fOverdraw[MODENUM];	// last measurement of each display mode
 
 // functions
 void SetBoundingBox();
@@ -88,9 +150,26 @@ void ReshapeFunc(int width, int height);
 void DisplayFunc();
 void IdleFunc();
 void DrawModelOnly();
-void DrawModelTriangleAdj();
+void DrawModelTriangleAdj(int lightIndex);
 void DrawModelShaded();
+GLShader *FixedFunctionShader();
+void SelectLod();
+void SetupMeshletCuller(MeshletCuller &culler, bool bFrustum, bool bBackFace, const GLfloat eyePoint[3]);
+bool IsMeshletVisible(const MeshletCuller &culler, const ModelOBJ::Meshlet &meshlet);
+void DrawMeshTriangles(GLenum mode, int indicesPerTriangle, const ModelOBJ::Mesh &mesh, bool bShort,
+	GPUMesh::Indices shortIndices, GPUMesh::Indices indices, GLint baseVertex, const MeshletCuller &culler);
+bool IsBackFaceCullingEnabled();
+void LoadShaders();
+void LoadShader(GLShader &shader, const char *pszFilename, const char *pszDefines);
+bool IsDisplayModeReady(EnumDisplayMode mode);
+void FinishPendingShaders();
+int MillisecondsSince(std::chrono::steady_clock::time_point start);
+int TexturedVariant();
+void UseShader(GLShader *pShader);
+void BindModelVertices(GLShader *pShader, bool bCompact);
+void UnbindModelVertices();
 void SetTransformMatrices();
+void ApplyModelTransform();
 void SetupShadowMapTextureMatrix(GLfloat lightModelView[], GLfloat lightProjection[]);
 void SetupShadowMapPOVMatrices(GLfloat lightPosition[]);
 void DrawWireframe();
@@ -102,6 +181,10 @@ void DrawShaderPerVertexLighting();
 void DrawShaderPerFragmentLighting();
 void DrawWithShadowMap(bool bVisualize);
 void DrawWithShadowVolume(bool bVisualize);
+void DrawFallbackShaded();
+void MeasureOverdraw();
+void ReportOverdraw();
+void ReportMemoryUsage();
 
 void KeyboardFunc(unsigned char ch, int x, int y);
 void MouseFunc(int button, int state, int x, int y);
@@ -112,6 +195,7 @@ void DrawText(float x, float y, char *string);
 GLuint LoadTexture(const char *pszFilename);
 GLuint CreateNullTexture(int width, int height);
 void LoadModel(const char *pszFilename);
+void FinishLoadModel();
 void UnloadModel();
 
 void SetBoundingBox() {
@@ -173,6 +257,7 @@ void InitGL() {
 	glDisable(GL_COLOR_MATERIAL);
 	glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
 	glEnable(GL_LIGHTING);
+	glEnable(GL_RESCALE_NORMAL);	// the model transform scales the normals
 	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambientLight);
 	glLightfv (GL_LIGHT0, GL_POSITION, light0Position);
 	glLightfv(GL_LIGHT0, GL_AMBIENT, light0Ambient);
@@ -201,14 +286,7 @@ void InitGL() {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    // load shaders
-	g_shaderPerVertLight.LoadShaderProgramFromFile("..\\shaders\\blinn_phong_vert.glsl");
-	g_shaderPerFragLight.LoadShaderProgramFromFile("..\\shaders\\blinn_phong_frag.glsl");
-    g_shaderAmbient.LoadShaderProgramFromFile("..\\shaders\\render_ambient.glsl");
-    g_shaderPerLightDiffuseSpecular.LoadShaderProgramFromFile("..\\shaders\\render_perlight_diff_spec.glsl");
-    g_shaderShadowVolume.LoadShaderProgramFromFile("..\\shaders\\shadow_volume.glsl");
-    g_shaderShadowMap.LoadShaderProgramFromFile("..\\shaders\\render_perlight_shadow_map.glsl");
-    g_shaderShadowMapVis.LoadShaderProgramFromFile("..\\shaders\\visualize_shadow_map.glsl");
+    LoadShaders();
 
     // Create null texture for consistently shading models without a texture
 	g_nullTexture = CreateNullTexture(2, 2);
@@ -238,6 +316,144 @@ void InitMenu() {
 	glutAttachMenu(GLUT_RIGHT_BUTTON);
 }
 
+// Build the shader permutations the display modes pick from. The light
+// index, shadow technique, texturing and animation are compile time
+// constants of each, so the shaders have no branches on them.
+//
+// Only the fallback shader is built before the first frame. The others are
+// handed to the driver and finished in the background, see
+// FinishPendingShaders(), so startup doesn't wait for programs of display
+// modes that aren't drawn yet.
+void LoadShaders()
+{
+	g_shaderLoadStart = std::chrono::steady_clock::now();
+	char defines[100];
+
+	g_shaderFallback.SetUniformSlots(g_UniformNames, UNIFORMNUM);
+	g_shaderFallback.LoadShaderProgramFromFile("..\\shaders\\fallback.glsl", 0, g_importOptions.useCache);
+
+	for (int textured = 0; textured < 2; ++textured)
+	{
+		for (int animated = 0; animated < 2; ++animated)
+		{
+			sprintf_s(defines, 100, "LIGHT_COUNT=%d TEXTURED=%d ANIMATED=%d", g_iNumLights, textured, animated);
+			LoadShader(g_shaderPerFragLight[animated][textured], "..\\shaders\\blinn_phong_frag.glsl", defines);
+		}
+
+		sprintf_s(defines, 100, "LIGHT_COUNT=%d TEXTURED=%d", g_iNumLights, textured);
+		LoadShader(g_shaderPerVertLight[textured], "..\\shaders\\blinn_phong_vert.glsl", defines);
+		LoadShader(g_shaderAmbient[textured], "..\\shaders\\render_ambient.glsl", defines);
+
+		for (int light = 0; light < g_iNumLights; ++light)
+		{
+			sprintf_s(defines, 100, "LIGHT_INDEX=%d TEXTURED=%d SHADOW_MAP=0", light, textured);
+			LoadShader(g_shaderPerLightDiffuseSpecular[light][textured], "..\\shaders\\render_perlight.glsl", defines);
+
+			sprintf_s(defines, 100, "LIGHT_INDEX=%d TEXTURED=%d SHADOW_MAP=1", light, textured);
+			LoadShader(g_shaderShadowMap[light][textured], "..\\shaders\\render_perlight.glsl", defines);
+		}
+	}
+
+	for (int light = 0; light < g_iNumLights; ++light)
+	{
+		sprintf_s(defines, 100, "LIGHT_INDEX=%d", light);
+		LoadShader(g_shaderShadowVolume[light], "..\\shaders\\shadow_volume.glsl", defines);
+	}
+
+	LoadShader(g_shaderShadowMapVis, "..\\shaders\\visualize_shadow_map.glsl", 0);
+	LoadShader(g_shaderUnlit, "..\\shaders\\unlit.glsl", 0);
+
+	fprintf(stdout, "Shaders started in %d ms, %d compiling %s.\n", MillisecondsSince(g_shaderLoadStart),
+		static_cast<int>(g_pendingShaders.size()),
+		GLShader::IsParallelCompileSupported() ? "in parallel" : "in the background");
+}
+
+// Load a shader permutation, from the program cache unless --no-cache is
+// given. Programs that have to be compiled are finished later.
+void LoadShader(GLShader &shader, const char *pszFilename, const char *pszDefines)
+{
+	shader.SetUniformSlots(g_UniformNames, UNIFORMNUM);
+	shader.LoadShaderProgramFromFile(pszFilename, pszDefines, g_importOptions.useCache, true);
+
+	if (shader.IsPending())
+		g_pendingShaders.push_back(&shader);
+}
+
+// Returns false while a program the display mode draws with is still being
+// compiled, finishing the ones the driver is done with.
+bool IsDisplayModeReady(EnumDisplayMode mode)
+{
+	// The shader modes draw with textures enabled, see TexturedVariant().
+	int textured = g_modelTextures.empty() ? 0 : 1;
+	bool ready = true;
+
+	switch (mode) {
+	case SHADERGOURAUD:
+		return g_shaderPerVertLight[textured].IsReady();
+	case SHADERPHONG:
+		return g_shaderPerFragLight[g_bAnimate][textured].IsReady();
+	case SHADOWMAPVIS:
+		ready = g_shaderShadowMapVis.IsReady();
+		// fall through
+	case SHADOWMAP:
+		ready = g_shaderAmbient[textured].IsReady() && ready;
+		for (int i = 0; i < g_iNumLights; ++i)
+			ready = g_shaderShadowMap[i][textured].IsReady() && ready;
+		return ready;
+	case SHADOWVOLUME:
+	case SHADOWVOLUMEVIS:
+		ready = g_shaderAmbient[textured].IsReady();
+		for (int i = 0; i < g_iNumLights; ++i)
+		{
+			ready = g_shaderShadowVolume[i].IsReady() && ready;
+			ready = g_shaderPerLightDiffuseSpecular[i][textured].IsReady() && ready;
+		}
+		return ready;
+	default:
+		// The fixed function modes only need programs for compact vertices.
+		if (g_model.getVertexBuffer() || !g_model.hasCompactVertices())
+			return true;
+		return g_shaderUnlit.IsReady() && g_shaderPerVertLight[0].IsReady() &&
+			g_shaderPerVertLight[textured].IsReady();
+	}
+}
+
+// Finish the programs that are done compiling in the background. Without
+// parallel compile support finishing a program waits for the driver, so
+// only one is finished per frame.
+void FinishPendingShaders()
+{
+	std::vector<GLShader *>::iterator i = g_pendingShaders.begin();
+
+	while (i != g_pendingShaders.end())
+	{
+		if (!(*i)->IsPending())
+		{
+			i = g_pendingShaders.erase(i);
+		}
+		else if ((*i)->IsReady())
+		{
+			i = g_pendingShaders.erase(i);
+
+			if (!GLShader::IsParallelCompileSupported())
+				break;
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	if (g_pendingShaders.empty())
+		fprintf(stdout, "All shaders ready in %d ms.\n", MillisecondsSince(g_shaderLoadStart));
+}
+
+int MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start).count());
+}
+
 void ChangeDisplayMode(EnumDisplayMode mode)
 {
 	if(int(mode) >= MODENUM || int(mode) < 0 )
@@ -312,6 +528,7 @@ void SetupShadowMapPOVMatrices(GLfloat lightPosition[])
 	glRotatef(-stheta, 1.0, 0.0, 0.0);
 	glRotatef(sphi, 0.0, 0.0, 1.0);
 	glTranslatef(-g_center[0], -g_center[1], -g_center[2]);
+	ApplyModelTransform();
 
 }
 
@@ -358,6 +575,19 @@ void SetTransformMatrices()
 	glRotatef(sphi, 0.0, 0.0, 1.0);
 
 	glTranslatef(-g_center[0], -g_center[1], -g_center[2]);
+	ApplyModelTransform();
+}
+
+// normalize() leaves the vertices as stored and only records the scale and
+// offset that bring them to the normalized model, so apply it here.
+void ApplyModelTransform()
+{
+	float scale;
+	float offset[3];
+
+	g_model.getTransform(scale, offset);
+	glScalef(scale, scale, scale);
+	glTranslatef(offset[0], offset[1], offset[2]);
 }
 
 
@@ -365,120 +595,429 @@ void SetTransformMatrices()
 void DisplayFunc() {
 
     SetTransformMatrices();
+	SelectLod();
 
 	// clear the framebuffer and the depth buffer
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	switch (displayMode) {
-	case WIREFRAME: DrawWireframe(); break;
-	case HIDDENLINE: DrawHiddenLine(); break;
-//	case FLATSHADED: DrawFlatShaded(); break;
-//	case SMOOTHSHADED: DrawSmoothShaded(); break;
-	case TEXTURESMOOTHSHADED: DrawTexturedSmoothShaded(); break;
-	case SHADERGOURAUD: DrawShaderPerVertexLighting(); break;
-	case SHADERPHONG: DrawShaderPerFragmentLighting(); break;
-    case SHADOWMAP: DrawWithShadowMap(false); break;
-    case SHADOWMAPVIS: DrawWithShadowMap(true); break;
-    case SHADOWVOLUME: DrawWithShadowVolume(false); break;
-    case SHADOWVOLUMEVIS: DrawWithShadowVolume(true); break;
+	// Modes whose programs are still compiling draw with the fallback shader
+	// and switch over once they are linked.
+	bool bModeReady = IsDisplayModeReady(displayMode);
+
+	if (!bModeReady)
+	{
+		DrawFallbackShaded();
+	}
+	else
+	{
+		switch (displayMode) {
+		case WIREFRAME: DrawWireframe(); break;
+		case HIDDENLINE: DrawHiddenLine(); break;
+//		case FLATSHADED: DrawFlatShaded(); break;
+//		case SMOOTHSHADED: DrawSmoothShaded(); break;
+		case TEXTURESMOOTHSHADED: DrawTexturedSmoothShaded(); break;
+		case SHADERGOURAUD: DrawShaderPerVertexLighting(); break;
+		case SHADERPHONG: DrawShaderPerFragmentLighting(); break;
+		case SHADOWMAP: DrawWithShadowMap(false); break;
+		case SHADOWMAPVIS: DrawWithShadowMap(true); break;
+		case SHADOWVOLUME: DrawWithShadowVolume(false); break;
+		case SHADOWVOLUMEVIS: DrawWithShadowVolume(true); break;
+		}
 	}
 
 	//  Print the FPS to the window
 	char strBuf[100];
-	sprintf_s(strBuf, 100, "FPS: %4.1f", g_fFPS);
+	sprintf_s(strBuf, 100, "FPS: %4.1f  LOD: %d", g_fFPS, g_iCurrentLod);
 	DrawText(-0.9f, -0.9f, strBuf);
 
+	if (!bModeReady)
+	{
+		sprintf_s(strBuf, 100, "Compiling shaders...");
+		DrawText(-0.9f, 0.75f, strBuf);
+	}
+
+	if (g_bMeasureOverdraw)
+	{
+		MeasureOverdraw();
+		sprintf_s(strBuf, 100, "Overdraw: %4.2f (%d passes)", g_fOverdraw[displayMode], g_overdrawPasses);
+		DrawText(-0.9f, -0.8f, strBuf);
+		g_overdrawPasses = 0;
+	}
+
+	// Show the progress of a model that is loading in the background
+	if (g_modelLoader.isLoading())
+	{
+		static const char *stageNames[] = {
+			"Waiting", "Loading cache", "Parsing", "Building triangles",
+			"Post processing", "Finishing"
+		};
+
+		const ModelOBJ::ImportProgress &progress = g_modelLoader.getProgress();
+		long long totalBytes = progress.totalBytes;
+
+		sprintf_s(strBuf, 100, "%s: %3d%%", stageNames[progress.stage],
+			(totalBytes > 0) ? static_cast<int>(std::min(progress.bytesParsed * 100 / totalBytes, 100LL)) : 0);
+		DrawText(-0.9f, 0.85f, strBuf);
+	}
+
 	glutSwapBuffers();
+
+	if (g_bFirstFrame)
+	{
+		fprintf(stdout, "First frame drawn %d ms after the shaders were started.\n",
+			MillisecondsSince(g_shaderLoadStart));
+		g_bFirstFrame = false;
+	}
 }
 
-void DrawModelTriangleAdj()
+void DrawModelTriangleAdj(int lightIndex)
 {
-    const ModelOBJ::Mesh *pMesh = 0;
-    const ModelOBJ::Material *pMaterial = 0;
-    const ModelOBJ::Vertex *pVertices = 0;
-    ModelTextures::const_iterator iter;
-    GLuint texture = 0;
+    MeshletCuller culler;
+    GLfloat lightPosition[4];
+
+    // Only triangles facing the light extrude silhouettes, so meshlets that
+    // face away from it can be skipped. The volumes reach beyond the view
+    // frustum, so they are never frustum culled.
+    glGetLightfv(GL_LIGHT0 + lightIndex, GL_POSITION, lightPosition);
+    SetupMeshletCuller(culler, false, true, lightPosition);
+
+    // The shadow volume shader only reads positions, so draw from the packed
+    // position stream instead of the interleaved vertex buffer.
+    g_gpuMesh.bindVertices(GPUMesh::LAYOUT_POSITIONS);
+
+    glActiveTexture(GL_TEXTURE0);
+    glDisable(GL_TEXTURE_2D);
 
     // Iterate all the object meshes in the OBJ file
     for (int i = 0; i < g_model.getNumberOfMeshes(); ++i)
     {
-        pMesh = &g_model.getMesh(i);
-        pMaterial = pMesh->pMaterial;
-        pVertices = g_model.getVertexBuffer();
+        // Meshes whose adjacency doesn't fit 16 bits fall back to 32-bit indices.
+        const ModelOBJ::Mesh &mesh = g_model.getMesh(i);
 
-        glActiveTexture(GL_TEXTURE0);
-        glDisable(GL_TEXTURE_2D);
+        DrawMeshTriangles(GL_TRIANGLES_ADJACENCY, 6, mesh, mesh.shortAdjacency, GPUMesh::SHORT_POSITION_INDICES_ADJ,
+            GPUMesh::POSITION_INDICES_ADJ, mesh.basePosition, culler);
+    }
 
-        // Bind vertex position buffer
-        if (g_model.hasPositions())
-        {
-            glEnableClientState(GL_VERTEX_ARRAY);
-            glVertexPointer(3, GL_FLOAT, g_model.getVertexSize(),
-                g_model.getVertexBuffer()->position);
-        }
+    g_gpuMesh.unbindVertices();
+}
 
-        // Bind normal direction buffer
-        if (g_model.hasNormals())
-        {
-            glEnableClientState(GL_NORMAL_ARRAY);
-            glNormalPointer(GL_FLOAT, g_model.getVertexSize(),
-                g_model.getVertexBuffer()->normal);
-        }
+void DrawModelOnly()
+{
+    const ModelOBJ::Mesh *pMesh = 0;
+    MeshletCuller culler;
+    GLfloat eyePosition[3] = {0.0f, 0.0f, 0.0f};
+
+    SetupMeshletCuller(culler, true, IsBackFaceCullingEnabled(), eyePosition);
+
+    // Depth only pass: draw from the packed position stream.
+    g_gpuMesh.bindVertices(GPUMesh::LAYOUT_POSITIONS);
 
-        // Draw all the triangles in one batch. Yay!
-        glDrawElements(GL_TRIANGLES_ADJACENCY, pMesh->triangleCount * 6, GL_UNSIGNED_INT,
-            g_model.getIndexBufferAdj() + pMesh->startIndex * 2);
+    // Iterate the meshes of the level of detail picked for this frame
+    const ModelOBJ::Lod *pLod = (g_iCurrentLod > 0) ? &g_model.getLod(g_iCurrentLod - 1) : 0;
+    int numMeshes = pLod ? pLod->meshCount : g_model.getNumberOfMeshes();
 
-        if (g_model.hasNormals())
-            glDisableClientState(GL_NORMAL_ARRAY);
-        if (g_model.hasPositions())
-            glDisableClientState(GL_VERTEX_ARRAY);
+    for (int i = 0; i < numMeshes; ++i)
+    {
+        pMesh = pLod ? &g_model.getLodMesh(pLod->startMesh + i) : &g_model.getMesh(i);
+
+        DrawMeshTriangles(GL_TRIANGLES, 3, *pMesh, pMesh->shortPositions, GPUMesh::SHORT_POSITION_INDICES,
+            pLod ? GPUMesh::LOD_POSITION_INDICES : GPUMesh::POSITION_INDICES,
+            pMesh->basePosition, culler);
     }
+
+    g_gpuMesh.unbindVertices();
 }
 
-void DrawModelOnly()
+// Pick the coarsest level of detail that still has about one front facing
+// triangle per g_fPixelsPerTriangle pixels of the model's bounding sphere on
+// screen. Shadow volumes are extruded from the full detail model, so the lit
+// passes drawn with them stay at full detail too.
+void SelectLod()
 {
-    const ModelOBJ::Mesh *pMesh = 0;
-    const ModelOBJ::Vertex *pVertices = 0;
+	int numLods = g_model.getNumberOfLods();
 
-    // Iterate all the object meshes in the OBJ file
-    for (int i = 0; i < g_model.getNumberOfMeshes(); ++i)
-    {
-        pMesh = &g_model.getMesh(i);
-        pVertices = g_model.getVertexBuffer();
+	g_iCurrentLod = 0;
 
-        // Bind vertex position buffer
-        if (g_model.hasPositions())
-        {
-            glEnableClientState(GL_VERTEX_ARRAY);
-            glVertexPointer(3, GL_FLOAT, g_model.getVertexSize(),
-                g_model.getVertexBuffer()->position);
-        }
+	if (g_iForcedLod >= 0)
+	{
+		g_iCurrentLod = std::min(g_iForcedLod, numLods);
+		return;
+	}
 
-        // Draw all the triangles in one batch. Yay!
-        glDrawElements(GL_TRIANGLES, pMesh->triangleCount * 3, GL_UNSIGNED_INT,
-            g_model.getIndexBuffer() + pMesh->startIndex);
+	if (displayMode == SHADOWVOLUME || displayMode == SHADOWVOLUMEVIS)
+		return;
 
-        if (g_model.hasPositions())
-            glDisableClientState(GL_VERTEX_ARRAY);
-    }
+	double PI = 3.14159265358979323846;
+	float radius = g_model.getRadius();
+
+	if (sdepth <= radius)
+		return;
+
+	double pixels = radius / (sdepth * tan(0.5 * g_fov * PI / 180.0)) * winHeight * 0.5;
+	double triangles = 2.0 * PI * pixels * pixels / g_fPixelsPerTriangle;
+
+	for (int i = 0; i < numLods; ++i)
+	{
+		if (g_model.getLod(i).triangleCount >= triangles)
+			g_iCurrentLod = i + 1;
+	}
+}
+
+// Only the back faces of counter-clockwise triangles are culled by the
+// meshlet back-face test
+bool IsBackFaceCullingEnabled()
+{
+	GLint cullFace = 0;
+	GLint frontFace = 0;
+
+	glGetIntegerv(GL_CULL_FACE_MODE, &cullFace);
+	glGetIntegerv(GL_FRONT_FACE, &frontFace);
+	return glIsEnabled(GL_CULL_FACE) && cullFace == GL_BACK && frontFace == GL_CCW;
+}
+
+// Set up meshlet culling for the current model-view and projection matrices.
+// eyePoint is the viewer or light position in eye space.
+void SetupMeshletCuller(MeshletCuller &culler, bool bFrustum, bool bBackFace, const GLfloat eyePoint[3])
+{
+	GLfloat modelView[16], projection[16], clip[16];
+
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+
+	culler.bFrustum = bFrustum && g_bCullMeshlets;
+	culler.bBackFace = bBackFace && g_bCullMeshlets;
+
+	// Frustum planes of the model space clip matrix (Gribb and Hartmann)
+	for (int col = 0; col < 4; ++col)
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			clip[col * 4 + row] = 0.0f;
+			for (int k = 0; k < 4; ++k)
+				clip[col * 4 + row] += projection[k * 4 + row] * modelView[col * 4 + k];
+		}
+	}
+
+	for (int i = 0; i < 6; ++i)
+	{
+		float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+
+		for (int k = 0; k < 4; ++k)
+			culler.planes[i][k] = clip[k * 4 + 3] + sign * clip[k * 4 + i / 2];
+	}
+
+	// Bring the eye point into model space: undo the translation of the
+	// model-view matrix and apply the inverse of its upper 3x3, which is
+	// stored column-major like the GL matrices.
+	float p[3] = {eyePoint[0] - modelView[12], eyePoint[1] - modelView[13], eyePoint[2] - modelView[14]};
+	const GLfloat *m = modelView;
+	float inverse[9] = {
+		m[5] * m[10] - m[9] * m[6], m[9] * m[2] - m[1] * m[10], m[1] * m[6] - m[5] * m[2],
+		m[8] * m[6] - m[4] * m[10], m[0] * m[10] - m[8] * m[2], m[4] * m[2] - m[0] * m[6],
+		m[4] * m[9] - m[8] * m[5], m[8] * m[1] - m[0] * m[9], m[0] * m[5] - m[4] * m[1]
+	};
+	float det = m[0] * inverse[0] + m[4] * inverse[1] + m[8] * inverse[2];
+
+	if (det == 0.0f)
+	{
+		culler.bBackFace = false;
+		return;
+	}
+
+	for (int i = 0; i < 3; ++i)
+		culler.eye[i] = (inverse[i] * p[0] + inverse[3 + i] * p[1] + inverse[6 + i] * p[2]) / det;
+}
+
+bool IsMeshletVisible(const MeshletCuller &culler, const ModelOBJ::Meshlet &meshlet)
+{
+	const float *c = meshlet.center;
+
+	if (culler.bFrustum)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			const float *plane = culler.planes[i];
+			float length = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+
+			if (plane[0] * c[0] + plane[1] * c[1] + plane[2] * c[2] + plane[3] < -meshlet.radius * length)
+				return false;
+		}
+	}
+
+	if (culler.bBackFace)
+	{
+		float d[3] = {c[0] - culler.eye[0], c[1] - culler.eye[1], c[2] - culler.eye[2]};
+		float distance = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		const float *axis = meshlet.coneAxis;
+
+		if (d[0] * axis[0] + d[1] * axis[1] + d[2] * axis[2] >= meshlet.coneCutoff * distance + meshlet.radius)
+			return false;
+	}
+
+	return true;
+}
+
+// Draw the visible meshlets of a mesh. Runs of visible meshlets are merged
+// and all of them go out in a single multi-draw call, with byte offsets into
+// the mesh's GPU index buffer. bShort picks the 16-bit index buffer, whose
+// indices are relative to baseVertex.
+void DrawMeshTriangles(GLenum mode, int indicesPerTriangle, const ModelOBJ::Mesh &mesh, bool bShort,
+	GPUMesh::Indices shortIndices, GPUMesh::Indices indices, GLint baseVertex, const MeshletCuller &culler)
+{
+	static std::vector<GLsizei> counts;
+	static std::vector<GLvoid *> offsets;
+	static std::vector<GLint> baseVertices;
+
+	GPUMesh::Indices drawIndices = bShort ? shortIndices : indices;
+	size_t indexSize = bShort ? sizeof(unsigned short) : sizeof(int);
+	int firstTriangle = g_gpuMesh.getFirstTriangle(drawIndices);
+
+	// Current run of visible triangles
+	int runStart = mesh.startIndex / 3;
+	int runEnd = runStart;
+
+	auto addRun = [&]()
+	{
+		if (runEnd == runStart)
+			return;
+
+		counts.push_back((runEnd - runStart) * indicesPerTriangle);
+		offsets.push_back(reinterpret_cast<GLvoid *>(
+			static_cast<size_t>(runStart - firstTriangle) * indicesPerTriangle * indexSize));
+	};
+
+	counts.clear();
+	offsets.clear();
+
+	if ((culler.bFrustum || culler.bBackFace) && mesh.meshletCount > 0)
+	{
+		for (int i = 0; i < mesh.meshletCount; ++i)
+		{
+			const ModelOBJ::Meshlet &meshlet = g_model.getMeshlet(mesh.startMeshlet + i);
+			int start = meshlet.startIndex / 3;
+
+			if (!IsMeshletVisible(culler, meshlet))
+				continue;
+
+			if (start != runEnd)
+			{
+				addRun();
+				runStart = start;
+			}
+
+			runEnd = start + meshlet.triangleCount;
+		}
+	}
+	else
+	{
+		runEnd = runStart + mesh.triangleCount;
+	}
+
+	addRun();
+
+	if (counts.empty())
+		return;
+
+	g_gpuMesh.bindIndices(drawIndices);
+
+	if (bShort)
+	{
+		baseVertices.assign(counts.size(), baseVertex);
+		glMultiDrawElementsBaseVertex(mode, &counts[0], GL_UNSIGNED_SHORT, &offsets[0],
+			static_cast<GLsizei>(counts.size()), &baseVertices[0]);
+	}
+	else
+	{
+		glMultiDrawElements(mode, &counts[0], GL_UNSIGNED_INT,
+			const_cast<const GLvoid **>(&offsets[0]), static_cast<GLsizei>(counts.size()));
+	}
+}
+
+// The shader variants that sample the color map are only used if the model
+// has textures. The others skip the lookup of the white null texture.
+int TexturedVariant()
+{
+	return (g_enableTextures && !g_modelTextures.empty()) ? 1 : 0;
+}
+
+// Use a shader program, or the fixed function pipeline if pShader is 0
+void UseShader(GLShader *pShader)
+{
+	// Shaders that failed to load fall back to the fixed function pipeline.
+	if (pShader && pShader->GetShader() == 0)
+		pShader = 0;
+
+	g_pCurrentShader = pShader;
+	glUseProgram(pShader ? pShader->GetShader() : 0);
+}
+
+void BindModelVertices(GLShader *pShader, bool bCompact)
+{
+	// Tell the shader how to decode the vertices
+	if (pShader)
+	{
+		float scale[3] = {1.0f, 1.0f, 1.0f};
+		float bias[3] = {0.0f, 0.0f, 0.0f};
+
+		if (bCompact)
+			g_model.getPositionDecode(scale, bias);
+
+		pShader->SetUniform(UNIFORM_COMPACTVERTICES, static_cast<GLint>(bCompact));
+		pShader->SetUniform3(UNIFORM_POSITIONSCALE, scale);
+		pShader->SetUniform3(UNIFORM_POSITIONBIAS, bias);
+	}
+
+	// The compact vertex array passes the octahedral normals and tangents
+	// to the program's own attributes, so each program has its own.
+	if (bCompact)
+		g_gpuMesh.bindVertices(GPUMesh::LAYOUT_COMPACT, pShader->GetShader());
+	else
+		g_gpuMesh.bindVertices(GPUMesh::LAYOUT_VERTICES);
 }
 
+void UnbindModelVertices()
+{
+	g_gpuMesh.unbindVertices();
+}
 
 void DrawModelShaded()
 {
 	const ModelOBJ::Mesh *pMesh = 0;
 	const ModelOBJ::Material *pMaterial = 0;
-	const ModelOBJ::Vertex *pVertices = 0;
 	ModelTextures::const_iterator iter;
 	GLuint texture = 0;
-	
-	// Iterate all the object meshes in the OBJ file
-	for (int i = 0; i < g_model.getNumberOfMeshes(); ++i)
+	MeshletCuller culler;
+	GLfloat eyePosition[3] = {0.0f, 0.0f, 0.0f};
+
+	SetupMeshletCuller(culler, true, IsBackFaceCullingEnabled(), eyePosition);
+
+	// Shaders decode the compact vertex format themselves. The fixed function
+	// pipeline can't, so models that only have compact vertices are drawn
+	// with the shader that matches its state.
+	GLShader *pFixedFunctionShader = g_pCurrentShader ? 0 : FixedFunctionShader();
+
+	if (pFixedFunctionShader)
+	{
+		UseShader(pFixedFunctionShader);
+		pFixedFunctionShader->SetUniform(UNIFORM_COLORMAP, 0);
+	}
+
+	bool bCompact = (g_pCurrentShader != 0) && g_model.hasCompactVertices();
+
+	BindModelVertices(g_pCurrentShader, bCompact);
+
+	// Count the samples this pass shades
+	if (g_bMeasureOverdraw)
+		glBeginQuery(GL_SAMPLES_PASSED, g_overdrawQuery);
+
+	// Iterate the meshes of the level of detail picked for this frame
+	const ModelOBJ::Lod *pLod = (g_iCurrentLod > 0) ? &g_model.getLod(g_iCurrentLod - 1) : 0;
+	int numMeshes = pLod ? pLod->meshCount : g_model.getNumberOfMeshes();
+
+	for (int i = 0; i < numMeshes; ++i)
 	{
-		pMesh = &g_model.getMesh(i);
+		pMesh = pLod ? &g_model.getLodMesh(pLod->startMesh + i) : &g_model.getMesh(i);
 		pMaterial = pMesh->pMaterial;
-		pVertices = g_model.getVertexBuffer();
 
 		// Set mesh-specific material properties
 		glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, pMaterial->ambient);
@@ -502,62 +1041,38 @@ void DrawModelShaded()
 		glEnable(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, texture);
 
-		// Bind vertex position buffer
-		if (g_model.hasPositions())
-		{
-			glEnableClientState(GL_VERTEX_ARRAY);
-			glVertexPointer(3, GL_FLOAT, g_model.getVertexSize(),
-				g_model.getVertexBuffer()->position);
-		}
+		DrawMeshTriangles(GL_TRIANGLES, 3, *pMesh, pMesh->shortIndices, GPUMesh::SHORT_INDICES,
+			pLod ? GPUMesh::LOD_INDICES : GPUMesh::INDICES, pMesh->baseVertex, culler);
+	}
 
-		// Bind texture coordinate buffer
-		if (g_model.hasTextureCoords())
-		{
-			glClientActiveTexture(GL_TEXTURE0);
-			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-			glTexCoordPointer(2, GL_FLOAT, g_model.getVertexSize(),
-				g_model.getVertexBuffer()->texCoord);
-		}
+	if (g_bMeasureOverdraw)
+	{
+		GLuint samples = 0;
 
-		// Bind normal direction buffer
-		if (g_model.hasNormals())
-		{
-			glEnableClientState(GL_NORMAL_ARRAY);
-			glNormalPointer(GL_FLOAT, g_model.getVertexSize(),
-				g_model.getVertexBuffer()->normal);
-		}
+		glEndQuery(GL_SAMPLES_PASSED);
+		glGetQueryObjectuiv(g_overdrawQuery, GL_QUERY_RESULT, &samples);
+		g_overdrawSamples += samples;
+		++g_overdrawPasses;
+	}
 
-		// Bind tangent direction buffer
-		if (g_model.hasTangents())
-		{
-			glClientActiveTexture(GL_TEXTURE1);
-			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-			glTexCoordPointer(4, GL_FLOAT, g_model.getVertexSize(),
-				g_model.getVertexBuffer()->tangent);
-		}
+	// Unbind the input buffers
+	UnbindModelVertices();
 
-		// Draw all the triangles in one batch. Yay!
-		glDrawElements(GL_TRIANGLES, pMesh->triangleCount * 3, GL_UNSIGNED_INT,
-			g_model.getIndexBuffer() + pMesh->startIndex);
+	glBindTexture(GL_TEXTURE_2D, 0);
 
-		// Unbind the input buffers
-		if (g_model.hasTangents())
-		{
-			glClientActiveTexture(GL_TEXTURE1);
-			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-		}
-		if (g_model.hasNormals())
-			glDisableClientState(GL_NORMAL_ARRAY);
-		if (g_model.hasTextureCoords())
-		{
-			glClientActiveTexture(GL_TEXTURE0);
-			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-		}
-		if (g_model.hasPositions())
-			glDisableClientState(GL_VERTEX_ARRAY);
-	}
+	if (pFixedFunctionShader)
+		UseShader(0);
+}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+// The per-vertex lighting shader when lighting is enabled, which matches the
+// fixed function lights and texturing, or else the unlit shader. Returns 0
+// for models that have float vertices the fixed function pipeline can draw.
+GLShader *FixedFunctionShader()
+{
+	if (g_model.getVertexBuffer() || !g_model.hasCompactVertices())
+		return 0;
+
+	return glIsEnabled(GL_LIGHTING) ? &g_shaderPerVertLight[TexturedVariant()] : &g_shaderUnlit;
 }
 
 // Wireframe render function
@@ -615,57 +1130,90 @@ void DrawTexturedSmoothShaded() {
 // Render using the programmable shader for per-vertex lighting
 void DrawShaderPerVertexLighting() { 
 	g_enableTextures = true;
-	glUseProgram(g_shaderPerVertLight.GetShader());
+	GLShader &shader = g_shaderPerVertLight[TexturedVariant()];
 
-	// Update shader parameters.
-	glUniform1i(glGetUniformLocation(
-		g_shaderPerVertLight.GetShader(), "colorMap"), 0);
+	UseShader(&shader);
 
-	glUniform1f(glGetUniformLocation(
-		g_shaderPerVertLight.GetShader(), "g_fFrameTime"), g_fFrameTime);
+	// Update shader parameters.
+	shader.SetUniform(UNIFORM_COLORMAP, 0);
 
 	DrawModelShaded();
 
-	glUseProgram(0);
+	UseShader(0);
 }
 
 // Render using the programmable shader for per-fragment lighting
 void DrawShaderPerFragmentLighting() { 
 	g_enableTextures = true;
-	glUseProgram(g_shaderPerFragLight.GetShader());
+	GLShader &shader = g_shaderPerFragLight[g_bAnimate][TexturedVariant()];
+
+	UseShader(&shader);
 
 	// Update shader parameters.
-	glUniform1i(glGetUniformLocation(
-		g_shaderPerFragLight.GetShader(), "colorMap"), 0);
+	shader.SetUniform(UNIFORM_COLORMAP, 0);
+	shader.SetUniform(UNIFORM_FRAMETIME, g_fFrameTime);
+
+	// The animation works on the normalized model.
+	float scale;
+	float offset[3];
 
-	glUniform1f(glGetUniformLocation(
-		g_shaderPerFragLight.GetShader(), "g_fFrameTime"), g_fFrameTime);
+	g_model.getTransform(scale, offset);
+	shader.SetUniform(UNIFORM_MODELSCALE, scale);
+	shader.SetUniform3(UNIFORM_MODELOFFSET, offset);
 
 	DrawModelShaded();
 
-	glUseProgram(0);
+	UseShader(0);
+}
+
+// Render with the fallback shader while the display mode's programs compile
+void DrawFallbackShaded() { 
+	g_enableTextures = true;
+
+	UseShader(&g_shaderFallback);
+
+	// Update shader parameters.
+	g_shaderFallback.SetUniform(UNIFORM_COLORMAP, 0);
+
+	DrawModelShaded();
+
+	UseShader(0);
 }
 
 // Render scene with shadow volume
 void DrawWithShadowVolume(bool bVisualize) { 
     g_enableTextures = true;
+    int textured = TexturedVariant();
 
     // Render the ambient light first
-    glUseProgram(g_shaderAmbient.GetShader());
-    glUniform1f(glGetUniformLocation(
-        g_shaderPerFragLight.GetShader(), "g_fFrameTime"), g_fFrameTime);
+    UseShader(&g_shaderAmbient[textured]);
+    g_shaderAmbient[textured].SetUniform(UNIFORM_COLORMAP, 0);
 	DrawModelShaded();
     
+    // The shadow volumes are extruded from triangles with adjacency, which
+    // is only built once a shadow volume mode is first drawn.
+    if (!g_model.hasAdjacency())
+    {
+        const ModelOBJ::ImportStatistics &stats = g_model.getImportStatistics();
+
+        g_model.generateAdjacency();
+        fprintf(stdout, "Adjacency: %d boundary edges, %d non-manifold edges. \n",
+            stats.boundaryEdges, stats.nonManifoldEdges);
+
+        if (!g_gpuMesh.update(g_model))
+            fprintf(stderr, "Failed to upload the adjacency to the GPU. \n");
+
+        ReportMemoryUsage();
+    }
+
     // Set shadow volume render states
     glEnable(GL_STENCIL_TEST);
 
     // Iterate all lights
-    for(int i = 0; i < 2; ++i)
+    for(int i = 0; i < g_iNumLights; ++i)
     {
         // render shadow volume
-        glUseProgram(g_shaderShadowVolume.GetShader());
-        glUniform1i(glGetUniformLocation(
-            g_shaderShadowVolume.GetShader(), "lightIndex"), i);
+        UseShader(&g_shaderShadowVolume[i]);
         glClear(GL_STENCIL_BUFFER_BIT);
         if(bVisualize)
         {
@@ -689,15 +1237,12 @@ void DrawWithShadowVolume(bool bVisualize) {
         glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
         glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
         // Draw the model in triangle-with-adjacency
-        DrawModelTriangleAdj();
+        DrawModelTriangleAdj(i);
 
         // render per-light diffuse and specular contribution
         // based on the stencil buffer
-        glUseProgram(g_shaderPerLightDiffuseSpecular.GetShader());
-        glUniform1i(glGetUniformLocation(
-            g_shaderPerLightDiffuseSpecular.GetShader(), "colorMap"), 0);
-        glUniform1i(glGetUniformLocation(
-            g_shaderPerLightDiffuseSpecular.GetShader(), "lightIndex"), i);
+        UseShader(&g_shaderPerLightDiffuseSpecular[i][textured]);
+        g_shaderPerLightDiffuseSpecular[i][textured].SetUniform(UNIFORM_COLORMAP, 0);
         glDepthMask(GL_TRUE);        // Can write to depth
         glDepthFunc(GL_LEQUAL);      // Depth func <=, allow re-rendering the front surface
         glEnable(GL_DEPTH);
@@ -714,17 +1259,17 @@ void DrawWithShadowVolume(bool bVisualize) {
     glDisable(GL_BLEND);
     glDepthFunc(GL_LESS);           // Reset depth function to <
     glDisable(GL_STENCIL_TEST);     // Disable stencil test 
-    glUseProgram(0);
+    UseShader(0);
 }
 
 void DrawWithShadowMap(bool bVisualize)
 {
     g_enableTextures = true;
+    int textured = TexturedVariant();
 
     // Render the ambient light first
-    glUseProgram(g_shaderAmbient.GetShader());
-    glUniform1f(glGetUniformLocation(
-        g_shaderAmbient.GetShader(), "g_fFrameTime"), g_fFrameTime);
+    UseShader(&g_shaderAmbient[textured]);
+    g_shaderAmbient[textured].SetUniform(UNIFORM_COLORMAP, 0);
     DrawModelShaded();
 
     GLfloat lightPosition[2][4];
@@ -732,7 +1277,7 @@ void DrawWithShadowMap(bool bVisualize)
     glGetLightfv(GL_LIGHT1, GL_POSITION, lightPosition[1]);
 
     // Iterate all lights
-    for(int i = 0; i < 2; ++i)
+    for(int i = 0; i < g_iNumLights; ++i)
     {
         glPushAttrib(GL_ALL_ATTRIB_BITS);
         GLfloat lightModelView[16];
@@ -741,7 +1286,7 @@ void DrawWithShadowMap(bool bVisualize)
         // First step: Render the shadow map
         // Render from the light POV to a FBO, store depth values only
         glBindFramebuffer(GL_FRAMEBUFFER, g_fboId);	// Rendering offscreen
-        glUseProgram(0);        // Using the fixed pipeline to render to the depthbuffer
+        UseShader(0);           // Using the fixed pipeline to render to the depthbuffer
         glViewport(0, 0, g_iShadowMapDim, g_iShadowMapDim); // Setting shadow map viewport
         glClear(GL_DEPTH_BUFFER_BIT);
         glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); // Disable color rendering, we only want to write to the Z-Buffer
@@ -778,12 +1323,11 @@ void DrawWithShadowMap(bool bVisualize)
                 viewport[3] = origViewport[3];
             }
             glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
-            glUseProgram(g_shaderShadowMapVis.GetShader());
+            UseShader(&g_shaderShadowMapVis);
             glActiveTexture(GL_TEXTURE1);               // Bind the depth texture to texture_1 slot
             glEnable(GL_TEXTURE_2D);
             glBindTexture(GL_TEXTURE_2D, g_depthTextureId);
-            glUniform1i(glGetUniformLocation(
-                g_shaderShadowMapVis.GetShader(), "depthMap"), 1);
+            g_shaderShadowMapVis.SetUniform(UNIFORM_DEPTHMAP, 1);
             // Draw a quad for displaying the shadow map
             glBegin(GL_QUADS);
             glVertex3i(-1, -1, -1);
@@ -796,16 +1340,12 @@ void DrawWithShadowMap(bool bVisualize)
         }
         else
         {
-            glUseProgram(g_shaderShadowMap.GetShader());
+            UseShader(&g_shaderShadowMap[i][textured]);
             SetTransformMatrices();         // Restore the original scene transformation matrices
             SetupShadowMapTextureMatrix( lightModelView, lightProjection ); // Setup the matrix for shadow map coordinate computation
             // Update shader parameters.
-            glUniform1i(glGetUniformLocation(
-                g_shaderShadowMap.GetShader(), "lightIndex"), i);
-            glUniform1i(glGetUniformLocation(
-                g_shaderShadowMap.GetShader(), "colorMap"), 0);
-            glUniform1i(glGetUniformLocation(
-                g_shaderShadowMap.GetShader(), "shadowMap"), 1);
+            g_shaderShadowMap[i][textured].SetUniform(UNIFORM_COLORMAP, 0);
+            g_shaderShadowMap[i][textured].SetUniform(UNIFORM_SHADOWMAP, 1);
             // Render the diffuse and specular light with shadow
             // into the framebuffer using additive blending
             glEnable(GL_BLEND);
@@ -822,10 +1362,95 @@ void DrawWithShadowMap(bool bVisualize)
         }
         glPopAttrib();
     }
-    glUseProgram(0);
+    UseShader(0);
+
+}
+
 
+// Overdraw of the current display mode: the samples shaded by all of its
+// passes over the samples the model covers. The coverage is counted by
+// priming the depth buffer with the model and drawing it again with an equal
+// depth test. The frame has been drawn already, so its depth can be reused.
+void MeasureOverdraw()
+{
+	GLuint coveredSamples = 0;
+
+	glPushAttrib(GL_ALL_ATTRIB_BITS);
+	SetTransformMatrices();
+	UseShader(0);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDisable(GL_BLEND);
+	glDisable(GL_STENCIL_TEST);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	DrawModelOnly();
+
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_EQUAL);
+	glBeginQuery(GL_SAMPLES_PASSED, g_overdrawQuery);
+	DrawModelOnly();
+	glEndQuery(GL_SAMPLES_PASSED);
+	glGetQueryObjectuiv(g_overdrawQuery, GL_QUERY_RESULT, &coveredSamples);
+	glPopAttrib();
+
+	g_fOverdraw[displayMode] = (coveredSamples > 0) ?
+		static_cast<float>(g_overdrawSamples) / coveredSamples : 0.0f;
+	g_overdrawSamples = 0;
+}
+
+// Print the bytes held by each of the model's buffers
+void ReportMemoryUsage()
+{
+	std::vector<ModelOBJ::BufferUsage> usage = g_model.memoryUsage();
+	size_t allocated = 0;
+	size_t mapped = 0;
+
+	fprintf(stdout, "Model memory:\n");
+
+	for (size_t i = 0; i < usage.size(); ++i)
+	{
+		fprintf(stdout, "    %-28s %8llu KB%s\n", usage[i].pszName,
+			static_cast<unsigned long long>(usage[i].bytes / 1024), usage[i].mapped ? " (mapped)" : "");
+
+		if (usage[i].mapped)
+			mapped += usage[i].bytes;
+		else
+			allocated += usage[i].bytes;
+	}
+
+	fprintf(stdout, "    %llu KB allocated, %llu KB mapped from the cache file.\n",
+		static_cast<unsigned long long>(allocated / 1024), static_cast<unsigned long long>(mapped / 1024));
+
+	usage = g_gpuMesh.memoryUsage();
+	allocated = 0;
+
+	fprintf(stdout, "GPU memory:\n");
+
+	for (size_t i = 0; i < usage.size(); ++i)
+	{
+		fprintf(stdout, "    %-28s %8llu KB\n", usage[i].pszName,
+			static_cast<unsigned long long>(usage[i].bytes / 1024));
+		allocated += usage[i].bytes;
+	}
+
+	fprintf(stdout, "    %llu KB in buffer objects.\n", static_cast<unsigned long long>(allocated / 1024));
 }
 
+// Print the last overdraw measured in every display mode
+void ReportOverdraw()
+{
+	fprintf(stdout, "Overdraw (shaded samples per covered sample):\n");
+
+	for (int i = 0; i < MODENUM; ++i)
+	{
+		if (g_fOverdraw[i] > 0.0f)
+			fprintf(stdout, "    %-45s %5.2f\n", g_DisplayModeNames[i], g_fOverdraw[i]);
+	}
+}
 
 // GLUT keyboard callback function
 void KeyboardFunc(unsigned char ch, int x, int y) {
@@ -834,6 +1459,40 @@ void KeyboardFunc(unsigned char ch, int x, int y) {
 	case '6': case '7': case '8': case '9':  
 		ChangeDisplayMode(EnumDisplayMode(ch - '1'));
 		break;
+	case 'n': case 'N':	// load the next model from the command line
+		g_currentModel = (g_currentModel + 1) % static_cast<int>(g_modelFilenames.size());
+		LoadModel(g_modelFilenames[g_currentModel].c_str());
+		break;
+	case 'r': case 'R':	// reload the current model
+		LoadModel(g_modelFilenames[g_currentModel].c_str());
+		break;
+	case 'c': case 'C':	// toggle meshlet culling
+		g_bCullMeshlets = !g_bCullMeshlets;
+		fprintf(stdout, "Meshlet culling %s.\n", g_bCullMeshlets ? "on" : "off");
+		break;
+	case 'l': case 'L':	// cycle through automatic and fixed levels of detail
+		if (++g_iForcedLod > g_model.getNumberOfLods())
+			g_iForcedLod = -1;
+		if (g_iForcedLod < 0)
+			fprintf(stdout, "LOD: automatic.\n");
+		else
+			fprintf(stdout, "LOD: %d, %d triangles.\n", g_iForcedLod, (g_iForcedLod > 0) ?
+				g_model.getLod(g_iForcedLod - 1).triangleCount : g_model.getNumberOfTriangles());
+		break;
+	case 'o': case 'O':	// toggle the overdraw measurement
+		if (g_bMeasureOverdraw)
+			ReportOverdraw();
+		else if (g_overdrawQuery == 0)
+			glGenQueries(1, &g_overdrawQuery);
+		g_bMeasureOverdraw = !g_bMeasureOverdraw;
+		break;
+	case 'a': case 'A':	// toggle the animation of the per-fragment lighting mode
+		g_bAnimate = !g_bAnimate;
+		fprintf(stdout, "Animation %s.\n", g_bAnimate ? "on" : "off");
+		break;
+	case 'm': case 'M':	// print the memory held by the model's buffers
+		ReportMemoryUsage();
+		break;
 	case 27:
 		exit(0);
 		break;
@@ -875,6 +1534,14 @@ void IdleFunc() {
 	g_fFrameTime = (float)glutGet(GLUT_ELAPSED_TIME); 
 
 	CalculateFPS();
+
+	// Swap in a model that finished loading in the background
+	if (g_modelLoader.isFinished())
+		FinishLoadModel();
+
+	if (!g_pendingShaders.empty())
+		FinishPendingShaders();
+
 	//  Call display function (draw the current frame)
 	glutPostRedisplay ();
 }
@@ -901,18 +1568,44 @@ void CalculateFPS()
 // main function
 void main(int argc, char **argv) {
 	glutInit(&argc, argv);
+
+	// Parse the command line options. Anything else is a model to load.
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--loader=legacy") == 0)
+			g_importOptions.loader = ModelOBJ::ImportOptions::LOADER_LEGACY;
+		else if (strcmp(argv[i], "--loader=mmap") == 0)
+			g_importOptions.loader = ModelOBJ::ImportOptions::LOADER_MMAP;
+		else if (strcmp(argv[i], "--loader=stream") == 0)
+			g_importOptions.loader = ModelOBJ::ImportOptions::LOADER_STREAM;
+		else if (strcmp(argv[i], "--no-cache") == 0)
+			g_importOptions.useCache = false;
+		else if (strcmp(argv[i], "--compact-vertices") == 0)
+			g_importOptions.compactVertices = true;
+		else if (strncmp(argv[i], "--", 2) == 0)
+		{
+			// Options shared with obj_cache, e.g. --lods=0.5,0.25 or --out-of-core=64.
+			if (!g_importOptions.parse(argv[i]))
+			{
+				fprintf(stderr, "Error: Invalid option \"%s\".\n", argv[i]);
+				throw std::runtime_error("Invalid option.\n");
+			}
+		}
+		else
+			g_modelFilenames.push_back(argv[i]);
+	}
+
 	InitGL();
 	InitMenu();
-	if (argc>=2) 
-		LoadModel(argv[1]);
+	if (!g_modelFilenames.empty()) 
+		LoadModel(g_modelFilenames[0].c_str());
 	else
 	{
 		fprintf(stderr, "Error: No input model specified.\n");
-		fprintf(stderr, "Usage: pa3.exe ..\\models\\venus.obj.\n");
+		fprintf(stderr, "Usage: pa3.exe [--loader=legacy|mmap|stream] [--threads=N] [--out-of-core[=MB]] [--no-cache] [--compact-vertices] [--no-optimize-triangles] [--no-optimize-overdraw] [--rebuild-normals] [--lods=R1,R2,...] [--weld=P[,T[,N]]] ..\\models\\venus.obj [more.obj|more.obj.gz|- ...].\n");
 		throw std::runtime_error("No input model specified.\n");
 		exit(0);
 	}
-	SetBoundingBox();
 
 	glutMainLoop();
 }
@@ -977,20 +1670,103 @@ GLuint CreateNullTexture(int width, int height)
 
 void LoadModel(const char *pszFilename)
 {
-	// Import the OBJ file and normalize to unit length.
+	// Start importing the OBJ file in the background. The current model is
+	// drawn until FinishLoadModel() swaps in the new one.
+
+	if (!g_modelLoader.start(pszFilename, g_importOptions))
+	{
+		fprintf(stdout, "Still loading model \"%s\". \n", g_modelLoader.getFilename().c_str());
+		return;
+	}
 
-	SetCursor(LoadCursor(0, IDC_WAIT));
-	
 	fprintf(stdout, "Loading model \"%s\". \n", pszFilename);
+}
 
-	if (!g_model.import(pszFilename))
+void FinishLoadModel()
+{
+	if (!g_modelLoader.finish())
 	{
-		SetCursor(LoadCursor(0, IDC_ARROW));
-		throw std::runtime_error("Failed to load model.");
-		exit(0);
+		fprintf(stderr, "Failed to load model \"%s\". \n", g_modelLoader.getFilename().c_str());
+
+		// Keep showing the previous model, if there is one.
+		if (g_model.getNumberOfMeshes() == 0)
+			throw std::runtime_error("Failed to load model.");
+
+		return;
+	}
+
+	UnloadModel();
+	g_modelLoader.takeModel(g_model);
+
+	// Drawing reads the model from the GPU buffers only.
+	if (!g_gpuMesh.create(g_model))
+		throw std::runtime_error("Failed to upload model to the GPU.");
+
+	const ModelOBJ::ImportStatistics &stats = g_model.getImportStatistics();
+
+	if (stats.loadedFromCache)
+	{
+		fprintf(stdout, "Model loaded from cache in %d ms. \n",
+			g_modelLoader.getImportTime());
+	}
+	else if (stats.importedOutOfCore)
+	{
+		fprintf(stdout, "Model imported out of core in %d ms: %d unique vertices, %d sorted runs spilled to disk. \n",
+			g_modelLoader.getImportTime(), stats.uniqueVertices, stats.sortRuns);
+		fprintf(stdout, "Materials: %d runs of triangles sorted into %d draws. \n",
+			stats.materialRuns, stats.materialBatches);
+		fprintf(stdout, "Adjacency: %d boundary edges, %d non-manifold edges. \n",
+			stats.boundaryEdges, stats.nonManifoldEdges);
 	}
+	else
+	{
+		fprintf(stdout, "Model imported in %d ms using the %s loader. \n",
+			g_modelLoader.getImportTime(),
+			(g_importOptions.loader == ModelOBJ::ImportOptions::LOADER_LEGACY) ? "legacy" :
+			(g_importOptions.loader == ModelOBJ::ImportOptions::LOADER_STREAM) ? "stream" : "mmap");
+		fprintf(stdout, "Vertex cache: %lld lookups, %.2f probes/lookup, %d unique vertices, load factor %.2f. \n",
+			stats.vertexCacheLookups,
+			(stats.vertexCacheLookups > 0) ? static_cast<float>(stats.vertexCacheProbes) / stats.vertexCacheLookups : 0.0f,
+			stats.uniqueVertices, stats.vertexCacheLoadFactor);
+		fprintf(stdout, "Materials: %d runs of triangles sorted into %d draws (%d meshes with 16-bit splits). \n",
+			stats.materialRuns, stats.materialBatches, g_model.getNumberOfMeshes());
+
+		if (g_importOptions.weldPositionTolerance > 0.0f || g_importOptions.weldTexCoordTolerance > 0.0f ||
+			g_importOptions.weldNormalTolerance > 0.0f)
+		{
+			fprintf(stdout, "Welding: %d vertices and %d boundary edges removed. \n",
+				stats.weldedVertices, stats.weldedBoundaryEdges);
+		}
 
-	g_model.normalize();
+		if (g_importOptions.optimizeTriangleOrder)
+		{
+			fprintf(stdout, "Triangle order: ACMR %.3f before, %.3f after optimizing, %d overdraw clusters. \n",
+				stats.acmrBefore, stats.acmrAfter, stats.overdrawClusters);
+		}
+	}
+
+	// The float vertices are released once the compact ones are built, on the
+	// host and the GPU alike.
+	if (g_model.hasCompactVertices() && !g_model.getVertexBuffer())
+	{
+		long long floatSize = static_cast<long long>(g_model.getNumberOfVertices()) * g_model.getVertexSize();
+		long long compactSize = static_cast<long long>(g_model.getNumberOfVertices()) * g_model.getCompactVertexSize();
+
+		fprintf(stdout, "Compact vertices: %lld KB instead of %lld KB, %lld KB saved on the host and the GPU each. \n",
+			compactSize / 1024, floatSize / 1024, (floatSize - compactSize) / 1024);
+	}
+
+	fprintf(stdout, "Meshlets: %d in %d meshes. \n", g_model.getNumberOfMeshlets(), g_model.getNumberOfMeshes());
+
+	for (int i = 0; i < g_model.getNumberOfLods(); ++i)
+	{
+		const ModelOBJ::Lod &lod = g_model.getLod(i);
+
+		fprintf(stdout, "LOD %d: %d triangles (%.0f%% requested, %.0f%% kept). \n", i + 1, lod.triangleCount,
+			lod.ratio * 100.0f, 100.0f * lod.triangleCount / std::max(g_model.getNumberOfTriangles(), 1));
+	}
+
+	ReportMemoryUsage();
 
 	// Load any associated textures.
 	// Note the path where the textures are assumed to be located.
@@ -1055,14 +1831,14 @@ void LoadModel(const char *pszFilename)
 			g_modelTextures[pMaterial->bumpMapFilename] = textureId;
 	}
 
+	SetBoundingBox();
 	fprintf(stdout, "Model loading completed. \n");
-
-	SetCursor(LoadCursor(0, IDC_ARROW));
 }
 
 void UnloadModel()
 {
-	SetCursor(LoadCursor(0, IDC_WAIT));
+	// The textures have to be deleted here, but the model itself is
+	// destroyed in the background.
 
 	ModelTextures::iterator i = g_modelTextures.begin();
 
@@ -1073,9 +1849,8 @@ void UnloadModel()
 	}
 
 	g_modelTextures.clear();
-	g_model.destroy();
-
-	SetCursor(LoadCursor(0, IDC_ARROW));
+	g_gpuMesh.destroy();
+	g_modelLoader.release(g_model);
 }
 
 //  Draws a string at the specified coordinates.
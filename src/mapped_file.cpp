@@ -0,0 +1,230 @@
+// Copyright info of this file is left out for the assignment.
+
+#include <algorithm>
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+#if defined(_WIN32)
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = 0;
+#else
+    m_fd = -1;
+#endif
+    m_pData = 0;
+    m_size = 0;
+    m_open = false;
+    m_copyOnWrite = false;
+    m_writable = false;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *pszFilename, bool copyOnWrite)
+{
+    close();
+
+#if defined(_WIN32)
+    m_hFile = CreateFileA(pszFilename, GENERIC_READ, FILE_SHARE_READ, 0,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(m_hFile, &fileSize))
+    {
+        close();
+        return false;
+    }
+
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+
+    // Zero length files can't be mapped. Treat them as empty but valid.
+    if (m_size > 0)
+    {
+        m_hMapping = CreateFileMappingA(m_hFile, 0,
+            copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, 0);
+
+        if (!m_hMapping)
+        {
+            close();
+            return false;
+        }
+
+        m_pData = static_cast<char *>(MapViewOfFile(m_hMapping,
+            copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+
+        if (!m_pData)
+        {
+            close();
+            return false;
+        }
+    }
+#else
+    m_fd = ::open(pszFilename, O_RDONLY);
+
+    if (m_fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat(m_fd, &st) != 0)
+    {
+        close();
+        return false;
+    }
+
+    m_size = static_cast<size_t>(st.st_size);
+
+    // Zero length files can't be mapped. Treat them as empty but valid.
+    if (m_size > 0)
+    {
+        void *pView = mmap(0, m_size,
+            copyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_PRIVATE, m_fd, 0);
+
+        if (pView == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+
+        madvise(pView, m_size, MADV_SEQUENTIAL);
+        m_pData = static_cast<char *>(pView);
+    }
+#endif
+
+    m_open = true;
+    m_copyOnWrite = copyOnWrite;
+    return true;
+}
+
+bool MappedFile::create(const char *pszFilename, size_t size)
+{
+    close();
+
+#if defined(_WIN32)
+    m_hFile = CreateFileA(pszFilename, GENERIC_READ | GENERIC_WRITE, 0, 0,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    m_size = size;
+
+    if (m_size > 0)
+    {
+        LARGE_INTEGER fileSize;
+
+        fileSize.QuadPart = static_cast<LONGLONG>(size);
+
+        // The mapping extends the file to its full size.
+        m_hMapping = CreateFileMappingA(m_hFile, 0, PAGE_READWRITE,
+            fileSize.HighPart, fileSize.LowPart, 0);
+
+        if (!m_hMapping)
+        {
+            close();
+            return false;
+        }
+
+        m_pData = static_cast<char *>(MapViewOfFile(m_hMapping, FILE_MAP_WRITE, 0, 0, 0));
+
+        if (!m_pData)
+        {
+            close();
+            return false;
+        }
+    }
+#else
+    m_fd = ::open(pszFilename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (m_fd < 0)
+        return false;
+
+    m_size = size;
+
+    if (m_size > 0)
+    {
+        if (ftruncate(m_fd, static_cast<off_t>(size)) != 0)
+        {
+            close();
+            return false;
+        }
+
+        void *pView = mmap(0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+
+        if (pView == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+
+        m_pData = static_cast<char *>(pView);
+    }
+#endif
+
+    m_open = true;
+    m_writable = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+#if defined(_WIN32)
+    if (m_pData)
+        UnmapViewOfFile(m_pData);
+
+    if (m_hMapping)
+        CloseHandle(m_hMapping);
+
+    if (m_hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(m_hFile);
+
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = 0;
+#else
+    if (m_pData)
+        munmap(m_pData, m_size);
+
+    if (m_fd >= 0)
+        ::close(m_fd);
+
+    m_fd = -1;
+#endif
+
+    m_pData = 0;
+    m_size = 0;
+    m_open = false;
+    m_copyOnWrite = false;
+    m_writable = false;
+}
+
+void MappedFile::swap(MappedFile &other)
+{
+#if defined(_WIN32)
+    std::swap(m_hFile, other.m_hFile);
+    std::swap(m_hMapping, other.m_hMapping);
+#else
+    std::swap(m_fd, other.m_fd);
+#endif
+    std::swap(m_pData, other.m_pData);
+    std::swap(m_size, other.m_size);
+    std::swap(m_open, other.m_open);
+    std::swap(m_copyOnWrite, other.m_copyOnWrite);
+    std::swap(m_writable, other.m_writable);
+}
@@ -0,0 +1,69 @@
+// Copyright info of this file is left out for the assignment.
+
+#if !defined(MAPPED_FILE_H)
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+//-----------------------------------------------------------------------------
+// Read-only memory mapped file.
+//
+// The whole file is mapped into the address space of the process so that it
+// can be parsed in place without any intermediate buffering. The mapped view
+// is NOT null terminated; always use getSize() to find the end of the data.
+//
+// A file opened copy-on-write can also be modified through getMutableData().
+// Modified pages become private to the process and are never written back.
+//
+// create() makes a new file of the given size, initially all zero, and maps
+// it for writing. Data stored through getMutableData() goes to the file.
+//-----------------------------------------------------------------------------
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const char *pszFilename, bool copyOnWrite = false);
+    bool create(const char *pszFilename, size_t size);
+    void close();
+    void swap(MappedFile &other);
+
+    const char *getData() const;
+    char *getMutableData() const;
+    size_t getSize() const;
+    bool isOpen() const;
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+#if defined(_WIN32)
+    void *m_hFile;
+    void *m_hMapping;
+#else
+    int m_fd;
+#endif
+    char *m_pData;
+    size_t m_size;
+    bool m_open;
+    bool m_copyOnWrite;
+    bool m_writable;
+};
+
+//-----------------------------------------------------------------------------
+
+inline const char *MappedFile::getData() const
+{ return m_pData; }
+
+inline char *MappedFile::getMutableData() const
+{ return (m_copyOnWrite || m_writable) ? m_pData : 0; }
+
+inline size_t MappedFile::getSize() const
+{ return m_size; }
+
+inline bool MappedFile::isOpen() const
+{ return m_open; }
+
+#endif
@@ -0,0 +1,99 @@
+// Copyright info of this file is left out for the assignment.
+
+#include <chrono>
+#include "model_loader.h"
+
+ModelLoader::ModelLoader()
+{
+    m_pReleasedModel = 0;
+    m_finished = false;
+    m_loading = false;
+    m_imported = false;
+    m_importTime = 0;
+}
+
+ModelLoader::~ModelLoader()
+{
+    if (m_loadThread.joinable())
+        m_loadThread.join();
+
+    if (m_releaseThread.joinable())
+        m_releaseThread.join();
+
+    delete m_pReleasedModel;
+}
+
+bool ModelLoader::start(const char *pszFilename, const ModelOBJ::ImportOptions &options)
+{
+    // Only one model is loaded at a time.
+
+    if (m_loading)
+        return false;
+
+    m_filename = pszFilename;
+    m_model.destroy();
+    m_progress.reset();
+    m_finished = false;
+    m_loading = true;
+    m_imported = false;
+    m_importTime = 0;
+
+    m_loadThread = std::thread(&ModelLoader::load, this, options);
+    return true;
+}
+
+bool ModelLoader::finish()
+{
+    // Waits for the worker thread and returns whether the model was loaded.
+    // A model that failed to load is discarded.
+
+    if (!m_loading)
+        return false;
+
+    m_loadThread.join();
+    m_loading = false;
+
+    if (!m_imported)
+        m_model.destroy();
+
+    return m_imported;
+}
+
+void ModelLoader::takeModel(ModelOBJ &model)
+{
+    // Must be called after a successful finish(). Whatever model was passed
+    // in ends up in the loader and is destroyed by the next start().
+
+    model.swap(m_model);
+    m_imported = false;
+}
+
+void ModelLoader::release(ModelOBJ &model)
+{
+    // Moves the model out of the caller's hands and destroys it on the
+    // release thread. Only one model is released at a time.
+
+    if (m_releaseThread.joinable())
+        m_releaseThread.join();
+
+    delete m_pReleasedModel;
+    m_pReleasedModel = new ModelOBJ;
+    m_pReleasedModel->swap(model);
+
+    m_releaseThread = std::thread(&ModelOBJ::destroy, m_pReleasedModel);
+}
+
+void ModelLoader::load(ModelOBJ::ImportOptions options)
+{
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    options.pProgress = &m_progress;
+    m_imported = m_model.import(m_filename.c_str(), options);
+
+    if (m_imported)
+        m_model.normalize();
+
+    m_importTime = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count());
+    m_finished = true;
+}
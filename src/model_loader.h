@@ -0,0 +1,76 @@
+// Copyright info of this file is left out for the assignment.
+
+#if !defined(MODEL_LOADER_H)
+#define MODEL_LOADER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "model_obj.h"
+
+//-----------------------------------------------------------------------------
+// Background OBJ model loader.
+//
+// start() imports and normalizes a model on a worker thread, leaving the
+// caller free to keep rendering its current model. Once isFinished() returns
+// true, finish() reports whether the import succeeded and takeModel() swaps
+// the new model into the caller's ModelOBJ without copying it.
+//
+// Models that are no longer needed can be handed to release(), which
+// destroys them on a worker thread instead of the caller's.
+//-----------------------------------------------------------------------------
+
+class ModelLoader
+{
+public:
+    ModelLoader();
+    ~ModelLoader();
+
+    bool start(const char *pszFilename, const ModelOBJ::ImportOptions &options);
+    bool finish();
+    void takeModel(ModelOBJ &model);
+    void release(ModelOBJ &model);
+
+    bool isLoading() const;
+    bool isFinished() const;
+
+    const std::string &getFilename() const;
+    const ModelOBJ::ImportProgress &getProgress() const;
+    int getImportTime() const;
+
+private:
+    ModelLoader(const ModelLoader &);
+    ModelLoader &operator=(const ModelLoader &);
+
+    void load(ModelOBJ::ImportOptions options);
+
+    std::thread m_loadThread;
+    std::thread m_releaseThread;
+    std::string m_filename;
+    ModelOBJ m_model;
+    ModelOBJ *m_pReleasedModel;
+    ModelOBJ::ImportProgress m_progress;
+    std::atomic<bool> m_finished;
+    bool m_loading;
+    bool m_imported;
+    int m_importTime;           // milliseconds
+};
+
+//-----------------------------------------------------------------------------
+
+inline bool ModelLoader::isLoading() const
+{ return m_loading; }
+
+inline bool ModelLoader::isFinished() const
+{ return m_loading && m_finished; }
+
+inline const std::string &ModelLoader::getFilename() const
+{ return m_filename; }
+
+inline const ModelOBJ::ImportProgress &ModelLoader::getProgress() const
+{ return m_progress; }
+
+inline int ModelLoader::getImportTime() const
+{ return m_importTime; }
+
+#endif
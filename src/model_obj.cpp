@@ -6,1139 +6,6258 @@
 // The addVertex() method is based on source code from the Direct3D MeshFromOBJ
 // sample found in the DirectX SDK.
 //
-// The generateTangents() method is based on public source code from
-// http://www.terathon.com/code/tangent.php.
-//
 // The importGeometryFirstPass(), importGeometrySecondPass(), and
 // importMaterials() methods are based on source code from Nate Robins' OpenGL
 // Tutors programs (http://www.xmission.com/~nate/tutors.html).
 //
+// The parseGeometry() method is a single pass replacement for the above two
+// geometry import passes that tokenizes a memory mapped OBJ file by hand.
+//
 //-----------------------------------------------------------------------------
 
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <functional>
 #include <limits>
 #include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "external_sort.h"
+#include "input_stream.h"
+#include "mapped_file.h"
 #include "model_obj.h"
+#include "parallel_for.h"
+#include "vertex_kernels.h"
 
 namespace
 {
-    bool MeshCompFunc(const ModelOBJ::Mesh &lhs, const ModelOBJ::Mesh &rhs)
+    // Vertex attributes referenced by an OBJ face.
+    enum
     {
-        return lhs.pMaterial->alpha > rhs.pMaterial->alpha;
-    }
-}
+        FACE_POS,                   // v
+        FACE_POS_TEXCOORD,          // v/vt
+        FACE_POS_NORMAL,            // v//vn
+        FACE_POS_TEXCOORD_NORMAL    // v/vt/vn
+    };
 
-ModelOBJ::ModelOBJ()
-{
-    m_hasPositions = false;
-    m_hasNormals = false;
-    m_hasTextureCoords = false;
-    m_hasTangents = false;
+    const float g_powersOf10[] =
+    {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+    };
 
-    m_numberOfVertexCoords = 0;
-    m_numberOfTextureCoords = 0;
-    m_numberOfNormals = 0;
-    m_numberOfTriangles = 0;
-    m_numberOfMaterials = 0;
-    m_numberOfMeshes = 0;
+    void BoxExtents(const float boundsMin[3], const float boundsMax[3],
+                    float center[3], float &width, float &height,
+                    float &length, float &radius)
+    {
+        center[0] = (boundsMin[0] + boundsMax[0]) / 2.0f;
+        center[1] = (boundsMin[1] + boundsMax[1]) / 2.0f;
+        center[2] = (boundsMin[2] + boundsMax[2]) / 2.0f;
 
-    m_center[0] = m_center[1] = m_center[2] = 0.0f;
-    m_width = m_height = m_length = m_radius = 0.0f;
-}
+        width = boundsMax[0] - boundsMin[0];
+        height = boundsMax[1] - boundsMin[1];
+        length = boundsMax[2] - boundsMin[2];
 
-ModelOBJ::~ModelOBJ()
-{
-    destroy();
-}
+        radius = std::max(std::max(width, height), length);
+    }
 
-void ModelOBJ::bounds(float center[3], float &width, float &height,
-                      float &length, float &radius) const
-{
-    float xMax = std::numeric_limits<float>::min();
-    float yMax = std::numeric_limits<float>::min();
-    float zMax = std::numeric_limits<float>::min();
+    bool MeshCompFunc(const ModelOBJ::Mesh &lhs, const ModelOBJ::Mesh &rhs)
+    {
+        return lhs.pMaterial->alpha > rhs.pMaterial->alpha;
+    }
 
-    float xMin = std::numeric_limits<float>::max();
-    float yMin = std::numeric_limits<float>::max();
-    float zMin = std::numeric_limits<float>::max();
+    inline bool IsBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
 
-    float x = 0.0f;
-    float y = 0.0f;
-    float z = 0.0f;
+    inline const char *SkipBlanks(const char *p, const char *pEnd)
+    {
+        while (p < pEnd && IsBlank(*p))
+            ++p;
+        return p;
+    }
 
-    int numVerts = static_cast<int>(m_vertexBuffer.size());
+    inline const char *SkipToken(const char *p, const char *pEnd)
+    {
+        while (p < pEnd && !IsBlank(*p) && *p != '\n')
+            ++p;
+        return p;
+    }
 
-    for (int i = 0; i < numVerts; ++i)
+    inline const char *SkipLine(const char *p, const char *pEnd)
+    {
+        const void *pEol = memchr(p, '\n', pEnd - p);
+        return pEol ? static_cast<const char *>(pEol) + 1 : pEnd;
+    }
+
+    bool ParseInt(const char *&p, const char *pEnd, int &value)
     {
-        x = m_vertexBuffer[i].position[0];
-        y = m_vertexBuffer[i].position[1];
-        z = m_vertexBuffer[i].position[2];
+        const char *s = p;
+        bool negative = false;
 
-        if (x < xMin)
-            xMin = x;
+        if (s < pEnd && (*s == '-' || *s == '+'))
+            negative = (*s++ == '-');
 
-        if (x > xMax)
-            xMax = x;
+        if (s == pEnd || !IsDigit(*s))
+            return false;
 
-        if (y < yMin)
-            yMin = y;
+        int result = 0;
+
+        while (s < pEnd && IsDigit(*s))
+        {
+            int digit = *s++ - '0';
 
-        if (y > yMax)
-            yMax = y;
+            // Numbers that don't fit an int are malformed.
+            if (result > (std::numeric_limits<int>::max() - digit) / 10)
+                return false;
 
-        if (z < zMin)
-            zMin = z;
+            result = result * 10 + digit;
+        }
 
-        if (z > zMax)
-            zMax = z;
+        value = negative ? -result : result;
+        p = s;
+        return true;
     }
 
-    center[0] = (xMin + xMax) / 2.0f;
-    center[1] = (yMin + yMax) / 2.0f;
-    center[2] = (zMin + zMax) / 2.0f;
+    bool ParseFloat(const char *&p, const char *pEnd, float &value)
+    {
+        // Fast path for plain decimal numbers such as "-1.185". When both the
+        // decimal mantissa and the power of ten are exactly representable as
+        // floats a single multiply or divide is correctly rounded, so the
+        // result is bit identical to strtof() and fscanf(). Anything longer,
+        // or in another notation, falls back to strtof().
+
+        const char *s = p;
+        bool negative = false;
+        bool exact = true;
+        bool hasDigits = false;
+        int digits = 0;
+        int exponent = 0;
+        unsigned long long mantissa = 0;
+
+        if (s < pEnd && (*s == '-' || *s == '+'))
+            negative = (*s++ == '-');
+
+        for (; s < pEnd && IsDigit(*s); ++s)
+        {
+            hasDigits = true;
 
-    width = xMax - xMin;
-    height = yMax - yMin;
-    length = zMax - zMin;
+            if (mantissa == 0 && *s == '0')
+                continue;
 
-    radius = std::max(std::max(width, height), length);
-}
+            if (++digits > 18)
+                ++exponent;
+            else
+                mantissa = mantissa * 10 + (*s - '0');
+        }
 
-void ModelOBJ::destroy()
-{
-    m_hasPositions = false;
-    m_hasTextureCoords = false;
-    m_hasNormals = false;
-    m_hasTangents = false;
+        if (s < pEnd && *s == '.')
+        {
+            for (++s; s < pEnd && IsDigit(*s); ++s)
+            {
+                hasDigits = true;
 
-    m_numberOfVertexCoords = 0;
-    m_numberOfTextureCoords = 0;
-    m_numberOfNormals = 0;
-    m_numberOfTriangles = 0;
-    m_numberOfMaterials = 0;
-    m_numberOfMeshes = 0;
+                if (mantissa == 0 && *s == '0')
+                {
+                    --exponent;
+                    continue;
+                }
 
-    m_center[0] = m_center[1] = m_center[2] = 0.0f;
-    m_width = m_height = m_length = m_radius = 0.0f;
+                if (++digits <= 18)
+                {
+                    mantissa = mantissa * 10 + (*s - '0');
+                    --exponent;
+                }
+            }
+        }
 
-    m_directoryPath.clear();
+        if (s < pEnd && (*s == 'e' || *s == 'E'))
+        {
+            int e = 0;
+            const char *pExponent = s + 1;
 
-    m_meshes.clear();
-    m_materials.clear();
-    m_vertexBuffer.clear();
-    m_indexBuffer.clear();
-	m_indexBufferAdj.clear();
-    m_attributeBuffer.clear();
+            if (ParseInt(pExponent, pEnd, e) && e > -64 && e < 64)
+            {
+                exponent += e;
+                s = pExponent;
+            }
+            else
+            {
+                exact = false;
+            }
+        }
 
-    m_vertexCoords.clear();
-    m_textureCoords.clear();
-    m_normals.clear();
+        if (hasDigits && exact && mantissa <= (1u << 24)
+            && exponent >= -10 && exponent <= 10
+            && (s == pEnd || (*s != 'x' && *s != 'X')))
+        {
+            float result = static_cast<float>(mantissa);
 
-    m_materialCache.clear();
-    m_vertexCache.clear();
-	m_edgeAdjCache.clear();
-}
+            if (exponent < 0)
+                result /= g_powersOf10[-exponent];
+            else
+                result *= g_powersOf10[exponent];
 
-bool ModelOBJ::import(const char *pszFilename, bool rebuildNormals)
-{
-    FILE *pFile = fopen(pszFilename, "r");
+            value = negative ? -result : result;
+            p = s;
+            return true;
+        }
 
-    if (!pFile)
-        return false;
+        // Slow path. The mapped file isn't null terminated so copy the token
+        // into a temporary buffer for strtof().
 
-    // Extract the directory the OBJ file is in from the file name.
-    // This directory path will be used to load the OBJ's associated MTL file.
+        char buffer[64];
+        const char *pToken = SkipToken(p, pEnd);
+        size_t length = std::min(static_cast<size_t>(pToken - p), sizeof(buffer) - 1);
+        char *pParsed = 0;
 
-    m_directoryPath.clear();
+        memcpy(buffer, p, length);
+        buffer[length] = '\0';
+        float result = strtof(buffer, &pParsed);
 
-    std::string filename = pszFilename;
-    std::string::size_type offset = filename.find_last_of('\\');
+        if (pParsed == buffer)
+            return false;
 
-    if (offset != std::string::npos)
-    {
-        m_directoryPath = filename.substr(0, ++offset);
+        value = result;
+        p += pParsed - buffer;
+        return true;
     }
-    else
+
+    int ParseFaceVertex(const char *&p, const char *pEnd, int &v, int &vt, int &vn)
     {
-        offset = filename.find_last_of('/');
+        // Parses a face vertex in one of the v, v/vt, v//vn, or v/vt/vn formats
+        // and returns which of the FACE_* formats it was in, or -1 on error.
 
-        if (offset != std::string::npos)
-            m_directoryPath = filename.substr(0, ++offset);
-    }
+        vt = vn = 0;
 
-    // Import the OBJ file.
+        if (!ParseInt(p, pEnd, v))
+            return -1;
 
-    importGeometryFirstPass(pFile);
-    rewind(pFile);
-    importGeometrySecondPass(pFile);
-    fclose(pFile);
+        if (p == pEnd || *p != '/')
+            return FACE_POS;
 
-    // Perform post import tasks.
+        if (++p < pEnd && *p == '/')
+        {
+            ++p;
+            return ParseInt(p, pEnd, vn) ? FACE_POS_NORMAL : -1;
+        }
 
-    buildMeshes();
-    bounds(m_center, m_width, m_height, m_length, m_radius);
+        if (!ParseInt(p, pEnd, vt))
+            return -1;
 
-    // Build vertex normals if required.
+        if (p == pEnd || *p != '/')
+            return FACE_POS_TEXCOORD;
 
-    if (rebuildNormals)
-    {
-        generateNormals();
+        ++p;
+        return ParseInt(p, pEnd, vn) ? FACE_POS_TEXCOORD_NORMAL : -1;
     }
-    else
+
+    // Files smaller than this are imported on a single thread.
+    const size_t MIN_IMPORT_CHUNK_SIZE = 1 << 20;
+
+    // Decompressed bytes read per block by the stream importer.
+    const size_t STREAM_BLOCK_SIZE = 4 << 20;
+
+    inline unsigned int HashCombine(unsigned int hash, unsigned int value)
     {
-        if (!hasNormals())
-            generateNormals();
+        // FNV-1a style combine followed by a final avalanche in HashFinish().
+        return (hash ^ value) * 16777619u;
     }
 
-    // Build tangents is required.
+    inline unsigned int HashFinish(unsigned int hash)
+    {
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+        return hash;
+    }
 
-    for (int i = 0; i < m_numberOfMaterials; ++i)
+    inline unsigned int HashFloats(const float *pValues, int count)
     {
-        if (!m_materials[i].bumpMapFilename.empty())
+        unsigned int hash = 2166136261u;
+        unsigned int bits = 0;
+
+        for (int i = 0; i < count; ++i)
         {
-            generateTangents();
-            break;
+            memcpy(&bits, &pValues[i], sizeof(bits));
+            hash = HashCombine(hash, bits);
         }
-    }
 
-    return true;
-}
+        return HashFinish(hash);
+    }
 
-void ModelOBJ::normalize(float scaleTo, bool center)
-{
-    float width = 0.0f;
-    float height = 0.0f;
-    float length = 0.0f;
-    float radius = 0.0f;
-    float centerPos[3] = {0.0f};
+    size_t HashTableCapacity(size_t count)
+    {
+        // Smallest power of two that keeps the load factor at or below 0.5.
+        size_t capacity = 16;
 
-    bounds(centerPos, width, height, length, radius);
+        while (capacity < count * 2)
+            capacity <<= 1;
 
-    float scalingFactor = scaleTo / radius;
-    float offset[3] = {0.0f};
+        return capacity;
+    }
 
-    if (center)
+    int BuildAliases(const std::vector<float> &values, int components,
+                     std::vector<int> &aliases)
     {
-        offset[0] = -centerPos[0];
-        offset[1] = -centerPos[1];
-        offset[2] = -centerPos[2];
+        // Maps every element of a texture coordinate or normal array to the
+        // first element with bitwise identical components. Vertices that only
+        // differ in which of two identical elements they reference then
+        // compare equal, exactly as a memcmp() of the whole vertex would.
+        // Returns the alias of the all zero element (which is what a vertex
+        // without this attribute contains), or -1 if there is none.
+
+        const float zero[3] = {0.0f, 0.0f, 0.0f};
+        int count = static_cast<int>(values.size()) / components;
+        size_t capacity = HashTableCapacity(count);
+        size_t mask = capacity - 1;
+        size_t slot = 0;
+        std::vector<int> table(capacity, -1);
+
+        aliases.resize(count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const float *pValue = &values[i * components];
+
+            for (slot = HashFloats(pValue, components) & mask; ; slot = (slot + 1) & mask)
+            {
+                if (table[slot] < 0)
+                {
+                    table[slot] = i;
+                    aliases[i] = i;
+                    break;
+                }
+
+                if (memcmp(&values[table[slot] * components], pValue, components * sizeof(float)) == 0)
+                {
+                    aliases[i] = table[slot];
+                    break;
+                }
+            }
+        }
+
+        for (slot = HashFloats(zero, components) & mask; table[slot] >= 0; slot = (slot + 1) & mask)
+        {
+            if (memcmp(&values[table[slot] * components], zero, components * sizeof(float)) == 0)
+                return table[slot];
+        }
+
+        return -1;
     }
-    else
+
+    inline unsigned int HashIndices(int v, int vt, int vn)
     {
-        offset[0] = 0.0f;
-        offset[1] = 0.0f;
-        offset[2] = 0.0f;
-    }
+        unsigned int hash = 2166136261u;
 
-    scale(scalingFactor, offset);
-    bounds(m_center, m_width, m_height, m_length, m_radius);
-}
+        hash = HashCombine(hash, static_cast<unsigned int>(v));
+        hash = HashCombine(hash, static_cast<unsigned int>(vt));
+        hash = HashCombine(hash, static_cast<unsigned int>(vn));
+        return HashFinish(hash);
+    }
 
-void ModelOBJ::reverseWinding()
-{
-    // Reverse face winding.
-    for (int i = 0; i < static_cast<int>(m_indexBuffer.size()); i += 3)
+    inline long long WeldCell(float value, float tolerance)
     {
-		std::swap( m_indexBuffer[i + 1],  m_indexBuffer[i + 2] );
-		int i2 = 2 * i;
-		std::swap( m_indexBufferAdj[i2 + 1],  m_indexBufferAdj[i2 + 5] );
-		std::swap( m_indexBufferAdj[i2 + 2],  m_indexBufferAdj[i2 + 4] );
-    }
+        // Grid cell of one component, clamped so that huge values or tiny
+        // tolerances can't overflow.
+        double cell = floor(static_cast<double>(value) / tolerance);
 
-    float *pNormal = 0;
-    float *pTangent = 0;
+        return static_cast<long long>(std::max(-4e18, std::min(4e18, cell)));
+    }
 
-    // Invert normals and tangents.
-    for (int i = 0; i < static_cast<int>(m_vertexBuffer.size()); ++i)
+    int WeldElements(const std::vector<float> &values, int components,
+                     float tolerance, std::vector<int> &remap)
     {
-        pNormal = m_vertexBuffer[i].normal;
-        pNormal[0] = -pNormal[0];
-        pNormal[1] = -pNormal[1];
-        pNormal[2] = -pNormal[2];
+        // Maps every element to the first earlier element whose components
+        // all differ from its own by at most tolerance, or to itself if there
+        // is none. Elements are only ever welded to such representatives, not
+        // to elements that were welded themselves, so a cluster can't drift
+        // further than the tolerance. The representatives are hashed by grid
+        // cells of the size of the tolerance, so only the 3^components cells
+        // around an element need to be searched. Returns the number of
+        // welded elements.
+
+        int count = static_cast<int>(values.size()) / components;
+        int numNeighbours = (components == 3) ? 27 : 9;
+        size_t capacity = HashTableCapacity(count);
+        size_t mask = capacity - 1;
+        std::vector<long long> cells(capacity * components);
+        std::vector<int> heads(capacity, -1);
+        std::vector<int> next(count, -1);
+        long long cell[3] = {0, 0, 0};
+        long long neighbour[3] = {0, 0, 0};
+        int welded = 0;
+
+        // Returns the slot of a cell, or the empty slot it would go in.
+        auto findCell = [&](const long long *pCell)
+        {
+            unsigned int hash = 2166136261u;
+
+            for (int k = 0; k < components; ++k)
+            {
+                hash = HashCombine(hash, static_cast<unsigned int>(pCell[k]));
+                hash = HashCombine(hash, static_cast<unsigned int>(pCell[k] >> 32));
+            }
+
+            for (size_t slot = HashFinish(hash) & mask; ; slot = (slot + 1) & mask)
+            {
+                if (heads[slot] < 0 || std::equal(pCell, pCell + components, &cells[slot * components]))
+                    return slot;
+            }
+        };
+
+        remap.resize(count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const float *pValue = &values[i * components];
+            bool finite = true;
+            int best = -1;
+
+            remap[i] = i;
+
+            for (int k = 0; k < components; ++k)
+                finite = finite && pValue[k] - pValue[k] == 0.0f;
+
+            // Infinities and NaNs are left alone.
+            if (!finite)
+                continue;
+
+            for (int k = 0; k < components; ++k)
+                cell[k] = WeldCell(pValue[k], tolerance);
+
+            for (int n = 0; n < numNeighbours; ++n)
+            {
+                for (int k = 0, digits = n; k < components; ++k, digits /= 3)
+                    neighbour[k] = cell[k] + digits % 3 - 1;
+
+                for (int j = heads[findCell(neighbour)]; j >= 0; j = next[j])
+                {
+                    const float *pOther = &values[j * components];
+                    bool close = true;
+
+                    for (int k = 0; k < components; ++k)
+                        close = close && fabs(pOther[k] - pValue[k]) <= tolerance;
+
+                    if (close && (best < 0 || j < best))
+                        best = j;
+                }
+            }
+
+            if (best >= 0)
+            {
+                remap[i] = best;
+                ++welded;
+                continue;
+            }
+
+            size_t slot = findCell(cell);
+
+            if (heads[slot] < 0)
+                std::copy(cell, cell + components, &cells[slot * components]);
 
-        pTangent = m_vertexBuffer[i].tangent;
-        pTangent[0] = -pTangent[0];
-        pTangent[1] = -pTangent[1];
-        pTangent[2] = -pTangent[2];
+            next[i] = heads[slot];
+            heads[slot] = i;
+        }
+
+        return welded;
     }
-}
 
-void ModelOBJ::scale(float scaleFactor, float offset[3])
-{
-    float *pPosition = 0;
+    // A half-edge for the half-edge builder.
+    struct AdjacencyEdge
+    {
+        unsigned long long key;     // packed smaller and larger position index
+        int halfEdge;
+    };
 
-    for (int i = 0; i < static_cast<int>(m_vertexBuffer.size()); ++i)
+    template <typename T>
+    void AddBufferUsage(std::vector<ModelOBJ::BufferUsage> &usage, const char *pszName,
+                        const std::vector<T> &buffer, const T *pBuffer, size_t count)
     {
-        pPosition = m_vertexBuffer[i].position;
+        // Adds a buffer of the model unless it is empty. pBuffer points into
+        // the memory mapped cache file if the vector doesn't hold the buffer.
+
+        ModelOBJ::BufferUsage entry;
 
-        pPosition[0] += offset[0];
-        pPosition[1] += offset[1];
-        pPosition[2] += offset[2];
+        entry.pszName = pszName;
+        entry.mapped = buffer.empty() && pBuffer != 0;
+        entry.bytes = (entry.mapped ? count : buffer.capacity()) * sizeof(T);
 
-        pPosition[0] *= scaleFactor;
-        pPosition[1] *= scaleFactor;
-        pPosition[2] *= scaleFactor;
+        if (entry.bytes > 0)
+            usage.push_back(entry);
     }
-}
 
-void ModelOBJ::matchAdjVertex(int v1, int v2, int v3Ind, int v3OppPos)
-{
-	if(v1 > v2)
-		std::swap(v1, v2);
-	Edge edge = {v1, v2};
+    template <typename T>
+    void AddBufferUsage(std::vector<ModelOBJ::BufferUsage> &usage, const char *pszName,
+                        const std::vector<T> &buffer)
+    {
+        AddBufferUsage(usage, pszName, buffer, static_cast<const T *>(0), 0);
+    }
 
-	std::map<Edge, int>::iterator iter = m_edgeAdjCache.find(edge);
+    // Adjacency edges are first partitioned on the top bits of their keys and
+    // each partition is then radix sorted on its own.
+    const int ADJACENCY_PARTITION_BITS = 8;
+    const int ADJACENCY_RADIX_BITS = 8;
 
-	if (iter == m_edgeAdjCache.end())
-	{
-		m_indexBufferAdj[v3OppPos] = v3Ind;
-		m_edgeAdjCache.insert(std::make_pair(edge, v3OppPos));
-	}
-	else
-	{
-		int v3OppPosPrev = iter->second;
-		int v3IndPrev = m_indexBufferAdj[v3OppPosPrev];
-		m_indexBufferAdj[v3OppPosPrev] = v3Ind;
-		m_indexBufferAdj[v3OppPos] = v3IndPrev;
-		m_edgeAdjCache.erase(iter);
-	}
-}
+    // Meshes with fewer edges than this are matched on a single thread.
+    const int MIN_PARALLEL_ADJACENCY_EDGES = 1 << 16;
 
-// add face to triangle-with-adjacency index buffer;
-// this must be executed after the face is added 
-// to regular index buffer 
-void ModelOBJ::addTriangleWithAdj(int index, int v0, int v1, int v2)
-{
-	int index3 = index * 3;
-	int index6 = index * 6;
-	m_indexBufferAdj[index6] = m_indexBuffer[index3];
-	m_indexBufferAdj[index6 + 2] = m_indexBuffer[index3 + 1];
-	m_indexBufferAdj[index6 + 4] = m_indexBuffer[index3 + 2];
-	matchAdjVertex(v0, v1, m_indexBuffer[index3 + 2], index6 + 1);
-	matchAdjVertex(v1, v2, m_indexBuffer[index3], index6 + 3);
-	matchAdjVertex(v0, v2, m_indexBuffer[index3 + 1], index6 + 5);
-}
+    // Number of parsed bytes between updates of the import progress.
+    const long long PROGRESS_REPORT_BYTES = 1 << 20;
 
-void ModelOBJ::addTrianglePos(int index, int material, int v0, int v1, int v2)
-{
-    Vertex vertex =
+    inline int EdgeKeyBits(int numberOfPositions)
     {
-        0.0f, 0.0f, 0.0f,
-        0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f
-    };
+        // Bits needed for one position index of an edge key.
+        int keyBits = 1;
 
-    m_attributeBuffer[index] = material;
+        while (keyBits < 31 && (1 << keyBits) < numberOfPositions)
+            ++keyBits;
 
-    vertex.position[0] = m_vertexCoords[v0 * 3];
-    vertex.position[1] = m_vertexCoords[v0 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v0 * 3 + 2];
-    m_indexBuffer[index * 3] = addVertex(v0, &vertex);
+        return keyBits;
+    }
 
-    vertex.position[0] = m_vertexCoords[v1 * 3];
-    vertex.position[1] = m_vertexCoords[v1 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v1 * 3 + 2];
-    m_indexBuffer[index * 3 + 1] = addVertex(v1, &vertex);
+    inline unsigned long long MakeEdgeKey(int v1, int v2, int keyBits)
+    {
+        if (v1 > v2)
+            std::swap(v1, v2);
 
-    vertex.position[0] = m_vertexCoords[v2 * 3];
-    vertex.position[1] = m_vertexCoords[v2 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v2 * 3 + 2];
-    m_indexBuffer[index * 3 + 2] = addVertex(v2, &vertex);
-	addTriangleWithAdj(index, v0, v1, v2);
-}
+        return (static_cast<unsigned long long>(v1) << keyBits) | static_cast<unsigned int>(v2);
+    }
 
-void ModelOBJ::addTrianglePosNormal(int index, int material, int v0, int v1,
-                                    int v2, int vn0, int vn1, int vn2)
-{
-    Vertex vertex =
+    AdjacencyEdge *RadixSortEdges(AdjacencyEdge *pEdges, AdjacencyEdge *pScratch,
+                                  int count, int bits)
     {
-        0.0f, 0.0f, 0.0f,
-        0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f
-    };
+        // Least significant digit first radix sort on the lowest bits of the
+        // edge keys. Returns whichever of the two buffers holds the result.
+        // The sort is stable so edges with equal keys stay in triangle order.
 
-    m_attributeBuffer[index] = material;
+        const int radix = 1 << ADJACENCY_RADIX_BITS;
+        int offsets[radix];
 
-    vertex.position[0] = m_vertexCoords[v0 * 3];
-    vertex.position[1] = m_vertexCoords[v0 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v0 * 3 + 2];
-    vertex.normal[0] = m_normals[vn0 * 3];
-    vertex.normal[1] = m_normals[vn0 * 3 + 1];
-    vertex.normal[2] = m_normals[vn0 * 3 + 2];
-    m_indexBuffer[index * 3] = addVertex(v0, &vertex);
+        if (count < 2)
+            return pEdges;
+
+        for (int shift = 0; shift < bits; shift += ADJACENCY_RADIX_BITS)
+        {
+            memset(offsets, 0, sizeof(offsets));
+
+            for (int i = 0; i < count; ++i)
+                ++offsets[(pEdges[i].key >> shift) & (radix - 1)];
+
+            // Skip digits that are the same for every key.
+            if (offsets[(pEdges[0].key >> shift) & (radix - 1)] == count)
+                continue;
+
+            for (int i = 0, sum = 0; i < radix; ++i)
+            {
+                int digitCount = offsets[i];
+                offsets[i] = sum;
+                sum += digitCount;
+            }
+
+            for (int i = 0; i < count; ++i)
+                pScratch[offsets[(pEdges[i].key >> shift) & (radix - 1)]++] = pEdges[i];
+
+            std::swap(pEdges, pScratch);
+        }
+
+        return pEdges;
+    }
+
+    // Largest index range a mesh drawn with 16-bit indices can span.
+    const int SHORT_INDEX_RANGE = 65536;
+
+    // A mesh that only splits into 16-bit sub-meshes of fewer triangles than
+    // this on average is drawn whole with 32-bit indices instead; the extra
+    // draw calls would cost more than the smaller indices save.
+    const int MIN_SHORT_MESH_TRIANGLES = 512;
+
+    // Range of the indices used by a mesh.
+    struct IndexRange
+    {
+        int first;
+        int last;
+
+        IndexRange() : first(std::numeric_limits<int>::max()), last(-1) {}
+
+        // Adds the indices to the range unless the result would no longer
+        // fit 16-bit indices.
+        bool extend(const int *pIndices, int count)
+        {
+            int newFirst = first;
+            int newLast = last;
+
+            for (int i = 0; i < count; ++i)
+            {
+                newFirst = std::min(newFirst, pIndices[i]);
+                newLast = std::max(newLast, pIndices[i]);
+            }
+
+            if (newLast - newFirst >= SHORT_INDEX_RANGE)
+                return false;
+
+            first = newFirst;
+            last = newLast;
+            return true;
+        }
+    };
+
+    // Post-transform vertex cache optimization. The scoring follows Tom
+    // Forsyth's "Linear-Speed Vertex Cache Optimisation".
+
+    const int FORSYTH_CACHE_SIZE = 32;
+    const int FORSYTH_MAX_VALENCE = 32;     // valence scores are tabulated up to this
+    const int ACMR_CACHE_SIZE = 32;         // FIFO size used to measure the ACMR
+    const int OPTIMIZE_BATCH_TRIANGLES = 1 << 16;   // optimized independently
+
+    struct ForsythScores
+    {
+        float cache[FORSYTH_CACHE_SIZE];
+        float valence[FORSYTH_MAX_VALENCE + 1];
+
+        ForsythScores()
+        {
+            // The three vertices of the last triangle get a fixed score so
+            // that its neighbors aren't favored over other recent triangles.
+
+            for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+            {
+                cache[i] = (i < 3) ? 0.75f :
+                    powf(1.0f - (i - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3), 1.5f);
+            }
+
+            // Vertices with few triangles left are boosted so that they are
+            // finished off instead of leaving lone triangles behind.
+
+            valence[0] = 0.0f;
+
+            for (int i = 1; i <= FORSYTH_MAX_VALENCE; ++i)
+                valence[i] = 2.0f / sqrtf(static_cast<float>(i));
+        }
+
+        float score(int cachePosition, int remainingTriangles) const
+        {
+            if (remainingTriangles == 0)
+                return -1.0f;
+
+            float result = (cachePosition >= 0) ? cache[cachePosition] : 0.0f;
+
+            if (remainingTriangles <= FORSYTH_MAX_VALENCE)
+                return result + valence[remainingTriangles];
+
+            return result + 2.0f / sqrtf(static_cast<float>(remainingTriangles));
+        }
+    };
+
+    void OptimizeTriangleOrder(const int *pIndices, int triangleCount,
+                               int vertexCount, int *pOrder)
+    {
+        // Greedily emits the triangle with the highest score, the sum of its
+        // vertices' scores, among the triangles of the vertices in the
+        // simulated LRU cache. pIndices are zero based and below vertexCount.
+        // On return pOrder holds the new order of the triangles.
+
+        static const ForsythScores scores;
+
+        std::vector<int> remaining(vertexCount, 0);
+        std::vector<int> offsets(vertexCount + 1, 0);
+        std::vector<int> vertexTriangles(triangleCount * 3);
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        std::vector<float> triangleScore(triangleCount, 0.0f);
+        std::vector<char> emitted(triangleCount, 0);
+        int cache[FORSYTH_CACHE_SIZE + 3];
+        int newCache[FORSYTH_CACHE_SIZE + 3];
+        int cacheSize = 0;
+
+        for (int i = 0; i < triangleCount * 3; ++i)
+            ++remaining[pIndices[i]];
+
+        for (int i = 0; i < vertexCount; ++i)
+            offsets[i + 1] = offsets[i] + remaining[i];
+
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+
+        for (int i = 0; i < triangleCount * 3; ++i)
+            vertexTriangles[fill[pIndices[i]]++] = i / 3;
+
+        for (int i = 0; i < vertexCount; ++i)
+            vertexScore[i] = scores.score(-1, remaining[i]);
+
+        for (int i = 0; i < triangleCount * 3; ++i)
+            triangleScore[i / 3] += vertexScore[pIndices[i]];
+
+        int best = static_cast<int>(std::max_element(triangleScore.begin(),
+            triangleScore.end()) - triangleScore.begin());
+        int nextUnemitted = 0;
+
+        for (int n = 0; n < triangleCount; ++n)
+        {
+            // Fall back to the next triangle in input order if none of the
+            // cached vertices have triangles left.
+            if (best < 0)
+            {
+                while (emitted[nextUnemitted])
+                    ++nextUnemitted;
+
+                best = nextUnemitted;
+            }
+
+            const int *pTriangle = &pIndices[best * 3];
+
+            pOrder[n] = best;
+            emitted[best] = 1;
+
+            // Remove the triangle from its vertices' remaining triangles.
+            for (int i = 0; i < 3; ++i)
+            {
+                int v = pTriangle[i];
+                int *pBegin = &vertexTriangles[offsets[v]];
+                int *pEnd = pBegin + remaining[v];
+
+                std::swap(*std::find(pBegin, pEnd, best), pEnd[-1]);
+                --remaining[v];
+            }
+
+            // Move the triangle's vertices to the front of the cache.
+            int newCacheSize = 0;
+
+            for (int i = 0; i < 3; ++i)
+            {
+                if (std::find(newCache, newCache + newCacheSize, pTriangle[i]) == newCache + newCacheSize)
+                    newCache[newCacheSize++] = pTriangle[i];
+            }
+
+            for (int i = 0; i < cacheSize; ++i)
+            {
+                if (cache[i] != pTriangle[0] && cache[i] != pTriangle[1] && cache[i] != pTriangle[2])
+                    newCache[newCacheSize++] = cache[i];
+            }
+
+            // Rescore the cached vertices and the triangles that use them.
+            // Vertices pushed past the end of the cache are rescored too.
+            best = -1;
+            float bestScore = -1.0f;
+
+            for (int i = 0; i < newCacheSize; ++i)
+            {
+                int v = newCache[i];
+
+                cachePosition[v] = (i < FORSYTH_CACHE_SIZE) ? i : -1;
+
+                float score = scores.score(cachePosition[v], remaining[v]);
+                float delta = score - vertexScore[v];
+
+                vertexScore[v] = score;
+
+                for (int j = offsets[v]; j < offsets[v] + remaining[v]; ++j)
+                    triangleScore[vertexTriangles[j]] += delta;
+            }
+
+            for (int i = 0; i < std::min(newCacheSize, FORSYTH_CACHE_SIZE); ++i)
+            {
+                int v = newCache[i];
+
+                for (int j = offsets[v]; j < offsets[v] + remaining[v]; ++j)
+                {
+                    int t = vertexTriangles[j];
+
+                    if (triangleScore[t] > bestScore)
+                    {
+                        best = t;
+                        bestScore = triangleScore[t];
+                    }
+                }
+            }
+
+            cacheSize = std::min(newCacheSize, FORSYTH_CACHE_SIZE);
+            std::copy(newCache, newCache + cacheSize, cache);
+        }
+    }
+
+    // FIFO post-transform cache of ACMR_CACHE_SIZE entries.
+    struct FifoCache
+    {
+        std::vector<long long> loadedAt;
+        long long time;     // advances on every miss
+
+        explicit FifoCache(int vertexCount)
+            : loadedAt(vertexCount, -ACMR_CACHE_SIZE - 1), time(0) {}
+
+        // Returns 1 if the vertex had to be loaded.
+        int add(int v)
+        {
+            if (time - loadedAt[v] < ACMR_CACHE_SIZE)
+                return 0;
+
+            loadedAt[v] = ++time;
+            return 1;
+        }
+
+        int addTriangle(const int *pTriangle)
+        { return add(pTriangle[0]) + add(pTriangle[1]) + add(pTriangle[2]); }
+
+        // Evicts everything without touching the per vertex state.
+        void flush()
+        { time += ACMR_CACHE_SIZE; }
+    };
+
+    long long CountCacheMisses(const int *pIndices, int indexCount, int vertexCount)
+    {
+        FifoCache cache(vertexCount);
+        long long misses = 0;
+
+        for (int i = 0; i < indexCount; ++i)
+            misses += cache.add(pIndices[i]);
+
+        return misses;
+    }
+
+    // Overdraw reduction after Sander, Nehab and Barczak's "Fast Triangle
+    // Reordering for Vertex Locality and Reduced Overdraw". The cache
+    // optimized order is cut into clusters, and the clusters that face away
+    // from the centroid of the model are drawn first: from most directions
+    // they are in front of the rest, so more of the later fragments fail the
+    // depth test. A cluster ends once its ACMR is within the threshold of
+    // the ACMR of the patch it belongs to, which keeps the vertex cache
+    // efficiency.
+
+    const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+    // Returns twice the area of the triangle; normal gets the unnormalized
+    // face normal, whose length is the same.
+    float TriangleNormal(const float *p0, const float *p1, const float *p2, float normal[3])
+    {
+        float edge1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float edge2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+
+        normal[0] = (edge1[1] * edge2[2]) - (edge1[2] * edge2[1]);
+        normal[1] = (edge1[2] * edge2[0]) - (edge1[0] * edge2[2]);
+        normal[2] = (edge1[0] * edge2[1]) - (edge1[1] * edge2[0]);
+
+        return sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    }
+
+    int OptimizeOverdraw(const int *pIndices, int triangleCount, int vertexCount,
+                         const float *pPositions, const float centroid[3], int *pOrder)
+    {
+        // pPositions holds three floats per vertex and pOrder the vertex
+        // cache optimized order, which is rearranged cluster by cluster.
+        // Returns the number of clusters.
+
+        FifoCache cache(vertexCount);
+        std::vector<int> patches;
+        std::vector<int> clusters;
+
+        // A triangle with three misses starts a new patch of the mesh.
+        for (int i = 0; i < triangleCount; ++i)
+        {
+            if (cache.addTriangle(&pIndices[pOrder[i] * 3]) == 3 || i == 0)
+                patches.push_back(i);
+        }
+
+        patches.push_back(triangleCount);
+
+        for (size_t p = 0; p + 1 < patches.size(); ++p)
+        {
+            int start = patches[p];
+            int end = patches[p + 1];
+            int misses = 0;
+
+            cache.flush();
+
+            for (int i = start; i < end; ++i)
+                misses += cache.addTriangle(&pIndices[pOrder[i] * 3]);
+
+            float threshold = OVERDRAW_ACMR_THRESHOLD * misses / (end - start);
+            int runMisses = 0;
+            int runTriangles = 0;
+
+            cache.flush();
+            clusters.push_back(start);
+
+            for (int i = start; i < end; ++i)
+            {
+                runMisses += cache.addTriangle(&pIndices[pOrder[i] * 3]);
+                ++runTriangles;
+
+                if (i + 1 < end && runMisses <= threshold * runTriangles)
+                {
+                    clusters.push_back(i + 1);
+                    cache.flush();
+                    runMisses = 0;
+                    runTriangles = 0;
+                }
+            }
+        }
+
+        int numClusters = static_cast<int>(clusters.size());
+        std::vector<std::pair<float, int> > keys(numClusters);
+
+        clusters.push_back(triangleCount);
+
+        for (int c = 0; c < numClusters; ++c)
+        {
+            // Area weighted centroid and normal of the cluster.
+            float center[3] = {0.0f, 0.0f, 0.0f};
+            float normal[3] = {0.0f, 0.0f, 0.0f};
+            float area = 0.0f;
+
+            for (int i = clusters[c]; i < clusters[c + 1]; ++i)
+            {
+                const int *pTriangle = &pIndices[pOrder[i] * 3];
+                float triangleNormal[3];
+                float weight = TriangleNormal(&pPositions[pTriangle[0] * 3],
+                    &pPositions[pTriangle[1] * 3], &pPositions[pTriangle[2] * 3],
+                    triangleNormal);
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    center[k] += (pPositions[pTriangle[0] * 3 + k] +
+                        pPositions[pTriangle[1] * 3 + k] +
+                        pPositions[pTriangle[2] * 3 + k]) * (weight / 3.0f);
+                    normal[k] += triangleNormal[k];
+                }
+
+                area += weight;
+            }
+
+            float key = 0.0f;
+            float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+            if (area > 0.0f && length > 0.0f)
+            {
+                for (int k = 0; k < 3; ++k)
+                    key += (center[k] / area - centroid[k]) * normal[k] / length;
+            }
+
+            // Sort descending, ties in the original order.
+            keys[c] = std::make_pair(-key, c);
+        }
+
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<int> order(pOrder, pOrder + triangleCount);
+        int *pOut = pOrder;
+
+        for (int c = 0; c < numClusters; ++c)
+        {
+            int cluster = keys[c].second;
+
+            pOut = std::copy(&order[clusters[cluster]], &order[clusters[cluster + 1]], pOut);
+        }
+
+        return numClusters;
+    }
+
+    // Meshlets hold MESHLET_MAX_TRIANGLES triangles unless a triangle would
+    // widen their normal cone past MESHLET_MIN_CONE_DOT after the first
+    // MESHLET_MIN_TRIANGLES. Cones wider than MESHLET_CULL_CONE_DOT are
+    // hardly ever back-facing as a whole and are marked as never culled.
+
+    const int MESHLET_MIN_TRIANGLES = 64;
+    const int MESHLET_MAX_TRIANGLES = 128;
+    const float MESHLET_MIN_CONE_DOT = 0.7f;
+    const float MESHLET_CULL_CONE_DOT = 0.1f;
+
+    // Quadric error metric simplification after Garland and Heckbert,
+    // "Surface Simplification Using Quadric Error Metrics". A position is
+    // only ever collapsed onto one of its neighbors, so the simplified
+    // triangles keep indexing the original vertex buffer. Each pass sorts the possible
+    // collapses by their error and performs the cheapest ones that don't
+    // touch the same triangles; passes repeat until the target is reached.
+
+    const int SIMPLIFY_MAX_PASSES = 64;
+    const float LOD_MAX_TRIANGLE_RATIO = 0.9f;  // of the level before, or a level is dropped
+
+    // Sum of squared distances to a set of planes, as a symmetric 4x4 matrix.
+    struct Quadric
+    {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+
+        Quadric() : a00(0), a01(0), a02(0), a11(0), a12(0), a22(0), b0(0), b1(0), b2(0), c(0) {}
+
+        // Adds the plane n.p + d = 0, n of unit length.
+        void addPlane(const double n[3], double d, double weight)
+        {
+            a00 += weight * n[0] * n[0];
+            a01 += weight * n[0] * n[1];
+            a02 += weight * n[0] * n[2];
+            a11 += weight * n[1] * n[1];
+            a12 += weight * n[1] * n[2];
+            a22 += weight * n[2] * n[2];
+            b0 += weight * n[0] * d;
+            b1 += weight * n[1] * d;
+            b2 += weight * n[2] * d;
+            c += weight * d * d;
+        }
+
+        void add(const Quadric &other)
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+        }
+
+        double error(const float *p) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+
+            return x * (a00 * x + 2.0 * (a01 * y + a02 * z + b0)) +
+                y * (a11 * y + 2.0 * (a12 * z + b1)) +
+                z * (a22 * z + 2.0 * b2) + c;
+        }
+    };
+
+    struct Collapse
+    {
+        double error;
+        int from;
+        int to;
+
+        bool operator<(const Collapse &other) const
+        { return error < other.error || (error == other.error && from < other.from) ||
+            (error == other.error && from == other.from && to < other.to); }
+    };
+
+    void SimplifyMesh(std::vector<int> &indices, const std::vector<int> &vertexPositions,
+                      const float *pPositions, const std::vector<char> &locked, int targetTriangles)
+    {
+        // indices are zero based, below vertexPositions.size(), which maps
+        // them to positions below locked.size(), with three floats per
+        // position in pPositions. Collapses move positions: every vertex on
+        // the position moves to the vertex of the target position it shares
+        // an edge with, so the vertices split along UV seams collapse
+        // together along the seam. Locked positions never move. The
+        // triangles that are left keep their relative order.
+
+        int positionCount = static_cast<int>(locked.size());
+        std::vector<Quadric> quadrics(positionCount);
+        std::vector<int> offsets(positionCount + 1);
+        std::vector<int> positionTriangles;
+        std::vector<char> touched(positionCount);
+        std::vector<int> marks(positionCount, -1);
+        std::vector<int> neighbors;
+        std::vector<std::pair<int, int> > moves;
+        std::vector<Collapse> best(positionCount);
+        std::vector<Collapse> collapses;
+        int stamp = 0;
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            int p0 = vertexPositions[indices[i]];
+            int p1 = vertexPositions[indices[i + 1]];
+            int p2 = vertexPositions[indices[i + 2]];
+            float normal[3];
+            float twiceArea = TriangleNormal(&pPositions[p0 * 3], &pPositions[p1 * 3],
+                &pPositions[p2 * 3], normal);
+
+            if (twiceArea == 0.0f)
+                continue;
+
+            const float *pPosition = &pPositions[p0 * 3];
+            double n[3] = {normal[0] / twiceArea, normal[1] / twiceArea, normal[2] / twiceArea};
+            double d = -(n[0] * pPosition[0] + n[1] * pPosition[1] + n[2] * pPosition[2]);
+            Quadric quadric;
+
+            quadric.addPlane(n, d, twiceArea * 0.5);
+
+            quadrics[p0].add(quadric);
+            quadrics[p1].add(quadric);
+            quadrics[p2].add(quadric);
+        }
+
+        for (int pass = 0; pass < SIMPLIFY_MAX_PASSES; ++pass)
+        {
+            int triangleCount = static_cast<int>(indices.size()) / 3;
+
+            if (triangleCount <= targetTriangles)
+                break;
+
+            // Triangles around every position.
+
+            std::fill(offsets.begin(), offsets.end(), 0);
+
+            for (size_t i = 0; i < indices.size(); ++i)
+                ++offsets[vertexPositions[indices[i]] + 1];
+
+            for (int i = 0; i < positionCount; ++i)
+                offsets[i + 1] += offsets[i];
+
+            positionTriangles.resize(indices.size());
+
+            std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+
+            for (size_t i = 0; i < indices.size(); ++i)
+                positionTriangles[fill[vertexPositions[indices[i]]]++] = static_cast<int>(i / 3);
+
+            // The cheapest collapse of every free position along one of its
+            // edges.
+
+            for (int i = 0; i < positionCount; ++i)
+            {
+                best[i].error = std::numeric_limits<double>::max();
+                best[i].from = i;
+                best[i].to = -1;
+            }
+
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    int a = vertexPositions[indices[i + k]];
+                    int b = vertexPositions[indices[i + (k + 1) % 3]];
+
+                    if (locked[a] && locked[b])
+                        continue;
+
+                    Quadric quadric = quadrics[a];
+
+                    quadric.add(quadrics[b]);
+
+                    if (!locked[a])
+                    {
+                        Collapse collapse = {quadric.error(&pPositions[b * 3]), a, b};
+
+                        if (collapse < best[a] || best[a].to < 0)
+                            best[a] = collapse;
+                    }
+
+                    if (!locked[b])
+                    {
+                        Collapse collapse = {quadric.error(&pPositions[a * 3]), b, a};
+
+                        if (collapse < best[b] || best[b].to < 0)
+                            best[b] = collapse;
+                    }
+                }
+            }
+
+            collapses.clear();
+
+            for (int i = 0; i < positionCount; ++i)
+            {
+                if (best[i].to >= 0)
+                    collapses.push_back(best[i]);
+            }
+
+            std::sort(collapses.begin(), collapses.end());
+            std::fill(touched.begin(), touched.end(), 0);
+
+            int removed = 0;
+            int performed = 0;
+
+            for (size_t c = 0; c < collapses.size() && triangleCount - removed > targetTriangles; ++c)
+            {
+                int a = collapses[c].from;
+                int b = collapses[c].to;
+
+                if (touched[a] || touched[b])
+                    continue;
+
+                // The edge must be shared by exactly two triangles whose
+                // other corners are the only common neighbors of a and b,
+                // otherwise the collapse folds the surface.
+
+                int shared = 0;
+
+                ++stamp;
+                for (int j = offsets[b]; j < offsets[b + 1]; ++j)
+                {
+                    const int *pTriangle = &indices[positionTriangles[j] * 3];
+
+                    for (int k = 0; k < 3; ++k)
+                        marks[vertexPositions[pTriangle[k]]] = stamp;
+                }
+
+                neighbors.clear();
+                moves.clear();
+
+                bool split = false;
+
+                for (int j = offsets[a]; j < offsets[a + 1] && !split; ++j)
+                {
+                    const int *pTriangle = &indices[positionTriangles[j] * 3];
+                    int from = -1;
+                    int to = -1;
+
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        int v = vertexPositions[pTriangle[k]];
+
+                        if (v == a)
+                            from = pTriangle[k];
+                        else if (v == b)
+                            to = pTriangle[k];
+                        else if (marks[v] == stamp &&
+                            std::find(neighbors.begin(), neighbors.end(), v) == neighbors.end())
+                            neighbors.push_back(v);
+                    }
+
+                    if (to < 0)
+                        continue;
+
+                    // Every vertex of a moves to the vertex of b on its side
+                    // of the seam, which has to be the same one everywhere.
+
+                    ++shared;
+
+                    for (size_t m = 0; m < moves.size() && !split; ++m)
+                        split = moves[m].first == from && moves[m].second != to;
+
+                    moves.push_back(std::make_pair(from, to));
+                }
+
+                if (split || shared != 2 || neighbors.size() != 2)
+                    continue;
+
+                // Each of a's vertices needs a vertex of b to move to, or the
+                // seam tears open.
+
+                for (int j = offsets[a]; j < offsets[a + 1] && !split; ++j)
+                {
+                    const int *pTriangle = &indices[positionTriangles[j] * 3];
+                    int from = pTriangle[0];
+
+                    for (int k = 1; k < 3 && vertexPositions[from] != a; ++k)
+                        from = pTriangle[k];
+
+                    split = true;
+
+                    for (size_t m = 0; m < moves.size() && split; ++m)
+                        split = moves[m].first != from;
+                }
+
+                if (split)
+                    continue;
+
+                // Moving a onto b must not flip any of the triangles that
+                // remain.
+
+                bool flips = false;
+
+                for (int j = offsets[a]; j < offsets[a + 1] && !flips; ++j)
+                {
+                    const int *pTriangle = &indices[positionTriangles[j] * 3];
+                    int corners[3] = {vertexPositions[pTriangle[0]], vertexPositions[pTriangle[1]],
+                        vertexPositions[pTriangle[2]]};
+
+                    if (corners[0] == b || corners[1] == b || corners[2] == b)
+                        continue;
+
+                    const float *p[3];
+                    const float *q[3];
+
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        p[k] = &pPositions[corners[k] * 3];
+                        q[k] = (corners[k] == a) ? &pPositions[b * 3] : p[k];
+                    }
+
+                    float before[3];
+                    float after[3];
+
+                    TriangleNormal(p[0], p[1], p[2], before);
+
+                    if (TriangleNormal(q[0], q[1], q[2], after) == 0.0f ||
+                        before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0f)
+                    {
+                        flips = true;
+                    }
+                }
+
+                if (flips)
+                    continue;
+
+                // Perform it. Only the triangles around a change, so their
+                // positions are off limits for the rest of the pass and the
+                // triangle lists of all other positions stay valid.
+
+                for (int j = offsets[a]; j < offsets[a + 1]; ++j)
+                {
+                    int *pTriangle = &indices[positionTriangles[j] * 3];
+
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        touched[vertexPositions[pTriangle[k]]] = 1;
+
+                        for (size_t m = 0; m < moves.size(); ++m)
+                        {
+                            if (pTriangle[k] == moves[m].first)
+                            {
+                                pTriangle[k] = moves[m].second;
+                                break;
+                            }
+                        }
+                    }
+                }
+
+                quadrics[b].add(quadrics[a]);
+                removed += shared;
+                ++performed;
+            }
+
+            if (performed == 0)
+                break;
+
+            // Drop the triangles that collapsed.
+
+            size_t kept = 0;
+
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                int v0 = indices[i], v1 = indices[i + 1], v2 = indices[i + 2];
+                int p0 = vertexPositions[v0], p1 = vertexPositions[v1], p2 = vertexPositions[v2];
+
+                if (p0 != p1 && p1 != p2 && p2 != p0)
+                {
+                    indices[kept++] = v0;
+                    indices[kept++] = v1;
+                    indices[kept++] = v2;
+                }
+            }
+
+            indices.resize(kept);
+        }
+    }
+
+    // Compact vertex encoding helpers.
+
+    const float SNORM16_MAX = 32767.0f;
+
+    inline short QuantizeSnorm16(float value)
+    {
+        value = std::min(std::max(value, -1.0f), 1.0f);
+        return static_cast<short>(floorf(value * SNORM16_MAX + 0.5f));
+    }
+
+    unsigned short FloatToHalf(float value)
+    {
+        // Rounds to the nearest half float. Values too large for a half
+        // become infinity and values too small become (signed) zero or a
+        // half float denormal.
+
+        unsigned int bits = 0;
+
+        memcpy(&bits, &value, sizeof(bits));
+
+        unsigned int sign = (bits >> 16) & 0x8000u;
+        unsigned int magnitude = bits & 0x7fffffffu;
+
+        if (magnitude >= 0x7f800000u)   // infinity or NaN
+            return static_cast<unsigned short>(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+
+        if (magnitude >= 0x477ff000u)   // rounds to larger than 65504
+            return static_cast<unsigned short>(sign | 0x7c00u);
+
+        if (magnitude < 0x38800000u)    // half float denormal or zero
+        {
+            float denormal = 0.0f;
+
+            memcpy(&denormal, &magnitude, sizeof(denormal));
+            return static_cast<unsigned short>(sign | static_cast<unsigned int>(floorf(denormal * 16777216.0f + 0.5f)));
+        }
+
+        magnitude += 0xc8000fffu + ((magnitude >> 13) & 1u);   // rebias and round to even
+        return static_cast<unsigned short>(sign | (magnitude >> 13));
+    }
+
+    void EncodeOctahedral(const float v[3], short encoded[2])
+    {
+        // Projects the unit vector onto the octahedron |x| + |y| + |z| = 1 and
+        // folds the lower hemisphere over the diagonals.
+
+        float length = fabsf(v[0]) + fabsf(v[1]) + fabsf(v[2]);
+
+        if (length == 0.0f)
+        {
+            encoded[0] = encoded[1] = 0;
+            return;
+        }
+
+        float x = v[0] / length;
+        float y = v[1] / length;
+
+        if (v[2] < 0.0f)
+        {
+            float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+
+            x = foldedX;
+            y = foldedY;
+        }
+
+        encoded[0] = QuantizeSnorm16(x);
+        encoded[1] = QuantizeSnorm16(y);
+    }
+
+    void DecodeOctahedral(const short encoded[2], float v[3])
+    {
+        // Unfolds the lower hemisphere again, as the shaders do.
+
+        float x = encoded[0] / static_cast<float>(SNORM16_MAX);
+        float y = encoded[1] / static_cast<float>(SNORM16_MAX);
+        float z = 1.0f - fabsf(x) - fabsf(y);
+        float t = std::max(-z, 0.0f);
+
+        v[0] = (x >= 0.0f) ? x - t : x + t;
+        v[1] = (y >= 0.0f) ? y - t : y + t;
+        v[2] = z;
+    }
+
+    // Binary cache file layout. The header is followed by sections that each
+    // start on a CACHE_ALIGNMENT byte boundary: vertices, indices, positions,
+    // position indices, the 16-bit copies of those two index buffers, the LOD
+    // index and position index buffers, the adjacency index and position
+    // index buffers, meshes, meshlets, LODs, LOD meshes, materials, material
+    // library names and finally the characters of all strings. Everything is
+    // stored in native byte order. The adjacency sections are empty unless
+    // the model had built its adjacency when the cache was written, as the
+    // out-of-core import always does; otherwise generateAdjacency() builds
+    // it when it is needed.
+
+    const char CACHE_MAGIC[8] = {'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E'};
+    const unsigned int CACHE_VERSION = 11;
+    const unsigned int CACHE_ALIGNMENT = 64;
+    const char CACHE_FILE_EXTENSION[] = ".cache";
+
+    enum
+    {
+        CACHE_HAS_POSITIONS = 1 << 0,
+        CACHE_HAS_TEXTURE_COORDS = 1 << 1,
+        CACHE_HAS_NORMALS = 1 << 2,
+        CACHE_HAS_TANGENTS = 1 << 3,
+        CACHE_NORMALS_REBUILT = 1 << 4,
+        CACHE_TRIANGLE_ORDER_OPTIMIZED = 1 << 5,
+        CACHE_OVERDRAW_OPTIMIZED = 1 << 6,
+        CACHE_HAS_ADJACENCY = 1 << 7
+    };
+
+    struct CacheString
+    {
+        unsigned int offset;    // relative to the start of the string section
+        unsigned int length;
+    };
+
+    struct CacheMesh
+    {
+        int startIndex;
+        int triangleCount;
+        int material;
+        int baseVertex;
+        int basePosition;
+        int shortIndices;
+        int shortPositions;
+        int startMeshlet;
+        int meshletCount;
+    };
+
+    struct CacheMaterial
+    {
+        float ambient[4];
+        float diffuse[4];
+        float specular[4];
+        float shininess;
+        float alpha;
+        CacheString name;
+        CacheString colorMapFilename;
+        CacheString bumpMapFilename;
+    };
+
+    struct CacheHeader
+    {
+        char magic[8];
+        unsigned long long fileSize;
+        unsigned long long vertexOffset;
+        unsigned long long indexOffset;
+        unsigned long long positionOffset;
+        unsigned long long positionIndexOffset;
+        unsigned long long shortIndexOffset;
+        unsigned long long shortPositionIndexOffset;
+        unsigned long long lodIndexOffset;
+        unsigned long long lodPositionIndexOffset;
+        unsigned long long adjacencyOffset;
+        unsigned long long positionAdjacencyOffset;
+        unsigned long long meshOffset;
+        unsigned long long meshletOffset;
+        unsigned long long lodOffset;
+        unsigned long long lodMeshOffset;
+        unsigned long long lodRatioOffset;
+        unsigned long long materialOffset;
+        unsigned long long libraryOffset;
+        unsigned long long stringOffset;
+        unsigned int version;
+        unsigned int vertexSize;
+        unsigned int flags;
+        int numberOfVertexCoords;
+        int numberOfTextureCoords;
+        int numberOfNormals;
+        int numberOfVertices;
+        int numberOfPositions;
+        int numberOfTriangles;
+        int numberOfShortTriangles;
+        int numberOfShortPositionTriangles;
+        int numberOfMeshes;
+        int numberOfMeshlets;
+        int numberOfLods;
+        int numberOfLodRatios;
+        int numberOfLodMeshes;
+        int numberOfLodIndices;
+        int numberOfMaterials;
+        int numberOfLibraries;
+        float center[3];
+        float width;
+        float height;
+        float length;
+        float radius;
+        float weldTolerances[3];
+    };
+
+    inline unsigned long long AlignCacheOffset(unsigned long long offset)
+    {
+        return (offset + CACHE_ALIGNMENT - 1) & ~static_cast<unsigned long long>(CACHE_ALIGNMENT - 1);
+    }
+
+    bool IsCacheSectionValid(const CacheHeader &header, unsigned long long offset,
+                             unsigned long long count, size_t elementSize)
+    {
+        return offset % CACHE_ALIGNMENT == 0 && offset <= header.fileSize &&
+            count <= (header.fileSize - offset) / elementSize;
+    }
+
+    template <typename T>
+    bool AreCacheIndicesValid(const T *pIndices, unsigned long long count, int base, int limit)
+    {
+        // Whether base plus every index is within [0, limit), the number of
+        // vertices or positions the indices refer to.
+
+        if (base < 0 || base > limit)
+            return false;
+
+        for (unsigned long long i = 0; i < count; ++i)
+        {
+            if (pIndices[i] < 0 || pIndices[i] >= limit - base)
+                return false;
+        }
+
+        return true;
+    }
+
+    CacheString AddCacheString(std::string &strings, const std::string &value)
+    {
+        CacheString cacheString;
+
+        cacheString.offset = static_cast<unsigned int>(strings.size());
+        cacheString.length = static_cast<unsigned int>(value.size());
+        strings += value;
+        return cacheString;
+    }
+
+    bool ReadCacheString(const CacheHeader &header, const char *pData,
+                         const CacheString &cacheString, std::string &value)
+    {
+        unsigned long long size = header.fileSize - header.stringOffset;
+
+        if (cacheString.offset > size || cacheString.length > size - cacheString.offset)
+            return false;
+
+        value.assign(pData + header.stringOffset + cacheString.offset, cacheString.length);
+        return true;
+    }
+
+    bool WriteCacheSection(FILE *pFile, unsigned long long &offset,
+                           const void *pData, size_t size)
+    {
+        // Pads the file up to the next section boundary and then writes
+        // the section. offset tracks the current end of the file.
+
+        static const char padding[CACHE_ALIGNMENT] = {0};
+        size_t paddingSize = static_cast<size_t>(AlignCacheOffset(offset) - offset);
+
+        if (paddingSize > 0 && fwrite(padding, 1, paddingSize, pFile) != paddingSize)
+            return false;
+
+        if (size > 0 && fwrite(pData, 1, size, pFile) != size)
+            return false;
+
+        offset += paddingSize + size;
+        return true;
+    }
+
+    std::string GetDirectoryPath(const std::string &filename)
+    {
+        std::string::size_type offset = filename.find_last_of('\\');
+
+        if (offset == std::string::npos)
+            offset = filename.find_last_of('/');
+
+        if (offset == std::string::npos)
+            return std::string();
+
+        return filename.substr(0, ++offset);
+    }
+
+    bool GetModificationTime(const char *pszFilename, long long &time)
+    {
+#if defined(_WIN32)
+        struct _stat64 st;
+
+        if (_stat64(pszFilename, &st) != 0)
+            return false;
+#else
+        struct stat st;
+
+        if (stat(pszFilename, &st) != 0)
+            return false;
+#endif
+
+        time = static_cast<long long>(st.st_mtime);
+        return true;
+    }
+
+    bool ParsePositiveInt(const char *p, int &value)
+    {
+        char *pEnd = 0;
+
+        errno = 0;
+        long number = strtol(p, &pEnd, 10);
+
+        if (pEnd == p || *pEnd != '\0' || errno != 0 || number <= 0 || number > INT_MAX)
+            return false;
+
+        value = static_cast<int>(number);
+        return true;
+    }
+
+    bool ParseFloatList(const char *p, std::vector<float> &values)
+    {
+        // Comma separated finite numbers. An empty string is an empty list.
+
+        char *pEnd = 0;
+
+        values.clear();
+
+        while (*p != '\0')
+        {
+            float value = strtof(p, &pEnd);
+
+            if (pEnd == p || !std::isfinite(value) || (*pEnd != ',' && *pEnd != '\0'))
+                return false;
+
+            values.push_back(value);
+            p = (*pEnd == ',') ? pEnd + 1 : pEnd;
+        }
+
+        return true;
+    }
+
+    std::string TemporaryFilename(const std::string &filename)
+    {
+        // "<filename>.tmp", or "<filename>.<n>.tmp" if that is taken, e.g. by
+        // a cache file another model still has mapped.
+
+        std::string tempFilename = filename + ".tmp";
+        long long time = 0;
+
+        for (int i = 1; GetModificationTime(tempFilename.c_str(), time); ++i)
+            tempFilename = filename + "." + std::to_string(i) + ".tmp";
+
+        return tempFilename;
+    }
+
+    bool ReplaceFile(const std::string &filename, const std::string &newFilename)
+    {
+#if defined(_WIN32)
+        // rename() doesn't replace existing files on Windows, and neither
+        // can remove() while the old file is memory mapped.
+        remove(newFilename.c_str());
+#endif
+
+        return rename(filename.c_str(), newFilename.c_str()) == 0;
+    }
+
+    void ReadLineBlocks(InputStream &stream, bool overlap,
+                        const std::function<void(const char *, const char *)> &parse,
+                        const std::function<void()> &done)
+    {
+        // Reads the stream in line aligned blocks and calls parse() for each
+        // of them. With overlap set a worker thread parses every block while
+        // the next one is read and decompressed. done() is called on this
+        // thread once a block has been parsed, before the next parse starts.
+        // The partial line at the end of a block is carried over to the front
+        // of the next one.
+
+        std::vector<char> buffers[2];
+        size_t carry = 0;
+        int current = 0;
+        bool pending = false;
+        std::thread worker;
+
+        for (;;)
+        {
+            std::vector<char> &buffer = buffers[current];
+
+            if (buffer.size() < carry + STREAM_BLOCK_SIZE)
+                buffer.resize(carry + STREAM_BLOCK_SIZE);
+
+            size_t size = carry + stream.read(&buffer[carry], buffer.size() - carry);
+            bool end = size < buffer.size();
+
+            if (size == 0)
+                break;
+
+            // Cut the block after its last complete line. A line longer than
+            // the block is read further into a larger buffer.
+
+            size_t cut = size;
+
+            if (!end)
+            {
+                while (cut > 0 && buffer[cut - 1] != '\n')
+                    --cut;
+
+                if (cut == 0)
+                {
+                    carry = size;
+                    buffer.resize(size * 2);
+                    continue;
+                }
+            }
+
+            // The other buffer may still be parsed by the worker.
+
+            if (worker.joinable())
+                worker.join();
+
+            if (pending && done)
+                done();
+
+            carry = size - cut;
+            std::vector<char> &next = buffers[1 - current];
+
+            if (next.size() < carry + STREAM_BLOCK_SIZE)
+                next.resize(carry + STREAM_BLOCK_SIZE);
+
+            if (carry > 0)
+                memcpy(&next[0], &buffer[cut], carry);
+
+            if (overlap)
+            {
+                worker = std::thread(parse, &buffer[0], &buffer[0] + cut);
+                pending = true;
+            }
+            else
+            {
+                parse(&buffer[0], &buffer[0] + cut);
+
+                if (done)
+                    done();
+            }
+
+            current = 1 - current;
+
+            if (end)
+                break;
+        }
+
+        if (worker.joinable())
+            worker.join();
+
+        if (pending && done)
+            done();
+    }
+
+    // Records of the out-of-core import, see ModelOBJ::importOutOfCore().
+
+    struct SpilledTriangle
+    {
+        int v[3];
+        int vt[3];              // -1 if the face has no texture coordinates
+        int vn[3];              // -1 if the face has no normals
+        int materialSlot;       // file wide usemtl slot, -1 before the first
+    };
+
+    struct CornerRecord
+    {
+        float attributes[8];    // position, texture coordinate and normal
+        int corner;             // into the material sorted index buffer
+    };
+
+    struct CornerRecordLess
+    {
+        // Bitwise order of the attributes. Equal vertices end up next to
+        // each other, and because the position comes first so do vertices
+        // with equal positions.
+        bool operator()(const CornerRecord &lhs, const CornerRecord &rhs) const
+        {
+            return memcmp(lhs.attributes, rhs.attributes, sizeof(lhs.attributes)) < 0;
+        }
+    };
+
+    struct IndexRecord
+    {
+        int slot;               // into the index or adjacency index buffer
+        int vertex;
+        int position;
+    };
+
+    struct IndexRecordLess
+    {
+        bool operator()(const IndexRecord &lhs, const IndexRecord &rhs) const
+        {
+            return lhs.slot < rhs.slot;
+        }
+    };
+
+    struct EdgeRecord
+    {
+        unsigned long long key; // see MakeEdgeKey()
+        int slot;               // adjacency slot of the edge, see generateAdjacency()
+        int origin;             // position the half-edge starts at
+        int vertex;             // corner of the triangle opposite the edge
+        int position;
+    };
+
+    struct EdgeRecordLess
+    {
+        bool operator()(const EdgeRecord &lhs, const EdgeRecord &rhs) const
+        {
+            return (lhs.key != rhs.key) ? lhs.key < rhs.key : lhs.slot < rhs.slot;
+        }
+    };
+}
+
+struct ModelOBJ::CacheLayout
+{
+    CacheHeader header;
+    std::vector<CacheMesh> meshes;
+    std::vector<CacheMesh> lodMeshes;
+    std::vector<CacheMaterial> materials;
+    std::vector<CacheString> libraries;
+    std::string strings;
+};
+
+ModelOBJ::ImportProgress::ImportProgress()
+{
+    reset();
+}
+
+void ModelOBJ::ImportProgress::reset()
+{
+    stage = STAGE_WAITING;
+    bytesParsed = 0;
+    totalBytes = 0;
+}
+
+ModelOBJ::ImportOptions::ImportOptions()
+{
+    loader = LOADER_MMAP;
+    useCache = true;
+    rebuildNormals = false;
+    threadCount = 0;
+    compactVertices = false;
+    optimizeTriangleOrder = true;
+    optimizeOverdraw = true;
+    lodRatios.push_back(0.5f);
+    lodRatios.push_back(0.25f);
+    lodRatios.push_back(0.125f);
+    weldPositionTolerance = 0.0f;
+    weldTexCoordTolerance = 0.0f;
+    weldNormalTolerance = 0.0f;
+    outOfCore = false;
+    outOfCoreMemory = 256 << 20;
+    pProgress = 0;
+}
+
+bool ModelOBJ::ImportOptions::parse(const char *pszArgument)
+{
+    const char *p = pszArgument;
+    int number = 0;
+    std::vector<float> values;
+
+    if (strcmp(p, "--rebuild-normals") == 0)
+        rebuildNormals = true;
+    else if (strcmp(p, "--no-optimize-triangles") == 0)
+        optimizeTriangleOrder = false;
+    else if (strcmp(p, "--no-optimize-overdraw") == 0)
+        optimizeOverdraw = false;
+    else if (strncmp(p, "--threads=", 10) == 0)
+    {
+        if (!ParsePositiveInt(p + 10, number))
+            return false;
+
+        threadCount = number;
+    }
+    else if (strcmp(p, "--out-of-core") == 0)
+        outOfCore = true;
+    else if (strncmp(p, "--out-of-core=", 14) == 0)
+    {
+        // The memory budget in MB.
+        if (!ParsePositiveInt(p + 14, number) ||
+            static_cast<size_t>(number) > (std::numeric_limits<size_t>::max() >> 20))
+            return false;
+
+        outOfCore = true;
+        outOfCoreMemory = static_cast<size_t>(number) << 20;
+    }
+    else if (strncmp(p, "--lods=", 7) == 0)
+    {
+        // Triangle ratios in (0, 1]. An empty list builds no LODs.
+        if (!ParseFloatList(p + 7, values))
+            return false;
+
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            if (values[i] <= 0.0f || values[i] > 1.0f)
+                return false;
+        }
+
+        lodRatios.swap(values);
+    }
+    else if (strncmp(p, "--weld=", 7) == 0)
+    {
+        // Position, texture coordinate and normal tolerances. Missing ones
+        // are 0, which doesn't weld that attribute.
+        if (!ParseFloatList(p + 7, values) || values.size() > 3)
+            return false;
+
+        values.resize(3, 0.0f);
+
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            if (values[i] < 0.0f)
+                return false;
+        }
+
+        weldPositionTolerance = values[0];
+        weldTexCoordTolerance = values[1];
+        weldNormalTolerance = values[2];
+    }
+    else
+        return false;
+
+    return true;
+}
+
+void ModelOBJ::ObjTriangle::shiftFanCorner()
+{
+    // The last corner of a triangle in a fan becomes the middle corner of the
+    // next triangle in that fan.
+
+    v[1] = v[2];
+    vt[1] = vt[2];
+    vn[1] = vn[2];
+    relative = (relative & ~RELATIVE_CORNER_1) | ((relative & RELATIVE_CORNER_2) >> 1);
+}
+
+void ModelOBJ::ImportChunk::resolveIndices(ObjTriangle &triangle, int corner,
+                                           int v, int vt, int vn) const
+{
+    // OBJ indices are one based. Negative indices are relative to the end of
+    // the elements read so far: -1 refers to the last one. These can only be
+    // resolved against this chunk's elements here and are flagged so that
+    // mergeChunks() can later add the number of elements in earlier chunks.
+
+    triangle.relative &= ~((RELATIVE_V | RELATIVE_VT | RELATIVE_VN) << corner);
+
+    if (v < 0)
+    {
+        triangle.v[corner] = v + static_cast<int>(vertexCoords.size() / 3);
+        triangle.relative |= RELATIVE_V << corner;
+    }
+    else
+    {
+        triangle.v[corner] = v - 1;
+    }
+
+    if (vt < 0)
+    {
+        triangle.vt[corner] = vt + static_cast<int>(textureCoords.size() / 2);
+        triangle.relative |= RELATIVE_VT << corner;
+    }
+    else
+    {
+        triangle.vt[corner] = vt - 1;
+    }
+
+    if (vn < 0)
+    {
+        triangle.vn[corner] = vn + static_cast<int>(normals.size() / 3);
+        triangle.relative |= RELATIVE_VN << corner;
+    }
+    else
+    {
+        triangle.vn[corner] = vn - 1;
+    }
+}
+
+ModelOBJ::ModelOBJ()
+{
+    m_hasPositions = false;
+    m_hasNormals = false;
+    m_hasTextureCoords = false;
+    m_hasTangents = false;
+    m_hasAdjacency = false;
+    m_hasHalfEdges = false;
+    m_normalsRebuilt = false;
+    m_triangleOrderOptimized = false;
+    m_overdrawOptimized = false;
+
+    m_numberOfVertexCoords = 0;
+    m_numberOfTextureCoords = 0;
+    m_numberOfNormals = 0;
+    m_numberOfTriangles = 0;
+    m_numberOfMaterials = 0;
+    m_numberOfMeshes = 0;
+    m_numberOfVertices = 0;
+    m_numberOfPositions = 0;
+    m_numberOfShortTriangles = 0;
+    m_numberOfShortPositionTriangles = 0;
+    m_numberOfLodIndices = 0;
+
+    m_center[0] = m_center[1] = m_center[2] = 0.0f;
+    m_width = m_height = m_length = m_radius = 0.0f;
+    m_transformScale = 1.0f;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        m_transformOffset[i] = 0.0f;
+        m_positionDecodeScale[i] = 1.0f;
+        m_positionDecodeBias[i] = 0.0f;
+        m_weldTolerances[i] = 0.0f;
+    }
+
+    m_zeroTexCoordAlias = -1;
+    m_zeroNormalAlias = -1;
+    m_importStatistics = ImportStatistics();
+    m_pProgress = 0;
+
+    m_pVertexBuffer = 0;
+    m_pIndexBuffer = 0;
+    m_pIndexBufferAdj = 0;
+    m_pPositionBuffer = 0;
+    m_pPositionIndexBuffer = 0;
+    m_pPositionIndexBufferAdj = 0;
+    m_pShortIndexBuffer = 0;
+    m_pShortPositionIndexBuffer = 0;
+    m_pShortPositionIndexBufferAdj = 0;
+    m_pLodIndexBuffer = 0;
+    m_pLodPositionIndexBuffer = 0;
+}
+
+ModelOBJ::~ModelOBJ()
+{
+    destroy();
+}
+
+void ModelOBJ::bounds(float center[3], float &width, float &height,
+                      float &length, float &radius, int threadCount) const
+{
+    float boundsMin[3];
+    float boundsMax[3];
+
+    // The position stream holds every vertex position, and outlives the
+    // float vertices of models with compact ones.
+    ComputeBounds(m_pPositionBuffer, m_numberOfPositions, 3 * sizeof(float),
+        boundsMin, boundsMax, threadCount);
+    BoxExtents(boundsMin, boundsMax, center, width, height, length, radius);
+}
+
+void ModelOBJ::destroy()
+{
+    m_hasPositions = false;
+    m_hasTextureCoords = false;
+    m_hasNormals = false;
+    m_hasTangents = false;
+    m_hasAdjacency = false;
+    m_hasHalfEdges = false;
+    m_normalsRebuilt = false;
+    m_triangleOrderOptimized = false;
+    m_overdrawOptimized = false;
+
+    m_numberOfVertexCoords = 0;
+    m_numberOfTextureCoords = 0;
+    m_numberOfNormals = 0;
+    m_numberOfTriangles = 0;
+    m_numberOfMaterials = 0;
+    m_numberOfMeshes = 0;
+    m_numberOfVertices = 0;
+    m_numberOfPositions = 0;
+    m_numberOfShortTriangles = 0;
+    m_numberOfShortPositionTriangles = 0;
+    m_numberOfLodIndices = 0;
+
+    m_center[0] = m_center[1] = m_center[2] = 0.0f;
+    m_width = m_height = m_length = m_radius = 0.0f;
+    m_transformScale = 1.0f;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        m_transformOffset[i] = 0.0f;
+        m_positionDecodeScale[i] = 1.0f;
+        m_positionDecodeBias[i] = 0.0f;
+        m_weldTolerances[i] = 0.0f;
+    }
+
+    m_directoryPath.clear();
+    m_materialLibraries.clear();
+
+    m_meshes.clear();
+    m_meshlets.clear();
+    m_lods.clear();
+    m_lodRatios.clear();
+    m_lodMeshes.clear();
+    m_materials.clear();
+    m_vertexBuffer.clear();
+    m_indexBuffer.clear();
+	m_indexBufferAdj.clear();
+    m_attributeBuffer.clear();
+    m_positionBuffer.clear();
+    m_positionIndexBuffer.clear();
+    m_positionIndexBufferAdj.clear();
+    m_shortIndexBuffer.clear();
+    m_shortPositionIndexBuffer.clear();
+    m_shortPositionIndexBufferAdj.clear();
+    m_lodIndexBuffer.clear();
+    m_lodPositionIndexBuffer.clear();
+    m_compactVertexBuffer.clear();
+
+    m_vertexCoords.clear();
+    m_textureCoords.clear();
+    m_normals.clear();
+    m_halfEdgeTwins.clear();
+    m_positionHalfEdges.clear();
+
+    m_materialCache.clear();
+    m_vertexCache.clear();
+    m_texCoordAliases.clear();
+    m_normalAliases.clear();
+
+    m_pVertexBuffer = 0;
+    m_pIndexBuffer = 0;
+    m_pIndexBufferAdj = 0;
+    m_pPositionBuffer = 0;
+    m_pPositionIndexBuffer = 0;
+    m_pPositionIndexBufferAdj = 0;
+    m_pShortIndexBuffer = 0;
+    m_pShortPositionIndexBuffer = 0;
+    m_pShortPositionIndexBufferAdj = 0;
+    m_pLodIndexBuffer = 0;
+    m_pLodPositionIndexBuffer = 0;
+    m_cacheFile.close();
+
+    // A cache written by the out-of-core import that couldn't replace the
+    // old one, or wasn't meant to, is moved or removed now that it is no
+    // longer mapped.
+    if (!m_cacheTempFilename.empty())
+    {
+        if (m_cacheTargetFilename.empty() || !ReplaceFile(m_cacheTempFilename, m_cacheTargetFilename))
+            remove(m_cacheTempFilename.c_str());
+
+        m_cacheTempFilename.clear();
+        m_cacheTargetFilename.clear();
+    }
+}
+
+void ModelOBJ::swap(ModelOBJ &other)
+{
+    // Exchanges two models without copying any of their buffers. Pointers
+    // into the buffers stay valid and move along with them.
+
+    std::swap(m_hasPositions, other.m_hasPositions);
+    std::swap(m_hasTextureCoords, other.m_hasTextureCoords);
+    std::swap(m_hasNormals, other.m_hasNormals);
+    std::swap(m_hasTangents, other.m_hasTangents);
+    std::swap(m_hasAdjacency, other.m_hasAdjacency);
+    std::swap(m_hasHalfEdges, other.m_hasHalfEdges);
+    std::swap(m_normalsRebuilt, other.m_normalsRebuilt);
+    std::swap(m_triangleOrderOptimized, other.m_triangleOrderOptimized);
+    std::swap(m_overdrawOptimized, other.m_overdrawOptimized);
+
+    std::swap(m_numberOfVertexCoords, other.m_numberOfVertexCoords);
+    std::swap(m_numberOfTextureCoords, other.m_numberOfTextureCoords);
+    std::swap(m_numberOfNormals, other.m_numberOfNormals);
+    std::swap(m_numberOfTriangles, other.m_numberOfTriangles);
+    std::swap(m_numberOfMaterials, other.m_numberOfMaterials);
+    std::swap(m_numberOfMeshes, other.m_numberOfMeshes);
+    std::swap(m_numberOfVertices, other.m_numberOfVertices);
+    std::swap(m_numberOfPositions, other.m_numberOfPositions);
+    std::swap(m_numberOfShortTriangles, other.m_numberOfShortTriangles);
+    std::swap(m_numberOfShortPositionTriangles, other.m_numberOfShortPositionTriangles);
+    std::swap(m_numberOfLodIndices, other.m_numberOfLodIndices);
+
+    std::swap(m_center, other.m_center);
+    std::swap(m_width, other.m_width);
+    std::swap(m_height, other.m_height);
+    std::swap(m_length, other.m_length);
+    std::swap(m_radius, other.m_radius);
+    std::swap(m_transformScale, other.m_transformScale);
+    std::swap(m_transformOffset, other.m_transformOffset);
+    std::swap(m_positionDecodeScale, other.m_positionDecodeScale);
+    std::swap(m_weldTolerances, other.m_weldTolerances);
+    std::swap(m_positionDecodeBias, other.m_positionDecodeBias);
+
+    m_directoryPath.swap(other.m_directoryPath);
+    m_materialLibraries.swap(other.m_materialLibraries);
+
+    m_meshes.swap(other.m_meshes);
+    m_meshlets.swap(other.m_meshlets);
+    m_lods.swap(other.m_lods);
+    m_lodRatios.swap(other.m_lodRatios);
+    m_lodMeshes.swap(other.m_lodMeshes);
+    m_materials.swap(other.m_materials);
+    m_vertexBuffer.swap(other.m_vertexBuffer);
+    m_indexBuffer.swap(other.m_indexBuffer);
+    m_indexBufferAdj.swap(other.m_indexBufferAdj);
+    m_attributeBuffer.swap(other.m_attributeBuffer);
+    m_positionBuffer.swap(other.m_positionBuffer);
+    m_positionIndexBuffer.swap(other.m_positionIndexBuffer);
+    m_positionIndexBufferAdj.swap(other.m_positionIndexBufferAdj);
+    m_shortIndexBuffer.swap(other.m_shortIndexBuffer);
+    m_shortPositionIndexBuffer.swap(other.m_shortPositionIndexBuffer);
+    m_shortPositionIndexBufferAdj.swap(other.m_shortPositionIndexBufferAdj);
+    m_lodIndexBuffer.swap(other.m_lodIndexBuffer);
+    m_lodPositionIndexBuffer.swap(other.m_lodPositionIndexBuffer);
+    m_compactVertexBuffer.swap(other.m_compactVertexBuffer);
+    m_vertexCoords.swap(other.m_vertexCoords);
+    m_textureCoords.swap(other.m_textureCoords);
+    m_normals.swap(other.m_normals);
+    m_halfEdgeTwins.swap(other.m_halfEdgeTwins);
+    m_positionHalfEdges.swap(other.m_positionHalfEdges);
+
+    std::swap(m_pVertexBuffer, other.m_pVertexBuffer);
+    std::swap(m_pIndexBuffer, other.m_pIndexBuffer);
+    std::swap(m_pIndexBufferAdj, other.m_pIndexBufferAdj);
+    std::swap(m_pPositionBuffer, other.m_pPositionBuffer);
+    std::swap(m_pPositionIndexBuffer, other.m_pPositionIndexBuffer);
+    std::swap(m_pPositionIndexBufferAdj, other.m_pPositionIndexBufferAdj);
+    std::swap(m_pShortIndexBuffer, other.m_pShortIndexBuffer);
+    std::swap(m_pShortPositionIndexBuffer, other.m_pShortPositionIndexBuffer);
+    std::swap(m_pShortPositionIndexBufferAdj, other.m_pShortPositionIndexBufferAdj);
+    std::swap(m_pLodIndexBuffer, other.m_pLodIndexBuffer);
+    std::swap(m_pLodPositionIndexBuffer, other.m_pLodPositionIndexBuffer);
+    m_cacheFile.swap(other.m_cacheFile);
+    m_cacheTempFilename.swap(other.m_cacheTempFilename);
+    m_cacheTargetFilename.swap(other.m_cacheTargetFilename);
+
+    m_materialCache.swap(other.m_materialCache);
+    m_vertexCache.swap(other.m_vertexCache);
+    m_texCoordAliases.swap(other.m_texCoordAliases);
+    m_normalAliases.swap(other.m_normalAliases);
+    std::swap(m_zeroTexCoordAlias, other.m_zeroTexCoordAlias);
+    std::swap(m_zeroNormalAlias, other.m_zeroNormalAlias);
+
+    std::swap(m_importStatistics, other.m_importStatistics);
+    std::swap(m_pProgress, other.m_pProgress);
+}
+
+bool ModelOBJ::import(const char *pszFilename, bool rebuildNormals)
+{
+    ImportOptions options;
+
+    options.rebuildNormals = rebuildNormals;
+    return import(pszFilename, options);
+}
+
+bool ModelOBJ::import(const char *pszFilename, const ImportOptions &options)
+{
+    m_pProgress = options.pProgress;
+    m_importStatistics = ImportStatistics();
+
+    bool imported = importModel(pszFilename, options);
+
+    setImportStage(ImportProgress::STAGE_FINISHED);
+    m_pProgress = 0;
+    return imported;
+}
+
+bool ModelOBJ::importModel(const char *pszFilename, const ImportOptions &options)
+{
+    // Use the binary cache of the OBJ file if it is up to date. Models read
+    // from stdin have no cache.
+
+    if (options.useCache && strcmp(pszFilename, "-") != 0)
+    {
+        std::string cacheFilename = pszFilename;
+
+        cacheFilename += CACHE_FILE_EXTENSION;
+        setImportStage(ImportProgress::STAGE_LOADING_CACHE);
+
+        if (loadCache(cacheFilename.c_str()))
+        {
+            // The out-of-core import takes any current cache, as it can't
+            // apply the other options anyway.
+
+            bool optionsMatch = options.outOfCore ||
+                (m_triangleOrderOptimized == options.optimizeTriangleOrder &&
+                m_overdrawOptimized == (options.optimizeTriangleOrder && options.optimizeOverdraw) &&
+                hasLodRatios(options.lodRatios) &&
+                hasWeldTolerances(options));
+
+            if (m_normalsRebuilt == options.rebuildNormals && optionsMatch &&
+                isCacheCurrent(cacheFilename.c_str(), pszFilename))
+            {
+                m_importStatistics.loadedFromCache = true;
+
+                if (options.compactVertices)
+                    buildCompactVertices();
+
+                return true;
+            }
+
+            destroy();
+        }
+    }
+
+    // Extract the directory the OBJ file is in from the file name.
+    // This directory path will be used to load the OBJ's associated MTL file.
+
+    m_directoryPath = GetDirectoryPath(pszFilename);
+
+    // Import the OBJ file.
+
+    setImportStage(ImportProgress::STAGE_PARSING);
+
+    if (options.outOfCore)
+    {
+        if (!importOutOfCore(pszFilename, options))
+            return false;
+
+        if (options.compactVertices)
+            buildCompactVertices();
+
+        return true;
+    }
+
+    // The legacy importer reads the file twice through fscanf(). The default
+    // importer memory maps the file and tokenizes it once by hand, splitting
+    // large files into line aligned chunks that are parsed in parallel. The
+    // stream importer reads the file once front to back in blocks, which
+    // also works for gzip compressed files (.obj.gz), pipes and stdin ("-");
+    // the default importer falls back to it for these. All produce identical
+    // results.
+
+    if (options.loader == ImportOptions::LOADER_STREAM)
+    {
+        if (!importGeometryStream(pszFilename, options))
+            return false;
+    }
+    else if (options.loader == ImportOptions::LOADER_LEGACY)
+    {
+        FILE *pFile = fopen(pszFilename, "r");
+
+        if (!pFile)
+            return false;
+
+        std::vector<ImportChunk> chunks(1);
+        std::vector<std::string> materialNames;
+
+        importGeometryFirstPass(pFile);
+        long long size = ftell(pFile);
+
+        if (m_pProgress)
+            m_pProgress->totalBytes = size;
+
+        rewind(pFile);
+        importGeometrySecondPass(pFile, chunks[0]);
+        fclose(pFile);
+        reportBytesParsed(size);
+
+        if (!mergeChunks(chunks, materialNames))
+        {
+            fprintf(stderr, "%s: face index out of range.\n", pszFilename);
+            return false;
+        }
+
+        weldAttributes(chunks, options);
+        setImportStage(ImportProgress::STAGE_BUILDING_TRIANGLES);
+        buildTriangles(chunks, materialNames);
+    }
+    else
+    {
+        if (!importGeometryMapped(pszFilename, options))
+            return false;
+    }
+
+    // Perform post import tasks.
+
+    setImportStage(ImportProgress::STAGE_POST_PROCESSING);
+
+    m_triangleOrderOptimized = options.optimizeTriangleOrder;
+    m_overdrawOptimized = options.optimizeTriangleOrder && options.optimizeOverdraw;
+
+    sortTrianglesByMaterial();
+
+    if (options.optimizeTriangleOrder)
+        optimizeTriangleOrder(options.threadCount, options.optimizeOverdraw);
+
+    buildPositionStream();
+    attachImportedBuffers();
+    buildMeshes();
+    buildShortIndexBuffers();
+    buildMeshlets();
+    buildLods(options.lodRatios, options.threadCount);
+    bounds(m_center, m_width, m_height, m_length, m_radius, options.threadCount);
+
+    // Build vertex normals if required.
+
+    m_normalsRebuilt = options.rebuildNormals;
+
+    if (options.rebuildNormals)
+    {
+        generateNormals(options.threadCount);
+    }
+    else
+    {
+        if (!hasNormals())
+            generateNormals(options.threadCount);
+    }
+
+    // Tangents and adjacency are left to generateTangents() and
+    // generateAdjacency(), called when a display mode first needs them.
+
+    if (options.compactVertices)
+        buildCompactVertices();
+
+    releaseImportBuffers();
+    return true;
+}
+
+void ModelOBJ::normalize(float scaleTo, bool center)
+{
+    // Only sets the model transform that getTransform() returns and the
+    // bounds getters apply, see scale(). The bounds found by import() are
+    // exact, so the vertices aren't read either.
+
+    if (m_numberOfVertices == 0)
+        return;
+
+    float centerPos[3] = {0.0f};
+
+    getCenter(centerPos[0], centerPos[1], centerPos[2]);
+
+    float scalingFactor = scaleTo / getRadius();
+    float offset[3] = {0.0f};
+
+    if (center)
+    {
+        offset[0] = -centerPos[0];
+        offset[1] = -centerPos[1];
+        offset[2] = -centerPos[2];
+    }
+    else
+    {
+        offset[0] = 0.0f;
+        offset[1] = 0.0f;
+        offset[2] = 0.0f;
+    }
+
+    scale(scalingFactor, offset);
+}
+
+void ModelOBJ::reverseWinding()
+{
+    // Reverse face winding.
+    for (int i = 0; i < m_numberOfTriangles * 3; i += 3)
+    {
+		std::swap( m_pIndexBuffer[i + 1],  m_pIndexBuffer[i + 2] );
+        std::swap(m_pPositionIndexBuffer[i + 1], m_pPositionIndexBuffer[i + 2]);
+    }
+
+    for (int i = 0; i < m_numberOfShortTriangles * 3; i += 3)
+        std::swap(m_pShortIndexBuffer[i + 1], m_pShortIndexBuffer[i + 2]);
+
+    for (int i = 0; i < m_numberOfShortPositionTriangles * 3; i += 3)
+        std::swap(m_pShortPositionIndexBuffer[i + 1], m_pShortPositionIndexBuffer[i + 2]);
+
+    for (int i2 = 0; m_hasAdjacency && i2 < m_numberOfTriangles * 6; i2 += 6)
+    {
+		std::swap( m_pIndexBufferAdj[i2 + 1],  m_pIndexBufferAdj[i2 + 5] );
+		std::swap( m_pIndexBufferAdj[i2 + 2],  m_pIndexBufferAdj[i2 + 4] );
+
+        std::swap(m_pPositionIndexBufferAdj[i2 + 1], m_pPositionIndexBufferAdj[i2 + 5]);
+        std::swap(m_pPositionIndexBufferAdj[i2 + 2], m_pPositionIndexBufferAdj[i2 + 4]);
+    }
+
+    for (int i2 = 0; m_pShortPositionIndexBufferAdj && i2 < m_numberOfShortPositionTriangles * 6; i2 += 6)
+    {
+        std::swap(m_pShortPositionIndexBufferAdj[i2 + 1], m_pShortPositionIndexBufferAdj[i2 + 5]);
+        std::swap(m_pShortPositionIndexBufferAdj[i2 + 2], m_pShortPositionIndexBufferAdj[i2 + 4]);
+    }
+
+    for (int i = 0; i < m_numberOfLodIndices; i += 3)
+    {
+        std::swap(m_pLodIndexBuffer[i + 1], m_pLodIndexBuffer[i + 2]);
+        std::swap(m_pLodPositionIndexBuffer[i + 1], m_pLodPositionIndexBuffer[i + 2]);
+    }
+
+    // Half-edge k of every triangle now runs backwards along the edge of
+    // half-edge 2 - k, and so do the twins.
+    if (m_hasHalfEdges)
+    {
+        std::vector<int> twins(m_halfEdgeTwins.size());
+
+        for (int i = 0; i < m_numberOfTriangles * 3; ++i)
+        {
+            int twin = m_halfEdgeTwins[i];
+
+            twins[i - i % 3 * 2 + 2] = (twin >= 0) ? twin - twin % 3 * 2 + 2 : -1;
+        }
+
+        m_halfEdgeTwins.swap(twins);
+        findPositionHalfEdges();
+    }
+
+    // Invert normals and tangents.
+    if (m_pVertexBuffer)
+        FlipNormals(m_pVertexBuffer, m_numberOfVertices, 0);
+
+    for (size_t i = 0; i < m_compactVertexBuffer.size(); ++i)
+    {
+        short *pNormal = m_compactVertexBuffer[i].normal;
+        float normal[3];
+
+        DecodeOctahedral(pNormal, normal);
+        normal[0] = -normal[0];
+        normal[1] = -normal[1];
+        normal[2] = -normal[2];
+        EncodeOctahedral(normal, pNormal);
+    }
+
+    // All face normals flip, and so do the meshlets' normal cones.
+    for (size_t i = 0; i < m_meshlets.size(); ++i)
+    {
+        float *pAxis = m_meshlets[i].coneAxis;
+
+        pAxis[0] = -pAxis[0];
+        pAxis[1] = -pAxis[1];
+        pAxis[2] = -pAxis[2];
+    }
+}
+
+void ModelOBJ::buildCompactVertices()
+{
+    // Replaces the float vertices by compact ones that store 16-bit
+    // positions, octahedral encoded normals and half float texture
+    // coordinates in 16 instead of 60 bytes. Positions are quantized relative
+    // to the bounding box so the full 16 bits cover the model on every axis.
+    // The float vertices are released afterwards, tangents included, which
+    // the compact ones don't store; getVertexBuffer() then returns 0. The
+    // position stream is kept.
+
+    if (!m_pVertexBuffer)
+        return;
+
+    for (int i = 0; i < 3; ++i)
+        m_positionDecodeBias[i] = m_center[i];
+
+    m_positionDecodeScale[0] = std::max(m_width * 0.5f, std::numeric_limits<float>::min()) / SNORM16_MAX;
+    m_positionDecodeScale[1] = std::max(m_height * 0.5f, std::numeric_limits<float>::min()) / SNORM16_MAX;
+    m_positionDecodeScale[2] = std::max(m_length * 0.5f, std::numeric_limits<float>::min()) / SNORM16_MAX;
+
+    m_compactVertexBuffer.resize(m_numberOfVertices);
+
+    for (int i = 0; i < m_numberOfVertices; ++i)
+    {
+        const Vertex &vertex = m_pVertexBuffer[i];
+        CompactVertex &compact = m_compactVertexBuffer[i];
+
+        for (int j = 0; j < 3; ++j)
+        {
+            compact.position[j] = QuantizeSnorm16((vertex.position[j] - m_positionDecodeBias[j]) /
+                (m_positionDecodeScale[j] * SNORM16_MAX));
+        }
+
+        compact.texCoord[0] = FloatToHalf(vertex.texCoord[0]);
+        compact.texCoord[1] = FloatToHalf(vertex.texCoord[1]);
+        EncodeOctahedral(vertex.normal, compact.normal);
+        compact.padding = 0;
+    }
+
+    std::vector<Vertex>().swap(m_vertexBuffer);
+    m_pVertexBuffer = 0;
+    m_hasTangents = false;
+}
+
+bool ModelOBJ::loadCache(const char *pszFilename)
+{
+    // The vertex and index buffers are used in place from a copy-on-write
+    // mapping of the cache file, so that reverseWinding() still works. Only
+    // the small mesh and material tables are copied.
+
+    destroy();
+
+    if (!m_cacheFile.open(pszFilename, true))
+        return false;
+
+    char *pData = m_cacheFile.getMutableData();
+    CacheHeader header;
+
+    if (m_cacheFile.getSize() < sizeof(header))
+    {
+        destroy();
+        return false;
+    }
+
+    memcpy(&header, pData, sizeof(header));
+
+    unsigned long long numberOfIndices = static_cast<unsigned long long>(header.numberOfTriangles) * 3;
+    unsigned long long numberOfAdjIndices = (header.flags & CACHE_HAS_ADJACENCY) ? numberOfIndices * 2 : 0;
+    unsigned long long numberOfShortIndices = static_cast<unsigned long long>(header.numberOfShortTriangles) * 3;
+    unsigned long long numberOfShortPositionIndices = static_cast<unsigned long long>(header.numberOfShortPositionTriangles) * 3;
+
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != CACHE_VERSION ||
+        header.vertexSize != sizeof(Vertex) ||
+        header.fileSize != m_cacheFile.getSize() ||
+        header.numberOfVertices < 0 || header.numberOfPositions < 0 ||
+        header.numberOfTriangles < 0 ||
+        header.numberOfShortPositionTriangles < 0 ||
+        header.numberOfShortPositionTriangles > header.numberOfShortTriangles ||
+        header.numberOfShortTriangles > header.numberOfTriangles ||
+        header.numberOfMeshes < 0 || header.numberOfMeshlets < 0 ||
+        header.numberOfLods < 0 || header.numberOfLods > header.numberOfLodRatios ||
+        header.numberOfLodMeshes < 0 ||
+        header.numberOfLodIndices < 0 || header.numberOfLodIndices % 3 != 0 ||
+        header.numberOfMaterials < 0 ||
+        header.numberOfLibraries < 0 ||
+        !IsCacheSectionValid(header, header.vertexOffset, header.numberOfVertices, sizeof(Vertex)) ||
+        !IsCacheSectionValid(header, header.indexOffset, numberOfIndices, sizeof(int)) ||
+        !IsCacheSectionValid(header, header.positionOffset, header.numberOfPositions, sizeof(float) * 3) ||
+        !IsCacheSectionValid(header, header.positionIndexOffset, numberOfIndices, sizeof(int)) ||
+        !IsCacheSectionValid(header, header.shortIndexOffset, numberOfShortIndices, sizeof(unsigned short)) ||
+        !IsCacheSectionValid(header, header.shortPositionIndexOffset, numberOfShortPositionIndices, sizeof(unsigned short)) ||
+        !IsCacheSectionValid(header, header.lodIndexOffset, header.numberOfLodIndices, sizeof(int)) ||
+        !IsCacheSectionValid(header, header.lodPositionIndexOffset, header.numberOfLodIndices, sizeof(int)) ||
+        !IsCacheSectionValid(header, header.adjacencyOffset, numberOfAdjIndices, sizeof(int)) ||
+        !IsCacheSectionValid(header, header.positionAdjacencyOffset, numberOfAdjIndices, sizeof(int)) ||
+        !IsCacheSectionValid(header, header.meshOffset, header.numberOfMeshes, sizeof(CacheMesh)) ||
+        !IsCacheSectionValid(header, header.meshletOffset, header.numberOfMeshlets, sizeof(Meshlet)) ||
+        !IsCacheSectionValid(header, header.lodOffset, header.numberOfLods, sizeof(Lod)) ||
+        !IsCacheSectionValid(header, header.lodMeshOffset, header.numberOfLodMeshes, sizeof(CacheMesh)) ||
+        !IsCacheSectionValid(header, header.lodRatioOffset, header.numberOfLodRatios, sizeof(float)) ||
+        !IsCacheSectionValid(header, header.materialOffset, header.numberOfMaterials, sizeof(CacheMaterial)) ||
+        !IsCacheSectionValid(header, header.libraryOffset, header.numberOfLibraries, sizeof(CacheString)) ||
+        !IsCacheSectionValid(header, header.stringOffset, 0, 1))
+    {
+        destroy();
+        return false;
+    }
+
+    const CacheMesh *pMeshes = reinterpret_cast<const CacheMesh *>(pData + header.meshOffset);
+    const Meshlet *pMeshlets = reinterpret_cast<const Meshlet *>(pData + header.meshletOffset);
+    const Lod *pLods = reinterpret_cast<const Lod *>(pData + header.lodOffset);
+    const CacheMesh *pLodMeshes = reinterpret_cast<const CacheMesh *>(pData + header.lodMeshOffset);
+    const float *pLodRatios = reinterpret_cast<const float *>(pData + header.lodRatioOffset);
+    const CacheMaterial *pMaterials = reinterpret_cast<const CacheMaterial *>(pData + header.materialOffset);
+    const CacheString *pLibraries = reinterpret_cast<const CacheString *>(pData + header.libraryOffset);
+    const int *pIndices = reinterpret_cast<const int *>(pData + header.indexOffset);
+    const int *pPositionIndices = reinterpret_cast<const int *>(pData + header.positionIndexOffset);
+    const unsigned short *pShortIndices = reinterpret_cast<const unsigned short *>(pData + header.shortIndexOffset);
+    const unsigned short *pShortPositionIndices = reinterpret_cast<const unsigned short *>(pData + header.shortPositionIndexOffset);
+    const int *pLodIndices = reinterpret_cast<const int *>(pData + header.lodIndexOffset);
+    const int *pLodPositionIndices = reinterpret_cast<const int *>(pData + header.lodPositionIndexOffset);
+    const int *pAdjacency = reinterpret_cast<const int *>(pData + header.adjacencyOffset);
+    const int *pPositionAdjacency = reinterpret_cast<const int *>(pData + header.positionAdjacencyOffset);
+
+    // Every index is checked as well, so that a stale or damaged cache file
+    // is parsed again rather than read past the buffers later on. This reads
+    // the index sections once, which costs little next to parsing the OBJ.
+    bool valid =
+        AreCacheIndicesValid(pIndices, numberOfIndices, 0, header.numberOfVertices) &&
+        AreCacheIndicesValid(pPositionIndices, numberOfIndices, 0, header.numberOfPositions) &&
+        AreCacheIndicesValid(pLodIndices, header.numberOfLodIndices, 0, header.numberOfVertices) &&
+        AreCacheIndicesValid(pLodPositionIndices, header.numberOfLodIndices, 0, header.numberOfPositions) &&
+        AreCacheIndicesValid(pAdjacency, numberOfAdjIndices, 0, header.numberOfVertices) &&
+        AreCacheIndicesValid(pPositionAdjacency, numberOfAdjIndices, 0, header.numberOfPositions);
+
+    m_materials.resize(header.numberOfMaterials);
+    m_meshes.resize(header.numberOfMeshes);
+    m_meshlets.assign(pMeshlets, pMeshlets + header.numberOfMeshlets);
+    m_lods.assign(pLods, pLods + header.numberOfLods);
+    m_lodRatios.assign(pLodRatios, pLodRatios + header.numberOfLodRatios);
+    m_lodMeshes.resize(header.numberOfLodMeshes);
+    m_materialLibraries.resize(header.numberOfLibraries);
+
+    for (int i = 0; i < header.numberOfMaterials; ++i)
+    {
+        const CacheMaterial &cacheMaterial = pMaterials[i];
+        Material &material = m_materials[i];
+
+        memcpy(material.ambient, cacheMaterial.ambient, sizeof(material.ambient));
+        memcpy(material.diffuse, cacheMaterial.diffuse, sizeof(material.diffuse));
+        memcpy(material.specular, cacheMaterial.specular, sizeof(material.specular));
+        material.shininess = cacheMaterial.shininess;
+        material.alpha = cacheMaterial.alpha;
+
+        valid = valid && ReadCacheString(header, pData, cacheMaterial.name, material.name);
+        valid = valid && ReadCacheString(header, pData, cacheMaterial.colorMapFilename, material.colorMapFilename);
+        valid = valid && ReadCacheString(header, pData, cacheMaterial.bumpMapFilename, material.bumpMapFilename);
+        m_materialCache[material.name] = i;
+    }
+
+    for (int i = 0; valid && i < header.numberOfMeshes; ++i)
+    {
+        const CacheMesh &cacheMesh = pMeshes[i];
+        Mesh &mesh = m_meshes[i];
+
+        if (cacheMesh.material < 0 || cacheMesh.material >= header.numberOfMaterials ||
+            cacheMesh.startIndex < 0 || cacheMesh.startIndex % 3 != 0 || cacheMesh.triangleCount < 0 ||
+            cacheMesh.startIndex / 3 > header.numberOfTriangles - cacheMesh.triangleCount ||
+            (cacheMesh.shortIndices && cacheMesh.startIndex / 3 > header.numberOfShortTriangles - cacheMesh.triangleCount) ||
+            (cacheMesh.shortPositions && (!cacheMesh.shortIndices ||
+                cacheMesh.startIndex / 3 > header.numberOfShortPositionTriangles - cacheMesh.triangleCount)) ||
+            cacheMesh.startMeshlet < 0 || cacheMesh.meshletCount < 0 ||
+            cacheMesh.startMeshlet > header.numberOfMeshlets - cacheMesh.meshletCount ||
+            cacheMesh.baseVertex < 0 || cacheMesh.baseVertex > header.numberOfVertices ||
+            cacheMesh.basePosition < 0 || cacheMesh.basePosition > header.numberOfPositions)
+        {
+            valid = false;
+            break;
+        }
+
+        // The 16-bit indices are relative to the mesh's base vertex and
+        // position.
+        unsigned long long numberOfMeshIndices = static_cast<unsigned long long>(cacheMesh.triangleCount) * 3;
+
+        valid = (!cacheMesh.shortIndices ||
+            AreCacheIndicesValid(pShortIndices + cacheMesh.startIndex, numberOfMeshIndices,
+                cacheMesh.baseVertex, header.numberOfVertices)) &&
+            (!cacheMesh.shortPositions ||
+            AreCacheIndicesValid(pShortPositionIndices + cacheMesh.startIndex, numberOfMeshIndices,
+                cacheMesh.basePosition, header.numberOfPositions));
+
+        mesh.startIndex = cacheMesh.startIndex;
+        mesh.triangleCount = cacheMesh.triangleCount;
+        mesh.pMaterial = &m_materials[cacheMesh.material];
+        mesh.baseVertex = cacheMesh.baseVertex;
+        mesh.basePosition = cacheMesh.basePosition;
+        mesh.shortIndices = cacheMesh.shortIndices != 0;
+        mesh.shortPositions = cacheMesh.shortPositions != 0;
+        mesh.shortAdjacency = false;
+        mesh.startMeshlet = cacheMesh.startMeshlet;
+        mesh.meshletCount = cacheMesh.meshletCount;
+
+        // The meshlets must lie within their mesh.
+        for (int j = mesh.startMeshlet; valid && j < mesh.startMeshlet + mesh.meshletCount; ++j)
+        {
+            const Meshlet &meshlet = m_meshlets[j];
+
+            valid = meshlet.startIndex >= mesh.startIndex && meshlet.startIndex % 3 == 0 &&
+                meshlet.triangleCount >= 0 &&
+                (meshlet.startIndex - mesh.startIndex) / 3 <= mesh.triangleCount - meshlet.triangleCount;
+        }
+    }
+
+    for (int i = 0; valid && i < header.numberOfLodMeshes; ++i)
+    {
+        const CacheMesh &cacheMesh = pLodMeshes[i];
+        Mesh &mesh = m_lodMeshes[i];
+
+        if (cacheMesh.material < 0 || cacheMesh.material >= header.numberOfMaterials ||
+            cacheMesh.startIndex < 0 || cacheMesh.startIndex % 3 != 0 || cacheMesh.triangleCount < 0 ||
+            cacheMesh.startIndex / 3 > header.numberOfLodIndices / 3 - cacheMesh.triangleCount)
+        {
+            valid = false;
+            break;
+        }
+
+        mesh.startIndex = cacheMesh.startIndex;
+        mesh.triangleCount = cacheMesh.triangleCount;
+        mesh.pMaterial = &m_materials[cacheMesh.material];
+        mesh.baseVertex = 0;
+        mesh.basePosition = 0;
+        mesh.shortIndices = false;
+        mesh.shortPositions = false;
+        mesh.shortAdjacency = false;
+        mesh.startMeshlet = 0;
+        mesh.meshletCount = 0;
+    }
+
+    for (int i = 0; valid && i < header.numberOfLods; ++i)
+    {
+        const Lod &lod = m_lods[i];
+
+        valid = lod.startMesh >= 0 && lod.meshCount >= 0 &&
+            lod.startMesh <= header.numberOfLodMeshes - lod.meshCount;
+    }
+
+    for (int i = 0; i < header.numberOfLibraries; ++i)
+        valid = valid && ReadCacheString(header, pData, pLibraries[i], m_materialLibraries[i]);
+
+    if (!valid)
+    {
+        destroy();
+        return false;
+    }
+
+    m_hasPositions = (header.flags & CACHE_HAS_POSITIONS) != 0;
+    m_hasTextureCoords = (header.flags & CACHE_HAS_TEXTURE_COORDS) != 0;
+    m_hasNormals = (header.flags & CACHE_HAS_NORMALS) != 0;
+    m_hasTangents = (header.flags & CACHE_HAS_TANGENTS) != 0;
+    m_hasAdjacency = (header.flags & CACHE_HAS_ADJACENCY) != 0;
+    m_normalsRebuilt = (header.flags & CACHE_NORMALS_REBUILT) != 0;
+    m_triangleOrderOptimized = (header.flags & CACHE_TRIANGLE_ORDER_OPTIMIZED) != 0;
+    m_overdrawOptimized = (header.flags & CACHE_OVERDRAW_OPTIMIZED) != 0;
+
+    m_numberOfVertexCoords = header.numberOfVertexCoords;
+    m_numberOfTextureCoords = header.numberOfTextureCoords;
+    m_numberOfNormals = header.numberOfNormals;
+    m_numberOfVertices = header.numberOfVertices;
+    m_numberOfPositions = header.numberOfPositions;
+    m_numberOfLodIndices = header.numberOfLodIndices;
+    m_numberOfTriangles = header.numberOfTriangles;
+    m_numberOfShortTriangles = header.numberOfShortTriangles;
+    m_numberOfShortPositionTriangles = header.numberOfShortPositionTriangles;
+    m_numberOfMeshes = header.numberOfMeshes;
+    m_numberOfMaterials = header.numberOfMaterials;
+
+    memcpy(m_center, header.center, sizeof(m_center));
+    memcpy(m_weldTolerances, header.weldTolerances, sizeof(m_weldTolerances));
+    m_width = header.width;
+    m_height = header.height;
+    m_length = header.length;
+    m_radius = header.radius;
+
+    m_pVertexBuffer = reinterpret_cast<Vertex *>(pData + header.vertexOffset);
+    m_pIndexBuffer = reinterpret_cast<int *>(pData + header.indexOffset);
+    m_pPositionBuffer = reinterpret_cast<float *>(pData + header.positionOffset);
+    m_pPositionIndexBuffer = reinterpret_cast<int *>(pData + header.positionIndexOffset);
+    m_pShortIndexBuffer = reinterpret_cast<unsigned short *>(pData + header.shortIndexOffset);
+    m_pShortPositionIndexBuffer = reinterpret_cast<unsigned short *>(pData + header.shortPositionIndexOffset);
+    m_pLodIndexBuffer = reinterpret_cast<int *>(pData + header.lodIndexOffset);
+    m_pLodPositionIndexBuffer = reinterpret_cast<int *>(pData + header.lodPositionIndexOffset);
+
+    if (m_hasAdjacency)
+    {
+        m_pIndexBufferAdj = reinterpret_cast<int *>(pData + header.adjacencyOffset);
+        m_pPositionIndexBufferAdj = reinterpret_cast<int *>(pData + header.positionAdjacencyOffset);
+    }
+
+    m_directoryPath = GetDirectoryPath(pszFilename);
+    return true;
+}
+
+void ModelOBJ::layoutCache(CacheLayout &layout) const
+{
+    // Fills in the header and the small tables of the cache file and lays
+    // out its sections. The big buffers are left to the caller to write.
+
+    CacheHeader &header = layout.header;
+    std::vector<CacheMesh> &meshes = layout.meshes;
+    std::vector<CacheMesh> &lodMeshes = layout.lodMeshes;
+    std::vector<CacheMaterial> &materials = layout.materials;
+    std::vector<CacheString> &libraries = layout.libraries;
+    std::string &strings = layout.strings;
+
+    meshes.resize(m_numberOfMeshes);
+    lodMeshes.resize(m_lodMeshes.size());
+    materials.resize(m_numberOfMaterials);
+    libraries.resize(m_materialLibraries.size());
+    strings.clear();
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+
+    header.flags |= m_hasPositions ? CACHE_HAS_POSITIONS : 0;
+    header.flags |= m_hasTextureCoords ? CACHE_HAS_TEXTURE_COORDS : 0;
+    header.flags |= m_hasNormals ? CACHE_HAS_NORMALS : 0;
+    header.flags |= m_hasTangents ? CACHE_HAS_TANGENTS : 0;
+    header.flags |= m_hasAdjacency ? CACHE_HAS_ADJACENCY : 0;
+    header.flags |= m_normalsRebuilt ? CACHE_NORMALS_REBUILT : 0;
+    header.flags |= m_triangleOrderOptimized ? CACHE_TRIANGLE_ORDER_OPTIMIZED : 0;
+    header.flags |= m_overdrawOptimized ? CACHE_OVERDRAW_OPTIMIZED : 0;
+
+    header.numberOfVertexCoords = m_numberOfVertexCoords;
+    header.numberOfTextureCoords = m_numberOfTextureCoords;
+    header.numberOfNormals = m_numberOfNormals;
+    header.numberOfVertices = m_numberOfVertices;
+    header.numberOfPositions = m_numberOfPositions;
+    header.numberOfTriangles = m_numberOfTriangles;
+    header.numberOfShortTriangles = m_numberOfShortTriangles;
+    header.numberOfShortPositionTriangles = m_numberOfShortPositionTriangles;
+    header.numberOfMeshes = m_numberOfMeshes;
+    header.numberOfMeshlets = static_cast<int>(m_meshlets.size());
+    header.numberOfLods = static_cast<int>(m_lods.size());
+    header.numberOfLodRatios = static_cast<int>(m_lodRatios.size());
+    header.numberOfLodMeshes = static_cast<int>(m_lodMeshes.size());
+    header.numberOfLodIndices = m_numberOfLodIndices;
+    header.numberOfMaterials = m_numberOfMaterials;
+    header.numberOfLibraries = static_cast<int>(m_materialLibraries.size());
+
+    memcpy(header.center, m_center, sizeof(m_center));
+    memcpy(header.weldTolerances, m_weldTolerances, sizeof(m_weldTolerances));
+    header.width = m_width;
+    header.height = m_height;
+    header.length = m_length;
+    header.radius = m_radius;
+
+    for (int i = 0; i < m_numberOfMaterials; ++i)
+    {
+        const Material &material = m_materials[i];
+        CacheMaterial &cacheMaterial = materials[i];
+
+        memcpy(cacheMaterial.ambient, material.ambient, sizeof(cacheMaterial.ambient));
+        memcpy(cacheMaterial.diffuse, material.diffuse, sizeof(cacheMaterial.diffuse));
+        memcpy(cacheMaterial.specular, material.specular, sizeof(cacheMaterial.specular));
+        cacheMaterial.shininess = material.shininess;
+        cacheMaterial.alpha = material.alpha;
+        cacheMaterial.name = AddCacheString(strings, material.name);
+        cacheMaterial.colorMapFilename = AddCacheString(strings, material.colorMapFilename);
+        cacheMaterial.bumpMapFilename = AddCacheString(strings, material.bumpMapFilename);
+    }
+
+    for (int i = 0; i < m_numberOfMeshes; ++i)
+    {
+        meshes[i].startIndex = m_meshes[i].startIndex;
+        meshes[i].triangleCount = m_meshes[i].triangleCount;
+        meshes[i].material = static_cast<int>(m_meshes[i].pMaterial - &m_materials[0]);
+        meshes[i].baseVertex = m_meshes[i].baseVertex;
+        meshes[i].basePosition = m_meshes[i].basePosition;
+        meshes[i].shortIndices = m_meshes[i].shortIndices ? 1 : 0;
+        meshes[i].shortPositions = m_meshes[i].shortPositions ? 1 : 0;
+        meshes[i].startMeshlet = m_meshes[i].startMeshlet;
+        meshes[i].meshletCount = m_meshes[i].meshletCount;
+    }
+
+    for (size_t i = 0; i < m_lodMeshes.size(); ++i)
+    {
+        memset(&lodMeshes[i], 0, sizeof(CacheMesh));
+        lodMeshes[i].startIndex = m_lodMeshes[i].startIndex;
+        lodMeshes[i].triangleCount = m_lodMeshes[i].triangleCount;
+        lodMeshes[i].material = static_cast<int>(m_lodMeshes[i].pMaterial - &m_materials[0]);
+    }
+
+    for (size_t i = 0; i < m_materialLibraries.size(); ++i)
+        libraries[i] = AddCacheString(strings, m_materialLibraries[i]);
+
+    // Lay out the sections.
+
+    size_t vertexSize = static_cast<size_t>(m_numberOfVertices) * sizeof(Vertex);
+    size_t indexSize = static_cast<size_t>(m_numberOfTriangles) * 3 * sizeof(int);
+    size_t positionSize = static_cast<size_t>(m_numberOfPositions) * 3 * sizeof(float);
+    size_t shortIndexSize = static_cast<size_t>(m_numberOfShortTriangles) * 3 * sizeof(unsigned short);
+    size_t shortPositionIndexSize = static_cast<size_t>(m_numberOfShortPositionTriangles) * 3 * sizeof(unsigned short);
+    size_t lodIndexSize = static_cast<size_t>(m_numberOfLodIndices) * sizeof(int);
+    size_t adjacencySize = m_hasAdjacency ? indexSize * 2 : 0;
+
+    header.vertexOffset = AlignCacheOffset(sizeof(header));
+    header.indexOffset = AlignCacheOffset(header.vertexOffset + vertexSize);
+    header.positionOffset = AlignCacheOffset(header.indexOffset + indexSize);
+    header.positionIndexOffset = AlignCacheOffset(header.positionOffset + positionSize);
+    header.shortIndexOffset = AlignCacheOffset(header.positionIndexOffset + indexSize);
+    header.shortPositionIndexOffset = AlignCacheOffset(header.shortIndexOffset + shortIndexSize);
+    header.lodIndexOffset = AlignCacheOffset(header.shortPositionIndexOffset + shortPositionIndexSize);
+    header.lodPositionIndexOffset = AlignCacheOffset(header.lodIndexOffset + lodIndexSize);
+    header.adjacencyOffset = AlignCacheOffset(header.lodPositionIndexOffset + lodIndexSize);
+    header.positionAdjacencyOffset = AlignCacheOffset(header.adjacencyOffset + adjacencySize);
+    header.meshOffset = AlignCacheOffset(header.positionAdjacencyOffset + adjacencySize);
+    header.meshletOffset = AlignCacheOffset(header.meshOffset + meshes.size() * sizeof(CacheMesh));
+    header.lodOffset = AlignCacheOffset(header.meshletOffset + m_meshlets.size() * sizeof(Meshlet));
+    header.lodMeshOffset = AlignCacheOffset(header.lodOffset + m_lods.size() * sizeof(Lod));
+    header.lodRatioOffset = AlignCacheOffset(header.lodMeshOffset + lodMeshes.size() * sizeof(CacheMesh));
+    header.materialOffset = AlignCacheOffset(header.lodRatioOffset + m_lodRatios.size() * sizeof(float));
+    header.libraryOffset = AlignCacheOffset(header.materialOffset + materials.size() * sizeof(CacheMaterial));
+    header.stringOffset = AlignCacheOffset(header.libraryOffset + libraries.size() * sizeof(CacheString));
+    header.fileSize = header.stringOffset + strings.size();
+}
+
+bool ModelOBJ::saveCache(const char *pszFilename) const
+{
+    // The cache is written to a temporary file that then replaces the old
+    // cache, so a partially written cache is never picked up by import().
+    // It stores float vertices, which models with compact ones no longer have.
+
+    if (m_numberOfVertices > 0 && !m_pVertexBuffer)
+        return false;
+
+    CacheLayout layout;
+    const CacheHeader &header = layout.header;
+    const std::vector<CacheMesh> &meshes = layout.meshes;
+    const std::vector<CacheMesh> &lodMeshes = layout.lodMeshes;
+    const std::vector<CacheMaterial> &materials = layout.materials;
+    const std::vector<CacheString> &libraries = layout.libraries;
+    const std::string &strings = layout.strings;
+
+    layoutCache(layout);
+
+    size_t vertexSize = static_cast<size_t>(m_numberOfVertices) * sizeof(Vertex);
+    size_t indexSize = static_cast<size_t>(m_numberOfTriangles) * 3 * sizeof(int);
+    size_t positionSize = static_cast<size_t>(m_numberOfPositions) * 3 * sizeof(float);
+    size_t shortIndexSize = static_cast<size_t>(m_numberOfShortTriangles) * 3 * sizeof(unsigned short);
+    size_t shortPositionIndexSize = static_cast<size_t>(m_numberOfShortPositionTriangles) * 3 * sizeof(unsigned short);
+    size_t lodIndexSize = static_cast<size_t>(m_numberOfLodIndices) * sizeof(int);
+    size_t adjacencySize = m_hasAdjacency ? indexSize * 2 : 0;
+
+    // Write the file.
+
+    std::string tempFilename = TemporaryFilename(pszFilename);
+    FILE *pFile = fopen(tempFilename.c_str(), "wb");
+
+    if (!pFile)
+        return false;
+
+    unsigned long long offset = 0;
+    bool written = WriteCacheSection(pFile, offset, &header, sizeof(header)) &&
+        WriteCacheSection(pFile, offset, m_pVertexBuffer, vertexSize) &&
+        WriteCacheSection(pFile, offset, m_pIndexBuffer, indexSize) &&
+        WriteCacheSection(pFile, offset, m_pPositionBuffer, positionSize) &&
+        WriteCacheSection(pFile, offset, m_pPositionIndexBuffer, indexSize) &&
+        WriteCacheSection(pFile, offset, m_pShortIndexBuffer, shortIndexSize) &&
+        WriteCacheSection(pFile, offset, m_pShortPositionIndexBuffer, shortPositionIndexSize) &&
+        WriteCacheSection(pFile, offset, m_pLodIndexBuffer, lodIndexSize) &&
+        WriteCacheSection(pFile, offset, m_pLodPositionIndexBuffer, lodIndexSize) &&
+        WriteCacheSection(pFile, offset, m_pIndexBufferAdj, adjacencySize) &&
+        WriteCacheSection(pFile, offset, m_pPositionIndexBufferAdj, adjacencySize) &&
+        WriteCacheSection(pFile, offset, meshes.empty() ? 0 : &meshes[0], meshes.size() * sizeof(CacheMesh)) &&
+        WriteCacheSection(pFile, offset, m_meshlets.empty() ? 0 : &m_meshlets[0], m_meshlets.size() * sizeof(Meshlet)) &&
+        WriteCacheSection(pFile, offset, m_lods.empty() ? 0 : &m_lods[0], m_lods.size() * sizeof(Lod)) &&
+        WriteCacheSection(pFile, offset, lodMeshes.empty() ? 0 : &lodMeshes[0], lodMeshes.size() * sizeof(CacheMesh)) &&
+        WriteCacheSection(pFile, offset, m_lodRatios.empty() ? 0 : &m_lodRatios[0], m_lodRatios.size() * sizeof(float)) &&
+        WriteCacheSection(pFile, offset, materials.empty() ? 0 : &materials[0], materials.size() * sizeof(CacheMaterial)) &&
+        WriteCacheSection(pFile, offset, libraries.empty() ? 0 : &libraries[0], libraries.size() * sizeof(CacheString)) &&
+        WriteCacheSection(pFile, offset, strings.data(), strings.size());
+
+    if (fclose(pFile) != 0)
+        written = false;
+
+    if (!written || !ReplaceFile(tempFilename, pszFilename))
+    {
+        remove(tempFilename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void ModelOBJ::initVertexCache()
+{
+    // Pre-size the vertex cache from the attribute counts. Most meshes have
+    // about as many vertices as their largest attribute array.
+
+    int expectedVertices = std::max(m_numberOfVertexCoords,
+        std::max(m_numberOfTextureCoords, m_numberOfNormals));
+    VertexCacheEntry emptyEntry = {0, 0, 0, -1};
+
+    m_vertexCache.assign(HashTableCapacity(expectedVertices), emptyEntry);
+    m_vertexBuffer.reserve(expectedVertices);
+
+    m_zeroTexCoordAlias = BuildAliases(m_textureCoords, 2, m_texCoordAliases);
+    m_zeroNormalAlias = BuildAliases(m_normals, 3, m_normalAliases);
+}
+
+bool ModelOBJ::hasLodRatios(const std::vector<float> &ratios) const
+{
+    return m_lodRatios == ratios;
+}
+
+bool ModelOBJ::hasWeldTolerances(const ImportOptions &options) const
+{
+    return m_weldTolerances[0] == options.weldPositionTolerance &&
+           m_weldTolerances[1] == options.weldTexCoordTolerance &&
+           m_weldTolerances[2] == options.weldNormalTolerance;
+}
+
+bool ModelOBJ::isCacheCurrent(const char *pszCacheFilename,
+                              const char *pszObjFilename) const
+{
+    // The cache is current if it's at least as new as the OBJ file and all
+    // of the MTL files that were used when it was written. Source files that
+    // don't exist (e.g. a library shipped with only the cache) are ignored.
+
+    long long cacheTime = 0;
+    long long sourceTime = 0;
+    std::string name;
+
+    if (!GetModificationTime(pszCacheFilename, cacheTime))
+        return false;
+
+    if (GetModificationTime(pszObjFilename, sourceTime) && sourceTime > cacheTime)
+        return false;
+
+    for (size_t i = 0; i < m_materialLibraries.size(); ++i)
+    {
+        name = m_directoryPath;
+        name += m_materialLibraries[i];
+
+        if (GetModificationTime(name.c_str(), sourceTime) && sourceTime > cacheTime)
+            return false;
+    }
+
+    return true;
+}
+
+void ModelOBJ::optimizeTriangleOrder(int threadCount, bool reduceOverdraw)
+{
+    // Reorders the triangles within every run of triangles that share a
+    // material (buildMeshes() turns each run into a mesh) and then renumbers
+    // the vertices in the order they are first used, duplicating the few
+    // that 16-bit sub-meshes need. Long runs are cut into batches that are
+    // optimized in parallel; the result doesn't depend on threadCount. If
+    // reduceOverdraw is set the clusters of each batch are also sorted front
+    // to back as seen from outside the model.
+
+    int numTriangles = static_cast<int>(m_attributeBuffer.size());
+    int numVerts = static_cast<int>(m_vertexBuffer.size());
+
+    if (numTriangles == 0)
+        return;
+
+    m_importStatistics.acmrBefore = static_cast<float>(CountCacheMisses(&m_indexBuffer[0],
+        numTriangles * 3, numVerts)) / numTriangles;
+
+    std::vector<int> batchStarts;
+
+    for (int start = 0, end = 0; start < numTriangles; start = end)
+    {
+        for (end = start + 1; end < numTriangles; ++end)
+        {
+            if (m_attributeBuffer[end] != m_attributeBuffer[start])
+                break;
+        }
+
+        for (int batch = start; batch < end; batch += OPTIMIZE_BATCH_TRIANGLES)
+            batchStarts.push_back(batch);
+    }
+
+    batchStarts.push_back(numTriangles);
+
+    int numBatches = static_cast<int>(batchStarts.size()) - 1;
+    std::vector<int> indexBuffer(m_indexBuffer.size());
+    std::vector<int> batchClusters(numBatches, 0);
+    float centroid[3] = {0.0f, 0.0f, 0.0f};
+
+    // The overdraw pass sorts clusters by their position relative to the
+    // area weighted centroid of the whole model.
+    if (reduceOverdraw)
+    {
+        double sum[3] = {0.0, 0.0, 0.0};
+        double area = 0.0;
+
+        for (int i = 0; i < numTriangles; ++i)
+        {
+            const float *p0 = m_vertexBuffer[m_indexBuffer[i * 3 + 0]].position;
+            const float *p1 = m_vertexBuffer[m_indexBuffer[i * 3 + 1]].position;
+            const float *p2 = m_vertexBuffer[m_indexBuffer[i * 3 + 2]].position;
+            float normal[3];
+            float weight = TriangleNormal(p0, p1, p2, normal);
+
+            for (int k = 0; k < 3; ++k)
+                sum[k] += (p0[k] + p1[k] + p2[k]) * (weight / 3.0f);
+
+            area += weight;
+        }
+
+        for (int k = 0; area > 0.0 && k < 3; ++k)
+            centroid[k] = static_cast<float>(sum[k] / area);
+    }
+
+    threadCount = std::min(ResolveThreadCount(threadCount), numBatches);
+
+    ParallelFor(threadCount, numBatches, [&](int, int begin, int end)
+    {
+        // Number each batch's vertices from zero so that the optimizer's
+        // per vertex arrays only cover the batch.
+
+        std::vector<int> localIndex(numVerts, -1);
+        std::vector<int> localVertices;
+        std::vector<int> localIndices;
+        std::vector<float> localPositions;
+        std::vector<int> order;
+
+        for (int batch = begin; batch < end; ++batch)
+        {
+            int start = batchStarts[batch];
+            int count = batchStarts[batch + 1] - start;
+            const int *pIndices = &m_indexBuffer[start * 3];
+
+            localVertices.clear();
+            localPositions.clear();
+            localIndices.resize(count * 3);
+            order.resize(count);
+
+            for (int i = 0; i < count * 3; ++i)
+            {
+                int v = pIndices[i];
+
+                if (localIndex[v] < 0)
+                {
+                    localIndex[v] = static_cast<int>(localVertices.size());
+                    localVertices.push_back(v);
+
+                    if (reduceOverdraw)
+                    {
+                        localPositions.insert(localPositions.end(), m_vertexBuffer[v].position,
+                            m_vertexBuffer[v].position + 3);
+                    }
+                }
+
+                localIndices[i] = localIndex[v];
+            }
+
+            OptimizeTriangleOrder(&localIndices[0], count,
+                static_cast<int>(localVertices.size()), &order[0]);
+
+            if (reduceOverdraw)
+            {
+                batchClusters[batch] = OptimizeOverdraw(&localIndices[0], count,
+                    static_cast<int>(localVertices.size()), &localPositions[0], centroid, &order[0]);
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                int src = start + order[i];
+                int dst = start + i;
+
+                std::copy(&m_indexBuffer[src * 3], &m_indexBuffer[src * 3] + 3, &indexBuffer[dst * 3]);
+            }
+
+            for (size_t i = 0; i < localVertices.size(); ++i)
+                localIndex[localVertices[i]] = -1;
+        }
+    });
+
+    // Renumber the vertices by first use, within windows of
+    // SHORT_INDEX_RANGE indices so that splitMeshes() can cut every mesh into
+    // sub-meshes with 16-bit indices. Once a triangle's new vertices don't
+    // fit the current window any more, the next window starts half of it
+    // back. A triangle that uses a vertex numbered before its window gets a
+    // copy of it. Unused vertices go last.
+
+    std::vector<int> remap(numVerts, -1);
+    std::vector<Vertex> vertexBuffer;
+    int windowStart = 0;
+
+    vertexBuffer.reserve(numVerts);
+
+    for (int i = 0; i < numTriangles; ++i)
+    {
+        int *pTriangle = &indexBuffer[i * 3];
+        int numNewVerts = 0;
+
+        for (int k = 0; k < 3; ++k)
+            numNewVerts += (remap[pTriangle[k]] < windowStart) ? 1 : 0;
+
+        if (static_cast<int>(vertexBuffer.size()) + numNewVerts > windowStart + SHORT_INDEX_RANGE)
+            windowStart = static_cast<int>(vertexBuffer.size()) - SHORT_INDEX_RANGE / 2;
+
+        for (int k = 0; k < 3; ++k)
+        {
+            int &index = remap[pTriangle[k]];
+
+            if (index < windowStart)
+            {
+                index = static_cast<int>(vertexBuffer.size());
+                vertexBuffer.push_back(m_vertexBuffer[pTriangle[k]]);
+            }
+
+            pTriangle[k] = index;
+        }
+    }
+
+    for (int i = 0; i < numVerts; ++i)
+    {
+        if (remap[i] < 0)
+            vertexBuffer.push_back(m_vertexBuffer[i]);
+    }
+
+    m_vertexBuffer.swap(vertexBuffer);
+    m_indexBuffer.swap(indexBuffer);
+
+    m_importStatistics.acmrAfter = static_cast<float>(CountCacheMisses(&m_indexBuffer[0],
+        numTriangles * 3, static_cast<int>(m_vertexBuffer.size()))) / numTriangles;
+
+    for (int i = 0; i < numBatches; ++i)
+        m_importStatistics.overdrawClusters += batchClusters[i];
+}
+
+void ModelOBJ::releaseImportBuffers()
+{
+    // The raw OBJ attributes and the triangles' material ids are only needed
+    // while the model's buffers are built. So are the half-edges, which
+    // generateAdjacency() builds again if it is called later.
+
+    std::vector<float>().swap(m_vertexCoords);
+    std::vector<float>().swap(m_textureCoords);
+    std::vector<float>().swap(m_normals);
+    std::vector<int>().swap(m_attributeBuffer);
+    releaseHalfEdges();
+}
+
+void ModelOBJ::releaseHalfEdges()
+{
+    std::vector<int>().swap(m_halfEdgeTwins);
+    std::vector<int>().swap(m_positionHalfEdges);
+    m_hasHalfEdges = false;
+}
+
+void ModelOBJ::releaseVertexCache()
+{
+    m_importStatistics.uniqueVertices = static_cast<int>(m_vertexBuffer.size());
+    m_importStatistics.vertexCacheCapacity = static_cast<int>(m_vertexCache.size());
+    m_importStatistics.vertexCacheLoadFactor = m_vertexCache.empty() ? 0.0f :
+        static_cast<float>(m_vertexBuffer.size()) / m_vertexCache.size();
+
+    std::vector<VertexCacheEntry>().swap(m_vertexCache);
+    std::vector<int>().swap(m_texCoordAliases);
+    std::vector<int>().swap(m_normalAliases);
+}
+
+void ModelOBJ::reportBytesParsed(long long bytes) const
+{
+    if (m_pProgress)
+        m_pProgress->bytesParsed += bytes;
+}
+
+void ModelOBJ::setImportStage(int stage) const
+{
+    if (m_pProgress)
+        m_pProgress->stage = stage;
+}
+
+void ModelOBJ::scale(float scaleFactor, float offset[3])
+{
+    // Applies position = (position + offset) * scaleFactor on top of the
+    // model transform. The vertices, positions and meshlet bounds stay as
+    // imported: a cached model's buffers are a copy-on-write mapping, and
+    // rewriting them would copy all of it into private memory.
+
+    for (int i = 0; i < 3; ++i)
+        m_transformOffset[i] += offset[i] / m_transformScale;
+
+    m_transformScale *= scaleFactor;
+}
+
+void ModelOBJ::sortTrianglesByMaterial()
+{
+    // Stable counting sort of the triangles on their material, so that
+    // buildMeshes() creates one mesh per material rather than one per run of
+    // faces between two usemtl statements. The triangles of each material
+    // keep their file order.
+
+    int numTriangles = static_cast<int>(m_attributeBuffer.size());
+    std::vector<int> offsets(m_numberOfMaterials + 1, 0);
+    int numRuns = 0;
+    int numBatches = 0;
+
+    for (int i = 0; i < numTriangles; ++i)
+    {
+        if (i == 0 || m_attributeBuffer[i] != m_attributeBuffer[i - 1])
+            ++numRuns;
+
+        ++offsets[m_attributeBuffer[i] + 1];
+    }
+
+    for (int i = 0; i < m_numberOfMaterials; ++i)
+    {
+        if (offsets[i + 1] > 0)
+            ++numBatches;
+
+        offsets[i + 1] += offsets[i];
+    }
+
+    m_importStatistics.materialRuns = numRuns;
+    m_importStatistics.materialBatches = numBatches;
+
+    if (numRuns == numBatches)
+        return;
+
+    std::vector<int> indexBuffer(m_indexBuffer.size());
+    std::vector<int> attributeBuffer(m_attributeBuffer.size());
+
+    for (int i = 0; i < numTriangles; ++i)
+    {
+        int material = m_attributeBuffer[i];
+        int slot = offsets[material]++;
+
+        std::copy(&m_indexBuffer[i * 3], &m_indexBuffer[i * 3] + 3, &indexBuffer[slot * 3]);
+        attributeBuffer[slot] = material;
+    }
+
+    m_indexBuffer.swap(indexBuffer);
+    m_attributeBuffer.swap(attributeBuffer);
+}
+
+void ModelOBJ::splitMeshes()
+{
+    // Splits every mesh into runs of triangles whose vertex indices span
+    // less than SHORT_INDEX_RANGE. Triangles too spread out to fit on their
+    // own are put into sub-meshes that keep 32-bit indices. Meshes that would
+    // fall apart into many small sub-meshes, e.g. a material whose triangles
+    // are spread all over a large model, aren't split at all. The 16-bit
+    // indices are relative to the mesh's base vertex and base position.
+    // Positions are welded across meshes, so a sub-mesh's position indices
+    // only use 16 bits too if they also fit (Mesh::shortPositions).
+
+    std::vector<Mesh> meshes;
+
+    meshes.reserve(m_meshes.size());
+
+    for (size_t i = 0; i < m_meshes.size(); ++i)
+    {
+        const Mesh &source = m_meshes[i];
+        Mesh mesh = source;
+        IndexRange vertexRange;
+        size_t firstMesh = meshes.size();
+
+        mesh.triangleCount = 0;
+        mesh.shortIndices = false;
+
+        for (int j = 0; j <= source.triangleCount; ++j)
+        {
+            int index = source.startIndex + j * 3;
+            IndexRange vertices = vertexRange;
+            bool last = (j == source.triangleCount);
+
+            if (!last && mesh.shortIndices && vertices.extend(&m_pIndexBuffer[index], 3))
+            {
+                vertexRange = vertices;
+                ++mesh.triangleCount;
+                continue;
+            }
+
+            // Start a new sub-mesh, using 16-bit indices if the triangle
+            // fits them on its own. Consecutive triangles that don't fit
+            // 16-bit indices share one 32-bit sub-mesh.
+
+            vertices = IndexRange();
+
+            bool shortIndices = !last && vertices.extend(&m_pIndexBuffer[index], 3);
+
+            if (mesh.triangleCount > 0 && (last || shortIndices || mesh.shortIndices))
+            {
+                IndexRange positionRange;
+
+                mesh.shortPositions = mesh.shortIndices &&
+                    positionRange.extend(&m_pPositionIndexBuffer[mesh.startIndex], mesh.triangleCount * 3);
+                mesh.baseVertex = mesh.shortIndices ? vertexRange.first : 0;
+                mesh.basePosition = mesh.shortPositions ? positionRange.first : 0;
+                meshes.push_back(mesh);
+
+                mesh.startIndex = index;
+                mesh.triangleCount = 0;
+            }
+
+            mesh.shortIndices = shortIndices;
+            vertexRange = vertices;
+
+            if (!last)
+                ++mesh.triangleCount;
+        }
+
+        size_t numSubMeshes = meshes.size() - firstMesh;
+
+        if (numSubMeshes > 1 && source.triangleCount < MIN_SHORT_MESH_TRIANGLES * static_cast<int>(numSubMeshes))
+        {
+            meshes.resize(firstMesh);
+            meshes.push_back(source);
+            meshes.back().shortIndices = false;
+            meshes.back().shortPositions = false;
+        }
+    }
+
+    m_meshes.swap(meshes);
+    m_numberOfMeshes = static_cast<int>(m_meshes.size());
+}
+
+void ModelOBJ::groupShortMeshes()
+{
+    // Moves the triangles of the meshes with 16-bit position indices to the
+    // front of the index buffers, followed by those of the other meshes with
+    // 16-bit vertex indices. The 16-bit buffers then only need to cover the
+    // start of the 32-bit ones, and renderers only need the rest of those.
+    // Every group keeps the meshes' order.
+
+    std::vector<int> indexBuffer(m_indexBuffer.size());
+    std::vector<int> positionIndexBuffer(m_positionIndexBuffer.size());
+    std::vector<int> attributeBuffer(m_attributeBuffer.size());
+    int triangle = 0;
+
+    m_numberOfShortTriangles = 0;
+    m_numberOfShortPositionTriangles = 0;
+
+    for (int group = 0; group < 3; ++group)
+    {
+        for (int i = 0; i < m_numberOfMeshes; ++i)
+        {
+            Mesh &mesh = m_meshes[i];
+            int meshGroup = mesh.shortPositions ? 0 : (mesh.shortIndices ? 1 : 2);
+            int start = mesh.startIndex / 3;
+
+            if (meshGroup != group)
+                continue;
+
+            std::copy(&m_indexBuffer[start * 3], &m_indexBuffer[(start + mesh.triangleCount) * 3],
+                &indexBuffer[triangle * 3]);
+            std::copy(&m_positionIndexBuffer[start * 3], &m_positionIndexBuffer[(start + mesh.triangleCount) * 3],
+                &positionIndexBuffer[triangle * 3]);
+            std::copy(&m_attributeBuffer[start], &m_attributeBuffer[start + mesh.triangleCount],
+                &attributeBuffer[triangle]);
+
+            mesh.startIndex = triangle * 3;
+            triangle += mesh.triangleCount;
+        }
+
+        if (group == 0)
+            m_numberOfShortPositionTriangles = triangle;
+        else if (group == 1)
+            m_numberOfShortTriangles = triangle;
+    }
+
+    // Copied back rather than swapped, the model's buffer pointers already
+    // point into these vectors.
+    std::copy(indexBuffer.begin(), indexBuffer.end(), m_indexBuffer.begin());
+    std::copy(positionIndexBuffer.begin(), positionIndexBuffer.end(), m_positionIndexBuffer.begin());
+    m_attributeBuffer.swap(attributeBuffer);
+}
+
+void ModelOBJ::addDefaultMaterial()
+{
+    Material defaultMaterial =
+    {
+        0.2f, 0.2f, 0.2f, 1.0f,
+        0.8f, 0.8f, 0.8f, 1.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+        0.0f,
+        1.0f,
+        std::string("default"),
+        std::string(),
+        std::string()
+    };
+
+    m_materials.push_back(defaultMaterial);
+    m_materialCache[defaultMaterial.name] = 0;
+    m_numberOfMaterials = 1;
+}
+
+void ModelOBJ::attachImportedBuffers()
+{
+    m_numberOfVertices = static_cast<int>(m_vertexBuffer.size());
+    m_pVertexBuffer = m_vertexBuffer.empty() ? 0 : &m_vertexBuffer[0];
+    m_pIndexBuffer = m_indexBuffer.empty() ? 0 : &m_indexBuffer[0];
+
+    m_numberOfPositions = static_cast<int>(m_positionBuffer.size()) / 3;
+    m_pPositionBuffer = m_positionBuffer.empty() ? 0 : &m_positionBuffer[0];
+    m_pPositionIndexBuffer = m_positionIndexBuffer.empty() ? 0 : &m_positionIndexBuffer[0];
+}
+
+void ModelOBJ::addTrianglePos(int index, int material, int v0, int v1, int v2)
+{
+    Vertex vertex =
+    {
+        0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f
+    };
+
+    m_attributeBuffer[index] = material;
+
+    vertex.position[0] = m_vertexCoords[v0 * 3];
+    vertex.position[1] = m_vertexCoords[v0 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v0 * 3 + 2];
+    m_indexBuffer[index * 3] = addVertex(v0, -1, -1, &vertex);
+
+    vertex.position[0] = m_vertexCoords[v1 * 3];
+    vertex.position[1] = m_vertexCoords[v1 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v1 * 3 + 2];
+    m_indexBuffer[index * 3 + 1] = addVertex(v1, -1, -1, &vertex);
+
+    vertex.position[0] = m_vertexCoords[v2 * 3];
+    vertex.position[1] = m_vertexCoords[v2 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v2 * 3 + 2];
+    m_indexBuffer[index * 3 + 2] = addVertex(v2, -1, -1, &vertex);
+}
+
+void ModelOBJ::addTrianglePosNormal(int index, int material, int v0, int v1,
+                                    int v2, int vn0, int vn1, int vn2)
+{
+    Vertex vertex =
+    {
+        0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f
+    };
+
+    m_attributeBuffer[index] = material;
+
+    vertex.position[0] = m_vertexCoords[v0 * 3];
+    vertex.position[1] = m_vertexCoords[v0 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v0 * 3 + 2];
+    vertex.normal[0] = m_normals[vn0 * 3];
+    vertex.normal[1] = m_normals[vn0 * 3 + 1];
+    vertex.normal[2] = m_normals[vn0 * 3 + 2];
+    m_indexBuffer[index * 3] = addVertex(v0, -1, vn0, &vertex);
+
+    vertex.position[0] = m_vertexCoords[v1 * 3];
+    vertex.position[1] = m_vertexCoords[v1 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v1 * 3 + 2];
+    vertex.normal[0] = m_normals[vn1 * 3];
+    vertex.normal[1] = m_normals[vn1 * 3 + 1];
+    vertex.normal[2] = m_normals[vn1 * 3 + 2];
+    m_indexBuffer[index * 3 + 1] = addVertex(v1, -1, vn1, &vertex);
+
+    vertex.position[0] = m_vertexCoords[v2 * 3];
+    vertex.position[1] = m_vertexCoords[v2 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v2 * 3 + 2];
+    vertex.normal[0] = m_normals[vn2 * 3];
+    vertex.normal[1] = m_normals[vn2 * 3 + 1];
+    vertex.normal[2] = m_normals[vn2 * 3 + 2];
+    m_indexBuffer[index * 3 + 2] = addVertex(v2, -1, vn2, &vertex);
+}
+
+void ModelOBJ::addTrianglePosTexCoord(int index, int material, int v0, int v1,
+                                      int v2, int vt0, int vt1, int vt2)
+{
+    Vertex vertex =
+    {
+        0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f
+    };
+
+    m_attributeBuffer[index] = material;
+
+    vertex.position[0] = m_vertexCoords[v0 * 3];
+    vertex.position[1] = m_vertexCoords[v0 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v0 * 3 + 2];
+    vertex.texCoord[0] = m_textureCoords[vt0 * 2];
+    vertex.texCoord[1] = m_textureCoords[vt0 * 2 + 1];
+    m_indexBuffer[index * 3] = addVertex(v0, vt0, -1, &vertex);
+
+    vertex.position[0] = m_vertexCoords[v1 * 3];
+    vertex.position[1] = m_vertexCoords[v1 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v1 * 3 + 2];
+    vertex.texCoord[0] = m_textureCoords[vt1 * 2];
+    vertex.texCoord[1] = m_textureCoords[vt1 * 2 + 1];
+    m_indexBuffer[index * 3 + 1] = addVertex(v1, vt1, -1, &vertex);
+
+    vertex.position[0] = m_vertexCoords[v2 * 3];
+    vertex.position[1] = m_vertexCoords[v2 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v2 * 3 + 2];
+    vertex.texCoord[0] = m_textureCoords[vt2 * 2];
+    vertex.texCoord[1] = m_textureCoords[vt2 * 2 + 1];
+    m_indexBuffer[index * 3 + 2] = addVertex(v2, vt2, -1, &vertex);
+}
+
+void ModelOBJ::addTrianglePosTexCoordNormal(int index, int material, int v0,
+                                            int v1, int v2, int vt0, int vt1,
+                                            int vt2, int vn0, int vn1, int vn2)
+{
+    Vertex vertex =
+    {
+        0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f
+    };
+
+    m_attributeBuffer[index] = material;
+
+    vertex.position[0] = m_vertexCoords[v0 * 3];
+    vertex.position[1] = m_vertexCoords[v0 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v0 * 3 + 2];
+    vertex.texCoord[0] = m_textureCoords[vt0 * 2];
+    vertex.texCoord[1] = m_textureCoords[vt0 * 2 + 1];
+    vertex.normal[0] = m_normals[vn0 * 3];
+    vertex.normal[1] = m_normals[vn0 * 3 + 1];
+    vertex.normal[2] = m_normals[vn0 * 3 + 2];
+    m_indexBuffer[index * 3] = addVertex(v0, vt0, vn0, &vertex);
 
     vertex.position[0] = m_vertexCoords[v1 * 3];
     vertex.position[1] = m_vertexCoords[v1 * 3 + 1];
     vertex.position[2] = m_vertexCoords[v1 * 3 + 2];
+    vertex.texCoord[0] = m_textureCoords[vt1 * 2];
+    vertex.texCoord[1] = m_textureCoords[vt1 * 2 + 1];
     vertex.normal[0] = m_normals[vn1 * 3];
     vertex.normal[1] = m_normals[vn1 * 3 + 1];
     vertex.normal[2] = m_normals[vn1 * 3 + 2];
-    m_indexBuffer[index * 3 + 1] = addVertex(v1, &vertex);
+    m_indexBuffer[index * 3 + 1] = addVertex(v1, vt1, vn1, &vertex);
+
+    vertex.position[0] = m_vertexCoords[v2 * 3];
+    vertex.position[1] = m_vertexCoords[v2 * 3 + 1];
+    vertex.position[2] = m_vertexCoords[v2 * 3 + 2];
+    vertex.texCoord[0] = m_textureCoords[vt2 * 2];
+    vertex.texCoord[1] = m_textureCoords[vt2 * 2 + 1];
+    vertex.normal[0] = m_normals[vn2 * 3];
+    vertex.normal[1] = m_normals[vn2 * 3 + 1];
+    vertex.normal[2] = m_normals[vn2 * 3 + 2];
+    m_indexBuffer[index * 3 + 2] = addVertex(v2, vt2, vn2, &vertex);
+}
+
+int ModelOBJ::addVertex(int v, int vt, int vn, const Vertex *pVertex)
+{
+    // Vertices are identified by their (v, vt, vn) index triple in a flat
+    // open addressing hash table with linear probing. The vt and vn indices
+    // are replaced by their aliases (see initVertexCache()) so that exactly
+    // the same vertices are shared as when comparing the vertex data itself.
+
+    vt = (vt < 0) ? m_zeroTexCoordAlias : m_texCoordAliases[vt];
+    vn = (vn < 0) ? m_zeroNormalAlias : m_normalAliases[vn];
+
+    size_t mask = m_vertexCache.size() - 1;
+    size_t slot = HashIndices(v, vt, vn) & mask;
+
+    ++m_importStatistics.vertexCacheLookups;
+
+    for (;; slot = (slot + 1) & mask)
+    {
+        VertexCacheEntry &entry = m_vertexCache[slot];
+
+        ++m_importStatistics.vertexCacheProbes;
+
+        if (entry.index < 0)
+        {
+            // Vertex doesn't exist in the cache.
+
+            int index = static_cast<int>(m_vertexBuffer.size());
+
+            entry.v = v;
+            entry.vt = vt;
+            entry.vn = vn;
+            entry.index = index;
+            m_vertexBuffer.push_back(*pVertex);
+
+            if (m_vertexBuffer.size() * 2 > m_vertexCache.size())
+                growVertexCache();
+
+            return index;
+        }
+
+        if (entry.v == v && entry.vt == vt && entry.vn == vn)
+            return entry.index;
+    }
+}
+
+void ModelOBJ::buildLods(const std::vector<float> &ratios, int threadCount)
+{
+    // Builds a chain of levels of detail by quadric error edge collapse.
+    // Every level is an extra index buffer into the full detail vertex
+    // buffer with its own list of meshes; renderers pick a level from the
+    // model's projected size.
+    //
+    // Simplifies every run of triangles that share a material on its own,
+    // each level starting from the one before it. Long runs are cut into
+    // batches that are simplified in parallel. Positions on half-edges
+    // without a twin in the batch (mesh borders, material boundaries) are
+    // locked, as are positions that appear in another batch. UV seams and
+    // other vertices that share a position collapse together. Levels that
+    // don't get clearly smaller than the one before are dropped.
+
+    int numTriangles = static_cast<int>(m_attributeBuffer.size());
+    int numVerts = m_numberOfVertices;
+    int numLevels = static_cast<int>(ratios.size());
+
+    m_lods.clear();
+    m_lodRatios = ratios;
+    m_lodMeshes.clear();
+    m_lodIndexBuffer.clear();
+    m_lodPositionIndexBuffer.clear();
+
+    if (numTriangles == 0 || numLevels == 0)
+        return;
+
+    buildHalfEdges(threadCount);
+
+    std::vector<int> batchStarts;
+    std::vector<int> runEnds;
+
+    for (int start = 0, end = 0; start < numTriangles; start = end)
+    {
+        for (end = start + 1; end < numTriangles; ++end)
+        {
+            if (m_attributeBuffer[end] != m_attributeBuffer[start])
+                break;
+        }
+
+        for (int batch = start; batch < end; batch += OPTIMIZE_BATCH_TRIANGLES)
+            batchStarts.push_back(batch);
+
+        runEnds.push_back(static_cast<int>(batchStarts.size()));
+    }
+
+    batchStarts.push_back(numTriangles);
+
+    int numBatches = static_cast<int>(batchStarts.size()) - 1;
+    std::vector<int> vertexPosition(numVerts, -1);
+    std::vector<int> positionBatch(m_numberOfPositions, -1);   // -2 if in several
+
+    for (int batch = 0; batch < numBatches; ++batch)
+    {
+        for (int i = batchStarts[batch] * 3; i < batchStarts[batch + 1] * 3; ++i)
+        {
+            int position = m_pPositionIndexBuffer[i];
+
+            vertexPosition[m_pIndexBuffer[i]] = position;
+
+            if (positionBatch[position] == -1)
+                positionBatch[position] = batch;
+            else if (positionBatch[position] != batch)
+                positionBatch[position] = -2;
+        }
+    }
+
+    std::vector<std::vector<std::vector<int> > > levels(numBatches);
+
+    threadCount = std::min(ResolveThreadCount(threadCount), numBatches);
+
+    ParallelFor(threadCount, numBatches, [&](int, int begin, int end)
+    {
+        std::vector<int> localIndex(numVerts, -1);
+        std::vector<int> localPositionIndex(m_numberOfPositions, -1);
+        std::vector<int> localVertices;
+        std::vector<int> localPositions;
+        std::vector<int> vertexPositions;
+        std::vector<int> indices;
+        std::vector<float> positions;
+        std::vector<char> locked;
+
+        for (int batch = begin; batch < end; ++batch)
+        {
+            int start = batchStarts[batch];
+            int count = batchStarts[batch + 1] - start;
+            const int *pIndices = &m_pIndexBuffer[start * 3];
+
+            localVertices.clear();
+            localPositions.clear();
+            vertexPositions.clear();
+            positions.clear();
+            indices.resize(count * 3);
+
+            for (int i = 0; i < count * 3; ++i)
+            {
+                int v = pIndices[i];
+                int position = vertexPosition[v];
+
+                if (localPositionIndex[position] < 0)
+                {
+                    localPositionIndex[position] = static_cast<int>(localPositions.size());
+                    localPositions.push_back(position);
+                    positions.insert(positions.end(), &m_pPositionBuffer[position * 3],
+                        &m_pPositionBuffer[position * 3] + 3);
+                }
+
+                if (localIndex[v] < 0)
+                {
+                    localIndex[v] = static_cast<int>(localVertices.size());
+                    localVertices.push_back(v);
+                    vertexPositions.push_back(localPositionIndex[position]);
+                }
+
+                indices[i] = localIndex[v];
+            }
+
+            int localCount = static_cast<int>(localPositions.size());
+
+            locked.assign(localCount, 0);
+
+            for (int i = 0; i < localCount; ++i)
+                locked[i] = positionBatch[localPositions[i]] == -2;
+
+            for (int i = 0; i < count * 3; ++i)
+            {
+                int halfEdge = start * 3 + i;
+                int next = getNextHalfEdge(halfEdge);
+                int twin = m_halfEdgeTwins[halfEdge];
+
+                if (twin >= start * 3 && twin < (start + count) * 3)
+                    continue;
+
+                locked[vertexPositions[indices[i]]] = 1;
+                locked[vertexPositions[indices[next - start * 3]]] = 1;
+            }
+
+            // Simplify level by level and map back to the model's vertices.
+
+            levels[batch].resize(numLevels);
+
+            for (int level = 0; level < numLevels; ++level)
+            {
+                int target = static_cast<int>(ceilf(ratios[level] * count));
+
+                SimplifyMesh(indices, vertexPositions, &positions[0], locked, target);
+
+                std::vector<int> &output = levels[batch][level];
+
+                output.resize(indices.size());
+
+                for (size_t i = 0; i < indices.size(); ++i)
+                    output[i] = localVertices[indices[i]];
+            }
+
+            for (size_t i = 0; i < localVertices.size(); ++i)
+                localIndex[localVertices[i]] = -1;
+
+            for (int i = 0; i < localCount; ++i)
+                localPositionIndex[localPositions[i]] = -1;
+        }
+    });
+
+    // Lay the levels out one after the other, one mesh per run.
+
+    int previousTriangles = numTriangles;
+
+    for (int level = 0; level < numLevels; ++level)
+    {
+        Lod lod;
+        size_t levelIndices = 0;
+
+        for (int batch = 0; batch < numBatches; ++batch)
+            levelIndices += levels[batch][level].size();
+
+        if (static_cast<float>(levelIndices / 3) > LOD_MAX_TRIANGLE_RATIO * previousTriangles)
+            continue;
+
+        previousTriangles = static_cast<int>(levelIndices / 3);
+
+        lod.ratio = ratios[level];
+        lod.startMesh = static_cast<int>(m_lodMeshes.size());
+        lod.triangleCount = 0;
+
+        for (size_t run = 0, batch = 0; run < runEnds.size(); ++run)
+        {
+            Mesh mesh;
+
+            mesh.startIndex = static_cast<int>(m_lodIndexBuffer.size());
+            mesh.pMaterial = &m_materials[m_attributeBuffer[batchStarts[batch]]];
+            mesh.baseVertex = 0;
+            mesh.basePosition = 0;
+            mesh.shortIndices = false;
+            mesh.shortPositions = false;
+            mesh.shortAdjacency = false;
+            mesh.startMeshlet = 0;
+            mesh.meshletCount = 0;
+
+            for (; batch < static_cast<size_t>(runEnds[run]); ++batch)
+            {
+                const std::vector<int> &indices = levels[batch][level];
+
+                m_lodIndexBuffer.insert(m_lodIndexBuffer.end(), indices.begin(), indices.end());
+            }
+
+            mesh.triangleCount = (static_cast<int>(m_lodIndexBuffer.size()) - mesh.startIndex) / 3;
+
+            if (mesh.triangleCount > 0)
+            {
+                m_lodMeshes.push_back(mesh);
+                lod.triangleCount += mesh.triangleCount;
+            }
+        }
+
+        lod.meshCount = static_cast<int>(m_lodMeshes.size()) - lod.startMesh;
+        std::sort(m_lodMeshes.begin() + lod.startMesh, m_lodMeshes.end(), MeshCompFunc);
+        m_lods.push_back(lod);
+    }
+
+    m_lodPositionIndexBuffer.resize(m_lodIndexBuffer.size());
+
+    for (size_t i = 0; i < m_lodIndexBuffer.size(); ++i)
+        m_lodPositionIndexBuffer[i] = vertexPosition[m_lodIndexBuffer[i]];
+
+    m_numberOfLodIndices = static_cast<int>(m_lodIndexBuffer.size());
+    m_pLodIndexBuffer = m_lodIndexBuffer.empty() ? 0 : &m_lodIndexBuffer[0];
+    m_pLodPositionIndexBuffer = m_lodPositionIndexBuffer.empty() ? 0 : &m_lodPositionIndexBuffer[0];
+}
+
+void ModelOBJ::buildMeshes()
+{
+    // Group the model's triangles based on material type.
+
+    Mesh *pMesh = 0;
+    int materialId = -1;
+    int numMeshes = 0;
+
+    // Count the number of meshes.
+    for (int i = 0; i < static_cast<int>(m_attributeBuffer.size()); ++i)
+    {
+        if (m_attributeBuffer[i] != materialId)
+        {
+            materialId = m_attributeBuffer[i];
+            ++numMeshes;
+        }
+    }
+
+    // Allocate memory for the meshes and reset counters.
+    m_numberOfMeshes = numMeshes;
+    m_meshes.resize(m_numberOfMeshes);
+    numMeshes = 0;
+    materialId = -1;
+
+    // Build the meshes. One mesh for each unique material.
+    for (int i = 0; i < static_cast<int>(m_attributeBuffer.size()); ++i)
+    {
+        if (m_attributeBuffer[i] != materialId)
+        {
+            materialId = m_attributeBuffer[i];
+            pMesh = &m_meshes[numMeshes++];            
+            pMesh->pMaterial = &m_materials[materialId];
+            pMesh->startIndex = i * 3;
+            pMesh->baseVertex = 0;
+            pMesh->basePosition = 0;
+            pMesh->shortIndices = false;
+            pMesh->shortPositions = false;
+            pMesh->shortAdjacency = false;
+            pMesh->startMeshlet = 0;
+            pMesh->meshletCount = 0;
+            ++pMesh->triangleCount;
+        }
+        else
+        {
+            ++pMesh->triangleCount;
+        }
+    }
+
+    splitMeshes();
+    groupShortMeshes();
+
+    // Sort the meshes based on its material alpha. Fully opaque meshes
+    // towards the front and fully transparent towards the back.
+    std::sort(m_meshes.begin(), m_meshes.end(), MeshCompFunc);
+}
+
+void ModelOBJ::buildMeshlets()
+{
+    // Cuts every mesh into runs of consecutive triangles, each with a
+    // bounding sphere and a cone bounding its face normals, so that
+    // renderers can skip meshlets outside the view frustum or facing away
+    // from the viewer or a light. The triangle order is already spatially
+    // coherent after optimizeTriangleOrder(), so the runs stay compact
+    // without reordering anything.
+
+    std::vector<float> normals;
+
+    m_meshlets.clear();
+
+    for (int i = 0; i < m_numberOfMeshes; ++i)
+    {
+        Mesh &mesh = m_meshes[i];
+        int start = mesh.startIndex / 3;
+        int end = start + mesh.triangleCount;
+
+        mesh.startMeshlet = static_cast<int>(m_meshlets.size());
+
+        for (int first = start, last = start; first < end; first = last)
+        {
+            float sum[3] = {0.0f, 0.0f, 0.0f};
+
+            normals.clear();
+
+            for (last = first; last < end && last - first < MESHLET_MAX_TRIANGLES; ++last)
+            {
+                const int *pTriangle = &m_pPositionIndexBuffer[last * 3];
+                float normal[3];
+                float length = TriangleNormal(&m_pPositionBuffer[pTriangle[0] * 3],
+                    &m_pPositionBuffer[pTriangle[1] * 3], &m_pPositionBuffer[pTriangle[2] * 3], normal);
+
+                if (length > 0.0f)
+                {
+                    for (int k = 0; k < 3; ++k)
+                        normal[k] /= length;
+                }
+
+                if (last - first >= MESHLET_MIN_TRIANGLES && length > 0.0f &&
+                    normal[0] * sum[0] + normal[1] * sum[1] + normal[2] * sum[2] <
+                    MESHLET_MIN_CONE_DOT * sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]))
+                {
+                    break;
+                }
+
+                for (int k = 0; k < 3; ++k)
+                    sum[k] += normal[k];
+
+                if (length > 0.0f)
+                    normals.insert(normals.end(), normal, normal + 3);
+            }
+
+            Meshlet meshlet;
+            float boundsMin[3];
+            float boundsMax[3];
+
+            meshlet.startIndex = first * 3;
+            meshlet.triangleCount = last - first;
+
+            // Bounding sphere around the center of the bounding box.
+
+            for (int k = 0; k < 3; ++k)
+            {
+                boundsMin[k] = std::numeric_limits<float>::max();
+                boundsMax[k] = -std::numeric_limits<float>::max();
+            }
+
+            for (int j = first * 3; j < last * 3; ++j)
+            {
+                const float *pPosition = &m_pPositionBuffer[m_pPositionIndexBuffer[j] * 3];
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    boundsMin[k] = std::min(boundsMin[k], pPosition[k]);
+                    boundsMax[k] = std::max(boundsMax[k], pPosition[k]);
+                }
+            }
+
+            float radiusSquared = 0.0f;
+
+            for (int k = 0; k < 3; ++k)
+                meshlet.center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+
+            for (int j = first * 3; j < last * 3; ++j)
+            {
+                const float *pPosition = &m_pPositionBuffer[m_pPositionIndexBuffer[j] * 3];
+                float dx = pPosition[0] - meshlet.center[0];
+                float dy = pPosition[1] - meshlet.center[1];
+                float dz = pPosition[2] - meshlet.center[2];
+
+                radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+            }
+
+            meshlet.radius = sqrtf(radiusSquared);
+
+            // Normal cone around the average face normal. Degenerate
+            // triangles have no area and don't constrain it.
+
+            float length = sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+            float minDot = 1.0f;
+
+            for (int k = 0; k < 3; ++k)
+                meshlet.coneAxis[k] = (length > 0.0f) ? sum[k] / length : 0.0f;
+
+            for (size_t j = 0; j < normals.size(); j += 3)
+            {
+                minDot = std::min(minDot, normals[j] * meshlet.coneAxis[0] +
+                    normals[j + 1] * meshlet.coneAxis[1] + normals[j + 2] * meshlet.coneAxis[2]);
+            }
+
+            meshlet.coneCutoff = (length > 0.0f && minDot > MESHLET_CULL_CONE_DOT) ?
+                sqrtf(1.0f - minDot * minDot) : 1.0f;
+
+            m_meshlets.push_back(meshlet);
+        }
+
+        mesh.meshletCount = static_cast<int>(m_meshlets.size()) - mesh.startMeshlet;
+    }
+}
+
+void ModelOBJ::buildPositionStream()
+{
+    // Welds vertices with bitwise identical positions into a packed float3
+    // stream and remaps both index buffers onto it. Vertices that only
+    // differ in their texture coordinates or normals share a position, so
+    // the stream is usually much smaller than the vertex buffer. Passes that
+    // only need positions, e.g. shadow map and shadow volume rendering, draw
+    // from it to avoid fetching the full vertex.
+
+    int numVerts = static_cast<int>(m_vertexBuffer.size());
+    size_t capacity = HashTableCapacity(numVerts);
+    size_t mask = capacity - 1;
+    size_t slot = 0;
+    std::vector<int> table(capacity, -1);
+    std::vector<int> remap(numVerts);
+
+    m_positionBuffer.clear();
+    m_positionBuffer.reserve(numVerts * 3);
+
+    for (int i = 0; i < numVerts; ++i)
+    {
+        const float *pPosition = m_vertexBuffer[i].position;
+
+        for (slot = HashFloats(pPosition, 3) & mask; ; slot = (slot + 1) & mask)
+        {
+            if (table[slot] < 0)
+            {
+                table[slot] = static_cast<int>(m_positionBuffer.size()) / 3;
+                m_positionBuffer.insert(m_positionBuffer.end(), pPosition, pPosition + 3);
+                break;
+            }
+
+            if (memcmp(&m_positionBuffer[table[slot] * 3], pPosition, 3 * sizeof(float)) == 0)
+                break;
+        }
+
+        remap[i] = table[slot];
+    }
+
+    m_positionIndexBuffer.resize(m_indexBuffer.size());
+
+    for (size_t i = 0; i < m_indexBuffer.size(); ++i)
+        m_positionIndexBuffer[i] = remap[m_indexBuffer[i]];
+}
+
+void ModelOBJ::buildShortIndexBuffers()
+{
+    // Rebases the indices of every mesh that fits 16-bit indices onto its
+    // base vertex and base position. groupShortMeshes() put these meshes
+    // first, so the buffers only cover them.
+
+    m_shortIndexBuffer.assign(static_cast<size_t>(m_numberOfShortTriangles) * 3, 0);
+    m_shortPositionIndexBuffer.assign(static_cast<size_t>(m_numberOfShortPositionTriangles) * 3, 0);
+
+    for (int i = 0; i < m_numberOfMeshes; ++i)
+    {
+        const Mesh &mesh = m_meshes[i];
+        int start = mesh.startIndex;
+        int end = start + mesh.triangleCount * 3;
+
+        for (int j = start; mesh.shortIndices && j < end; ++j)
+            m_shortIndexBuffer[j] = static_cast<unsigned short>(m_pIndexBuffer[j] - mesh.baseVertex);
+
+        for (int j = start; mesh.shortPositions && j < end; ++j)
+            m_shortPositionIndexBuffer[j] = static_cast<unsigned short>(m_pPositionIndexBuffer[j] - mesh.basePosition);
+    }
+
+    m_pShortIndexBuffer = m_shortIndexBuffer.empty() ? 0 : &m_shortIndexBuffer[0];
+    m_pShortPositionIndexBuffer = m_shortPositionIndexBuffer.empty() ? 0 : &m_shortPositionIndexBuffer[0];
+}
+
+void ModelOBJ::buildHalfEdges(int threadCount)
+{
+    // Builds an index based half-edge structure over the position stream.
+    // Half-edge h runs from corner h to the next corner of triangle h / 3,
+    // so next, previous and origin (m_pPositionIndexBuffer[h]) need no
+    // storage. Only the twin of every half-edge and one outgoing half-edge
+    // of every position are kept, from which its fan of triangles can be
+    // walked. The adjacency buffers, rebuilt normals and the LODs are all
+    // derived from it. import() builds it when it needs either and releases
+    // it before returning; generateAdjacency() builds it again.
+    //
+    // Half-edges are matched into twins by turning each into a 64-bit key
+    // made of its two position indices and sorting the keys, which brings
+    // together the half-edges of each edge. Keys are partitioned on their top
+    // bits first so that the partitions can be sorted in parallel. An edge
+    // with exactly two half-edges running in opposite directions makes them
+    // twins; any other edge, non-manifold or inconsistently wound, is a
+    // boundary. The result doesn't depend on the number of threads.
+
+    if (m_hasHalfEdges)
+        return;
+
+    int numHalfEdges = m_numberOfTriangles * 3;
+    int keyBits = EdgeKeyBits(m_numberOfPositions);
+
+    int partitionBits = std::min(ADJACENCY_PARTITION_BITS, keyBits * 2);
+    int partitionShift = keyBits * 2 - partitionBits;
+    int numPartitions = 1 << partitionBits;
+
+    if (numHalfEdges < MIN_PARALLEL_ADJACENCY_EDGES)
+        threadCount = 1;
+    else
+        threadCount = ResolveThreadCount(threadCount);
+
+    std::vector<AdjacencyEdge> edges(numHalfEdges);
+    std::vector<AdjacencyEdge> partitioned(numHalfEdges);
+    std::vector<int> partitionOffsets(threadCount * numPartitions, 0);
+    std::vector<int> partitionStarts(numPartitions + 1, 0);
+    std::vector<int> boundaryEdges(threadCount, 0);
+    std::vector<int> nonManifoldEdges(threadCount, 0);
+
+    m_halfEdgeTwins.assign(numHalfEdges, -1);
+
+    // Generate the keys and count them in each partition.
+
+    ParallelFor(threadCount, m_numberOfTriangles, [&](int thread, int begin, int end)
+    {
+        int *pCounts = &partitionOffsets[thread * numPartitions];
+
+        for (int i = begin * 3; i < end * 3; ++i)
+        {
+            edges[i].key = MakeEdgeKey(m_pPositionIndexBuffer[i],
+                m_pPositionIndexBuffer[getNextHalfEdge(i)], keyBits);
+            edges[i].halfEdge = i;
+            ++pCounts[edges[i].key >> partitionShift];
+        }
+    });
+
+    // Turn the per thread counts into stable scatter offsets.
+
+    for (int p = 0, offset = 0; p < numPartitions; ++p)
+    {
+        partitionStarts[p] = offset;
+
+        for (int thread = 0; thread < threadCount; ++thread)
+        {
+            int count = partitionOffsets[thread * numPartitions + p];
+            partitionOffsets[thread * numPartitions + p] = offset;
+            offset += count;
+        }
+    }
+
+    partitionStarts[numPartitions] = numHalfEdges;
+
+    ParallelFor(threadCount, m_numberOfTriangles, [&](int thread, int begin, int end)
+    {
+        int *pOffsets = &partitionOffsets[thread * numPartitions];
+
+        for (int i = begin * 3; i < end * 3; ++i)
+            partitioned[pOffsets[edges[i].key >> partitionShift]++] = edges[i];
+    });
+
+    // Sort and match each partition. Equal keys never span partitions.
+
+    ParallelFor(threadCount, numPartitions, [&](int thread, int begin, int end)
+    {
+        for (int p = begin; p < end; ++p)
+        {
+            int first = partitionStarts[p];
+            int count = partitionStarts[p + 1] - first;
+
+            if (count == 0)
+                continue;
+
+            const AdjacencyEdge *pSorted = RadixSortEdges(&partitioned[first],
+                &edges[first], count, partitionShift);
+
+            for (int i = 0, j = 0; i < count; i = j)
+            {
+                j = i + 1;
+
+                while (j < count && pSorted[j].key == pSorted[i].key)
+                    ++j;
+
+                if (j - i == 1)
+                {
+                    ++boundaryEdges[thread];
+                }
+                else if (j - i > 2)
+                {
+                    ++nonManifoldEdges[thread];
+                }
+                else
+                {
+                    int a = pSorted[i].halfEdge;
+                    int b = pSorted[i + 1].halfEdge;
+
+                    if (m_pPositionIndexBuffer[a] != m_pPositionIndexBuffer[b])
+                    {
+                        m_halfEdgeTwins[a] = b;
+                        m_halfEdgeTwins[b] = a;
+                    }
+                }
+            }
+        }
+    });
+
+    // Overwritten rather than added to, the half-edges are built again each
+    // time generateAdjacency() needs them after import() released them.
+    m_importStatistics.boundaryEdges = 0;
+    m_importStatistics.nonManifoldEdges = 0;
+
+    for (int thread = 0; thread < threadCount; ++thread)
+    {
+        m_importStatistics.boundaryEdges += boundaryEdges[thread];
+        m_importStatistics.nonManifoldEdges += nonManifoldEdges[thread];
+    }
+
+    findPositionHalfEdges();
+    m_hasHalfEdges = true;
+}
+
+void ModelOBJ::findPositionHalfEdges()
+{
+    // Picks an outgoing half-edge for every position, preferring one without
+    // a twin. Walking a fan forward from there then visits all of it.
+
+    m_positionHalfEdges.assign(m_numberOfPositions, -1);
+
+    for (int i = 0; i < m_numberOfTriangles * 3; ++i)
+    {
+        int &start = m_positionHalfEdges[m_pPositionIndexBuffer[i]];
+
+        if (start < 0 || (m_halfEdgeTwins[i] < 0 && m_halfEdgeTwins[start] >= 0))
+            start = i;
+    }
+}
+
+void ModelOBJ::generateAdjacency(int threadCount)
+{
+    // Builds the GL_TRIANGLES_ADJACENCY index buffers from the half-edges.
+    // import() doesn't, so call this before drawing with them the first
+    // time. Every edge gets the corner opposite it in its twin's triangle. Edges
+    // without a twin get the triangle's own opposite corner, which the
+    // shadow volume shader treats as a silhouette.
+
+    if (m_hasAdjacency)
+        return;
+
+    bool builtHalfEdges = !m_hasHalfEdges;
+
+    buildHalfEdges(threadCount);
+
+    int numHalfEdges = m_numberOfTriangles * 3;
+
+    if (numHalfEdges < MIN_PARALLEL_ADJACENCY_EDGES)
+        threadCount = 1;
+    else
+        threadCount = ResolveThreadCount(threadCount);
+
+    m_indexBufferAdj.resize(static_cast<size_t>(numHalfEdges) * 2);
+    m_positionIndexBufferAdj.resize(m_indexBufferAdj.size());
+
+    ParallelFor(threadCount, m_numberOfTriangles, [&](int, int begin, int end)
+    {
+        for (int i = begin * 3; i < end * 3; ++i)
+        {
+            int twin = m_halfEdgeTwins[i];
+            int opposite = getPrevHalfEdge((twin >= 0) ? twin : i);
+
+            m_indexBufferAdj[i * 2] = m_pIndexBuffer[i];
+            m_indexBufferAdj[i * 2 + 1] = m_pIndexBuffer[opposite];
+            m_positionIndexBufferAdj[i * 2] = m_pPositionIndexBuffer[i];
+            m_positionIndexBufferAdj[i * 2 + 1] = m_pPositionIndexBuffer[opposite];
+        }
+    });
+
+    // Meshes with 16-bit position indices use them for adjacency too if the
+    // adjacent positions are within reach of the mesh's base position. The
+    // 16-bit buffer is only allocated if at least one mesh qualifies, and
+    // like the 16-bit position indices only covers the meshes that can.
+
+    int numShortMeshes = 0;
+
+    for (int i = 0; i < m_numberOfMeshes; ++i)
+    {
+        Mesh &mesh = m_meshes[i];
+        int start = mesh.startIndex * 2;
+        int end = start + mesh.triangleCount * 6;
+
+        mesh.shortAdjacency = mesh.shortPositions;
+
+        for (int j = start; mesh.shortAdjacency && j < end; ++j)
+        {
+            int offset = m_positionIndexBufferAdj[j] - mesh.basePosition;
+
+            mesh.shortAdjacency = offset >= 0 && offset < SHORT_INDEX_RANGE;
+        }
+
+        if (mesh.shortAdjacency)
+            ++numShortMeshes;
+    }
+
+    if (numShortMeshes > 0)
+        m_shortPositionIndexBufferAdj.assign(static_cast<size_t>(m_numberOfShortPositionTriangles) * 6, 0);
+
+    for (int i = 0; numShortMeshes > 0 && i < m_numberOfMeshes; ++i)
+    {
+        const Mesh &mesh = m_meshes[i];
+        int start = mesh.startIndex * 2;
+        int end = start + mesh.triangleCount * 6;
+
+        for (int j = start; mesh.shortAdjacency && j < end; ++j)
+            m_shortPositionIndexBufferAdj[j] = static_cast<unsigned short>(m_positionIndexBufferAdj[j] - mesh.basePosition);
+    }
+
+    m_pIndexBufferAdj = m_indexBufferAdj.empty() ? 0 : &m_indexBufferAdj[0];
+    m_pPositionIndexBufferAdj = m_positionIndexBufferAdj.empty() ? 0 : &m_positionIndexBufferAdj[0];
+    m_pShortPositionIndexBufferAdj = m_shortPositionIndexBufferAdj.empty() ? 0 : &m_shortPositionIndexBufferAdj[0];
+    m_hasAdjacency = true;
+
+    // Half-edges built just for the adjacency aren't kept either.
+    if (builtHalfEdges)
+        releaseHalfEdges();
+}
+
+void ModelOBJ::generateNormals(int threadCount)
+{
+    // Sums the area weighted face normals over the fan of triangles around
+    // every position, walked through the half-edges, so that vertices that
+    // only differ in their texture coordinates get the same normal and UV
+    // seams don't show. The walk stops at hard edges, where the vertices on
+    // either side don't share their normal, and those stay sharp. Models
+    // imported without normals have only zero normals and no hard edges.
+    // The fans of each position are walked by one thread, so the sums don't
+    // depend on the number of threads.
+
+    buildHalfEdges(threadCount);
+
+    int numHalfEdges = m_numberOfTriangles * 3;
+    std::vector<float> faceNormals(static_cast<size_t>(m_numberOfTriangles) * 3);
+    std::vector<float> normals(static_cast<size_t>(m_numberOfVertices) * 3, 0.0f);
+    std::vector<char> visited(numHalfEdges, 0);
+
+    threadCount = ResolveThreadCount(threadCount);
+
+    ParallelFor(threadCount, m_numberOfTriangles, [&](int, int begin, int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            const float *p0 = m_pVertexBuffer[m_pIndexBuffer[i * 3]].position;
+            const float *p1 = m_pVertexBuffer[m_pIndexBuffer[i * 3 + 1]].position;
+            const float *p2 = m_pVertexBuffer[m_pIndexBuffer[i * 3 + 2]].position;
+            float edge1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float edge2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float *pNormal = &faceNormals[i * 3];
+
+            pNormal[0] = (edge1[1] * edge2[2]) - (edge1[2] * edge2[1]);
+            pNormal[1] = (edge1[2] * edge2[0]) - (edge1[0] * edge2[2]);
+            pNormal[2] = (edge1[0] * edge2[1]) - (edge1[1] * edge2[0]);
+        }
+    });
+
+    // Whether the fan can go on from half-edge from to half-edge to, which
+    // leaves the same position: only if to is new and no hard edge is
+    // between them.
+    auto crosses = [&](int from, int to) -> bool
+    {
+        if (to < 0 || visited[to])
+            return false;
+
+        int v1 = m_pIndexBuffer[from];
+        int v2 = m_pIndexBuffer[to];
+
+        return v1 == v2 || memcmp(m_pVertexBuffer[v1].normal,
+            m_pVertexBuffer[v2].normal, sizeof(m_pVertexBuffer[v1].normal)) == 0;
+    };
+
+    // Walks the fan forward around the position start leaves and, if that
+    // ends at a boundary or hard edge, backward.
+    auto walkFan = [&](int start, std::vector<int> &fan)
+    {
+        float sum[3] = {0.0f, 0.0f, 0.0f};
+
+        fan.clear();
+
+        for (int i = start, next = start; next >= 0; )
+        {
+            i = next;
+            fan.push_back(i);
+            visited[i] = 1;
+
+            next = m_halfEdgeTwins[getPrevHalfEdge(i)];
+            next = crosses(i, next) ? next : -1;
+        }
+
+        for (int i = start, next = start; next >= 0; )
+        {
+            int twin = m_halfEdgeTwins[i];
+
+            next = (twin >= 0) ? getNextHalfEdge(twin) : -1;
+
+            if (!crosses(i, next))
+                break;
+
+            i = next;
+            fan.push_back(i);
+            visited[i] = 1;
+        }
+
+        for (size_t k = 0; k < fan.size(); ++k)
+        {
+            const float *pNormal = &faceNormals[fan[k] / 3 * 3];
+
+            sum[0] += pNormal[0];
+            sum[1] += pNormal[1];
+            sum[2] += pNormal[2];
+        }
+
+        float length = 1.0f / sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+
+        for (size_t k = 0; k < fan.size(); ++k)
+        {
+            float *pNormal = &normals[m_pIndexBuffer[fan[k]] * 3];
+
+            pNormal[0] = sum[0] * length;
+            pNormal[1] = sum[1] * length;
+            pNormal[2] = sum[2] * length;
+        }
+    };
+
+    // Every position's first fan, then any fans left over where a position
+    // has hard edges or where separate sheets of triangles touch.
+
+    ParallelFor(threadCount, m_numberOfPositions, [&](int, int begin, int end)
+    {
+        std::vector<int> fan;
+
+        for (int i = begin; i < end; ++i)
+        {
+            if (m_positionHalfEdges[i] >= 0)
+                walkFan(m_positionHalfEdges[i], fan);
+        }
+    });
+
+    std::vector<int> fan;
+
+    for (int i = 0; i < numHalfEdges; ++i)
+    {
+        if (!visited[i])
+            walkFan(i, fan);
+    }
+
+    for (int i = 0; i < m_numberOfVertices; ++i)
+        memcpy(m_pVertexBuffer[i].normal, &normals[i * 3], sizeof(m_pVertexBuffer[i].normal));
+
+    m_hasNormals = true;
+}
+
+void ModelOBJ::generateTangents(int threadCount)
+{
+    // import() doesn't build tangents, so call this before binding them the
+    // first time. Compact vertices have no room for them.
+
+    if (m_hasTangents || !m_pVertexBuffer)
+        return;
+
+    ComputeTangents(m_pVertexBuffer, getNumberOfVertices(), m_pIndexBuffer,
+        getNumberOfTriangles(), threadCount);
+
+    m_hasTangents = true;
+}
+
+std::vector<ModelOBJ::BufferUsage> ModelOBJ::memoryUsage() const
+{
+    // The bytes each buffer holds after import() released the parser's
+    // temporary ones. Vectors report their capacity. Buffers used in place
+    // from the cache file report the bytes mapped for them.
+
+    size_t numIndices = static_cast<size_t>(m_numberOfTriangles) * 3;
+    size_t numAdjIndices = m_hasAdjacency ? numIndices * 2 : 0;
+    size_t numShortIndices = static_cast<size_t>(m_numberOfShortTriangles) * 3;
+    size_t numShortPositionIndices = static_cast<size_t>(m_numberOfShortPositionTriangles) * 3;
+    std::vector<BufferUsage> usage;
+
+    AddBufferUsage(usage, "vertices", m_vertexBuffer, m_pVertexBuffer, m_numberOfVertices);
+    AddBufferUsage(usage, "compact vertices", m_compactVertexBuffer);
+    AddBufferUsage(usage, "indices", m_indexBuffer, m_pIndexBuffer, numIndices);
+    AddBufferUsage(usage, "positions", m_positionBuffer, m_pPositionBuffer, m_numberOfPositions * 3);
+    AddBufferUsage(usage, "position indices", m_positionIndexBuffer, m_pPositionIndexBuffer, numIndices);
+    AddBufferUsage(usage, "16-bit indices", m_shortIndexBuffer, m_pShortIndexBuffer, numShortIndices);
+    AddBufferUsage(usage, "16-bit position indices", m_shortPositionIndexBuffer, m_pShortPositionIndexBuffer, numShortPositionIndices);
+    AddBufferUsage(usage, "adjacency", m_indexBufferAdj, m_pIndexBufferAdj, numAdjIndices);
+    AddBufferUsage(usage, "position adjacency", m_positionIndexBufferAdj, m_pPositionIndexBufferAdj, numAdjIndices);
+    AddBufferUsage(usage, "16-bit position adjacency", m_shortPositionIndexBufferAdj, m_pShortPositionIndexBufferAdj,
+        m_pShortPositionIndexBufferAdj ? numShortPositionIndices * 2 : 0);
+    AddBufferUsage(usage, "LOD indices", m_lodIndexBuffer, m_pLodIndexBuffer, m_numberOfLodIndices);
+    AddBufferUsage(usage, "LOD position indices", m_lodPositionIndexBuffer, m_pLodPositionIndexBuffer, m_numberOfLodIndices);
+    AddBufferUsage(usage, "half-edge twins", m_halfEdgeTwins);
+    AddBufferUsage(usage, "position half-edges", m_positionHalfEdges);
+    AddBufferUsage(usage, "meshes", m_meshes);
+    AddBufferUsage(usage, "meshlets", m_meshlets);
+    AddBufferUsage(usage, "LOD meshes", m_lodMeshes);
+    AddBufferUsage(usage, "OBJ positions", m_vertexCoords);
+    AddBufferUsage(usage, "OBJ texture coordinates", m_textureCoords);
+    AddBufferUsage(usage, "OBJ normals", m_normals);
+    AddBufferUsage(usage, "material ids", m_attributeBuffer);
+    AddBufferUsage(usage, "vertex cache", m_vertexCache);
+
+    return usage;
+}
+
+void ModelOBJ::growVertexCache()
+{
+    std::vector<VertexCacheEntry> entries(m_vertexCache.size() * 2);
+    size_t mask = entries.size() - 1;
+    size_t slot = 0;
+
+    for (size_t i = 0; i < entries.size(); ++i)
+        entries[i].index = -1;
+
+    for (size_t i = 0; i < m_vertexCache.size(); ++i)
+    {
+        const VertexCacheEntry &entry = m_vertexCache[i];
+
+        if (entry.index < 0)
+            continue;
+
+        slot = HashIndices(entry.v, entry.vt, entry.vn) & mask;
+
+        while (entries[slot].index >= 0)
+            slot = (slot + 1) & mask;
+
+        entries[slot] = entry;
+    }
+
+    m_vertexCache.swap(entries);
+}
+
+void ModelOBJ::importGeometryFirstPass(FILE *pFile)
+{
+    m_hasTextureCoords = false;
+    m_hasNormals = false;
+
+    m_numberOfVertexCoords = 0;
+    m_numberOfTextureCoords = 0;
+    m_numberOfNormals = 0;
+    m_numberOfTriangles = 0;
+
+    int v = 0;
+    int vt = 0;
+    int vn = 0;
+    char buffer[256] = {0};
+    std::string name;
+
+    while (fscanf(pFile, "%s", buffer) != EOF)
+    {
+        switch (buffer[0])
+        {
+        case 'f':   // v, v//vn, v/vt, v/vt/vn.
+            fscanf(pFile, "%s", buffer);
+
+            if (strstr(buffer, "//")) // v//vn
+            {
+                sscanf(buffer, "%d//%d", &v, &vn);
+                fscanf(pFile, "%d//%d", &v, &vn);
+                fscanf(pFile, "%d//%d", &v, &vn);
+                ++m_numberOfTriangles;
+
+                while (fscanf(pFile, "%d//%d", &v, &vn) > 0)
+                    ++m_numberOfTriangles;
+            }
+            else if (sscanf(buffer, "%d/%d/%d", &v, &vt, &vn) == 3) // v/vt/vn
+            {
+                fscanf(pFile, "%d/%d/%d", &v, &vt, &vn);
+                fscanf(pFile, "%d/%d/%d", &v, &vt, &vn);
+                ++m_numberOfTriangles;
+
+                while (fscanf(pFile, "%d/%d/%d", &v, &vt, &vn) > 0)
+                    ++m_numberOfTriangles;
+            }
+            else if (sscanf(buffer, "%d/%d", &v, &vt) == 2) // v/vt
+            {
+                fscanf(pFile, "%d/%d", &v, &vt);
+                fscanf(pFile, "%d/%d", &v, &vt);
+                ++m_numberOfTriangles;
+
+                while (fscanf(pFile, "%d/%d", &v, &vt) > 0)
+                    ++m_numberOfTriangles;
+            }
+            else // v
+            {
+                fscanf(pFile, "%d", &v);
+                fscanf(pFile, "%d", &v);
+                ++m_numberOfTriangles;
+
+                while (fscanf(pFile, "%d", &v) > 0)
+                    ++m_numberOfTriangles;
+            }
+            break;
+
+        case 'm':   // mtllib
+            fgets(buffer, sizeof(buffer), pFile);
+            sscanf(buffer, "%s %s", buffer, buffer);
+            m_materialLibraries.push_back(buffer);
+            name = m_directoryPath;
+            name += buffer;
+            importMaterials(name.c_str());
+            break;
+
+        case 'v':   // v, vt, or vn
+            switch (buffer[1])
+            {
+            case '\0':
+                fgets(buffer, sizeof(buffer), pFile);
+                ++m_numberOfVertexCoords;
+                break;
+
+            case 'n':
+                fgets(buffer, sizeof(buffer), pFile);
+                ++m_numberOfNormals;
+                break;
+
+            case 't':
+                fgets(buffer, sizeof(buffer), pFile);
+                ++m_numberOfTextureCoords;
 
-    vertex.position[0] = m_vertexCoords[v2 * 3];
-    vertex.position[1] = m_vertexCoords[v2 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v2 * 3 + 2];
-    vertex.normal[0] = m_normals[vn2 * 3];
-    vertex.normal[1] = m_normals[vn2 * 3 + 1];
-    vertex.normal[2] = m_normals[vn2 * 3 + 2];
-    m_indexBuffer[index * 3 + 2] = addVertex(v2, &vertex);
-	addTriangleWithAdj(index, v0, v1, v2);
+            default:
+                break;
+            }
+            break;
+
+        default:
+            fgets(buffer, sizeof(buffer), pFile);
+            break;
+        }
+    }
+
+    m_hasPositions = m_numberOfVertexCoords > 0;
+    m_hasNormals = m_numberOfNormals > 0;
+    m_hasTextureCoords = m_numberOfTextureCoords > 0;
 }
 
-void ModelOBJ::addTrianglePosTexCoord(int index, int material, int v0, int v1,
-                                      int v2, int vt0, int vt1, int vt2)
+void ModelOBJ::importGeometrySecondPass(FILE *pFile, ImportChunk &chunk)
 {
-    Vertex vertex =
+    // Reads the vertex attributes and faces into a single import chunk, the
+    // same as the memory mapped importer, so that buildTriangles() can be
+    // shared by both importers.
+
+    int v[3] = {0};
+    int vt[3] = {0};
+    int vn[3] = {0};
+    float value[3] = {0.0f};
+    int activeSlot = -1;
+    char buffer[256] = {0};
+    ObjTriangle triangle;
+    std::map<std::string, int> materialSlots;
+    std::map<std::string, int>::const_iterator iter;
+
+    chunk.vertexCoords.reserve(m_numberOfVertexCoords * 3);
+    chunk.textureCoords.reserve(m_numberOfTextureCoords * 2);
+    chunk.normals.reserve(m_numberOfNormals * 3);
+    chunk.triangles.reserve(m_numberOfTriangles);
+
+    while (fscanf(pFile, "%s", buffer) != EOF)
+    {
+        switch (buffer[0])
+        {
+        case 'f': // v, v//vn, v/vt, or v/vt/vn.
+            v[0]  = v[1]  = v[2]  = 0;
+            vt[0] = vt[1] = vt[2] = 0;
+            vn[0] = vn[1] = vn[2] = 0;
+
+            triangle.materialSlot = activeSlot;
+            triangle.relative = 0;
+
+            fscanf(pFile, "%s", buffer);
+
+            if (strstr(buffer, "//")) // v//vn
+            {
+                sscanf(buffer, "%d//%d", &v[0], &vn[0]);
+                fscanf(pFile, "%d//%d", &v[1], &vn[1]);
+                fscanf(pFile, "%d//%d", &v[2], &vn[2]);
+
+                triangle.format = FACE_POS_NORMAL;
+                chunk.resolveIndices(triangle, 0, v[0], vt[0], vn[0]);
+                chunk.resolveIndices(triangle, 1, v[1], vt[1], vn[1]);
+                chunk.resolveIndices(triangle, 2, v[2], vt[2], vn[2]);
+                chunk.triangles.push_back(triangle);
+
+                while (fscanf(pFile, "%d//%d", &v[2], &vn[2]) > 0)
+                {
+                    triangle.shiftFanCorner();
+                    chunk.resolveIndices(triangle, 2, v[2], vt[2], vn[2]);
+                    chunk.triangles.push_back(triangle);
+                }
+            }
+            else if (sscanf(buffer, "%d/%d/%d", &v[0], &vt[0], &vn[0]) == 3) // v/vt/vn
+            {
+                fscanf(pFile, "%d/%d/%d", &v[1], &vt[1], &vn[1]);
+                fscanf(pFile, "%d/%d/%d", &v[2], &vt[2], &vn[2]);
+
+                triangle.format = FACE_POS_TEXCOORD_NORMAL;
+                chunk.resolveIndices(triangle, 0, v[0], vt[0], vn[0]);
+                chunk.resolveIndices(triangle, 1, v[1], vt[1], vn[1]);
+                chunk.resolveIndices(triangle, 2, v[2], vt[2], vn[2]);
+                chunk.triangles.push_back(triangle);
+
+                while (fscanf(pFile, "%d/%d/%d", &v[2], &vt[2], &vn[2]) > 0)
+                {
+                    triangle.shiftFanCorner();
+                    chunk.resolveIndices(triangle, 2, v[2], vt[2], vn[2]);
+                    chunk.triangles.push_back(triangle);
+                }
+            }
+            else if (sscanf(buffer, "%d/%d", &v[0], &vt[0]) == 2) // v/vt
+            {
+                fscanf(pFile, "%d/%d", &v[1], &vt[1]);
+                fscanf(pFile, "%d/%d", &v[2], &vt[2]);
+
+                triangle.format = FACE_POS_TEXCOORD;
+                chunk.resolveIndices(triangle, 0, v[0], vt[0], vn[0]);
+                chunk.resolveIndices(triangle, 1, v[1], vt[1], vn[1]);
+                chunk.resolveIndices(triangle, 2, v[2], vt[2], vn[2]);
+                chunk.triangles.push_back(triangle);
+
+                while (fscanf(pFile, "%d/%d", &v[2], &vt[2]) > 0)
+                {
+                    triangle.shiftFanCorner();
+                    chunk.resolveIndices(triangle, 2, v[2], vt[2], vn[2]);
+                    chunk.triangles.push_back(triangle);
+                }
+            }
+            else // v
+            {
+                sscanf(buffer, "%d", &v[0]);
+                fscanf(pFile, "%d", &v[1]);
+                fscanf(pFile, "%d", &v[2]);
+
+                triangle.format = FACE_POS;
+                chunk.resolveIndices(triangle, 0, v[0], vt[0], vn[0]);
+                chunk.resolveIndices(triangle, 1, v[1], vt[1], vn[1]);
+                chunk.resolveIndices(triangle, 2, v[2], vt[2], vn[2]);
+                chunk.triangles.push_back(triangle);
+
+                while (fscanf(pFile, "%d", &v[2]) > 0)
+                {
+                    triangle.shiftFanCorner();
+                    chunk.resolveIndices(triangle, 2, v[2], vt[2], vn[2]);
+                    chunk.triangles.push_back(triangle);
+                }
+            }
+            break;
+
+        case 'u': // usemtl
+            fgets(buffer, sizeof(buffer), pFile);
+            sscanf(buffer, "%s %s", buffer, buffer);
+            iter = materialSlots.find(buffer);
+
+            if (iter == materialSlots.end())
+            {
+                activeSlot = static_cast<int>(chunk.materialNames.size());
+                chunk.materialNames.push_back(buffer);
+                materialSlots[buffer] = activeSlot;
+            }
+            else
+            {
+                activeSlot = iter->second;
+            }
+            break;
+
+        case 'v': // v, vn, or vt.
+            value[0] = value[1] = value[2] = 0.0f;
+
+            switch (buffer[1])
+            {
+            case '\0': // v
+                fscanf(pFile, "%f %f %f", &value[0], &value[1], &value[2]);
+                chunk.vertexCoords.insert(chunk.vertexCoords.end(), value, value + 3);
+                break;
+
+            case 'n': // vn
+                fscanf(pFile, "%f %f %f", &value[0], &value[1], &value[2]);
+                chunk.normals.insert(chunk.normals.end(), value, value + 3);
+                break;
+
+            case 't': // vt
+                fscanf(pFile, "%f %f", &value[0], &value[1]);
+                chunk.textureCoords.insert(chunk.textureCoords.end(), value, value + 2);
+                break;
+
+            default:
+                break;
+            }
+            break;
+
+        default:
+            fgets(buffer, sizeof(buffer), pFile);
+            break;
+        }
+    }
+
+    chunk.activeSlot = activeSlot;
+}
+
+bool ModelOBJ::importGeometryMapped(const char *pszFilename, const ImportOptions &options)
+{
+    MappedFile file;
+
+    if (!file.open(pszFilename))
+        return importGeometryStream(pszFilename, options);
+
+    const char *pData = file.getData();
+    size_t size = file.getSize();
+
+    // Compressed files and empty mappings (e.g. of a named pipe) are read
+    // through the stream importer instead.
+
+    if (size < 2 || (static_cast<unsigned char>(pData[0]) == 0x1f &&
+        static_cast<unsigned char>(pData[1]) == 0x8b))
+    {
+        file.close();
+        return importGeometryStream(pszFilename, options);
+    }
+
+    if (m_pProgress)
+        m_pProgress->totalBytes = static_cast<long long>(size);
+
+    // Split the file into line aligned chunks, one per thread. Small files
+    // aren't worth the thread start up costs and are parsed in one chunk.
+
+    size_t maxChunks = std::max(static_cast<size_t>(1), size / MIN_IMPORT_CHUNK_SIZE);
+    int numChunks = static_cast<int>(std::min(static_cast<size_t>(ResolveThreadCount(options.threadCount)), maxChunks));
+
+    std::vector<ImportChunk> chunks(numChunks);
+    std::vector<const char *> bounds(numChunks + 1, pData + size);
+
+    bounds[0] = pData;
+
+    for (int i = 1; i < numChunks; ++i)
+    {
+        const char *pSplit = std::max(bounds[i - 1], pData + size / numChunks * i);
+        bounds[i] = SkipLine(pSplit, pData + size);
+    }
+
+    if (numChunks == 1)
+    {
+        parseGeometry(bounds[0], bounds[1], chunks[0]);
+    }
+    else
+    {
+        std::vector<std::thread> workers;
+
+        for (int i = 1; i < numChunks; ++i)
+        {
+            workers.push_back(std::thread(&ModelOBJ::parseGeometry, this,
+                bounds[i], bounds[i + 1], std::ref(chunks[i])));
+        }
+
+        parseGeometry(bounds[0], bounds[1], chunks[0]);
+
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+    }
+
+    file.close();
+
+    if (!finishGeometryImport(chunks, options))
+    {
+        fprintf(stderr, "%s: face index out of range.\n", pszFilename);
+        return false;
+    }
+
+    return true;
+}
+
+bool ModelOBJ::importGeometryStream(const char *pszFilename, const ImportOptions &options)
+{
+    // Single pass importer for sources that can't be memory mapped: gzip
+    // compressed files, pipes and stdin. Every line aligned block of the
+    // stream is parsed as a chunk of its own, see ReadLineBlocks().
+
+    InputStream stream;
+
+    if (!stream.open(pszFilename))
+        return false;
+
+    if (m_pProgress)
+        m_pProgress->totalBytes = stream.getSize();
+
+    // The worker thread appends the chunks. Only one block is parsed at a
+    // time, so this doesn't race with anything.
+
+    std::deque<ImportChunk> blocks;
+
+    ReadLineBlocks(stream, ResolveThreadCount(options.threadCount) > 1,
+        [&](const char *pBegin, const char *pEnd)
+        {
+            blocks.push_back(ImportChunk());
+            parseGeometry(pBegin, pEnd, blocks.back());
+        },
+        std::function<void()>());
+
+    bool error = stream.hasError();
+    stream.close();
+
+    if (error)
+    {
+        fprintf(stderr, "%s: read error or corrupt compressed data.\n", pszFilename);
+        return false;
+    }
+
+    std::vector<ImportChunk> chunks(blocks.size());
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+        std::swap(chunks[i], blocks[i]);
+
+    blocks.clear();
+
+    if (chunks.empty())
+        chunks.resize(1);
+
+    if (!finishGeometryImport(chunks, options))
+    {
+        fprintf(stderr, "%s: face index out of range.\n", pszFilename);
+        return false;
+    }
+
+    return true;
+}
+
+bool ModelOBJ::finishGeometryImport(std::vector<ImportChunk> &chunks, const ImportOptions &options)
+{
+    // Load the material libraries in the order they were referenced.
+
+    std::vector<std::string> materialNames;
+    std::string name;
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        for (size_t j = 0; j < chunks[i].materialLibraries.size(); ++j)
+        {
+            m_materialLibraries.push_back(chunks[i].materialLibraries[j]);
+            name = m_directoryPath;
+            name += chunks[i].materialLibraries[j];
+            importMaterials(name.c_str());
+        }
+    }
+
+    if (!mergeChunks(chunks, materialNames))
+        return false;
+
+    weldAttributes(chunks, options);
+    setImportStage(ImportProgress::STAGE_BUILDING_TRIANGLES);
+    buildTriangles(chunks, materialNames);
+    return true;
+}
+
+bool ModelOBJ::importOutOfCore(const char *pszFilename, const ImportOptions &options)
+{
+    // Imports models larger than memory into a cache file. Only the parse
+    // blocks, the material tables and the sort buffers are held in memory:
+    //
+    // 1. The file is parsed block by block like in importGeometryStream().
+    //    The attributes and triangles of every block are appended to
+    //    temporary files, with the same offsetting and material slot
+    //    remapping as mergeChunks().
+    // 2. The attribute files are memory mapped and every triangle corner
+    //    becomes a record of its vertex data and its position in the index
+    //    buffer, whose triangles are sorted by material like
+    //    sortTrianglesByMaterial() does. An external sort on the vertex data
+    //    brings equal vertices together, and with them equal positions; the
+    //    sorted records number the unique vertices and positions.
+    // 3. A second external sort on the index buffer position writes the
+    //    index buffers, and a third one on the edges matches the triangles
+    //    on each edge for the adjacency buffers, as generateAdjacency() does
+    //    in memory.
+    //
+    // The vertex, index and adjacency buffers are written straight into a
+    // memory mapped cache file under a temporary name, which is then loaded
+    // with loadCache(). The sort buffers stay within
+    // ImportOptions::outOfCoreMemory.
+    //
+    // This import skips the triangle order optimization, meshlets, LODs,
+    // welding and the 16-bit index buffers, so every mesh is drawn with
+    // 32-bit indices, and rebuilds normals per vertex rather than across UV
+    // seams. Unlike the in-memory importers, vertices are welded on their
+    // data rather than on their OBJ indices and are numbered in sort order.
+
+    if (strcmp(pszFilename, "-") == 0)
+    {
+        fprintf(stderr, "Out-of-core import needs a file name to write the cache to.\n");
+        return false;
+    }
+
+    std::string cacheFilename = pszFilename;
+
+    cacheFilename += CACHE_FILE_EXTENSION;
+
+    std::string tempFilename = TemporaryFilename(cacheFilename);
+    size_t sortMemory = std::max(options.outOfCoreMemory / 2, static_cast<size_t>(1 << 20));
+
+    InputStream stream;
+
+    if (!stream.open(pszFilename))
+        return false;
+
+    if (m_pProgress)
+        m_pProgress->totalBytes = stream.getSize();
+
+    // 1. Spill the parsed blocks to disk.
+
+    TempFile positionFile;
+    TempFile texCoordFile;
+    TempFile normalFile;
+    TempFile triangleFile;
+
+    if (!positionFile.open(tempFilename + ".v") || !texCoordFile.open(tempFilename + ".vt") ||
+        !normalFile.open(tempFilename + ".vn") || !triangleFile.open(tempFilename + ".f"))
+    {
+        fprintf(stderr, "%s: can't create temporary files.\n", tempFilename.c_str());
+        return false;
+    }
+
+    ImportChunk chunk;
+    std::vector<SpilledTriangle> triangles;
+    std::vector<std::string> materialNames;
+    std::map<std::string, int> materialSlots;
+    std::map<std::string, int>::const_iterator iter;
+    std::vector<long long> slotTriangles(1, 0);     // per slot + 1
+    std::vector<int> slotMap;
+    int inheritedSlot = -1;
+    int vertexBase = 0;
+    int texCoordBase = 0;
+    int normalBase = 0;
+    long long numTriangles = 0;
+
+    ReadLineBlocks(stream, ResolveThreadCount(options.threadCount) > 1,
+        [&](const char *pBegin, const char *pEnd)
+        {
+            parseGeometry(pBegin, pEnd, chunk);
+        },
+        [&]()
+        {
+            slotMap.resize(chunk.materialNames.size());
+
+            for (size_t i = 0; i < chunk.materialNames.size(); ++i)
+            {
+                iter = materialSlots.find(chunk.materialNames[i]);
+
+                if (iter == materialSlots.end())
+                {
+                    slotMap[i] = static_cast<int>(materialNames.size());
+                    materialSlots[chunk.materialNames[i]] = slotMap[i];
+                    materialNames.push_back(chunk.materialNames[i]);
+                    slotTriangles.push_back(0);
+                }
+                else
+                {
+                    slotMap[i] = iter->second;
+                }
+            }
+
+            triangles.resize(chunk.triangles.size());
+
+            for (size_t i = 0; i < chunk.triangles.size(); ++i)
+            {
+                const ObjTriangle &t = chunk.triangles[i];
+                SpilledTriangle &spilled = triangles[i];
+                bool hasTexCoords = t.format == FACE_POS_TEXCOORD || t.format == FACE_POS_TEXCOORD_NORMAL;
+                bool hasNormals = t.format == FACE_POS_NORMAL || t.format == FACE_POS_TEXCOORD_NORMAL;
+
+                spilled.materialSlot = (t.materialSlot < 0) ? inheritedSlot : slotMap[t.materialSlot];
+                ++slotTriangles[spilled.materialSlot + 1];
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    spilled.v[k] = t.v[k] + ((t.relative & (RELATIVE_V << k)) ? vertexBase : 0);
+                    spilled.vt[k] = !hasTexCoords ? -1 :
+                        t.vt[k] + ((t.relative & (RELATIVE_VT << k)) ? texCoordBase : 0);
+                    spilled.vn[k] = !hasNormals ? -1 :
+                        t.vn[k] + ((t.relative & (RELATIVE_VN << k)) ? normalBase : 0);
+                }
+            }
+
+            if (chunk.activeSlot >= 0)
+                inheritedSlot = slotMap[chunk.activeSlot];
+
+            m_materialLibraries.insert(m_materialLibraries.end(),
+                chunk.materialLibraries.begin(), chunk.materialLibraries.end());
+
+            if (!chunk.vertexCoords.empty())
+                positionFile.write(&chunk.vertexCoords[0], chunk.vertexCoords.size() * sizeof(float));
+
+            if (!chunk.textureCoords.empty())
+                texCoordFile.write(&chunk.textureCoords[0], chunk.textureCoords.size() * sizeof(float));
+
+            if (!chunk.normals.empty())
+                normalFile.write(&chunk.normals[0], chunk.normals.size() * sizeof(float));
+
+            if (!triangles.empty())
+                triangleFile.write(&triangles[0], triangles.size() * sizeof(SpilledTriangle));
+
+            vertexBase += static_cast<int>(chunk.vertexCoords.size() / 3);
+            texCoordBase += static_cast<int>(chunk.textureCoords.size() / 2);
+            normalBase += static_cast<int>(chunk.normals.size() / 3);
+            numTriangles += static_cast<long long>(triangles.size());
+
+            chunk = ImportChunk();
+        });
+
+    bool error = stream.hasError();
+    stream.close();
+
+    if (error)
+    {
+        fprintf(stderr, "%s: read error or corrupt compressed data.\n", pszFilename);
+        return false;
+    }
+
+    if (!positionFile.close() || !texCoordFile.close() || !normalFile.close() ||
+        triangleFile.hasError())
+    {
+        fprintf(stderr, "%s: can't write temporary files.\n", tempFilename.c_str());
+        return false;
+    }
+
+    // Every triangle has six adjacency indices, which must fit in an int.
+    if (numTriangles > std::numeric_limits<int>::max() / 6)
     {
-        0.0f, 0.0f, 0.0f,
-        0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f
-    };
+        fprintf(stderr, "%s: too many triangles.\n", pszFilename);
+        return false;
+    }
 
-    m_attributeBuffer[index] = material;
+    setImportStage(ImportProgress::STAGE_BUILDING_TRIANGLES);
 
-    vertex.position[0] = m_vertexCoords[v0 * 3];
-    vertex.position[1] = m_vertexCoords[v0 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v0 * 3 + 2];
-    vertex.texCoord[0] = m_textureCoords[vt0 * 2];
-    vertex.texCoord[1] = m_textureCoords[vt0 * 2 + 1];
-    m_indexBuffer[index * 3] = addVertex(v0, &vertex);
+    for (size_t i = 0; i < m_materialLibraries.size(); ++i)
+        importMaterials((m_directoryPath + m_materialLibraries[i]).c_str());
 
-    vertex.position[0] = m_vertexCoords[v1 * 3];
-    vertex.position[1] = m_vertexCoords[v1 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v1 * 3 + 2];
-    vertex.texCoord[0] = m_textureCoords[vt1 * 2];
-    vertex.texCoord[1] = m_textureCoords[vt1 * 2 + 1];
-    m_indexBuffer[index * 3 + 1] = addVertex(v1, &vertex);
+    if (m_numberOfMaterials == 0)
+        addDefaultMaterial();
 
-    vertex.position[0] = m_vertexCoords[v2 * 3];
-    vertex.position[1] = m_vertexCoords[v2 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v2 * 3 + 2];
-    vertex.texCoord[0] = m_textureCoords[vt2 * 2];
-    vertex.texCoord[1] = m_textureCoords[vt2 * 2 + 1];
-    m_indexBuffer[index * 3 + 2] = addVertex(v2, &vertex);
-	addTriangleWithAdj(index, v0, v1, v2);
-}
+    // Map the usemtl slots to materials, unknown ones and faces before the
+    // first usemtl to material 0, and find where each material's triangles
+    // start in the material sorted index buffer.
 
-void ModelOBJ::addTrianglePosTexCoordNormal(int index, int material, int v0,
-                                            int v1, int v2, int vt0, int vt1,
-                                            int vt2, int vn0, int vn1, int vn2)
-{
-    Vertex vertex =
+    std::vector<int> slotMaterials(slotTriangles.size(), 0);
+    std::vector<int> nextTriangle(m_numberOfMaterials + 1, 0);
+
+    for (size_t i = 0; i < materialNames.size(); ++i)
     {
-        0.0f, 0.0f, 0.0f,
-        0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f
-    };
+        iter = m_materialCache.find(materialNames[i]);
 
-    m_attributeBuffer[index] = material;
+        if (iter != m_materialCache.end())
+            slotMaterials[i + 1] = iter->second;
+    }
 
-    vertex.position[0] = m_vertexCoords[v0 * 3];
-    vertex.position[1] = m_vertexCoords[v0 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v0 * 3 + 2];
-    vertex.texCoord[0] = m_textureCoords[vt0 * 2];
-    vertex.texCoord[1] = m_textureCoords[vt0 * 2 + 1];
-    vertex.normal[0] = m_normals[vn0 * 3];
-    vertex.normal[1] = m_normals[vn0 * 3 + 1];
-    vertex.normal[2] = m_normals[vn0 * 3 + 2];
-    m_indexBuffer[index * 3] = addVertex(v0, &vertex);
+    for (size_t i = 0; i < slotTriangles.size(); ++i)
+        nextTriangle[slotMaterials[i] + 1] += static_cast<int>(slotTriangles[i]);
 
-    vertex.position[0] = m_vertexCoords[v1 * 3];
-    vertex.position[1] = m_vertexCoords[v1 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v1 * 3 + 2];
-    vertex.texCoord[0] = m_textureCoords[vt1 * 2];
-    vertex.texCoord[1] = m_textureCoords[vt1 * 2 + 1];
-    vertex.normal[0] = m_normals[vn1 * 3];
-    vertex.normal[1] = m_normals[vn1 * 3 + 1];
-    vertex.normal[2] = m_normals[vn1 * 3 + 2];
-    m_indexBuffer[index * 3 + 1] = addVertex(v1, &vertex);
+    m_numberOfTriangles = static_cast<int>(numTriangles);
+    m_numberOfMeshes = 0;
 
-    vertex.position[0] = m_vertexCoords[v2 * 3];
-    vertex.position[1] = m_vertexCoords[v2 * 3 + 1];
-    vertex.position[2] = m_vertexCoords[v2 * 3 + 2];
-    vertex.texCoord[0] = m_textureCoords[vt2 * 2];
-    vertex.texCoord[1] = m_textureCoords[vt2 * 2 + 1];
-    vertex.normal[0] = m_normals[vn2 * 3];
-    vertex.normal[1] = m_normals[vn2 * 3 + 1];
-    vertex.normal[2] = m_normals[vn2 * 3 + 2];
-    m_indexBuffer[index * 3 + 2] = addVertex(v2, &vertex);
-	addTriangleWithAdj(index, v0, v1, v2);
-}
+    for (int i = 0; i < m_numberOfMaterials; ++i)
+    {
+        if (nextTriangle[i + 1] > 0)
+        {
+            Mesh mesh;
+
+            mesh.startIndex = nextTriangle[i] * 3;
+            mesh.triangleCount = nextTriangle[i + 1];
+            mesh.pMaterial = &m_materials[i];
+            mesh.baseVertex = 0;
+            mesh.basePosition = 0;
+            mesh.shortIndices = false;
+            mesh.shortPositions = false;
+            mesh.shortAdjacency = false;
+            mesh.startMeshlet = 0;
+            mesh.meshletCount = 0;
+            m_meshes.push_back(mesh);
+        }
 
-int ModelOBJ::addVertex(int hash, const Vertex *pVertex)
-{
-    int index = -1;
-	std::map<int, std::vector<int> >::const_iterator iter = m_vertexCache.find(hash);
+        nextTriangle[i + 1] += nextTriangle[i];
+    }
 
-    if (iter == m_vertexCache.end())
-    {
-        // Vertex hash doesn't exist in the cache.
+    m_numberOfMeshes = static_cast<int>(m_meshes.size());
+    std::sort(m_meshes.begin(), m_meshes.end(), MeshCompFunc);
 
-        index = static_cast<int>(m_vertexBuffer.size());
-        m_vertexBuffer.push_back(*pVertex);
-        m_vertexCache.insert(std::make_pair(hash, std::vector<int>(1, index)));
+    m_numberOfVertexCoords = vertexBase;
+    m_numberOfTextureCoords = texCoordBase;
+    m_numberOfNormals = normalBase;
+    m_hasPositions = m_numberOfVertexCoords > 0;
+    m_hasTextureCoords = m_numberOfTextureCoords > 0;
+    m_hasNormals = m_numberOfNormals > 0;
+
+    // 2. Turn the triangle corners into vertex records, reading the
+    // attributes from the mapped temporary files.
+
+    MappedFile positionMap;
+    MappedFile texCoordMap;
+    MappedFile normalMap;
+
+    if (!positionMap.open(positionFile.getFilename().c_str()) ||
+        !texCoordMap.open(texCoordFile.getFilename().c_str()) ||
+        !normalMap.open(normalFile.getFilename().c_str()))
+    {
+        fprintf(stderr, "%s: can't map temporary files.\n", tempFilename.c_str());
+        return false;
     }
-    else
+
+    const float *pPositions = reinterpret_cast<const float *>(positionMap.getData());
+    const float *pTexCoords = reinterpret_cast<const float *>(texCoordMap.getData());
+    const float *pNormals = reinterpret_cast<const float *>(normalMap.getData());
+
+    ExternalSorter<CornerRecord, CornerRecordLess> corners(tempFilename + ".corners", sortMemory);
+    ExternalSorter<IndexRecord, IndexRecordLess> indices(tempFilename + ".indices", sortMemory);
+    ExternalSorter<EdgeRecord, EdgeRecordLess> edges(tempFilename + ".edges", sortMemory);
+    ExternalSorter<IndexRecord, IndexRecordLess> adjacent(tempFilename + ".adjacent", sortMemory);
+    const size_t TRIANGLES_PER_READ = 1 << 16;
+    int previousMaterial = -1;
+    bool valid = triangleFile.seek(0);
+
+    triangles.resize(TRIANGLES_PER_READ);
+
+    for (long long read = 0; valid && read < numTriangles; )
     {
-        // One or more vertices have been hashed to this entry in the cache.
+        size_t count = static_cast<size_t>(std::min(numTriangles - read,
+            static_cast<long long>(TRIANGLES_PER_READ)));
+
+        if (triangleFile.read(&triangles[0], count * sizeof(SpilledTriangle)) != count * sizeof(SpilledTriangle))
+        {
+            valid = false;
+            break;
+        }
 
-        const std::vector<int> &vertices = iter->second;
-        const Vertex *pCachedVertex = 0;
-        bool found = false;
+        read += static_cast<long long>(count);
 
-        for (std::vector<int>::const_iterator i = vertices.begin(); i != vertices.end(); ++i)
+        for (size_t i = 0; valid && i < count; ++i)
         {
-            index = *i;
-            pCachedVertex = &m_vertexBuffer[index];
+            const SpilledTriangle &t = triangles[i];
+            int material = slotMaterials[t.materialSlot + 1];
+            int triangle = nextTriangle[material]++;
 
-            if (memcmp(pCachedVertex, pVertex, sizeof(Vertex)) == 0)
+            if (material != previousMaterial)
             {
-                found = true;
-                break;
+                ++m_importStatistics.materialRuns;
+                previousMaterial = material;
             }
-        }
 
-        if (!found)
-        {
-            index = static_cast<int>(m_vertexBuffer.size());
-            m_vertexBuffer.push_back(*pVertex);
-            m_vertexCache[hash].push_back(index);
+            for (int k = 0; k < 3; ++k)
+            {
+                CornerRecord record;
+
+                if (t.v[k] < 0 || t.v[k] >= m_numberOfVertexCoords ||
+                    t.vt[k] >= m_numberOfTextureCoords || t.vn[k] >= m_numberOfNormals)
+                {
+                    valid = false;
+                    break;
+                }
+
+                memcpy(record.attributes, &pPositions[t.v[k] * 3], 3 * sizeof(float));
+
+                if (t.vt[k] >= 0)
+                    memcpy(record.attributes + 3, &pTexCoords[t.vt[k] * 2], 2 * sizeof(float));
+                else
+                    record.attributes[3] = record.attributes[4] = 0.0f;
+
+                if (t.vn[k] >= 0)
+                    memcpy(record.attributes + 5, &pNormals[t.vn[k] * 3], 3 * sizeof(float));
+                else
+                    record.attributes[5] = record.attributes[6] = record.attributes[7] = 0.0f;
+
+                record.corner = triangle * 3 + k;
+                corners.add(record);
+            }
         }
     }
 
-    return index;
-}
+    std::vector<SpilledTriangle>().swap(triangles);
+    positionMap.close();
+    texCoordMap.close();
+    normalMap.close();
+    positionFile.remove();
+    texCoordFile.remove();
+    normalFile.remove();
+    triangleFile.remove();
 
-void ModelOBJ::buildMeshes()
-{
-    // Group the model's triangles based on material type.
+    if (!valid)
+    {
+        fprintf(stderr, "%s: face index out of range or temporary file read error.\n", pszFilename);
+        return false;
+    }
 
-    Mesh *pMesh = 0;
-    int materialId = -1;
-    int numMeshes = 0;
+    m_importStatistics.materialBatches = m_numberOfMeshes;
 
-    // Count the number of meshes.
-    for (int i = 0; i < static_cast<int>(m_attributeBuffer.size()); ++i)
+    // Count the unique vertices and positions to size the cache file.
+
+    CornerRecord previous;
+    long long numVertices = 0;
+    long long numPositions = 0;
+
+    valid = corners.merge([&](const CornerRecord &record)
     {
-        if (m_attributeBuffer[i] != materialId)
+        if (numVertices == 0 || memcmp(record.attributes, previous.attributes, 3 * sizeof(float)) != 0)
         {
-            materialId = m_attributeBuffer[i];
-            ++numMeshes;
+            ++numPositions;
+            ++numVertices;
+        }
+        else if (memcmp(record.attributes + 3, previous.attributes + 3, 5 * sizeof(float)) != 0)
+        {
+            ++numVertices;
         }
+
+        previous = record;
+    });
+
+    m_numberOfVertices = static_cast<int>(numVertices);
+    m_numberOfPositions = static_cast<int>(numPositions);
+    m_hasAdjacency = true;
+    m_normalsRebuilt = options.rebuildNormals;
+    m_importStatistics.uniqueVertices = m_numberOfVertices;
+
+    // Create the cache file and point the model's buffers into it. The new
+    // file is all zeros, which is what the tangents have to be. No mesh uses
+    // 16-bit indices, so their buffers are empty.
+
+    CacheLayout layout;
+    MappedFile output;
+
+    layoutCache(layout);
+
+    if (!valid || !output.create(tempFilename.c_str(), static_cast<size_t>(layout.header.fileSize)))
+    {
+        fprintf(stderr, "%s: can't create the cache file.\n", tempFilename.c_str());
+        remove(tempFilename.c_str());
+        return false;
     }
 
-    // Allocate memory for the meshes and reset counters.
-    m_numberOfMeshes = numMeshes;
-    m_meshes.resize(m_numberOfMeshes);
-    numMeshes = 0;
-    materialId = -1;
+    char *pData = output.getMutableData();
 
-    // Build the meshes. One mesh for each unique material.
-    for (int i = 0; i < static_cast<int>(m_attributeBuffer.size()); ++i)
+    m_pVertexBuffer = reinterpret_cast<Vertex *>(pData + layout.header.vertexOffset);
+    m_pIndexBuffer = reinterpret_cast<int *>(pData + layout.header.indexOffset);
+    m_pPositionBuffer = reinterpret_cast<float *>(pData + layout.header.positionOffset);
+    m_pPositionIndexBuffer = reinterpret_cast<int *>(pData + layout.header.positionIndexOffset);
+    m_pIndexBufferAdj = reinterpret_cast<int *>(pData + layout.header.adjacencyOffset);
+    m_pPositionIndexBufferAdj = reinterpret_cast<int *>(pData + layout.header.positionAdjacencyOffset);
+
+    // Write the unique vertices and positions and record which ones every
+    // corner uses.
+
+    int vertex = -1;
+    int position = -1;
+
+    valid = corners.merge([&](const CornerRecord &record)
     {
-        if (m_attributeBuffer[i] != materialId)
+        bool newPosition = position < 0 ||
+            memcmp(record.attributes, previous.attributes, 3 * sizeof(float)) != 0;
+
+        if (newPosition || memcmp(record.attributes + 3, previous.attributes + 3, 5 * sizeof(float)) != 0)
         {
-            materialId = m_attributeBuffer[i];
-            pMesh = &m_meshes[numMeshes++];            
-            pMesh->pMaterial = &m_materials[materialId];
-            pMesh->startIndex = i * 3;
-            ++pMesh->triangleCount;
+            Vertex &v = m_pVertexBuffer[++vertex];
+
+            memcpy(v.position, record.attributes, sizeof(v.position));
+            memcpy(v.texCoord, record.attributes + 3, sizeof(v.texCoord));
+            memcpy(v.normal, record.attributes + 5, sizeof(v.normal));
+
+            if (newPosition)
+                memcpy(&m_pPositionBuffer[++position * 3], record.attributes, 3 * sizeof(float));
         }
-        else
+
+        IndexRecord index = {record.corner, vertex, position};
+
+        indices.add(index);
+        previous = record;
+    });
+
+    m_importStatistics.sortRuns += corners.getNumberOfRuns();
+    corners.clear();
+
+    // 3. Write the index buffers in order and generate the three edges of
+    // every triangle once all of its corners are known.
+
+    int keyBits = EdgeKeyBits(m_numberOfPositions);
+
+    valid = valid && indices.merge([&](const IndexRecord &record)
+    {
+        m_pIndexBuffer[record.slot] = record.vertex;
+        m_pPositionIndexBuffer[record.slot] = record.position;
+
+        if (record.slot % 3 != 2)
+            return;
+
+        int i = record.slot / 3;
+        const int *pVertices = &m_pIndexBuffer[i * 3];
+        const int *pPositions = &m_pPositionIndexBuffer[i * 3];
+        EdgeRecord edge;
+
+        edge.key = MakeEdgeKey(pPositions[0], pPositions[1], keyBits);
+        edge.slot = i * 6 + 1;
+        edge.origin = pPositions[0];
+        edge.vertex = pVertices[2];
+        edge.position = pPositions[2];
+        edges.add(edge);
+
+        edge.key = MakeEdgeKey(pPositions[1], pPositions[2], keyBits);
+        edge.slot = i * 6 + 3;
+        edge.origin = pPositions[1];
+        edge.vertex = pVertices[0];
+        edge.position = pPositions[0];
+        edges.add(edge);
+
+        edge.key = MakeEdgeKey(pPositions[0], pPositions[2], keyBits);
+        edge.slot = i * 6 + 5;
+        edge.origin = pPositions[2];
+        edge.vertex = pVertices[1];
+        edge.position = pPositions[1];
+        edges.add(edge);
+    });
+
+    m_importStatistics.sortRuns += indices.getNumberOfRuns();
+    indices.clear();
+
+    // Two triangles that run along an edge in opposite directions store
+    // each other's opposite corner, like twins in buildHalfEdges(). Any
+    // other edge keeps the triangle's own.
+
+    std::vector<EdgeRecord> group;
+
+    auto matchEdges = [&]()
+    {
+        bool twins = group.size() == 2 && group[0].origin != group[1].origin;
+
+        if (group.size() == 1)
+            ++m_importStatistics.boundaryEdges;
+        else if (group.size() > 2)
+            ++m_importStatistics.nonManifoldEdges;
+
+        for (size_t k = 0; k < group.size(); ++k)
         {
-            ++pMesh->triangleCount;
+            const EdgeRecord &partner = twins ? group[k ^ 1] : group[k];
+            IndexRecord slot = {group[k].slot, partner.vertex, partner.position};
+
+            adjacent.add(slot);
         }
-    }
 
-    // Sort the meshes based on its material alpha. Fully opaque meshes
-    // towards the front and fully transparent towards the back.
-    std::sort(m_meshes.begin(), m_meshes.end(), MeshCompFunc);
-}
+        group.clear();
+    };
 
-void ModelOBJ::generateNormals()
-{
-    const int *pTriangle = 0;
-    Vertex *pVertex0 = 0;
-    Vertex *pVertex1 = 0;
-    Vertex *pVertex2 = 0;
-    float edge1[3] = {0.0f, 0.0f, 0.0f};
-    float edge2[3] = {0.0f, 0.0f, 0.0f};
-    float normal[3] = {0.0f, 0.0f, 0.0f};
-    float length = 0.0f;
-    int totalVertices = getNumberOfVertices();
-    int totalTriangles = getNumberOfTriangles();
+    valid = valid && edges.merge([&](const EdgeRecord &edge)
+    {
+        if (!group.empty() && group[0].key != edge.key)
+            matchEdges();
+
+        group.push_back(edge);
+    });
+
+    if (!group.empty())
+        matchEdges();
+
+    m_importStatistics.sortRuns += edges.getNumberOfRuns();
+    edges.clear();
+
+    // Write the adjacency buffers. Every record fills an edge slot and the
+    // slot before it, which holds one of the triangle's own corners.
+
+    valid = valid && adjacent.merge([&](const IndexRecord &record)
+    {
+        int own = record.slot - 1;
+        int corner = own / 6 * 3 + own % 6 / 2;
+
+        m_pIndexBufferAdj[own] = m_pIndexBuffer[corner];
+        m_pPositionIndexBufferAdj[own] = m_pPositionIndexBuffer[corner];
+        m_pIndexBufferAdj[record.slot] = record.vertex;
+        m_pPositionIndexBufferAdj[record.slot] = record.position;
+    });
 
-    // Initialize all the vertex normals.
-    for (int i = 0; i < totalVertices; ++i)
+    m_importStatistics.sortRuns += adjacent.getNumberOfRuns();
+    adjacent.clear();
+
+    if (!valid)
     {
-        pVertex0 = &m_vertexBuffer[i];
-        pVertex0->normal[0] = 0.0f;
-        pVertex0->normal[1] = 0.0f;
-        pVertex0->normal[2] = 0.0f;
+        fprintf(stderr, "%s: temporary file error.\n", tempFilename.c_str());
+        output.close();
+        remove(tempFilename.c_str());
+        return false;
     }
 
-    // Calculate the vertex normals.
-    for (int i = 0; i < totalTriangles; ++i)
+    setImportStage(ImportProgress::STAGE_POST_PROCESSING);
+
+    // The scalar kernel needs no memory besides the buffers themselves.
+    if (options.rebuildNormals || !m_hasNormals)
     {
-        pTriangle = &m_indexBuffer[i * 3];
+        ComputeNormalsScalar(m_pVertexBuffer, m_numberOfVertices, m_pIndexBuffer, m_numberOfTriangles);
+        m_hasNormals = true;
+    }
 
-        pVertex0 = &m_vertexBuffer[pTriangle[0]];
-        pVertex1 = &m_vertexBuffer[pTriangle[1]];
-        pVertex2 = &m_vertexBuffer[pTriangle[2]];
+    bounds(m_center, m_width, m_height, m_length, m_radius, options.threadCount);
 
-        // Calculate triangle face normal.
+    // The header and tables go in last, now that the flags and bounds are
+    // known. Then replace the old cache and load the new one.
 
-        edge1[0] = pVertex1->position[0] - pVertex0->position[0];
-        edge1[1] = pVertex1->position[1] - pVertex0->position[1];
-        edge1[2] = pVertex1->position[2] - pVertex0->position[2];
+    layoutCache(layout);
 
-        edge2[0] = pVertex2->position[0] - pVertex0->position[0];
-        edge2[1] = pVertex2->position[1] - pVertex0->position[1];
-        edge2[2] = pVertex2->position[2] - pVertex0->position[2];
+    memcpy(pData, &layout.header, sizeof(layout.header));
 
-        normal[0] = (edge1[1] * edge2[2]) - (edge1[2] * edge2[1]);
-        normal[1] = (edge1[2] * edge2[0]) - (edge1[0] * edge2[2]);
-        normal[2] = (edge1[0] * edge2[1]) - (edge1[1] * edge2[0]);
+    if (!layout.meshes.empty())
+        memcpy(pData + layout.header.meshOffset, &layout.meshes[0], layout.meshes.size() * sizeof(CacheMesh));
+
+    if (!layout.materials.empty())
+        memcpy(pData + layout.header.materialOffset, &layout.materials[0], layout.materials.size() * sizeof(CacheMaterial));
 
-        // Accumulate the normals.
+    if (!layout.libraries.empty())
+        memcpy(pData + layout.header.libraryOffset, &layout.libraries[0], layout.libraries.size() * sizeof(CacheString));
 
-        pVertex0->normal[0] += normal[0];
-        pVertex0->normal[1] += normal[1];
-        pVertex0->normal[2] += normal[2];
+    if (!layout.strings.empty())
+        memcpy(pData + layout.header.stringOffset, layout.strings.data(), layout.strings.size());
+
+    output.close();
+
+    // With useCache the new file replaces the cache. On Windows that fails
+    // while another model or process still has the old cache mapped, e.g.
+    // the one still drawn while this model loads. The model then uses the
+    // file under its temporary name, and destroy() moves it over the cache
+    // once the model is done with it. Without useCache destroy() removes it.
+
+    bool replaced = options.useCache && ReplaceFile(tempFilename, cacheFilename);
+    ImportStatistics statistics = m_importStatistics;
+
+    if (!loadCache(replaced ? cacheFilename.c_str() : tempFilename.c_str()))
+    {
+        if (!replaced)
+            remove(tempFilename.c_str());
+
+        return false;
+    }
 
-        pVertex1->normal[0] += normal[0];
-        pVertex1->normal[1] += normal[1];
-        pVertex1->normal[2] += normal[2];
+    if (!replaced)
+    {
+        m_cacheTempFilename = tempFilename;
 
-        pVertex2->normal[0] += normal[0];
-        pVertex2->normal[1] += normal[1];
-        pVertex2->normal[2] += normal[2];
+        if (options.useCache)
+            m_cacheTargetFilename = cacheFilename;
     }
 
-    // Normalize the vertex normals.
-    for (int i = 0; i < totalVertices; ++i)
-    {
-        pVertex0 = &m_vertexBuffer[i];
+    m_importStatistics = statistics;
+    m_importStatistics.importedOutOfCore = true;
+    return true;
+}
+
+void ModelOBJ::parseGeometry(const char *pData, const char *pEnd,
+                             ImportChunk &chunk) const
+{
+    // Single pass OBJ geometry parser. The raw vertex attributes are appended
+    // to the chunk's arrays as they are read and the triangulated faces are
+    // recorded with their indices already resolved. Negative indices can only
+    // be resolved relative to the start of the chunk and are flagged so that
+    // mergeChunks() can offset them. Material names and libraries are only
+    // recorded here and resolved once the whole file has been read.
+    //
+    // This method may be called concurrently for different chunks.
+
+    std::map<std::string, int> materialSlots;
+    std::map<std::string, int>::const_iterator iter;
+    std::string name;
+    ObjTriangle triangle;
+    float value[3] = {0.0f};
+    int v = 0;
+    int vt = 0;
+    int vn = 0;
+    int format = 0;
+    const char *p = pData;
+    const char *pToken = 0;
+    const char *pReported = pData;
+    size_t length = 0;
+
+    chunk.activeSlot = -1;
+
+    while (p < pEnd)
+    {
+        if (p - pReported >= PROGRESS_REPORT_BYTES)
+        {
+            reportBytesParsed(p - pReported);
+            pReported = p;
+        }
+
+        p = SkipBlanks(p, pEnd);
+
+        if (p == pEnd)
+            break;
+
+        pToken = p;
+        p = SkipToken(p, pEnd);
+        length = p - pToken;
+
+        switch (pToken[0])
+        {
+        case 'f': // v, v//vn, v/vt, or v/vt/vn.
+            if (length != 1)
+                break;
+
+            p = SkipBlanks(p, pEnd);
+            format = ParseFaceVertex(p, pEnd, v, vt, vn);
+
+            if (format < 0)
+                break;
+
+            triangle.materialSlot = chunk.activeSlot;
+            triangle.format = format;
+            triangle.relative = 0;
+            chunk.resolveIndices(triangle, 0, v, vt, vn);
+
+            // Triangulate the face as a fan around its first vertex.
+            for (int corner = 1; ; ++corner)
+            {
+                p = SkipBlanks(p, pEnd);
+
+                if (ParseFaceVertex(p, pEnd, v, vt, vn) != format)
+                    break;
+
+                if (corner > 2)
+                    triangle.shiftFanCorner();
+
+                chunk.resolveIndices(triangle, (corner == 1) ? 1 : 2, v, vt, vn);
+
+                if (corner >= 2)
+                    chunk.triangles.push_back(triangle);
+            }
+            break;
+
+        case 'm': // mtllib
+            if (length != 6 || memcmp(pToken, "mtllib", 6) != 0)
+                break;
+
+            p = SkipBlanks(p, pEnd);
+            pToken = p;
+            p = SkipToken(p, pEnd);
+            chunk.materialLibraries.push_back(std::string(pToken, p));
+            break;
+
+        case 'u': // usemtl
+            if (length != 6 || memcmp(pToken, "usemtl", 6) != 0)
+                break;
+
+            p = SkipBlanks(p, pEnd);
+            pToken = p;
+            p = SkipToken(p, pEnd);
+            name.assign(pToken, p);
+            iter = materialSlots.find(name);
+
+            if (iter == materialSlots.end())
+            {
+                chunk.activeSlot = static_cast<int>(chunk.materialNames.size());
+                chunk.materialNames.push_back(name);
+                materialSlots[name] = chunk.activeSlot;
+            }
+            else
+            {
+                chunk.activeSlot = iter->second;
+            }
+            break;
+
+        case 'v': // v, vn, or vt.
+            if (length == 1 || (length == 2 && pToken[1] == 'n'))
+            {
+                value[0] = value[1] = value[2] = 0.0f;
+
+                for (int i = 0; i < 3; ++i)
+                {
+                    p = SkipBlanks(p, pEnd);
+
+                    if (!ParseFloat(p, pEnd, value[i]))
+                        break;
+                }
+
+                std::vector<float> &coords = (length == 1) ? chunk.vertexCoords : chunk.normals;
+                coords.insert(coords.end(), value, value + 3);
+            }
+            else if (length == 2 && pToken[1] == 't')
+            {
+                value[0] = value[1] = 0.0f;
+
+                for (int i = 0; i < 2; ++i)
+                {
+                    p = SkipBlanks(p, pEnd);
+
+                    if (!ParseFloat(p, pEnd, value[i]))
+                        break;
+                }
+
+                chunk.textureCoords.insert(chunk.textureCoords.end(), value, value + 2);
+            }
+            break;
 
-        length = 1.0f / sqrtf(pVertex0->normal[0] * pVertex0->normal[0] +
-            pVertex0->normal[1] * pVertex0->normal[1] +
-            pVertex0->normal[2] * pVertex0->normal[2]);
+        default:
+            break;
+        }
 
-        pVertex0->normal[0] *= length;
-        pVertex0->normal[1] *= length;
-        pVertex0->normal[2] *= length;
+        p = SkipLine(p, pEnd);
     }
 
-    m_hasNormals = true;
+    reportBytesParsed(pEnd - pReported);
 }
 
-void ModelOBJ::generateTangents()
+bool ModelOBJ::mergeChunks(std::vector<ImportChunk> &chunks,
+                           std::vector<std::string> &materialNames)
 {
-    const int *pTriangle = 0;
-    Vertex *pVertex0 = 0;
-    Vertex *pVertex1 = 0;
-    Vertex *pVertex2 = 0;
-    float edge1[3] = {0.0f, 0.0f, 0.0f};
-    float edge2[3] = {0.0f, 0.0f, 0.0f};
-    float texEdge1[2] = {0.0f, 0.0f};
-    float texEdge2[2] = {0.0f, 0.0f};
-    float tangent[3] = {0.0f, 0.0f, 0.0f};
-    float bitangent[3] = {0.0f, 0.0f, 0.0f};
-    float det = 0.0f;
-    float nDotT = 0.0f;
-    float bDotB = 0.0f;
-    float length = 0.0f;
-    int totalVertices = getNumberOfVertices();
-    int totalTriangles = getNumberOfTriangles();
+    // Concatenates the vertex attributes of the parsed chunks in file order.
+    // The running (prefix sum) attribute counts are used to offset the chunk
+    // relative indices, and the chunk local material slots are remapped to
+    // file wide ones. A chunk inherits the material active at the end of the
+    // previous chunk until its first usemtl statement. Returns false if a
+    // face refers to an attribute that doesn't exist.
+
+    size_t totalVertexCoords = 0;
+    size_t totalTextureCoords = 0;
+    size_t totalNormals = 0;
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        totalVertexCoords += chunks[i].vertexCoords.size();
+        totalTextureCoords += chunks[i].textureCoords.size();
+        totalNormals += chunks[i].normals.size();
+    }
 
-    // Initialize all the vertex tangents and bitangents.
-    for (int i = 0; i < totalVertices; ++i)
+    if (chunks.size() == 1)
     {
-        pVertex0 = &m_vertexBuffer[i];
+        // Nothing to offset or remap.
+        m_vertexCoords.swap(chunks[0].vertexCoords);
+        m_textureCoords.swap(chunks[0].textureCoords);
+        m_normals.swap(chunks[0].normals);
+        materialNames.swap(chunks[0].materialNames);
+        return hasValidIndices(chunks);
+    }
 
-        pVertex0->tangent[0] = 0.0f;
-        pVertex0->tangent[1] = 0.0f;
-        pVertex0->tangent[2] = 0.0f;
-        pVertex0->tangent[3] = 0.0f;
+    m_vertexCoords.clear();
+    m_textureCoords.clear();
+    m_normals.clear();
+    m_vertexCoords.reserve(totalVertexCoords);
+    m_textureCoords.reserve(totalTextureCoords);
+    m_normals.reserve(totalNormals);
+    materialNames.clear();
 
-        pVertex0->bitangent[0] = 0.0f;
-        pVertex0->bitangent[1] = 0.0f;
-        pVertex0->bitangent[2] = 0.0f;
-    }
+    std::map<std::string, int> materialSlots;
+    std::map<std::string, int>::const_iterator iter;
+    std::vector<int> slotMap;
+    int inheritedSlot = -1;
 
-    // Calculate the vertex tangents and bitangents.
-    for (int i = 0; i < totalTriangles; ++i)
+    for (size_t i = 0; i < chunks.size(); ++i)
     {
-        pTriangle = &m_indexBuffer[i * 3];
+        ImportChunk &chunk = chunks[i];
+        int vertexBase = static_cast<int>(m_vertexCoords.size() / 3);
+        int texCoordBase = static_cast<int>(m_textureCoords.size() / 2);
+        int normalBase = static_cast<int>(m_normals.size() / 3);
 
-        pVertex0 = &m_vertexBuffer[pTriangle[0]];
-        pVertex1 = &m_vertexBuffer[pTriangle[1]];
-        pVertex2 = &m_vertexBuffer[pTriangle[2]];
+        m_vertexCoords.insert(m_vertexCoords.end(), chunk.vertexCoords.begin(), chunk.vertexCoords.end());
+        m_textureCoords.insert(m_textureCoords.end(), chunk.textureCoords.begin(), chunk.textureCoords.end());
+        m_normals.insert(m_normals.end(), chunk.normals.begin(), chunk.normals.end());
 
-        // Calculate the triangle face tangent and bitangent.
+        std::vector<float>().swap(chunk.vertexCoords);
+        std::vector<float>().swap(chunk.textureCoords);
+        std::vector<float>().swap(chunk.normals);
 
-        edge1[0] = pVertex1->position[0] - pVertex0->position[0];
-        edge1[1] = pVertex1->position[1] - pVertex0->position[1];
-        edge1[2] = pVertex1->position[2] - pVertex0->position[2];
+        slotMap.resize(chunk.materialNames.size());
 
-        edge2[0] = pVertex2->position[0] - pVertex0->position[0];
-        edge2[1] = pVertex2->position[1] - pVertex0->position[1];
-        edge2[2] = pVertex2->position[2] - pVertex0->position[2];
+        for (size_t j = 0; j < chunk.materialNames.size(); ++j)
+        {
+            iter = materialSlots.find(chunk.materialNames[j]);
+
+            if (iter == materialSlots.end())
+            {
+                slotMap[j] = static_cast<int>(materialNames.size());
+                materialSlots[chunk.materialNames[j]] = slotMap[j];
+                materialNames.push_back(chunk.materialNames[j]);
+            }
+            else
+            {
+                slotMap[j] = iter->second;
+            }
+        }
 
-        texEdge1[0] = pVertex1->texCoord[0] - pVertex0->texCoord[0];
-        texEdge1[1] = pVertex1->texCoord[1] - pVertex0->texCoord[1];
+        for (size_t j = 0; j < chunk.triangles.size(); ++j)
+        {
+            ObjTriangle &t = chunk.triangles[j];
 
-        texEdge2[0] = pVertex2->texCoord[0] - pVertex0->texCoord[0];
-        texEdge2[1] = pVertex2->texCoord[1] - pVertex0->texCoord[1];
+            t.materialSlot = (t.materialSlot < 0) ? inheritedSlot : slotMap[t.materialSlot];
 
-        det = texEdge1[0] * texEdge2[1] - texEdge2[0] * texEdge1[1];
+            if (!t.relative)
+                continue;
 
-        if (fabs(det) < 1e-6f)
-        {
-            tangent[0] = 1.0f;
-            tangent[1] = 0.0f;
-            tangent[2] = 0.0f;
+            for (int k = 0; k < 3; ++k)
+            {
+                if (t.relative & (RELATIVE_V << k))
+                    t.v[k] += vertexBase;
+
+                if (t.relative & (RELATIVE_VT << k))
+                    t.vt[k] += texCoordBase;
 
-            bitangent[0] = 0.0f;
-            bitangent[1] = 1.0f;
-            bitangent[2] = 0.0f;
+                if (t.relative & (RELATIVE_VN << k))
+                    t.vn[k] += normalBase;
+            }
         }
-        else
-        {
-            det = 1.0f / det;
-
-            tangent[0] = (texEdge2[1] * edge1[0] - texEdge1[1] * edge2[0]) * det;
-            tangent[1] = (texEdge2[1] * edge1[1] - texEdge1[1] * edge2[1]) * det;
-            tangent[2] = (texEdge2[1] * edge1[2] - texEdge1[1] * edge2[2]) * det;
-
-            bitangent[0] = (-texEdge2[0] * edge1[0] + texEdge1[0] * edge2[0]) * det;
-            bitangent[1] = (-texEdge2[0] * edge1[1] + texEdge1[0] * edge2[1]) * det;
-            bitangent[2] = (-texEdge2[0] * edge1[2] + texEdge1[0] * edge2[2]) * det;
-        }
-
-        // Accumulate the tangents and bitangents.
-
-        pVertex0->tangent[0] += tangent[0];
-        pVertex0->tangent[1] += tangent[1];
-        pVertex0->tangent[2] += tangent[2];
-        pVertex0->bitangent[0] += bitangent[0];
-        pVertex0->bitangent[1] += bitangent[1];
-        pVertex0->bitangent[2] += bitangent[2];
-
-        pVertex1->tangent[0] += tangent[0];
-        pVertex1->tangent[1] += tangent[1];
-        pVertex1->tangent[2] += tangent[2];
-        pVertex1->bitangent[0] += bitangent[0];
-        pVertex1->bitangent[1] += bitangent[1];
-        pVertex1->bitangent[2] += bitangent[2];
-
-        pVertex2->tangent[0] += tangent[0];
-        pVertex2->tangent[1] += tangent[1];
-        pVertex2->tangent[2] += tangent[2];
-        pVertex2->bitangent[0] += bitangent[0];
-        pVertex2->bitangent[1] += bitangent[1];
-        pVertex2->bitangent[2] += bitangent[2];
-    }
-
-    // Orthogonalize and normalize the vertex tangents.
-    for (int i = 0; i < totalVertices; ++i)
-    {
-        pVertex0 = &m_vertexBuffer[i];
-
-        // Gram-Schmidt orthogonalize tangent with normal.
-
-        nDotT = pVertex0->normal[0] * pVertex0->tangent[0] +
-                pVertex0->normal[1] * pVertex0->tangent[1] +
-                pVertex0->normal[2] * pVertex0->tangent[2];
-
-        pVertex0->tangent[0] -= pVertex0->normal[0] * nDotT;
-        pVertex0->tangent[1] -= pVertex0->normal[1] * nDotT;
-        pVertex0->tangent[2] -= pVertex0->normal[2] * nDotT;
-
-        // Normalize the tangent.
-
-        length = 1.0f / sqrtf(pVertex0->tangent[0] * pVertex0->tangent[0] +
-                              pVertex0->tangent[1] * pVertex0->tangent[1] +
-                              pVertex0->tangent[2] * pVertex0->tangent[2]);
-
-        pVertex0->tangent[0] *= length;
-        pVertex0->tangent[1] *= length;
-        pVertex0->tangent[2] *= length;
-
-        // Calculate the handedness of the local tangent space.
-        // The bitangent vector is the cross product between the triangle face
-        // normal vector and the calculated tangent vector. The resulting
-        // bitangent vector should be the same as the bitangent vector
-        // calculated from the set of linear equations above. If they point in
-        // different directions then we need to invert the cross product
-        // calculated bitangent vector. We store this scalar multiplier in the
-        // tangent vector's 'w' component so that the correct bitangent vector
-        // can be generated in the normal mapping shader's vertex shader.
-        //
-        // Normal maps have a left handed coordinate system with the origin
-        // located at the top left of the normal map texture. The x coordinates
-        // run horizontally from left to right. The y coordinates run
-        // vertically from top to bottom. The z coordinates run out of the
-        // normal map texture towards the viewer. Our handedness calculations
-        // must take this fact into account as well so that the normal mapping
-        // shader's vertex shader will generate the correct bitangent vectors.
-        // Some normal map authoring tools such as Crazybump
-        // (http://www.crazybump.com/) includes options to allow you to control
-        // the orientation of the normal map normal's y-axis.
-
-        bitangent[0] = (pVertex0->normal[1] * pVertex0->tangent[2]) - 
-                       (pVertex0->normal[2] * pVertex0->tangent[1]);
-        bitangent[1] = (pVertex0->normal[2] * pVertex0->tangent[0]) -
-                       (pVertex0->normal[0] * pVertex0->tangent[2]);
-        bitangent[2] = (pVertex0->normal[0] * pVertex0->tangent[1]) - 
-                       (pVertex0->normal[1] * pVertex0->tangent[0]);
-
-        bDotB = bitangent[0] * pVertex0->bitangent[0] + 
-                bitangent[1] * pVertex0->bitangent[1] + 
-                bitangent[2] * pVertex0->bitangent[2];
-
-        pVertex0->tangent[3] = (bDotB < 0.0f) ? 1.0f : -1.0f;
-
-        pVertex0->bitangent[0] = bitangent[0];
-        pVertex0->bitangent[1] = bitangent[1];
-        pVertex0->bitangent[2] = bitangent[2];
+
+        if (chunk.activeSlot >= 0)
+            inheritedSlot = slotMap[chunk.activeSlot];
     }
 
-    m_hasTangents = true;
+    return hasValidIndices(chunks);
 }
 
-void ModelOBJ::importGeometryFirstPass(FILE *pFile)
+bool ModelOBJ::hasValidIndices(const std::vector<ImportChunk> &chunks) const
 {
-    m_hasTextureCoords = false;
-    m_hasNormals = false;
-
-    m_numberOfVertexCoords = 0;
-    m_numberOfTextureCoords = 0;
-    m_numberOfNormals = 0;
-    m_numberOfTriangles = 0;
+    // Checks the merged triangles' indices of the attributes their face
+    // format uses against the attribute counts. A zero index, or a relative
+    // one reaching back before the first element, has resolved to a
+    // negative index by now.
 
-    int v = 0;
-    int vt = 0;
-    int vn = 0;
-    char buffer[256] = {0};
-    std::string name;
+    int numVertexCoords = static_cast<int>(m_vertexCoords.size() / 3);
+    int numTextureCoords = static_cast<int>(m_textureCoords.size() / 2);
+    int numNormals = static_cast<int>(m_normals.size() / 3);
 
-    while (fscanf(pFile, "%s", buffer) != EOF)
+    for (size_t i = 0; i < chunks.size(); ++i)
     {
-        switch (buffer[0])
-        {
-        case 'f':   // v, v//vn, v/vt, v/vt/vn.
-            fscanf(pFile, "%s", buffer);
-
-            if (strstr(buffer, "//")) // v//vn
-            {
-                sscanf(buffer, "%d//%d", &v, &vn);
-                fscanf(pFile, "%d//%d", &v, &vn);
-                fscanf(pFile, "%d//%d", &v, &vn);
-                ++m_numberOfTriangles;
+        const std::vector<ObjTriangle> &triangles = chunks[i].triangles;
 
-                while (fscanf(pFile, "%d//%d", &v, &vn) > 0)
-                    ++m_numberOfTriangles;
-            }
-            else if (sscanf(buffer, "%d/%d/%d", &v, &vt, &vn) == 3) // v/vt/vn
-            {
-                fscanf(pFile, "%d/%d/%d", &v, &vt, &vn);
-                fscanf(pFile, "%d/%d/%d", &v, &vt, &vn);
-                ++m_numberOfTriangles;
+        for (size_t j = 0; j < triangles.size(); ++j)
+        {
+            const ObjTriangle &t = triangles[j];
+            bool hasTexCoords = t.format == FACE_POS_TEXCOORD || t.format == FACE_POS_TEXCOORD_NORMAL;
+            bool hasNormals = t.format == FACE_POS_NORMAL || t.format == FACE_POS_TEXCOORD_NORMAL;
 
-                while (fscanf(pFile, "%d/%d/%d", &v, &vt, &vn) > 0)
-                    ++m_numberOfTriangles;
-            }
-            else if (sscanf(buffer, "%d/%d", &v, &vt) == 2) // v/vt
+            for (int k = 0; k < 3; ++k)
             {
-                fscanf(pFile, "%d/%d", &v, &vt);
-                fscanf(pFile, "%d/%d", &v, &vt);
-                ++m_numberOfTriangles;
+                if (t.v[k] < 0 || t.v[k] >= numVertexCoords)
+                    return false;
 
-                while (fscanf(pFile, "%d/%d", &v, &vt) > 0)
-                    ++m_numberOfTriangles;
-            }
-            else // v
-            {
-                fscanf(pFile, "%d", &v);
-                fscanf(pFile, "%d", &v);
-                ++m_numberOfTriangles;
+                if (hasTexCoords && (t.vt[k] < 0 || t.vt[k] >= numTextureCoords))
+                    return false;
 
-                while (fscanf(pFile, "%d", &v) > 0)
-                    ++m_numberOfTriangles;
+                if (hasNormals && (t.vn[k] < 0 || t.vn[k] >= numNormals))
+                    return false;
             }
-            break;
-
-        case 'm':   // mtllib
-            fgets(buffer, sizeof(buffer), pFile);
-            sscanf(buffer, "%s %s", buffer, buffer);
-            name = m_directoryPath;
-            name += buffer;
-            importMaterials(name.c_str());
-            break;
-
-        case 'v':   // v, vt, or vn
-            switch (buffer[1])
-            {
-            case '\0':
-                fgets(buffer, sizeof(buffer), pFile);
-                ++m_numberOfVertexCoords;
-                break;
+        }
+    }
 
-            case 'n':
-                fgets(buffer, sizeof(buffer), pFile);
-                ++m_numberOfNormals;
-                break;
+    return true;
+}
 
-            case 't':
-                fgets(buffer, sizeof(buffer), pFile);
-                ++m_numberOfTextureCoords;
+void ModelOBJ::buildTriangles(const std::vector<ImportChunk> &chunks,
+                              const std::vector<std::string> &materialNames)
+{
+    // Builds the vertex and index buffers from the parsed triangles. This is
+    // the equivalent of importGeometrySecondPass() for the single pass
+    // importer and produces exactly the same buffers.
 
-            default:
-                break;
-            }
-            break;
+    m_numberOfVertexCoords = static_cast<int>(m_vertexCoords.size() / 3);
+    m_numberOfTextureCoords = static_cast<int>(m_textureCoords.size() / 2);
+    m_numberOfNormals = static_cast<int>(m_normals.size() / 3);
+    m_numberOfTriangles = 0;
 
-        default:
-            fgets(buffer, sizeof(buffer), pFile);
-            break;
-        }
-    }
+    for (size_t i = 0; i < chunks.size(); ++i)
+        m_numberOfTriangles += static_cast<int>(chunks[i].triangles.size());
 
     m_hasPositions = m_numberOfVertexCoords > 0;
     m_hasNormals = m_numberOfNormals > 0;
     m_hasTextureCoords = m_numberOfTextureCoords > 0;
 
-    // Allocate memory for the OBJ model data.
-    m_vertexCoords.resize(m_numberOfVertexCoords * 3);
-    m_textureCoords.resize(m_numberOfTextureCoords * 2);
-    m_normals.resize(m_numberOfNormals * 3);
     m_indexBuffer.resize(m_numberOfTriangles * 3);
-	m_indexBufferAdj.resize(m_numberOfTriangles * 6);
     m_attributeBuffer.resize(m_numberOfTriangles);
 
     // Define a default material if no materials were loaded.
     if (m_numberOfMaterials == 0)
+        addDefaultMaterial();
+
+    // Map the usemtl names to material ids. Unknown materials use material 0.
+    std::vector<int> materialIds(materialNames.size(), 0);
+    std::map<std::string, int>::const_iterator iter;
+
+    for (size_t i = 0; i < materialNames.size(); ++i)
     {
-        Material defaultMaterial =
-        {
-            0.2f, 0.2f, 0.2f, 1.0f,
-            0.8f, 0.8f, 0.8f, 1.0f,
-            0.0f, 0.0f, 0.0f, 1.0f,
-            0.0f,
-            1.0f,
-            std::string("default"),
-            std::string(),
-            std::string()
-        };
+        iter = m_materialCache.find(materialNames[i]);
 
-        m_materials.push_back(defaultMaterial);
-        m_materialCache[defaultMaterial.name] = 0;
+        if (iter != m_materialCache.end())
+            materialIds[i] = iter->second;
     }
-}
 
-void ModelOBJ::importGeometrySecondPass(FILE *pFile)
-{
-    int v[3] = {0};
-    int vt[3] = {0};
-    int vn[3] = {0};
-    int numVertices = 0;
-    int numTexCoords = 0;
-    int numNormals = 0;
-    int numTriangles = 0;
-    int activeMaterial = 0;
-    char buffer[256] = {0};
-    std::string name;
-    std::map<std::string, int>::const_iterator iter;
+    initVertexCache();
 
-    while (fscanf(pFile, "%s", buffer) != EOF)
+    for (int i = 0, c = 0, j = 0; i < m_numberOfTriangles; ++i, ++j)
     {
-        switch (buffer[0])
+        while (j == static_cast<int>(chunks[c].triangles.size()))
         {
-        case 'f': // v, v//vn, v/vt, or v/vt/vn.
-            v[0]  = v[1]  = v[2]  = 0;
-            vt[0] = vt[1] = vt[2] = 0;
-            vn[0] = vn[1] = vn[2] = 0;
+            ++c;
+            j = 0;
+        }
 
-            fscanf(pFile, "%s", buffer);
+        const ObjTriangle &t = chunks[c].triangles[j];
+        int material = (t.materialSlot < 0) ? 0 : materialIds[t.materialSlot];
 
-            if (strstr(buffer, "//")) // v//vn
-            {
-                sscanf(buffer, "%d//%d", &v[0], &vn[0]);
-                fscanf(pFile, "%d//%d", &v[1], &vn[1]);
-                fscanf(pFile, "%d//%d", &v[2], &vn[2]);
+        switch (t.format)
+        {
+        case FACE_POS:
+            addTrianglePos(i, material, t.v[0], t.v[1], t.v[2]);
+            break;
 
-                v[0] = (v[0] < 0) ? v[0] + numVertices - 1 : v[0] - 1;
-                v[1] = (v[1] < 0) ? v[1] + numVertices - 1 : v[1] - 1;
-                v[2] = (v[2] < 0) ? v[2] + numVertices - 1 : v[2] - 1;
+        case FACE_POS_TEXCOORD:
+            addTrianglePosTexCoord(i, material, t.v[0], t.v[1], t.v[2],
+                t.vt[0], t.vt[1], t.vt[2]);
+            break;
 
-                vn[0] = (vn[0] < 0) ? vn[0] + numNormals - 1 : vn[0] - 1;
-                vn[1] = (vn[1] < 0) ? vn[1] + numNormals - 1 : vn[1] - 1;
-                vn[2] = (vn[2] < 0) ? vn[2] + numNormals - 1 : vn[2] - 1;
+        case FACE_POS_NORMAL:
+            addTrianglePosNormal(i, material, t.v[0], t.v[1], t.v[2],
+                t.vn[0], t.vn[1], t.vn[2]);
+            break;
 
-                addTrianglePosNormal(numTriangles++, activeMaterial,
-                    v[0], v[1], v[2], vn[0], vn[1], vn[2]);
+        default:
+            addTrianglePosTexCoordNormal(i, material, t.v[0], t.v[1], t.v[2],
+                t.vt[0], t.vt[1], t.vt[2], t.vn[0], t.vn[1], t.vn[2]);
+            break;
+        }
+    }
 
-                v[1] = v[2];
-                vn[1] = vn[2];
+    releaseVertexCache();
+}
 
-                while (fscanf(pFile, "%d//%d", &v[2], &vn[2]) > 0)
-                {
-                    v[2] = (v[2] < 0) ? v[2] + numVertices - 1 : v[2] - 1;
-                    vn[2] = (vn[2] < 0) ? vn[2] + numNormals - 1 : vn[2] - 1;
+void ModelOBJ::weldAttributes(std::vector<ImportChunk> &chunks,
+                              const ImportOptions &options)
+{
+    // Welds positions, texture coordinates and normals that are within the
+    // import tolerances of an earlier one by pointing the triangles at the
+    // earlier element instead. addVertex() only looks at these indices, so
+    // nearly identical vertices are then shared, and so are their positions
+    // in the position stream that buildHalfEdges() matches edges on.
 
-                    addTrianglePosNormal(numTriangles++, activeMaterial,
-                        v[0], v[1], v[2], vn[0], vn[1], vn[2]);
+    m_weldTolerances[0] = std::max(options.weldPositionTolerance, 0.0f);
+    m_weldTolerances[1] = std::max(options.weldTexCoordTolerance, 0.0f);
+    m_weldTolerances[2] = std::max(options.weldNormalTolerance, 0.0f);
 
-                    v[1] = v[2];
-                    vn[1] = vn[2];
-                }
-            }
-            else if (sscanf(buffer, "%d/%d/%d", &v[0], &vt[0], &vn[0]) == 3) // v/vt/vn
-            {
-                fscanf(pFile, "%d/%d/%d", &v[1], &vt[1], &vn[1]);
-                fscanf(pFile, "%d/%d/%d", &v[2], &vt[2], &vn[2]);
+    if (m_weldTolerances[0] == 0.0f && m_weldTolerances[1] == 0.0f && m_weldTolerances[2] == 0.0f)
+        return;
 
-                v[0] = (v[0] < 0) ? v[0] + numVertices - 1 : v[0] - 1;
-                v[1] = (v[1] < 0) ? v[1] + numVertices - 1 : v[1] - 1;
-                v[2] = (v[2] < 0) ? v[2] + numVertices - 1 : v[2] - 1;
+    int numVertices = countVertices(chunks);
+    int numBoundaryEdges = countBoundaryEdges(chunks);
+    std::vector<int> positionRemap;
+    std::vector<int> texCoordRemap;
+    std::vector<int> normalRemap;
 
-                vt[0] = (vt[0] < 0) ? vt[0] + numTexCoords - 1 : vt[0] - 1;
-                vt[1] = (vt[1] < 0) ? vt[1] + numTexCoords - 1 : vt[1] - 1;
-                vt[2] = (vt[2] < 0) ? vt[2] + numTexCoords - 1 : vt[2] - 1;
+    if (m_weldTolerances[0] > 0.0f)
+        WeldElements(m_vertexCoords, 3, m_weldTolerances[0], positionRemap);
 
-                vn[0] = (vn[0] < 0) ? vn[0] + numNormals - 1 : vn[0] - 1;
-                vn[1] = (vn[1] < 0) ? vn[1] + numNormals - 1 : vn[1] - 1;
-                vn[2] = (vn[2] < 0) ? vn[2] + numNormals - 1 : vn[2] - 1;
+    if (m_weldTolerances[1] > 0.0f)
+        WeldElements(m_textureCoords, 2, m_weldTolerances[1], texCoordRemap);
 
-                addTrianglePosTexCoordNormal(numTriangles++, activeMaterial,
-                    v[0], v[1], v[2], vt[0], vt[1], vt[2], vn[0], vn[1], vn[2]);
+    if (m_weldTolerances[2] > 0.0f)
+        WeldElements(m_normals, 3, m_weldTolerances[2], normalRemap);
 
-                v[1] = v[2];
-                vt[1] = vt[2];
-                vn[1] = vn[2];
+    // An empty remap table leaves its indices alone, and so does an index
+    // outside of its attribute array.
+    auto remapIndex = [](const std::vector<int> &remap, int &index)
+    {
+        if (index >= 0 && index < static_cast<int>(remap.size()))
+            index = remap[index];
+    };
 
-                while (fscanf(pFile, "%d/%d/%d", &v[2], &vt[2], &vn[2]) > 0)
-                {
-                    v[2] = (v[2] < 0) ? v[2] + numVertices - 1 : v[2] - 1;
-                    vt[2] = (vt[2] < 0) ? vt[2] + numTexCoords - 1 : vt[2] - 1;
-                    vn[2] = (vn[2] < 0) ? vn[2] + numNormals - 1 : vn[2] - 1;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        std::vector<ObjTriangle> &triangles = chunks[i].triangles;
 
-                    addTrianglePosTexCoordNormal(numTriangles++, activeMaterial,
-                        v[0], v[1], v[2], vt[0], vt[1], vt[2], vn[0], vn[1], vn[2]);
+        for (size_t j = 0; j < triangles.size(); ++j)
+        {
+            ObjTriangle &t = triangles[j];
+            bool hasTexCoords = t.format == FACE_POS_TEXCOORD || t.format == FACE_POS_TEXCOORD_NORMAL;
+            bool hasNormals = t.format == FACE_POS_NORMAL || t.format == FACE_POS_TEXCOORD_NORMAL;
 
-                    v[1] = v[2];
-                    vt[1] = vt[2];
-                    vn[1] = vn[2];
-                }
-            }
-            else if (sscanf(buffer, "%d/%d", &v[0], &vt[0]) == 2) // v/vt
+            for (int k = 0; k < 3; ++k)
             {
-                fscanf(pFile, "%d/%d", &v[1], &vt[1]);
-                fscanf(pFile, "%d/%d", &v[2], &vt[2]);
+                remapIndex(positionRemap, t.v[k]);
 
-                v[0] = (v[0] < 0) ? v[0] + numVertices - 1 : v[0] - 1;
-                v[1] = (v[1] < 0) ? v[1] + numVertices - 1 : v[1] - 1;
-                v[2] = (v[2] < 0) ? v[2] + numVertices - 1 : v[2] - 1;
+                if (hasTexCoords)
+                    remapIndex(texCoordRemap, t.vt[k]);
+
+                if (hasNormals)
+                    remapIndex(normalRemap, t.vn[k]);
+            }
+        }
+    }
 
-                vt[0] = (vt[0] < 0) ? vt[0] + numTexCoords - 1 : vt[0] - 1;
-                vt[1] = (vt[1] < 0) ? vt[1] + numTexCoords - 1 : vt[1] - 1;
-                vt[2] = (vt[2] < 0) ? vt[2] + numTexCoords - 1 : vt[2] - 1;
+    m_importStatistics.weldedVertices = numVertices - countVertices(chunks);
+    m_importStatistics.weldedBoundaryEdges = numBoundaryEdges - countBoundaryEdges(chunks);
+}
 
-                addTrianglePosTexCoord(numTriangles++, activeMaterial,
-                    v[0], v[1], v[2], vt[0], vt[1], vt[2]);
+int ModelOBJ::countVertices(const std::vector<ImportChunk> &chunks) const
+{
+    // Number of vertices addVertex() would create for the triangles: their
+    // distinct (v, vt, vn) triples after aliasing.
+
+    std::vector<int> texCoordAliases;
+    std::vector<int> normalAliases;
+    int zeroTexCoordAlias = BuildAliases(m_textureCoords, 2, texCoordAliases);
+    int zeroNormalAlias = BuildAliases(m_normals, 3, normalAliases);
+    VertexCacheEntry emptyEntry = {0, 0, 0, -1};
+    std::vector<VertexCacheEntry> table(HashTableCapacity(m_vertexCoords.size() / 3), emptyEntry);
+    size_t mask = table.size() - 1;
+    int count = 0;
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        const std::vector<ObjTriangle> &triangles = chunks[i].triangles;
 
-                v[1] = v[2];
-                vt[1] = vt[2];
+        for (size_t j = 0; j < triangles.size(); ++j)
+        {
+            const ObjTriangle &t = triangles[j];
+            bool hasTexCoords = t.format == FACE_POS_TEXCOORD || t.format == FACE_POS_TEXCOORD_NORMAL;
+            bool hasNormals = t.format == FACE_POS_NORMAL || t.format == FACE_POS_TEXCOORD_NORMAL;
 
-                while (fscanf(pFile, "%d/%d", &v[2], &vt[2]) > 0)
+            for (int k = 0; k < 3; ++k)
+            {
+                VertexCacheEntry key =
                 {
-                    v[2] = (v[2] < 0) ? v[2] + numVertices - 1 : v[2] - 1;
-                    vt[2] = (vt[2] < 0) ? vt[2] + numTexCoords - 1 : vt[2] - 1;
+                    t.v[k],
+                    hasTexCoords ? texCoordAliases[t.vt[k]] : zeroTexCoordAlias,
+                    hasNormals ? normalAliases[t.vn[k]] : zeroNormalAlias,
+                    count
+                };
+                size_t slot = HashIndices(key.v, key.vt, key.vn) & mask;
+
+                while (table[slot].index >= 0 &&
+                       (table[slot].v != key.v || table[slot].vt != key.vt || table[slot].vn != key.vn))
+                {
+                    slot = (slot + 1) & mask;
+                }
 
-                    addTrianglePosTexCoord(numTriangles++, activeMaterial,
-                        v[0], v[1], v[2], vt[0], vt[1], vt[2]);
+                if (table[slot].index >= 0)
+                    continue;
 
-                    v[1] = v[2];
-                    vt[1] = vt[2];
-                }
-            }
-            else // v
-            {
-                sscanf(buffer, "%d", &v[0]);
-                fscanf(pFile, "%d", &v[1]);
-                fscanf(pFile, "%d", &v[2]);
+                table[slot] = key;
 
-                v[0] = (v[0] < 0) ? v[0] + numVertices - 1 : v[0] - 1;
-                v[1] = (v[1] < 0) ? v[1] + numVertices - 1 : v[1] - 1;
-                v[2] = (v[2] < 0) ? v[2] + numVertices - 1 : v[2] - 1;
+                if (++count * 2 <= static_cast<int>(table.size()))
+                    continue;
 
-                addTrianglePos(numTriangles++, activeMaterial, v[0], v[1], v[2]);
+                // Grow the table like growVertexCache() does.
 
-                v[1] = v[2];
+                std::vector<VertexCacheEntry> entries(table.size() * 2, emptyEntry);
 
-                while (fscanf(pFile, "%d", &v[2]) > 0)
+                mask = entries.size() - 1;
+
+                for (size_t e = 0; e < table.size(); ++e)
                 {
-                    v[2] = (v[2] < 0) ? v[2] + numVertices - 1 : v[2] - 1;
+                    if (table[e].index < 0)
+                        continue;
+
+                    slot = HashIndices(table[e].v, table[e].vt, table[e].vn) & mask;
 
-                    addTrianglePos(numTriangles++, activeMaterial, v[0], v[1], v[2]);
+                    while (entries[slot].index >= 0)
+                        slot = (slot + 1) & mask;
 
-                    v[1] = v[2];
+                    entries[slot] = table[e];
                 }
+
+                table.swap(entries);
             }
-            break;
+        }
+    }
 
-        case 'u': // usemtl
-            fgets(buffer, sizeof(buffer), pFile);
-            sscanf(buffer, "%s %s", buffer, buffer);
-            name = buffer;
-            iter = m_materialCache.find(buffer);
-            activeMaterial = (iter == m_materialCache.end()) ? 0 : iter->second;
-            break;
+    return count;
+}
 
-        case 'v': // v, vn, or vt.
-            switch (buffer[1])
-            {
-            case '\0': // v
-                fscanf(pFile, "%f %f %f",
-                    &m_vertexCoords[3 * numVertices],
-                    &m_vertexCoords[3 * numVertices + 1],
-                    &m_vertexCoords[3 * numVertices + 2]);
-                ++numVertices;
-                break;
+int ModelOBJ::countBoundaryEdges(const std::vector<ImportChunk> &chunks) const
+{
+    // Number of edges between the OBJ position indices that are used by a
+    // single triangle, to report how many of them welding closed.
 
-            case 'n': // vn
-                fscanf(pFile, "%f %f %f",
-                    &m_normals[3 * numNormals],
-                    &m_normals[3 * numNormals + 1],
-                    &m_normals[3 * numNormals + 2]);
-                ++numNormals;
-                break;
+    int keyBits = EdgeKeyBits(static_cast<int>(m_vertexCoords.size() / 3));
+    std::vector<unsigned long long> keys;
+    size_t numEdges = 0;
+    int count = 0;
 
-            case 't': // vt
-                fscanf(pFile, "%f %f",
-                    &m_textureCoords[2 * numTexCoords],
-                    &m_textureCoords[2 * numTexCoords + 1]);
-                ++numTexCoords;
-                break;
+    for (size_t i = 0; i < chunks.size(); ++i)
+        numEdges += chunks[i].triangles.size() * 3;
 
-            default:
-                break;
-            }
-            break;
+    keys.reserve(numEdges);
 
-        default:
-            fgets(buffer, sizeof(buffer), pFile);
-            break;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        const std::vector<ObjTriangle> &triangles = chunks[i].triangles;
+
+        for (size_t j = 0; j < triangles.size(); ++j)
+        {
+            const ObjTriangle &t = triangles[j];
+
+            keys.push_back(MakeEdgeKey(t.v[0], t.v[1], keyBits));
+            keys.push_back(MakeEdgeKey(t.v[1], t.v[2], keyBits));
+            keys.push_back(MakeEdgeKey(t.v[0], t.v[2], keyBits));
         }
     }
+
+    std::sort(keys.begin(), keys.end());
+
+    for (size_t i = 0, j = 0; i < keys.size(); i = j)
+    {
+        j = i + 1;
+
+        while (j < keys.size() && keys[j] == keys[i])
+            ++j;
+
+        if (j - i == 1)
+            ++count;
+    }
+
+    return count;
 }
 
 bool ModelOBJ::importMaterials(const char *pszFilename)
@@ -1150,33 +6269,10 @@ bool ModelOBJ::importMaterials(const char *pszFilename)
 
     Material *pMaterial = 0;
     int illum = 0;
-    int numMaterials = 0;
     char buffer[256] = {0};
 
-    // Count the number of materials in the MTL file.
-    while (fscanf(pFile, "%s", buffer) != EOF)
-    {
-        switch (buffer[0])
-        {
-        case 'n': // newmtl
-            ++numMaterials;
-            fgets(buffer, sizeof(buffer), pFile);
-            sscanf(buffer, "%s %s", buffer, buffer);
-            break;
-
-        default:
-            fgets(buffer, sizeof(buffer), pFile);
-            break;
-        }
-    }
-
-    rewind(pFile);
-
-    m_numberOfMaterials = numMaterials;
-    numMaterials = 0;
-    m_materials.resize(m_numberOfMaterials);
-
-    // Load the materials in the MTL file.
+    // Load the materials in the MTL file in a single pass. The materials are
+    // appended so that several material libraries can be loaded in turn.
     while (fscanf(pFile, "%s", buffer) != EOF)
     {
         switch (buffer[0])
@@ -1275,7 +6371,8 @@ bool ModelOBJ::importMaterials(const char *pszFilename)
             fgets(buffer, sizeof(buffer), pFile);
             sscanf(buffer, "%s %s", buffer, buffer);
 
-            pMaterial = &m_materials[numMaterials];
+            m_materials.push_back(Material());
+            pMaterial = &m_materials.back();
             pMaterial->ambient[0] = 0.2f;
             pMaterial->ambient[1] = 0.2f;
             pMaterial->ambient[2] = 0.2f;
@@ -1294,8 +6391,7 @@ bool ModelOBJ::importMaterials(const char *pszFilename)
             pMaterial->colorMapFilename.clear();
             pMaterial->bumpMapFilename.clear();
 
-            m_materialCache[pMaterial->name] = numMaterials;
-            ++numMaterials;
+            m_materialCache[pMaterial->name] = static_cast<int>(m_materials.size()) - 1;
             break;
 
         default:
@@ -1304,6 +6400,7 @@ bool ModelOBJ::importMaterials(const char *pszFilename)
         }
     }
 
+    m_numberOfMaterials = static_cast<int>(m_materials.size());
     fclose(pFile);
     return true;
 }
\ No newline at end of file
@@ -3,10 +3,13 @@
 #if !defined(MODEL_OBJ_H)
 #define MODEL_OBJ_H
 
+#include <atomic>
+#include <cmath>
 #include <cstdio>
 #include <map>
 #include <string>
 #include <vector>
+#include "mapped_file.h"
 
 //-----------------------------------------------------------------------------
 // Alias|Wavefront OBJ file loader.
@@ -20,6 +23,13 @@
 //    it isn't then the MTL file will fail to load and a default material is
 //    used instead.
 // 4. This loader triangulates all polygonal faces during importing.
+//
+// import() parses the OBJ file, or loads the binary cache saveCache() wrote
+// for it, and prepares the model for drawing: the triangles are sorted by
+// material and reordered for the vertex cache, and the model gets a welded
+// position stream, meshlets, levels of detail and 16-bit index buffers.
+// Adjacency and tangents are built on demand. The functions doing each step
+// describe it.
 //-----------------------------------------------------------------------------
 
 class ModelOBJ
@@ -47,27 +57,155 @@ public:
         float bitangent[3];
     };
 
+    // Compact vertex format built by buildCompactVertices(). Positions are
+    // decoded with position * scale + bias, see getPositionDecode().
+    struct CompactVertex
+    {
+        short position[3];          // snorm16 relative to the model's bounds
+        unsigned short texCoord[2]; // half floats
+        short normal[2];            // octahedral encoded snorm16
+        short padding;              // keeps the stride a multiple of 4 bytes
+    };
+
     struct Mesh
     {
         int startIndex;
         int triangleCount;
         const Material *pMaterial;
+        int baseVertex;         // added to the 16-bit vertex indices
+        int basePosition;       // added to the 16-bit position indices
+        bool shortIndices;      // false if the mesh needs 32-bit indices
+        bool shortPositions;    // position indices fit 16 bits as well
+        bool shortAdjacency;    // and so do the adjacency indices
+        int startMeshlet;
+        int meshletCount;
+    };
+
+    // A run of consecutive triangles of a mesh that can be culled as a
+    // whole. A viewer at eye sees none of its triangles' front faces if
+    // dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius.
+    struct Meshlet
+    {
+        int startIndex;         // into the index buffers, like Mesh::startIndex
+        int triangleCount;
+        float center[3];        // bounding sphere
+        float radius;
+        float coneAxis[3];      // average direction of the face normals
+        float coneCutoff;       // sine of the cone's half angle, 1 if too wide
+    };
+
+    // A simplified level of detail. Its meshes, getLodMesh(startMesh) and on,
+    // index the LOD index buffers and always use 32-bit indices.
+    struct Lod
+    {
+        float ratio;            // requested fraction of the model's triangles
+        int startMesh;
+        int meshCount;
+        int triangleCount;
+    };
+
+    // Progress of an import(), safe to read from other threads. The legacy
+    // loader only reports the parsed bytes once the whole file is read.
+    struct ImportProgress
+    {
+        enum Stage
+        {
+            STAGE_WAITING,
+            STAGE_LOADING_CACHE,
+            STAGE_PARSING,
+            STAGE_BUILDING_TRIANGLES,
+            STAGE_POST_PROCESSING,
+            STAGE_FINISHED
+        };
+
+        std::atomic<int> stage;
+        std::atomic<long long> bytesParsed;
+        std::atomic<long long> totalBytes;
+
+        ImportProgress();
+        void reset();
     };
 
-	struct Edge
-	{
-		int startIndex;		// the smaller one
-		int endIndex;		// the larger one
-		bool operator<(const Edge& rhs) const;
-	};
+    struct ImportOptions
+    {
+        enum Loader
+        {
+            LOADER_LEGACY,      // two pass fscanf() based importer
+            LOADER_MMAP,        // single pass memory mapped importer
+            LOADER_STREAM       // single pass importer for gzip files and pipes
+        };
+
+        Loader loader;
+        bool rebuildNormals;
+        bool useCache;          // load an up to date "<filename>.cache" (and
+                                // let the out-of-core import replace it)
+        int threadCount;        // import threads, 0 = one per core
+        bool compactVertices;   // replace the float vertices by compact ones
+        bool optimizeTriangleOrder; // reorder triangles for the vertex cache
+        bool optimizeOverdraw;  // then sort clusters of them to cut overdraw
+        std::vector<float> lodRatios;   // simplified levels to build, finest first
+        float weldPositionTolerance;    // weld positions, texture coordinates
+        float weldTexCoordTolerance;    // and normals whose components all
+        float weldNormalTolerance;      // differ by at most this, 0 = off
+        bool outOfCore;         // import through temporary files, for models larger than memory
+        size_t outOfCoreMemory; // bytes of sort buffers the out-of-core import uses
+        ImportProgress *pProgress;  // optional, updated during import()
+
+        ImportOptions();
+
+        // Applies a command line option shared by the viewer and the tools,
+        // e.g. "--lods=0.5,0.25". Returns false, leaving the options as they
+        // were, for anything else and for values out of range.
+        bool parse(const char *pszArgument);
+    };
+
+    // Counters gathered during the last import().
+    struct ImportStatistics
+    {
+        long long vertexCacheLookups;
+        long long vertexCacheProbes;
+        int vertexCacheCapacity;
+        int uniqueVertices;
+        float vertexCacheLoadFactor;
+        int materialRuns;       // runs of triangles with the same material
+        int materialBatches;    // and the runs left after sorting by material
+        int boundaryEdges;      // edges used by a single triangle and
+        int nonManifoldEdges;   // by more than two, see buildHalfEdges()
+        float acmrBefore;       // average post-transform cache misses per
+        float acmrAfter;        // triangle before and after optimizing
+        int overdrawClusters;   // clusters sorted by the overdraw pass
+        int weldedVertices;     // vertices and boundary edges removed by
+        int weldedBoundaryEdges;    // welding nearly identical attributes
+        bool loadedFromCache;   // if set the counters above are all zero
+        bool importedOutOfCore; // the import wrote and loaded the cache file
+        int sortRuns;           // runs the out-of-core sorts spilled to disk
+    };
+
+    // Memory held by one of the model's buffers, see memoryUsage().
+    struct BufferUsage
+    {
+        const char *pszName;
+        size_t bytes;           // allocated, or mapped from the cache file
+        bool mapped;            // used in place from the cache file
+    };
 
     ModelOBJ();
     ~ModelOBJ();
 
     void destroy();
+    void swap(ModelOBJ &other);
     bool import(const char *pszFilename, bool rebuildNormals = false);
+    bool import(const char *pszFilename, const ImportOptions &options);
     void normalize(float scaleTo = 1.0f, bool center = true);
     void reverseWinding();
+    void buildCompactVertices();
+    void buildHalfEdges(int threadCount = 0);
+    void generateAdjacency(int threadCount = 0);
+    void generateTangents(int threadCount = 0);
+    std::vector<BufferUsage> memoryUsage() const;
+
+    bool loadCache(const char *pszFilename);
+    bool saveCache(const char *pszFilename) const;
 
     // Getter methods.
 
@@ -76,6 +214,7 @@ public:
     float getHeight() const;
     float getLength() const;
     float getRadius() const;
+    void getTransform(float &scale, float offset[3]) const;
 
     const int *getIndexBuffer() const;
 	const int *getIndexBufferAdj() const;
@@ -83,26 +222,111 @@ public:
 
     const Material &getMaterial(int i) const;
     const Mesh &getMesh(int i) const;
+    const Meshlet &getMeshlet(int i) const;
+    const Lod &getLod(int i) const;
+    const Mesh &getLodMesh(int i) const;
 
     int getNumberOfIndices() const;
     int getNumberOfMaterials() const;
     int getNumberOfMeshes() const;
+    int getNumberOfMeshlets() const;
+    int getNumberOfLods() const;
     int getNumberOfTriangles() const;
     int getNumberOfVertices() const;
 
     const std::string &getPath() const;
+    const ImportStatistics &getImportStatistics() const;
 
     const Vertex &getVertex(int i) const;
     const Vertex *getVertexBuffer() const;
     int getVertexSize() const;
 
+    const float *getPositionBuffer() const;
+    const int *getPositionIndexBuffer() const;
+    const int *getPositionIndexBufferAdj() const;
+    int getNumberOfPositions() const;
+    int getPositionSize() const;
+
+    const unsigned short *getShortIndexBuffer() const;
+    const unsigned short *getShortPositionIndexBuffer() const;
+    const unsigned short *getShortPositionIndexBufferAdj() const;
+    int getNumberOfShortTriangles() const;
+    int getNumberOfShortPositionTriangles() const;
+
+    const int *getLodIndexBuffer() const;
+    const int *getLodPositionIndexBuffer() const;
+    int getNumberOfLodIndices() const;
+
+    const int *getHalfEdgeTwins() const;
+    const int *getPositionHalfEdges() const;
+    static int getNextHalfEdge(int halfEdge);
+    static int getPrevHalfEdge(int halfEdge);
+
+    const CompactVertex *getCompactVertexBuffer() const;
+    int getCompactVertexSize() const;
+    void getPositionDecode(float scale[3], float bias[3]) const;
+
+    bool hasAdjacency() const;
+    bool hasCompactVertices() const;
+    bool hasHalfEdges() const;
+
     bool hasNormals() const;
     bool hasPositions() const;
     bool hasTangents() const;
     bool hasTextureCoords() const;
 
 private:
-	void addTriangleWithAdj(int index, int v0, int v1, int v2);
+    // A single triangle of a parsed OBJ face. Indices are zero based.
+    struct ObjTriangle
+    {
+        int v[3];
+        int vt[3];
+        int vn[3];
+        int materialSlot;       // index into the parsed usemtl names
+        int format;             // which vertex attributes the face uses
+        int relative;           // RELATIVE_* flags of chunk relative indices
+
+        void shiftFanCorner();
+    };
+
+    enum
+    {
+        RELATIVE_V = 1 << 0,    // shifted left by the corner number
+        RELATIVE_VT = 1 << 3,
+        RELATIVE_VN = 1 << 6,
+        RELATIVE_CORNER_1 = (RELATIVE_V | RELATIVE_VT | RELATIVE_VN) << 1,
+        RELATIVE_CORNER_2 = (RELATIVE_V | RELATIVE_VT | RELATIVE_VN) << 2
+    };
+
+    // Open addressing vertex cache entry keyed on a vertex's index triple.
+    struct VertexCacheEntry
+    {
+        int v;
+        int vt;
+        int vn;
+        int index;              // index into m_vertexBuffer, -1 if empty
+    };
+
+    // Header, tables and section offsets of a cache file, see layoutCache().
+    struct CacheLayout;
+
+    // Geometry parsed from a line aligned range of an OBJ file.
+    struct ImportChunk
+    {
+        std::vector<float> vertexCoords;
+        std::vector<float> textureCoords;
+        std::vector<float> normals;
+        std::vector<ObjTriangle> triangles;
+        std::vector<std::string> materialNames;
+        std::vector<std::string> materialLibraries;
+        int activeSlot;         // usemtl slot in effect at the end of the chunk
+
+        void resolveIndices(ObjTriangle &triangle, int corner,
+            int v, int vt, int vn) const;
+    };
+
+    void addDefaultMaterial();
+    void attachImportedBuffers();
     void addTrianglePos(int index, int material,
         int v0, int v1, int v2);
     void addTrianglePosNormal(int index, int material,
@@ -115,22 +339,63 @@ private:
         int v0, int v1, int v2,
         int vt0, int vt1, int vt2,
         int vn0, int vn1, int vn2);
-    int addVertex(int hash, const Vertex *pVertex);
+    int addVertex(int v, int vt, int vn, const Vertex *pVertex);
     void bounds(float center[3], float &width, float &height,
-        float &length, float &radius) const;
+        float &length, float &radius, int threadCount) const;
+    void buildLods(const std::vector<float> &ratios, int threadCount);
     void buildMeshes();
-    void generateNormals();
-    void generateTangents();
+    void buildMeshlets();
+    void buildPositionStream();
+    void buildShortIndexBuffers();
+    void findPositionHalfEdges();
+    void generateNormals(int threadCount);
+    void growVertexCache();
     void importGeometryFirstPass(FILE *pFile);
-    void importGeometrySecondPass(FILE *pFile);
+    void importGeometrySecondPass(FILE *pFile, ImportChunk &chunk);
+    bool importGeometryMapped(const char *pszFilename, const ImportOptions &options);
+    bool importGeometryStream(const char *pszFilename, const ImportOptions &options);
+    bool importOutOfCore(const char *pszFilename, const ImportOptions &options);
+    bool finishGeometryImport(std::vector<ImportChunk> &chunks,
+        const ImportOptions &options);
+    void parseGeometry(const char *pData, const char *pEnd,
+        ImportChunk &chunk) const;
+    bool mergeChunks(std::vector<ImportChunk> &chunks,
+        std::vector<std::string> &materialNames);
+    bool hasValidIndices(const std::vector<ImportChunk> &chunks) const;
+    void buildTriangles(const std::vector<ImportChunk> &chunks,
+        const std::vector<std::string> &materialNames);
+    void weldAttributes(std::vector<ImportChunk> &chunks,
+        const ImportOptions &options);
+    int countVertices(const std::vector<ImportChunk> &chunks) const;
+    int countBoundaryEdges(const std::vector<ImportChunk> &chunks) const;
     bool importMaterials(const char *pszFilename);
+    bool importModel(const char *pszFilename, const ImportOptions &options);
+    void optimizeTriangleOrder(int threadCount, bool reduceOverdraw);
+    void initVertexCache();
+    bool hasLodRatios(const std::vector<float> &ratios) const;
+    bool hasWeldTolerances(const ImportOptions &options) const;
+    bool isCacheCurrent(const char *pszCacheFilename,
+        const char *pszObjFilename) const;
+    void layoutCache(CacheLayout &layout) const;
+    void releaseHalfEdges();
+    void releaseImportBuffers();
+    void releaseVertexCache();
+    void reportBytesParsed(long long bytes) const;
+    void setImportStage(int stage) const;
     void scale(float scaleFactor, float offset[3]);
-	void matchAdjVertex(int vert1Ind, int vert2Ind, int vert3IndBuf, int vert3OppPos);
+    void sortTrianglesByMaterial();
+    void splitMeshes();
+    void groupShortMeshes();
 
     bool m_hasPositions;
     bool m_hasTextureCoords;
     bool m_hasNormals;
     bool m_hasTangents;
+    bool m_hasAdjacency;
+    bool m_hasHalfEdges;
+    bool m_normalsRebuilt;
+    bool m_triangleOrderOptimized;
+    bool m_overdrawOptimized;
 
     int m_numberOfVertexCoords;
     int m_numberOfTextureCoords;
@@ -138,52 +403,120 @@ private:
     int m_numberOfTriangles;
     int m_numberOfMaterials;
     int m_numberOfMeshes;
+    int m_numberOfVertices;
+    int m_numberOfPositions;
+    int m_numberOfShortTriangles;
+    int m_numberOfShortPositionTriangles;
+    int m_numberOfLodIndices;
 
     float m_center[3];
     float m_width;
     float m_height;
     float m_length;
     float m_radius;
+    float m_transformScale;     // position = (stored + offset) * scale
+    float m_transformOffset[3];
+    float m_positionDecodeScale[3];
+    float m_positionDecodeBias[3];
+    float m_weldTolerances[3];  // position, texture coordinate, normal
 
     std::string m_directoryPath;
+    std::vector<std::string> m_materialLibraries;
 
     std::vector<Mesh> m_meshes;
+    std::vector<Meshlet> m_meshlets;
+    std::vector<Lod> m_lods;
+    std::vector<float> m_lodRatios;     // as requested, m_lods may have fewer
+    std::vector<Mesh> m_lodMeshes;
     std::vector<Material> m_materials;
     std::vector<Vertex> m_vertexBuffer;
     std::vector<int> m_indexBuffer;
 	std::vector<int> m_indexBufferAdj;
     std::vector<int> m_attributeBuffer;
+    std::vector<float> m_positionBuffer;
+    std::vector<int> m_positionIndexBuffer;
+    std::vector<int> m_positionIndexBufferAdj;
+    std::vector<unsigned short> m_shortIndexBuffer;
+    std::vector<unsigned short> m_shortPositionIndexBuffer;
+    std::vector<unsigned short> m_shortPositionIndexBufferAdj;
+    std::vector<int> m_lodIndexBuffer;
+    std::vector<int> m_lodPositionIndexBuffer;
+    std::vector<CompactVertex> m_compactVertexBuffer;
     std::vector<float> m_vertexCoords;
     std::vector<float> m_textureCoords;
     std::vector<float> m_normals;
 
+    // The half-edge structure, see buildHalfEdges(). Twins are -1 on
+    // boundaries.
+    std::vector<int> m_halfEdgeTwins;
+    std::vector<int> m_positionHalfEdges;
+
+    // The model's final vertex and index buffers. These point either into
+    // the vectors above or into the memory mapped cache file; the 16-bit
+    // adjacency buffer is never cached. The short index buffers are laid
+    // out like the start of the 32-bit ones; entries of meshes without
+    // shortIndices (or shortPositions, or for adjacency, shortAdjacency)
+    // are zero.
+    Vertex *m_pVertexBuffer;
+    int *m_pIndexBuffer;
+    int *m_pIndexBufferAdj;
+    float *m_pPositionBuffer;
+    int *m_pPositionIndexBuffer;
+    int *m_pPositionIndexBufferAdj;
+    unsigned short *m_pShortIndexBuffer;
+    unsigned short *m_pShortPositionIndexBuffer;
+    unsigned short *m_pShortPositionIndexBufferAdj;
+    int *m_pLodIndexBuffer;
+    int *m_pLodPositionIndexBuffer;
+    MappedFile m_cacheFile;
+    std::string m_cacheTempFilename;    // mapped under a temporary name and
+    std::string m_cacheTargetFilename;  // moved here once released, see destroy()
+
     std::map<std::string, int> m_materialCache;
-    std::map<int, std::vector<int> > m_vertexCache;
-	std::map<Edge, int> m_edgeAdjCache;
+    std::vector<VertexCacheEntry> m_vertexCache;
+    std::vector<int> m_texCoordAliases;
+    std::vector<int> m_normalAliases;
+    int m_zeroTexCoordAlias;
+    int m_zeroNormalAlias;
+
+    ImportStatistics m_importStatistics;
+    ImportProgress *m_pProgress;
 };
 
 //-----------------------------------------------------------------------------
 
 inline void ModelOBJ::getCenter(float &x, float &y, float &z) const
-{ x = m_center[0]; y = m_center[1]; z = m_center[2]; }
+{
+    x = (m_center[0] + m_transformOffset[0]) * m_transformScale;
+    y = (m_center[1] + m_transformOffset[1]) * m_transformScale;
+    z = (m_center[2] + m_transformOffset[2]) * m_transformScale;
+}
 
 inline float ModelOBJ::getWidth() const
-{ return m_width; }
+{ return m_width * fabsf(m_transformScale); }
 
 inline float ModelOBJ::getHeight() const
-{ return m_height; }
+{ return m_height * fabsf(m_transformScale); }
 
 inline float ModelOBJ::getLength() const
-{ return m_length; }
+{ return m_length * fabsf(m_transformScale); }
 
 inline float ModelOBJ::getRadius() const
-{ return m_radius; }
+{ return m_radius * fabsf(m_transformScale); }
+
+inline void ModelOBJ::getTransform(float &scale, float offset[3]) const
+{
+    scale = m_transformScale;
+    offset[0] = m_transformOffset[0];
+    offset[1] = m_transformOffset[1];
+    offset[2] = m_transformOffset[2];
+}
 
 inline const int *ModelOBJ::getIndexBuffer() const
-{ return &m_indexBuffer[0]; }
+{ return m_pIndexBuffer; }
 
 inline const int *ModelOBJ::getIndexBufferAdj() const
-{ return &m_indexBufferAdj[0]; }
+{ return m_pIndexBufferAdj; }
 
 inline int ModelOBJ::getIndexSize() const
 { return static_cast<int>(sizeof(int)); }
@@ -194,6 +527,15 @@ inline const ModelOBJ::Material &ModelOBJ::getMaterial(int i) const
 inline const ModelOBJ::Mesh &ModelOBJ::getMesh(int i) const
 { return m_meshes[i]; }
 
+inline const ModelOBJ::Meshlet &ModelOBJ::getMeshlet(int i) const
+{ return m_meshlets[i]; }
+
+inline const ModelOBJ::Lod &ModelOBJ::getLod(int i) const
+{ return m_lods[i]; }
+
+inline const ModelOBJ::Mesh &ModelOBJ::getLodMesh(int i) const
+{ return m_lodMeshes[i]; }
+
 inline int ModelOBJ::getNumberOfIndices() const
 { return m_numberOfTriangles * 3; }
 
@@ -203,24 +545,108 @@ inline int ModelOBJ::getNumberOfMaterials() const
 inline int ModelOBJ::getNumberOfMeshes() const
 { return m_numberOfMeshes; }
 
+inline int ModelOBJ::getNumberOfMeshlets() const
+{ return static_cast<int>(m_meshlets.size()); }
+
+inline int ModelOBJ::getNumberOfLods() const
+{ return static_cast<int>(m_lods.size()); }
+
 inline int ModelOBJ::getNumberOfTriangles() const
 { return m_numberOfTriangles; }
 
 inline int ModelOBJ::getNumberOfVertices() const
-{ return static_cast<int>(m_vertexBuffer.size()); }
+{ return m_numberOfVertices; }
 
 inline const std::string &ModelOBJ::getPath() const
 { return m_directoryPath; }
 
+inline const ModelOBJ::ImportStatistics &ModelOBJ::getImportStatistics() const
+{ return m_importStatistics; }
+
 inline const ModelOBJ::Vertex &ModelOBJ::getVertex(int i) const
-{ return m_vertexBuffer[i]; }
+{ return m_pVertexBuffer[i]; }
 
 inline const ModelOBJ::Vertex *ModelOBJ::getVertexBuffer() const
-{ return &m_vertexBuffer[0]; }
+{ return m_pVertexBuffer; }
 
 inline int ModelOBJ::getVertexSize() const
 { return static_cast<int>(sizeof(Vertex)); }
 
+inline const float *ModelOBJ::getPositionBuffer() const
+{ return m_pPositionBuffer; }
+
+inline const int *ModelOBJ::getPositionIndexBuffer() const
+{ return m_pPositionIndexBuffer; }
+
+inline const int *ModelOBJ::getPositionIndexBufferAdj() const
+{ return m_pPositionIndexBufferAdj; }
+
+inline int ModelOBJ::getNumberOfPositions() const
+{ return m_numberOfPositions; }
+
+inline int ModelOBJ::getPositionSize() const
+{ return static_cast<int>(sizeof(float) * 3); }
+
+inline const unsigned short *ModelOBJ::getShortIndexBuffer() const
+{ return m_pShortIndexBuffer; }
+
+inline const unsigned short *ModelOBJ::getShortPositionIndexBuffer() const
+{ return m_pShortPositionIndexBuffer; }
+
+inline const unsigned short *ModelOBJ::getShortPositionIndexBufferAdj() const
+{ return m_pShortPositionIndexBufferAdj; }
+
+inline int ModelOBJ::getNumberOfShortTriangles() const
+{ return m_numberOfShortTriangles; }
+
+inline int ModelOBJ::getNumberOfShortPositionTriangles() const
+{ return m_numberOfShortPositionTriangles; }
+
+inline const int *ModelOBJ::getLodIndexBuffer() const
+{ return m_pLodIndexBuffer; }
+
+inline const int *ModelOBJ::getLodPositionIndexBuffer() const
+{ return m_pLodPositionIndexBuffer; }
+
+inline int ModelOBJ::getNumberOfLodIndices() const
+{ return m_numberOfLodIndices; }
+
+inline const int *ModelOBJ::getHalfEdgeTwins() const
+{ return m_halfEdgeTwins.empty() ? 0 : &m_halfEdgeTwins[0]; }
+
+inline const int *ModelOBJ::getPositionHalfEdges() const
+{ return m_positionHalfEdges.empty() ? 0 : &m_positionHalfEdges[0]; }
+
+inline int ModelOBJ::getNextHalfEdge(int halfEdge)
+{ return (halfEdge % 3 == 2) ? halfEdge - 2 : halfEdge + 1; }
+
+inline int ModelOBJ::getPrevHalfEdge(int halfEdge)
+{ return (halfEdge % 3 == 0) ? halfEdge + 2 : halfEdge - 1; }
+
+inline const ModelOBJ::CompactVertex *ModelOBJ::getCompactVertexBuffer() const
+{ return m_compactVertexBuffer.empty() ? 0 : &m_compactVertexBuffer[0]; }
+
+inline int ModelOBJ::getCompactVertexSize() const
+{ return static_cast<int>(sizeof(CompactVertex)); }
+
+inline void ModelOBJ::getPositionDecode(float scale[3], float bias[3]) const
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        scale[i] = m_positionDecodeScale[i];
+        bias[i] = m_positionDecodeBias[i];
+    }
+}
+
+inline bool ModelOBJ::hasAdjacency() const
+{ return m_hasAdjacency; }
+
+inline bool ModelOBJ::hasCompactVertices() const
+{ return !m_compactVertexBuffer.empty(); }
+
+inline bool ModelOBJ::hasHalfEdges() const
+{ return m_hasHalfEdges; }
+
 inline bool ModelOBJ::hasNormals() const
 { return m_hasNormals; }
 
@@ -233,12 +659,4 @@ inline bool ModelOBJ::hasTangents() const
 inline bool ModelOBJ::hasTextureCoords() const
 { return m_hasTextureCoords; }
 
-inline bool ModelOBJ::Edge::operator<(const Edge& rhs) const
-{
-	return (startIndex == rhs.startIndex) ? 
-		endIndex < rhs.endIndex :
-		startIndex < rhs.startIndex;
-}
-
-
 #endif
\ No newline at end of file
@@ -0,0 +1,45 @@
+// Copyright info of this file is left out for the assignment.
+
+#if !defined(PARALLEL_FOR_H)
+#define PARALLEL_FOR_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Minimal fork-join helpers shared by the model import and geometry kernels.
+//-----------------------------------------------------------------------------
+
+// Returns threadCount, or one thread per core if threadCount is 0 or less.
+inline int ResolveThreadCount(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+
+    return std::max(threadCount, 1);
+}
+
+// Splits [0, count) into threadCount contiguous ranges and calls
+// function(thread, begin, end) for each one. The ranges only depend on
+// threadCount and count. The calling thread handles the first range.
+template <typename Function>
+void ParallelFor(int threadCount, int count, Function function)
+{
+    std::vector<std::thread> workers;
+
+    for (int i = 1; i < threadCount; ++i)
+    {
+        int begin = static_cast<int>(static_cast<long long>(count) * i / threadCount);
+        int end = static_cast<int>(static_cast<long long>(count) * (i + 1) / threadCount);
+
+        workers.push_back(std::thread(function, i, begin, end));
+    }
+
+    function(0, 0, static_cast<int>(static_cast<long long>(count) / threadCount));
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+#endif
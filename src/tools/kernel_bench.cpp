@@ -0,0 +1,212 @@
+// Copyright info of this file is left out for the assignment.
+//
+// Microbenchmark for the geometry kernels in vertex_kernels.h. Every kernel
+// is run on copies of an imported model's buffers, once with the scalar
+// reference loop and once with the SSE/threaded version. The results must be
+// bitwise identical; the best of several runs of each is printed. Last, the
+// edge counts of the import statistics are checked to stay the same when
+// generateAdjacency() builds the half-edges again.
+//
+// Usage: kernel_bench [--runs=N] [--threads=N] file.obj
+//
+//-----------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "../model_obj.h"
+#include "../parallel_for.h"
+#include "../vertex_kernels.h"
+
+namespace
+{
+    typedef std::vector<ModelOBJ::Vertex> VertexArray;
+
+    double BestTime(int runs, const std::function<void()> &reset, const std::function<void()> &kernel)
+    {
+        double best = 1e30;
+
+        for (int i = 0; i < runs; ++i)
+        {
+            reset();
+
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            kernel();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            best = std::min(best, elapsed.count());
+        }
+
+        return best;
+    }
+
+    bool Report(const char *pszName, double scalarTime, double kernelTime, bool same)
+    {
+        fprintf(stdout, "%-16s scalar %8.3f ms   kernel %8.3f ms   %5.2fx   %s\n",
+            pszName, scalarTime, kernelTime, scalarTime / std::max(kernelTime, 1e-6),
+            same ? "identical" : "MISMATCH");
+
+        return same;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ModelOBJ::ImportOptions options;
+    const char *pszFilename = 0;
+    int runs = 5;
+    int threadCount = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "--runs=", 7) == 0)
+            runs = std::max(1, atoi(argv[i] + 7));
+        else if (strncmp(argv[i], "--threads=", 10) == 0)
+            threadCount = atoi(argv[i] + 10);
+        else
+            pszFilename = argv[i];
+    }
+
+    if (!pszFilename)
+    {
+        fprintf(stderr, "Usage: kernel_bench [--runs=N] [--threads=N] file.obj\n");
+        return 1;
+    }
+
+    ModelOBJ model;
+
+    if (!model.import(pszFilename, options))
+    {
+        fprintf(stderr, "%s: failed to import.\n", pszFilename);
+        return 1;
+    }
+
+    const ModelOBJ::Vertex *pSource = model.getVertexBuffer();
+    const int *pIndices = model.getIndexBuffer();
+    int numVertices = model.getNumberOfVertices();
+    int numTriangles = model.getNumberOfTriangles();
+    size_t vertexBytes = sizeof(ModelOBJ::Vertex) * numVertices;
+    VertexArray reference(pSource, pSource + numVertices);
+    VertexArray vertices(reference);
+    bool ok = true;
+
+    if (numVertices == 0)
+    {
+        fprintf(stderr, "%s: no vertices.\n", pszFilename);
+        return 1;
+    }
+
+    fprintf(stdout, "%s: %d vertices, %d triangles, %d threads, SSE %s.\n",
+        pszFilename, numVertices, numTriangles, ResolveThreadCount(threadCount),
+        HasSseKernels() ? "on" : "off");
+
+    // Bounds, over the interleaved vertices.
+    {
+        float scalarMin[3], scalarMax[3], kernelMin[3], kernelMax[3];
+        std::function<void()> noReset = [] {};
+
+        double scalarTime = BestTime(runs, noReset, [&]
+        {
+            ComputeBoundsScalar(reference[0].position, numVertices, sizeof(ModelOBJ::Vertex), scalarMin, scalarMax);
+        });
+        double kernelTime = BestTime(runs, noReset, [&]
+        {
+            ComputeBounds(reference[0].position, numVertices, sizeof(ModelOBJ::Vertex), kernelMin, kernelMax, threadCount);
+        });
+
+        ok &= Report("bounds", scalarTime, kernelTime,
+            memcmp(scalarMin, kernelMin, sizeof(scalarMin)) == 0 &&
+            memcmp(scalarMax, kernelMax, sizeof(scalarMax)) == 0);
+    }
+
+    // Normals.
+    {
+        VertexArray scalarResult(reference);
+
+        double scalarTime = BestTime(runs, [] {}, [&]
+        {
+            ComputeNormalsScalar(&scalarResult[0], numVertices, pIndices, numTriangles);
+        });
+        vertices = reference;
+        double kernelTime = BestTime(runs, [] {}, [&]
+        {
+            ComputeNormals(&vertices[0], numVertices, pIndices, numTriangles, threadCount);
+        });
+
+        ok &= Report("normals", scalarTime, kernelTime,
+            memcmp(&scalarResult[0], &vertices[0], vertexBytes) == 0);
+    }
+
+    // Tangents, on top of the normals above.
+    {
+        VertexArray scalarResult(vertices);
+
+        double scalarTime = BestTime(runs, [] {}, [&]
+        {
+            ComputeTangentsScalar(&scalarResult[0], numVertices, pIndices, numTriangles);
+        });
+        double kernelTime = BestTime(runs, [] {}, [&]
+        {
+            ComputeTangents(&vertices[0], numVertices, pIndices, numTriangles, threadCount);
+        });
+
+        ok &= Report("tangents", scalarTime, kernelTime,
+            memcmp(&scalarResult[0], &vertices[0], vertexBytes) == 0);
+    }
+
+    // Normal flip, as done by reverseWinding().
+    {
+        VertexArray scalarResult(reference);
+
+        double scalarTime = BestTime(runs, [&] { scalarResult = reference; }, [&]
+        {
+            FlipNormalsScalar(&scalarResult[0], numVertices);
+        });
+        double kernelTime = BestTime(runs, [&] { vertices = reference; }, [&]
+        {
+            FlipNormals(&vertices[0], numVertices, threadCount);
+        });
+
+        ok &= Report("flip normals", scalarTime, kernelTime,
+            memcmp(&scalarResult[0], &vertices[0], vertexBytes) == 0);
+    }
+
+    // Edge counts, first from the half-edges that rebuilding the normals
+    // builds and import() releases, then from generateAdjacency(), which
+    // builds them again.
+    {
+        ModelOBJ::ImportOptions rebuildOptions(options);
+        ModelOBJ rebuilt;
+
+        rebuildOptions.rebuildNormals = true;
+        rebuildOptions.threadCount = threadCount;
+
+        if (!rebuilt.import(pszFilename, rebuildOptions))
+        {
+            fprintf(stderr, "%s: failed to import.\n", pszFilename);
+            return 1;
+        }
+
+        ModelOBJ::ImportStatistics imported = rebuilt.getImportStatistics();
+
+        rebuilt.generateAdjacency(threadCount);
+
+        const ModelOBJ::ImportStatistics &adjacency = rebuilt.getImportStatistics();
+        bool same = imported.boundaryEdges == adjacency.boundaryEdges &&
+            imported.nonManifoldEdges == adjacency.nonManifoldEdges;
+
+        fprintf(stdout, "%-16s boundary %d, non-manifold %d   %s\n", "edge counts",
+            adjacency.boundaryEdges, adjacency.nonManifoldEdges,
+            same ? "identical" : "MISMATCH");
+
+        ok &= same;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+// Copyright info of this file is left out for the assignment.
+//
+// Command line converter that pre-bakes the binary cache files used by
+// ModelOBJ::import(). For every OBJ file given, "<filename>.cache" is written
+// next to it unless an up to date cache already exists.
+//
+// Usage: obj_cache [--force] [--rebuild-normals] [--no-optimize-triangles] [--no-optimize-overdraw] [--lods=R1,R2,...] [--weld=P[,T[,N]]] [--threads=N] [--out-of-core[=MB]] file.obj ...
+//
+//-----------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "../model_obj.h"
+
+int main(int argc, char **argv)
+{
+    ModelOBJ::ImportOptions options;
+    bool force = false;
+    int numFiles = 0;
+    int numFailed = 0;
+
+    // Options apply to all files, so parse them first.
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--force") == 0)
+            force = true;
+        else if (strncmp(argv[i], "--", 2) == 0)
+        {
+            // --out-of-core writes the cache itself, except with --force,
+            // which keeps it from touching the old one.
+            if (!options.parse(argv[i]))
+            {
+                fprintf(stderr, "%s: invalid option.\n", argv[i]);
+                return 1;
+            }
+        }
+        else
+            ++numFiles;
+    }
+
+    if (numFiles == 0)
+    {
+        fprintf(stderr, "Usage: obj_cache [--force] [--rebuild-normals] [--no-optimize-triangles] [--no-optimize-overdraw] [--lods=R1,R2,...] [--weld=P[,T[,N]]] [--threads=N] [--out-of-core[=MB]] file.obj ...\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "--", 2) == 0)
+            continue;
+
+        std::string cacheFilename = argv[i];
+        ModelOBJ model;
+
+        cacheFilename += ".cache";
+        options.useCache = !force;
+
+        if (!model.import(argv[i], options))
+        {
+            fprintf(stderr, "%s: failed to import.\n", argv[i]);
+            ++numFailed;
+            continue;
+        }
+
+        if (model.getImportStatistics().loadedFromCache)
+        {
+            fprintf(stdout, "%s: up to date.\n", cacheFilename.c_str());
+            continue;
+        }
+
+        if ((!model.getImportStatistics().importedOutOfCore || force) &&
+            !model.saveCache(cacheFilename.c_str()))
+        {
+            fprintf(stderr, "%s: failed to write.\n", cacheFilename.c_str());
+            ++numFailed;
+            continue;
+        }
+
+        fprintf(stdout, "%s: %d vertices, %d triangles, %d meshes, %d LODs.\n",
+            cacheFilename.c_str(), model.getNumberOfVertices(),
+            model.getNumberOfTriangles(), model.getNumberOfMeshes(),
+            model.getNumberOfLods());
+    }
+
+    return (numFailed > 0) ? 1 : 0;
+}
@@ -0,0 +1,592 @@
+// Copyright info of this file is left out for the assignment.
+//
+// The tangent kernels are based on public source code from
+// http://www.terathon.com/code/tangent.php.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "parallel_for.h"
+#include "vertex_kernels.h"
+
+#if defined(_M_X64) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VERTEX_KERNELS_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+    // Inputs with fewer vertices or triangles than this per thread aren't
+    // split any further.
+    const int MIN_PARALLEL_ELEMENTS = 1 << 15;
+
+    int KernelThreadCount(int threadCount, int count)
+    {
+        return std::max(1, std::min(ResolveThreadCount(threadCount), count / MIN_PARALLEL_ELEMENTS));
+    }
+
+    inline const float *PositionAt(const float *pPositions, int stride, int i)
+    {
+        return reinterpret_cast<const float *>(reinterpret_cast<const char *>(pPositions) +
+            static_cast<size_t>(stride) * i);
+    }
+
+    void BoundsRange(const float *pPositions, int stride, int begin, int end,
+                     float boundsMin[3], float boundsMax[3])
+    {
+        // Grows boundsMin and boundsMax by the positions in [begin, end).
+
+#if defined(VERTEX_KERNELS_SSE)
+        // Every position is loaded as four floats, so the last one is left to
+        // the scalar loop: its fourth float may lie past the end of a packed
+        // position stream or in another thread's range. _mm_min_ps(p, bound)
+        // returns bound on ties and NaNs, exactly like the scalar compares.
+
+        __m128 vMin = _mm_setr_ps(boundsMin[0], boundsMin[1], boundsMin[2], 0.0f);
+        __m128 vMax = _mm_setr_ps(boundsMax[0], boundsMax[1], boundsMax[2], 0.0f);
+        float result[4];
+
+        for (; begin < end - 1; ++begin)
+        {
+            __m128 p = _mm_loadu_ps(PositionAt(pPositions, stride, begin));
+
+            vMin = _mm_min_ps(p, vMin);
+            vMax = _mm_max_ps(p, vMax);
+        }
+
+        _mm_storeu_ps(result, vMin);
+        std::copy(result, result + 3, boundsMin);
+        _mm_storeu_ps(result, vMax);
+        std::copy(result, result + 3, boundsMax);
+#endif
+
+        for (; begin < end; ++begin)
+        {
+            const float *p = PositionAt(pPositions, stride, begin);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                if (p[k] < boundsMin[k])
+                    boundsMin[k] = p[k];
+
+                if (p[k] > boundsMax[k])
+                    boundsMax[k] = p[k];
+            }
+        }
+    }
+
+    inline void FaceNormal(const float *p0, const float *p1, const float *p2, float normal[4])
+    {
+        // Unnormalized cross product (p1 - p0) x (p2 - p0). The positions are
+        // those of ModelOBJ::Vertex, so reading a fourth float is safe.
+
+#if defined(VERTEX_KERNELS_SSE)
+        __m128 v0 = _mm_loadu_ps(p0);
+        __m128 edge1 = _mm_sub_ps(_mm_loadu_ps(p1), v0);
+        __m128 edge2 = _mm_sub_ps(_mm_loadu_ps(p2), v0);
+        __m128 edge1Yzx = _mm_shuffle_ps(edge1, edge1, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 edge1Zxy = _mm_shuffle_ps(edge1, edge1, _MM_SHUFFLE(3, 1, 0, 2));
+        __m128 edge2Yzx = _mm_shuffle_ps(edge2, edge2, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 edge2Zxy = _mm_shuffle_ps(edge2, edge2, _MM_SHUFFLE(3, 1, 0, 2));
+
+        _mm_storeu_ps(normal, _mm_sub_ps(_mm_mul_ps(edge1Yzx, edge2Zxy), _mm_mul_ps(edge1Zxy, edge2Yzx)));
+#else
+        float edge1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float edge2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+
+        normal[0] = (edge1[1] * edge2[2]) - (edge1[2] * edge2[1]);
+        normal[1] = (edge1[2] * edge2[0]) - (edge1[0] * edge2[2]);
+        normal[2] = (edge1[0] * edge2[1]) - (edge1[1] * edge2[0]);
+        normal[3] = 0.0f;
+#endif
+    }
+
+    void FaceTangent(const ModelOBJ::Vertex &v0, const ModelOBJ::Vertex &v1,
+                     const ModelOBJ::Vertex &v2, float tangent[3], float bitangent[3])
+    {
+        float edge1[3] = {0.0f, 0.0f, 0.0f};
+        float edge2[3] = {0.0f, 0.0f, 0.0f};
+        float texEdge1[2] = {0.0f, 0.0f};
+        float texEdge2[2] = {0.0f, 0.0f};
+        float det = 0.0f;
+
+        edge1[0] = v1.position[0] - v0.position[0];
+        edge1[1] = v1.position[1] - v0.position[1];
+        edge1[2] = v1.position[2] - v0.position[2];
+
+        edge2[0] = v2.position[0] - v0.position[0];
+        edge2[1] = v2.position[1] - v0.position[1];
+        edge2[2] = v2.position[2] - v0.position[2];
+
+        texEdge1[0] = v1.texCoord[0] - v0.texCoord[0];
+        texEdge1[1] = v1.texCoord[1] - v0.texCoord[1];
+
+        texEdge2[0] = v2.texCoord[0] - v0.texCoord[0];
+        texEdge2[1] = v2.texCoord[1] - v0.texCoord[1];
+
+        det = texEdge1[0] * texEdge2[1] - texEdge2[0] * texEdge1[1];
+
+        if (fabs(det) < 1e-6f)
+        {
+            tangent[0] = 1.0f;
+            tangent[1] = 0.0f;
+            tangent[2] = 0.0f;
+
+            bitangent[0] = 0.0f;
+            bitangent[1] = 1.0f;
+            bitangent[2] = 0.0f;
+        }
+        else
+        {
+            det = 1.0f / det;
+
+            tangent[0] = (texEdge2[1] * edge1[0] - texEdge1[1] * edge2[0]) * det;
+            tangent[1] = (texEdge2[1] * edge1[1] - texEdge1[1] * edge2[1]) * det;
+            tangent[2] = (texEdge2[1] * edge1[2] - texEdge1[1] * edge2[2]) * det;
+
+            bitangent[0] = (-texEdge2[0] * edge1[0] + texEdge1[0] * edge2[0]) * det;
+            bitangent[1] = (-texEdge2[0] * edge1[1] + texEdge1[0] * edge2[1]) * det;
+            bitangent[2] = (-texEdge2[0] * edge1[2] + texEdge1[0] * edge2[2]) * det;
+        }
+    }
+
+    void NormalizeNormal(ModelOBJ::Vertex &vertex)
+    {
+        float length = 1.0f / sqrtf(vertex.normal[0] * vertex.normal[0] +
+            vertex.normal[1] * vertex.normal[1] +
+            vertex.normal[2] * vertex.normal[2]);
+
+        vertex.normal[0] *= length;
+        vertex.normal[1] *= length;
+        vertex.normal[2] *= length;
+    }
+
+    void OrthogonalizeTangent(ModelOBJ::Vertex &vertex)
+    {
+        float bitangent[3] = {0.0f, 0.0f, 0.0f};
+        float nDotT = 0.0f;
+        float bDotB = 0.0f;
+        float length = 0.0f;
+
+        // Gram-Schmidt orthogonalize tangent with normal.
+
+        nDotT = vertex.normal[0] * vertex.tangent[0] +
+                vertex.normal[1] * vertex.tangent[1] +
+                vertex.normal[2] * vertex.tangent[2];
+
+        vertex.tangent[0] -= vertex.normal[0] * nDotT;
+        vertex.tangent[1] -= vertex.normal[1] * nDotT;
+        vertex.tangent[2] -= vertex.normal[2] * nDotT;
+
+        // Normalize the tangent.
+
+        length = 1.0f / sqrtf(vertex.tangent[0] * vertex.tangent[0] +
+                              vertex.tangent[1] * vertex.tangent[1] +
+                              vertex.tangent[2] * vertex.tangent[2]);
+
+        vertex.tangent[0] *= length;
+        vertex.tangent[1] *= length;
+        vertex.tangent[2] *= length;
+
+        // Calculate the handedness of the local tangent space.
+        // The bitangent vector is the cross product between the triangle face
+        // normal vector and the calculated tangent vector. The resulting
+        // bitangent vector should be the same as the bitangent vector
+        // calculated from the set of linear equations above. If they point in
+        // different directions then we need to invert the cross product
+        // calculated bitangent vector. We store this scalar multiplier in the
+        // tangent vector's 'w' component so that the correct bitangent vector
+        // can be generated in the normal mapping shader's vertex shader.
+        //
+        // Normal maps have a left handed coordinate system with the origin
+        // located at the top left of the normal map texture. The x coordinates
+        // run horizontally from left to right. The y coordinates run
+        // vertically from top to bottom. The z coordinates run out of the
+        // normal map texture towards the viewer. Our handedness calculations
+        // must take this fact into account as well so that the normal mapping
+        // shader's vertex shader will generate the correct bitangent vectors.
+        // Some normal map authoring tools such as Crazybump
+        // (http://www.crazybump.com/) includes options to allow you to control
+        // the orientation of the normal map normal's y-axis.
+
+        bitangent[0] = (vertex.normal[1] * vertex.tangent[2]) -
+                       (vertex.normal[2] * vertex.tangent[1]);
+        bitangent[1] = (vertex.normal[2] * vertex.tangent[0]) -
+                       (vertex.normal[0] * vertex.tangent[2]);
+        bitangent[2] = (vertex.normal[0] * vertex.tangent[1]) -
+                       (vertex.normal[1] * vertex.tangent[0]);
+
+        bDotB = bitangent[0] * vertex.bitangent[0] +
+                bitangent[1] * vertex.bitangent[1] +
+                bitangent[2] * vertex.bitangent[2];
+
+        vertex.tangent[3] = (bDotB < 0.0f) ? 1.0f : -1.0f;
+
+        vertex.bitangent[0] = bitangent[0];
+        vertex.bitangent[1] = bitangent[1];
+        vertex.bitangent[2] = bitangent[2];
+    }
+}
+
+void ComputeBounds(const float *pPositions, int count, int stride,
+                   float boundsMin[3], float boundsMax[3], int threadCount)
+{
+    // Every thread bounds its own range. The ranges are merged in order with
+    // the same compares, so ties resolve as in a single pass.
+
+    int numThreads = KernelThreadCount(threadCount, count);
+    std::vector<float> threadBounds(numThreads * 6);
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            threadBounds[i * 6 + k] = std::numeric_limits<float>::max();
+            threadBounds[i * 6 + 3 + k] = -std::numeric_limits<float>::max();
+        }
+    }
+
+    ParallelFor(numThreads, count, [&](int thread, int begin, int end)
+    {
+        BoundsRange(pPositions, stride, begin, end,
+            &threadBounds[thread * 6], &threadBounds[thread * 6 + 3]);
+    });
+
+    for (int k = 0; k < 3; ++k)
+    {
+        boundsMin[k] = threadBounds[k];
+        boundsMax[k] = threadBounds[3 + k];
+    }
+
+    for (int i = 1; i < numThreads; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            if (threadBounds[i * 6 + k] < boundsMin[k])
+                boundsMin[k] = threadBounds[i * 6 + k];
+
+            if (threadBounds[i * 6 + 3 + k] > boundsMax[k])
+                boundsMax[k] = threadBounds[i * 6 + 3 + k];
+        }
+    }
+}
+
+void ComputeNormals(ModelOBJ::Vertex *pVertices, int vertexCount,
+                    const int *pIndices, int triangleCount, int threadCount)
+{
+    // On a single thread this is the scalar loop, which adds every face
+    // normal to its three vertices right away; SSE face normals don't make
+    // up for going through memory twice there. Otherwise the face normals
+    // are computed first, and each thread then owns a range of vertices and
+    // adds up the normals of the triangles using them. Either way every
+    // vertex sums its face normals in triangle order.
+
+    int numThreads = KernelThreadCount(threadCount, std::max(vertexCount, triangleCount));
+
+    if (numThreads == 1)
+    {
+        ComputeNormalsScalar(pVertices, vertexCount, pIndices, triangleCount);
+        return;
+    }
+
+    std::vector<float> faceNormals(static_cast<size_t>(triangleCount) * 4);
+
+    ParallelFor(numThreads, triangleCount, [&](int, int begin, int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            const int *pTriangle = &pIndices[i * 3];
+
+            FaceNormal(pVertices[pTriangle[0]].position, pVertices[pTriangle[1]].position,
+                pVertices[pTriangle[2]].position, &faceNormals[i * 4]);
+        }
+    });
+
+    ParallelFor(numThreads, vertexCount, [&](int, int begin, int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            pVertices[i].normal[0] = 0.0f;
+            pVertices[i].normal[1] = 0.0f;
+            pVertices[i].normal[2] = 0.0f;
+        }
+
+        for (int i = 0; i < triangleCount * 3; ++i)
+        {
+            int v = pIndices[i];
+
+            if (v < begin || v >= end)
+                continue;
+
+            const float *pNormal = &faceNormals[(i / 3) * 4];
+
+            pVertices[v].normal[0] += pNormal[0];
+            pVertices[v].normal[1] += pNormal[1];
+            pVertices[v].normal[2] += pNormal[2];
+        }
+
+        for (int i = begin; i < end; ++i)
+            NormalizeNormal(pVertices[i]);
+    });
+}
+
+void ComputeTangents(ModelOBJ::Vertex *pVertices, int vertexCount,
+                     const int *pIndices, int triangleCount, int threadCount)
+{
+    // Same scheme as ComputeNormals(), including the scalar loop on a single
+    // thread. Face tangents and bitangents are stored as eight floats per
+    // triangle.
+
+    int numThreads = KernelThreadCount(threadCount, std::max(vertexCount, triangleCount));
+
+    if (numThreads == 1)
+    {
+        ComputeTangentsScalar(pVertices, vertexCount, pIndices, triangleCount);
+        return;
+    }
+
+    std::vector<float> faceTangents(static_cast<size_t>(triangleCount) * 8);
+
+    ParallelFor(numThreads, triangleCount, [&](int, int begin, int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            const int *pTriangle = &pIndices[i * 3];
+
+            FaceTangent(pVertices[pTriangle[0]], pVertices[pTriangle[1]],
+                pVertices[pTriangle[2]], &faceTangents[i * 8], &faceTangents[i * 8 + 4]);
+        }
+    });
+
+    ParallelFor(numThreads, vertexCount, [&](int, int begin, int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            std::fill(pVertices[i].tangent, pVertices[i].tangent + 4, 0.0f);
+            std::fill(pVertices[i].bitangent, pVertices[i].bitangent + 3, 0.0f);
+        }
+
+        for (int i = 0; i < triangleCount * 3; ++i)
+        {
+            int v = pIndices[i];
+
+            if (v < begin || v >= end)
+                continue;
+
+            const float *pTangent = &faceTangents[(i / 3) * 8];
+
+            for (int k = 0; k < 3; ++k)
+            {
+                pVertices[v].tangent[k] += pTangent[k];
+                pVertices[v].bitangent[k] += pTangent[4 + k];
+            }
+        }
+
+        for (int i = begin; i < end; ++i)
+            OrthogonalizeTangent(pVertices[i]);
+    });
+}
+
+void FlipNormals(ModelOBJ::Vertex *pVertices, int vertexCount, int threadCount)
+{
+    ParallelFor(KernelThreadCount(threadCount, vertexCount), vertexCount, [&](int, int begin, int end)
+    {
+        FlipNormalsScalar(pVertices + begin, end - begin);
+    });
+}
+
+bool HasSseKernels()
+{
+#if defined(VERTEX_KERNELS_SSE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ComputeBoundsScalar(const float *pPositions, int count, int stride,
+                         float boundsMin[3], float boundsMax[3])
+{
+    float xMax = -std::numeric_limits<float>::max();
+    float yMax = -std::numeric_limits<float>::max();
+    float zMax = -std::numeric_limits<float>::max();
+
+    float xMin = std::numeric_limits<float>::max();
+    float yMin = std::numeric_limits<float>::max();
+    float zMin = std::numeric_limits<float>::max();
+
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const float *pPosition = PositionAt(pPositions, stride, i);
+
+        x = pPosition[0];
+        y = pPosition[1];
+        z = pPosition[2];
+
+        if (x < xMin)
+            xMin = x;
+
+        if (x > xMax)
+            xMax = x;
+
+        if (y < yMin)
+            yMin = y;
+
+        if (y > yMax)
+            yMax = y;
+
+        if (z < zMin)
+            zMin = z;
+
+        if (z > zMax)
+            zMax = z;
+    }
+
+    boundsMin[0] = xMin;
+    boundsMin[1] = yMin;
+    boundsMin[2] = zMin;
+
+    boundsMax[0] = xMax;
+    boundsMax[1] = yMax;
+    boundsMax[2] = zMax;
+}
+
+void ComputeNormalsScalar(ModelOBJ::Vertex *pVertices, int vertexCount,
+                          const int *pIndices, int triangleCount)
+{
+    const int *pTriangle = 0;
+    ModelOBJ::Vertex *pVertex0 = 0;
+    ModelOBJ::Vertex *pVertex1 = 0;
+    ModelOBJ::Vertex *pVertex2 = 0;
+    float edge1[3] = {0.0f, 0.0f, 0.0f};
+    float edge2[3] = {0.0f, 0.0f, 0.0f};
+    float normal[3] = {0.0f, 0.0f, 0.0f};
+
+    // Initialize all the vertex normals.
+    for (int i = 0; i < vertexCount; ++i)
+    {
+        pVertex0 = &pVertices[i];
+        pVertex0->normal[0] = 0.0f;
+        pVertex0->normal[1] = 0.0f;
+        pVertex0->normal[2] = 0.0f;
+    }
+
+    // Calculate the vertex normals.
+    for (int i = 0; i < triangleCount; ++i)
+    {
+        pTriangle = &pIndices[i * 3];
+
+        pVertex0 = &pVertices[pTriangle[0]];
+        pVertex1 = &pVertices[pTriangle[1]];
+        pVertex2 = &pVertices[pTriangle[2]];
+
+        // Calculate triangle face normal.
+
+        edge1[0] = pVertex1->position[0] - pVertex0->position[0];
+        edge1[1] = pVertex1->position[1] - pVertex0->position[1];
+        edge1[2] = pVertex1->position[2] - pVertex0->position[2];
+
+        edge2[0] = pVertex2->position[0] - pVertex0->position[0];
+        edge2[1] = pVertex2->position[1] - pVertex0->position[1];
+        edge2[2] = pVertex2->position[2] - pVertex0->position[2];
+
+        normal[0] = (edge1[1] * edge2[2]) - (edge1[2] * edge2[1]);
+        normal[1] = (edge1[2] * edge2[0]) - (edge1[0] * edge2[2]);
+        normal[2] = (edge1[0] * edge2[1]) - (edge1[1] * edge2[0]);
+
+        // Accumulate the normals.
+
+        pVertex0->normal[0] += normal[0];
+        pVertex0->normal[1] += normal[1];
+        pVertex0->normal[2] += normal[2];
+
+        pVertex1->normal[0] += normal[0];
+        pVertex1->normal[1] += normal[1];
+        pVertex1->normal[2] += normal[2];
+
+        pVertex2->normal[0] += normal[0];
+        pVertex2->normal[1] += normal[1];
+        pVertex2->normal[2] += normal[2];
+    }
+
+    // Normalize the vertex normals.
+    for (int i = 0; i < vertexCount; ++i)
+        NormalizeNormal(pVertices[i]);
+}
+
+void ComputeTangentsScalar(ModelOBJ::Vertex *pVertices, int vertexCount,
+                           const int *pIndices, int triangleCount)
+{
+    const int *pTriangle = 0;
+    ModelOBJ::Vertex *pVertex0 = 0;
+    float tangent[3] = {0.0f, 0.0f, 0.0f};
+    float bitangent[3] = {0.0f, 0.0f, 0.0f};
+
+    // Initialize all the vertex tangents and bitangents.
+    for (int i = 0; i < vertexCount; ++i)
+    {
+        pVertex0 = &pVertices[i];
+
+        pVertex0->tangent[0] = 0.0f;
+        pVertex0->tangent[1] = 0.0f;
+        pVertex0->tangent[2] = 0.0f;
+        pVertex0->tangent[3] = 0.0f;
+
+        pVertex0->bitangent[0] = 0.0f;
+        pVertex0->bitangent[1] = 0.0f;
+        pVertex0->bitangent[2] = 0.0f;
+    }
+
+    // Calculate the vertex tangents and bitangents.
+    for (int i = 0; i < triangleCount; ++i)
+    {
+        pTriangle = &pIndices[i * 3];
+
+        FaceTangent(pVertices[pTriangle[0]], pVertices[pTriangle[1]],
+            pVertices[pTriangle[2]], tangent, bitangent);
+
+        // Accumulate the tangents and bitangents.
+
+        for (int j = 0; j < 3; ++j)
+        {
+            pVertex0 = &pVertices[pTriangle[j]];
+
+            pVertex0->tangent[0] += tangent[0];
+            pVertex0->tangent[1] += tangent[1];
+            pVertex0->tangent[2] += tangent[2];
+            pVertex0->bitangent[0] += bitangent[0];
+            pVertex0->bitangent[1] += bitangent[1];
+            pVertex0->bitangent[2] += bitangent[2];
+        }
+    }
+
+    // Orthogonalize and normalize the vertex tangents.
+    for (int i = 0; i < vertexCount; ++i)
+        OrthogonalizeTangent(pVertices[i]);
+}
+
+void FlipNormalsScalar(ModelOBJ::Vertex *pVertices, int vertexCount)
+{
+    float *pNormal = 0;
+    float *pTangent = 0;
+
+    for (int i = 0; i < vertexCount; ++i)
+    {
+        pNormal = pVertices[i].normal;
+        pNormal[0] = -pNormal[0];
+        pNormal[1] = -pNormal[1];
+        pNormal[2] = -pNormal[2];
+
+        pTangent = pVertices[i].tangent;
+        pTangent[0] = -pTangent[0];
+        pTangent[1] = -pTangent[1];
+        pTangent[2] = -pTangent[2];
+    }
+}
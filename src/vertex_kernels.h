@@ -0,0 +1,58 @@
+// Copyright info of this file is left out for the assignment.
+
+#if !defined(VERTEX_KERNELS_H)
+#define VERTEX_KERNELS_H
+
+#include "model_obj.h"
+
+//-----------------------------------------------------------------------------
+// Geometry kernels run by ModelOBJ on imported models.
+//
+// Each kernel splits its work over up to threadCount threads (0 = one per
+// core; inputs smaller than a few ten thousand vertices stay on the calling
+// thread) and uses SSE when the target has it. Normals and tangents only
+// gain from SSE once split over threads and run the scalar loops on one.
+// The results are bitwise identical to the single threaded scalar versions
+// for any thread count: vertex normals and tangents are gathered per vertex
+// in triangle order rather than scattered from every triangle, so no two
+// threads ever write the same vertex and the sums are added up in the same
+// order.
+//
+// Positions are passed as a pointer to the first position and a byte stride
+// so that the kernels work on both the interleaved vertex buffer and the
+// packed position stream.
+//
+// The *Scalar versions are the plain loops the kernels replaced. They are
+// kept as the reference that tools/kernel_bench.cpp checks and times the
+// kernels against.
+//-----------------------------------------------------------------------------
+
+// Component-wise minimum and maximum of the positions. Empty inputs give
+// boundsMin = FLT_MAX and boundsMax = -FLT_MAX.
+void ComputeBounds(const float *pPositions, int count, int stride,
+    float boundsMin[3], float boundsMax[3], int threadCount);
+
+// Area weighted vertex normals of an indexed triangle list.
+void ComputeNormals(ModelOBJ::Vertex *pVertices, int vertexCount,
+    const int *pIndices, int triangleCount, int threadCount);
+
+// Per vertex tangents orthogonalized against the normals, with the
+// handedness in tangent[3] and the matching bitangents.
+void ComputeTangents(ModelOBJ::Vertex *pVertices, int vertexCount,
+    const int *pIndices, int triangleCount, int threadCount);
+
+// Negates the normals and the xyz of the tangents.
+void FlipNormals(ModelOBJ::Vertex *pVertices, int vertexCount, int threadCount);
+
+// Whether the kernels above were built with SSE.
+bool HasSseKernels();
+
+void ComputeBoundsScalar(const float *pPositions, int count, int stride,
+    float boundsMin[3], float boundsMax[3]);
+void ComputeNormalsScalar(ModelOBJ::Vertex *pVertices, int vertexCount,
+    const int *pIndices, int triangleCount);
+void ComputeTangentsScalar(ModelOBJ::Vertex *pVertices, int vertexCount,
+    const int *pIndices, int triangleCount);
+void FlipNormalsScalar(ModelOBJ::Vertex *pVertices, int vertexCount);
+
+#endif